@@ -0,0 +1,61 @@
+///
+/// @brief Command parser throughput benchmark
+///
+/// Parses a mix of good and bad command lines over and over and reports
+/// how many lines per second CommandParser::parse can handle on the
+/// host.
+///
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include "command_parser.h"
+
+int main()
+{
+  const char* const lines[] = {
+    "abs_pos=500000",
+    "PSTATUS",
+    "mstatus",
+    "rel_pos -100",
+    "Sync=0",
+    "lazyhome",
+    "firmware\r",
+    "junk",
+    "abs_pos=12ab",
+    "perf",
+  };
+  const std::size_t numLines = sizeof( lines ) / sizeof( lines[0] );
+  std::size_t lengths[ numLines ];
+  for ( std::size_t i = 0; i < numLines; ++i )
+  {
+    lengths[i] = strlen( lines[i] );
+  }
+
+  const unsigned long long linesToParse = 20000000;
+  unsigned long long commands = 0;
+  long long argSum = 0;
+
+  const auto start = std::chrono::steady_clock::now();
+  for ( unsigned long long i = 0; i < linesToParse; ++i )
+  {
+    const std::size_t line = i % numLines;
+    CommandParser::CommandPacket cp;
+    if ( CommandParser::parse( lines[ line ], lengths[ line ], cp ) 
+         == CommandParser::ParseError::None )
+    {
+      ++commands;
+      argSum += cp.optionalArg;
+    }
+  }
+  const auto end = std::chrono::steady_clock::now();
+  const double seconds = std::chrono::duration<double>( end - start ).count();
+
+  // Print argSum so the compiler can't skip the parsing.
+  std::cout << "Lines parsed:       " << linesToParse << "\n";
+  std::cout << "Commands found:     " << commands << "\n";
+  std::cout << "Argument checksum:  " << argSum << "\n";
+  std::cout << "Wall clock ms:      " << seconds * 1e3 << "\n";
+  std::cout << "Lines per second:   " << linesToParse / seconds << "\n";
+  return 0;
+}
@@ -0,0 +1,43 @@
+///
+/// @brief Debug output throughput benchmark
+///
+/// Writes the kind of lines the focuser logs through a WifiDebugOstream
+/// whose serial port and net interface throw the output away, and
+/// reports how many bytes and lines per second the debug path can
+/// take on the host.
+///
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include "bench_mocks.h"
+#include "wifi_debug_ostream.h"
+
+int main()
+{
+  const unsigned long long linesToWrite = 20000000;
+
+  NetBenchScripted net( {} );
+  DebugBenchIgnore debug;
+  WifiDebugOstream log( &debug, &net );
+
+  unsigned long long lines = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for ( int position = 0; lines < linesToWrite; ++position )
+  {
+    log << "Moving " << position << "\n";
+    log << "Processing pstatus request\n";
+    log << "Hit home at position " << position << "\nResetting position to 0\n";
+    lines += 4;
+  }
+  const auto end = std::chrono::steady_clock::now();
+  const double seconds = std::chrono::duration<double>( end - start ).count();
+
+  std::cout << "Lines written:      " << lines << "\n";
+  std::cout << "Bytes to the net:   " << net.getBytesWritten() << "\n";
+  std::cout << "Wall clock ms:      " << seconds * 1e3 << "\n";
+  std::cout << "Lines per second:   " << lines / seconds << "\n";
+  std::cout << "MB per second:      " 
+            << net.getBytesWritten() / seconds / 1e6 << "\n";
+  return 0;
+}
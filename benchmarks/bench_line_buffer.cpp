@@ -0,0 +1,52 @@
+///
+/// @brief Line framing throughput benchmark
+///
+/// Feeds a stream of typical client commands, cut into odd sized TCP
+/// segments, through the LineBuffer that WifiConnectionEthernet uses
+/// and measures how many bytes and lines per second it can frame on
+/// the host.
+///
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "bench_mocks.h"
+#include "line_buffer.h"
+
+int main()
+{
+  const unsigned long long linesToFrame = 20000000;
+
+  StreamBenchFragments stream(
+    "abs_pos=500000\npstatus\r\nmstatus\nrel_pos -100\nsstatus\nfirmware\n",
+    { 1, 7, 31, 536, 2, 97 } );
+  LineBuffer<256> buffer;
+
+  unsigned long long lines = 0;
+  unsigned long long lineBytes = 0;
+  std::string line;
+
+  const auto start = std::chrono::steady_clock::now();
+  while ( lines < linesToFrame )
+  {
+    stream.nextSegment();
+    buffer.fill( stream );
+    while ( buffer.getLine( line ))
+    {
+      ++lines;
+      lineBytes += line.length();
+    }
+  }
+  const auto end = std::chrono::steady_clock::now();
+  const double seconds = std::chrono::duration<double>( end - start ).count();
+
+  std::cout << "Lines framed:       " << lines << "\n";
+  std::cout << "Bytes read:         " << stream.getBytesRead() << "\n";
+  std::cout << "Line bytes:         " << lineBytes << "\n";
+  std::cout << "Lines dropped:      " << buffer.linesDropped() << "\n";
+  std::cout << "Wall clock ms:      " << seconds * 1e3 << "\n";
+  std::cout << "Lines per second:   " << lines / seconds << "\n";
+  std::cout << "MB per second:      " 
+            << stream.getBytesRead() / seconds / 1e6 << "\n";
+  return 0;
+}
@@ -0,0 +1,209 @@
+///
+/// @brief Light weight interfaces for host benchmarks
+///
+
+#ifndef __BENCH_MOCKS_H__
+#define __BENCH_MOCKS_H__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "net_interface.h"
+#include "hardware_interface.h"
+#include "debug_interface.h"
+#include "clock_interface.h"
+
+///
+/// @brief Network interface that feeds a fixed script and discards output
+///
+/// Unlike the unit test mocks, nothing is recorded.  The benchmarks want
+/// to measure the focuser, not the cost of logging every output string.
+///
+class NetBenchScripted: public NetInterface
+{
+  public:
+
+  ///
+  /// @brief Constructor
+  ///
+  /// @param[in] scriptArg - Input lines, returned one per getString call
+  ///
+  NetBenchScripted( const std::vector<std::string>& scriptArg )
+    : script{ scriptArg }, nextLine{ 0 }, bytesWritten{ 0 }
+  {
+  }
+
+  void setup( DebugInterface& debugLog ) override
+  {
+    (void) debugLog;
+  }
+
+  bool getString( WifiDebugOstream& log, std::string& string ) override
+  {
+    (void) log;
+    if ( nextLine == script.size() )
+    {
+      return false;
+    }
+    string = script[ nextLine++ ];
+    return true;
+  }
+
+  std::streamsize write( const char_type* s, std::streamsize n ) override
+  {
+    (void) s;
+    bytesWritten += n;
+    return n;
+  }
+
+  void flush() override
+  {
+  }
+
+  /// @brief Total number of bytes the focuser tried to send
+  std::streamsize getBytesWritten() const { return bytesWritten; }
+
+  private:
+
+  const std::vector<std::string> script;
+  size_t nextLine;
+  std::streamsize bytesWritten;
+};
+
+///
+/// @brief Hardware interface that counts step pulses
+///
+class HWBenchCounter: public HWI
+{
+  public:
+
+  HWBenchCounter() : steps{ 0 } 
+  {
+  }
+
+  void DigitalWrite( Pin pin, PinState state ) override
+  {
+    if ( pin == Pin::STEP && state == PinState::STEP_ACTIVE )
+    {
+      ++steps;
+    }
+  }
+
+  void PinMode( Pin pin, PinIOMode mode ) override
+  {
+    (void) pin;
+    (void) mode;
+  }
+
+  PinState DigitalRead( Pin pin ) override
+  {
+    (void) pin;
+    return PinState::HOME_INACTIVE;
+  }
+
+  /// @brief Number of step pulses (STEP_ACTIVE writes) seen so far
+  unsigned int getSteps() const { return steps; }
+
+  private:
+
+  unsigned int steps;
+};
+
+///
+/// @brief Debug interface that ignores all output
+///
+class DebugBenchIgnore: public DebugInterface
+{
+  public:
+
+  std::streamsize write( const char_type* s, std::streamsize n ) override
+  {
+    (void) s;
+    return n;
+  }
+
+  void disable() override
+  {
+  }
+};
+
+///
+/// @brief The host's wall clock, for benchmarks that run in real time
+///
+class ClockBenchSteady: public Clock
+{
+  public:
+
+  uint64_t uSecNow() override
+  {
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>( now ).count();
+  }
+};
+
+///
+/// @brief Byte stream that repeats a text in TCP segment sized pieces
+///
+/// Looks like a WiFiClient to LineBuffer::fill.  Each segment is the
+/// next size from the fragment list, and a segment is only available
+/// after the last one has been read, like data trickling in from a
+/// client.
+///
+class StreamBenchFragments
+{
+  public:
+
+  StreamBenchFragments( 
+    const std::string& textArg, 
+    const std::vector<std::size_t>& fragmentsArg )
+    : text{ textArg }, fragments{ fragmentsArg }, pos{ 0 }, 
+      nextFragment{ 0 }, segmentLeft{ 0 }, bytesRead{ 0 }
+  {
+  }
+
+  int available()
+  {
+    return static_cast<int>( segmentLeft );
+  }
+
+  int read( uint8_t* buffer, std::size_t size )
+  {
+    const std::size_t n = std::min( size, segmentLeft );
+    segmentLeft -= n;
+    bytesRead += n;
+    for ( std::size_t done = 0; done != n; )
+    {
+      const std::size_t run = std::min( n - done, text.length() - pos );
+      memcpy( buffer + done, text.data() + pos, run );
+      done += run;
+      pos = ( pos + run ) % text.length();
+    }
+    return static_cast<int>( n );
+  }
+
+  /// @brief Let the next segment arrive
+  void nextSegment()
+  {
+    segmentLeft = fragments[ nextFragment ];
+    nextFragment = ( nextFragment + 1 ) % fragments.size();
+  }
+
+  unsigned long long getBytesRead() const
+  {
+    return bytesRead;
+  }
+
+  private:
+
+  std::string text;
+  std::vector<std::size_t> fragments;
+  std::size_t pos;
+  std::size_t nextFragment;
+  std::size_t segmentLeft;
+  unsigned long long bytesRead;
+};
+
+#endif
@@ -0,0 +1,380 @@
+///
+/// @brief Network load benchmark
+///
+/// Opens several TCP sessions to a focuser and has each one replay a
+/// mix of status polls, moves and aborts, sending its next command as
+/// soon as the last one is answered.  The run has two phases - polls
+/// only, so the focuser stays idle, then the whole mix, so the focuser
+/// spends the phase stepping - and reports command latency and
+/// throughput for each.
+///
+/// Moves and aborts don't answer, so they're sent as "abs_pos=N;pstatus"
+/// and "abort;pstatus", and their latency is until the joined reply.
+///
+/// By default the focuser runs in this process, serving the simulator's
+/// NetInterfaceEpoll on a free port, and the step pulses in each phase
+/// are counted.  --port sends the load to a simulator that's already
+/// running, i.e., "firware_sim --tcp".
+///
+/// Usage:
+///
+///   bench_net_load [--clients N] [--seconds S] [--port P]
+///                  [--mix polls,moves,aborts]
+///
+/// The defaults are 4 clients, 5 seconds a phase and a mix of 80 polls,
+/// 15 moves and 5 aborts.
+///
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "focuser_state.h"
+#include "bench_mocks.h"
+#include "net_epoll.h"
+
+namespace {
+
+/// @brief How often each kind of command comes up, out of the total
+struct CommandMix {
+  unsigned int polls;
+  unsigned int moves;
+  unsigned int aborts;
+};
+
+enum class Phase { Idle, Stepping, Done };
+
+/// @brief What one client saw in one phase
+struct PhaseResult {
+  std::vector<double> msLatency;
+  unsigned int timeouts = 0;
+};
+
+///
+/// @brief One TCP session that sends a command and waits for its answer
+///
+class LoadClient {
+  public:
+
+  LoadClient( uint16_t port ) : fd{ socket( AF_INET, SOCK_STREAM, 0 ) }
+  {
+    timeval timeout{ 2, 0 };
+    setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ));
+    const int noDelay = 1;
+    setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof( noDelay ));
+
+    sockaddr_in address;
+    memset( &address, 0, sizeof( address ));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    address.sin_port = htons( port );
+    connected = fd >= 0 && connect( fd,
+      reinterpret_cast<sockaddr*>( &address ), sizeof( address )) == 0;
+  }
+
+  ~LoadClient()
+  {
+    if ( fd >= 0 ) close( fd );
+  }
+
+  ///
+  /// @brief Send a command line and wait for its answer
+  ///
+  /// Debug ("# ...") and event lines aren't answers and are skipped.
+  ///
+  /// @param[in] line - The command line, without '\n'
+  /// @return    false if no answer came
+  ///
+  bool command( const std::string& line )
+  {
+    const std::string out = line + "\n";
+    if ( send( fd, out.data(), out.size(), MSG_NOSIGNAL ) !=
+         static_cast<ssize_t>( out.size() ))
+    {
+      return false;
+    }
+    std::string answer;
+    while ( getLine( answer ))
+    {
+      if ( answer.compare( 0, 1, "#" ) != 0 &&
+           answer.compare( 0, 6, "Event:" ) != 0 )
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool connected;
+
+  private:
+
+  bool getLine( std::string& line )
+  {
+    for ( ;; )
+    {
+      const std::size_t newLine = received.find( '\n' );
+      if ( newLine != std::string::npos )
+      {
+        line.assign( received, 0, newLine );
+        received.erase( 0, newLine + 1 );
+        return true;
+      }
+      char buffer[ 512 ];
+      const ssize_t got = recv( fd, buffer, sizeof( buffer ), 0 );
+      if ( got <= 0 )
+      {
+        return false;
+      }
+      received.append( buffer, got );
+    }
+  }
+
+  int fd;
+  std::string received;
+};
+
+/// @brief Replay the mix on one session until the run is done
+void replayMix(
+  uint16_t port, unsigned int id, const CommandMix& mix,
+  const std::atomic<Phase>& phase, PhaseResult results[2] )
+{
+  LoadClient client( port );
+  if ( !client.connected )
+  {
+    ++results[0].timeouts;
+    return;
+  }
+
+  std::mt19937 random( id );
+  const unsigned int total = mix.polls + mix.moves + mix.aborts;
+  const char* const polls[] = { "pstatus", "mstatus", "sstatus" };
+  Phase last = Phase::Idle;
+
+  for ( ;; )
+  {
+    const Phase now = phase.load();
+    if ( now == Phase::Done )
+    {
+      return;
+    }
+
+    // Polls only while idle.  Start stepping with a move.
+    std::string line;
+    unsigned int pick = random() % total;
+    if ( now == Phase::Stepping && last == Phase::Idle )
+    {
+      pick = mix.polls;
+    }
+    last = now;
+    if ( now == Phase::Idle || pick < mix.polls )
+    {
+      line = polls[ random() % 3 ];
+    }
+    else if ( pick < mix.polls + mix.moves )
+    {
+      line = "abs_pos=" + std::to_string( random() % 50001 ) + ";pstatus";
+    }
+    else
+    {
+      line = "abort;pstatus";
+    }
+
+    PhaseResult& result = results[ now == Phase::Idle ? 0 : 1 ];
+    const auto start = std::chrono::steady_clock::now();
+    if ( !client.command( line ))
+    {
+      ++result.timeouts;
+      return;
+    }
+    const auto end = std::chrono::steady_clock::now();
+    result.msLatency.push_back(
+      std::chrono::duration<double, std::milli>( end - start ).count() );
+  }
+}
+
+/// @brief A client's thread.  running counts the threads still going.
+void runClient(
+  uint16_t port, unsigned int id, const CommandMix& mix,
+  const std::atomic<Phase>& phase, std::atomic<unsigned int>& running,
+  PhaseResult results[2] )
+{
+  replayMix( port, id, mix, phase, results );
+  --running;
+}
+
+/// @brief Print one phase's numbers.  steps < 0 if they weren't counted.
+void report(
+  const char* name, std::vector<PhaseResult*> results,
+  double seconds, long long steps )
+{
+  std::vector<double> msLatency;
+  unsigned int timeouts = 0;
+  for ( PhaseResult* result : results )
+  {
+    msLatency.insert( msLatency.end(),
+      result->msLatency.begin(), result->msLatency.end() );
+    timeouts += result->timeouts;
+  }
+  std::sort( msLatency.begin(), msLatency.end() );
+  const std::size_t n = msLatency.size();
+  auto percentile = [&]( std::size_t p ) {
+    return n == 0 ? 0.0 : msLatency[ std::min( n - 1, n * p / 100 ) ];
+  };
+
+  std::cout << name << "\n";
+  std::cout << "  Commands:           " << n << "\n";
+  std::cout << "  Commands per sec:   " << n / seconds << "\n";
+  std::cout << "  p50 latency ms:     " << percentile( 50 ) << "\n";
+  std::cout << "  p99 latency ms:     " << percentile( 99 ) << "\n";
+  std::cout << "  Max latency ms:     " << ( n == 0 ? 0.0 : msLatency.back() ) << "\n";
+  std::cout << "  Timeouts:           " << timeouts << "\n";
+  if ( steps >= 0 )
+  {
+    std::cout << "  Step pulses:        " << steps << "\n";
+  }
+}
+
+} // namespace
+
+int main( int argc, char* argv[] )
+{
+  unsigned int clients = NetInterfaceEpoll::maxConnections;
+  double seconds = 5;
+  unsigned int port = 0;
+  CommandMix mix{ 80, 15, 5 };
+
+  for ( int i = 1; i + 1 < argc; i += 2 )
+  {
+    if ( strcmp( argv[i], "--clients" ) == 0 )
+    {
+      clients = std::strtoul( argv[i+1], nullptr, 10 );
+    }
+    else if ( strcmp( argv[i], "--seconds" ) == 0 )
+    {
+      seconds = std::strtod( argv[i+1], nullptr );
+    }
+    else if ( strcmp( argv[i], "--port" ) == 0 )
+    {
+      port = std::strtoul( argv[i+1], nullptr, 10 );
+    }
+    else if ( strcmp( argv[i], "--mix" ) == 0 )
+    {
+      if ( sscanf( argv[i+1], "%u,%u,%u",
+                   &mix.polls, &mix.moves, &mix.aborts ) != 3 )
+      {
+        std::cerr << "--mix takes polls,moves,aborts\n";
+        return 1;
+      }
+    }
+  }
+  if ( clients == 0 || clients > NetInterfaceEpoll::maxConnections ||
+       mix.polls + mix.moves + mix.aborts == 0 || seconds <= 0 )
+  {
+    std::cerr << "Use 1 to " << NetInterfaceEpoll::maxConnections
+              << " clients, a non-zero mix and some seconds.  More clients "
+                 "than the focuser has slots would just knock each other "
+                 "off.\n";
+    return 1;
+  }
+
+  // The focuser in this process, unless there's one on port.
+  std::unique_ptr<FS::Focuser> focuser;
+  HWBenchCounter* hwAlias = nullptr;
+  if ( port == 0 )
+  {
+    std::unique_ptr<NetInterfaceEpoll> net( new NetInterfaceEpoll( 0 ));
+    if ( !net->open() )
+    {
+      perror( "Can't listen for clients" );
+      return 1;
+    }
+    port = net->getPort();
+    std::unique_ptr<HWBenchCounter> hardware( new HWBenchCounter );
+    hwAlias = hardware.get();
+    focuser.reset( new FS::Focuser(
+      std::move( net ),
+      std::move( hardware ),
+      std::unique_ptr<Clock>( new ClockBenchSteady ),
+      std::unique_ptr<DebugInterface>( new DebugBenchIgnore ),
+      FS::BuildParams( FS::Build::LOW_POWER_HYPERSTAR_FOCUSER )));
+  }
+
+  std::atomic<Phase> phase( Phase::Idle );
+  std::atomic<unsigned int> running( clients );
+  std::vector< std::array< PhaseResult, 2 >> results( clients );
+  std::vector< std::thread > threads;
+  for ( unsigned int i = 0; i < clients; ++i )
+  {
+    threads.emplace_back( runClient, static_cast<uint16_t>( port ), i,
+      std::cref( mix ), std::cref( phase ), std::ref( running ),
+      results[i].data() );
+  }
+
+  // Run the focuser, or just wait, until the phase is over.
+  auto runFor = [&]( double phaseSeconds ) {
+    const auto end = std::chrono::steady_clock::now() +
+      std::chrono::duration<double>( phaseSeconds );
+    while ( std::chrono::steady_clock::now() < end )
+    {
+      if ( !focuser )
+      {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ));
+        continue;
+      }
+      unsigned int pause = focuser->loop();
+      pause = focuser->waitForInput( pause );
+      if ( pause != 0 )
+      {
+        usleep( pause );
+      }
+    }
+  };
+
+  runFor( seconds );
+  const long long idleSteps = hwAlias ? hwAlias->getSteps() : -1;
+  phase = Phase::Stepping;
+  runFor( seconds );
+  const long long steppingSteps = hwAlias ? hwAlias->getSteps() - idleSteps : -1;
+  phase = Phase::Done;
+
+  // Clients waiting on an answer need the focuser to send it.
+  while ( focuser && running != 0 )
+  {
+    runFor( 0.01 );
+  }
+  for ( std::thread& thread : threads )
+  {
+    thread.join();
+  }
+
+  std::vector<PhaseResult*> idle;
+  std::vector<PhaseResult*> stepping;
+  for ( std::array< PhaseResult, 2 >& result : results )
+  {
+    idle.push_back( &result[0] );
+    stepping.push_back( &result[1] );
+  }
+  std::cout << "Clients:              " << clients << "\n";
+  std::cout << "Mix:                  " << mix.polls << " polls, "
+            << mix.moves << " moves, " << mix.aborts << " aborts\n";
+  report( "Idle, polls only", idle, seconds, idleSteps );
+  report( "Stepping, whole mix", stepping, seconds, steppingSteps );
+  return 0;
+}
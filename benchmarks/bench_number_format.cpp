@@ -0,0 +1,105 @@
+///
+/// @brief Number formatting benchmark
+///
+/// Writes a spread of positions and times to a net interface that
+/// throws the output away, first with the old digit at a time
+/// formatting (one virtual write per digit) and then with the
+/// simple_ostream operators, and reports numbers per second for each.
+///
+
+#include <chrono>
+#include <iostream>
+#include "bench_mocks.h"
+#include "simple_ostream.h"
+
+namespace {
+
+/// @brief The old operator<<( sink, unsigned int ), kept to compare with
+template< class T >
+void digitAtATime( T& sink, unsigned int i )
+{
+  if ( i >= 10 )
+  {
+    digitAtATime( sink, i/10 );
+  }
+  char c = '0' + (i % 10);
+  sink.write( &c, 1 );
+}
+
+template< class T >
+void digitAtATime( T& sink, int i )
+{
+  if ( i < 0 )
+  {
+    sink << "-";
+    i = -i;
+  }
+  digitAtATime( sink, (unsigned int) i );
+}
+
+/// @brief Time numbersToWrite calls of format.  Returns seconds.
+template< typename Format >
+double run( unsigned long long numbersToWrite, Format format )
+{
+  const auto start = std::chrono::steady_clock::now();
+  for ( unsigned long long i = 0; i < numbersToWrite; ++i )
+  {
+    // Focuser positions, with some negative relative moves mixed in.
+    const int n = static_cast<int>( i * 7919 % 500000 ) - 
+      ( i % 8 == 0 ? 250000 : 0 );
+    format( n );
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>( end - start ).count();
+}
+
+} // namespace
+
+int main()
+{
+  const unsigned long long numbersToWrite = 20000000;
+
+  NetBenchScripted oldNet( {} );
+  NetInterface& oldSink = oldNet;
+  const double oldSeconds = run( numbersToWrite, [&]( int n ) {
+    digitAtATime( oldSink, n );
+  });
+
+  NetBenchScripted newNet( {} );
+  NetInterface& newSink = newNet;
+  const double newSeconds = run( numbersToWrite, [&]( int n ) {
+    newSink << n;
+  });
+
+  // Fixed point and hex, which only have the new path.
+  NetBenchScripted fixedNet( {} );
+  NetInterface& fixedSink = fixedNet;
+  const double fixedSeconds = run( numbersToWrite, [&]( int n ) {
+    fixedSink << BeeFocus::fixed( n, 3 );
+  });
+  NetBenchScripted hexNet( {} );
+  NetInterface& hexSink = hexNet;
+  const double hexSeconds = run( numbersToWrite, [&]( int n ) {
+    hexSink << BeeFocus::hex( static_cast<unsigned int>( n ), 8 );
+  });
+
+  std::cout << "Numbers written:    " << numbersToWrite << "\n";
+  std::cout << "Bytes per pass:     " << newNet.getBytesWritten() << "\n";
+  std::cout << "Digit at a time:    " << numbersToWrite / oldSeconds 
+            << " numbers/s\n";
+  std::cout << "Buffered decimal:   " << numbersToWrite / newSeconds 
+            << " numbers/s\n";
+  std::cout << "Buffered fixed(3):  " << numbersToWrite / fixedSeconds 
+            << " numbers/s\n";
+  std::cout << "Buffered hex(8):    " << numbersToWrite / hexSeconds
+            << " numbers/s\n";
+  std::cout << "Speed up:           " << oldSeconds / newSeconds << "\n";
+
+  // Check the new path writes the same bytes as the old one.
+  if ( oldNet.getBytesWritten() != newNet.getBytesWritten() )
+  {
+    std::cout << "Byte counts differ!\n";
+    return 1;
+  }
+  return 0;
+}
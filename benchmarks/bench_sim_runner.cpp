@@ -0,0 +1,51 @@
+///
+/// @brief Virtual time simulation benchmark
+///
+/// Uses a SimRunner to move the micro-stepping Hyperstar build to the
+/// end of its travel (500000 steps), then leaves it idle for the rest
+/// of 4 hours of virtual time.  Reports how long that took on the
+/// host.
+///
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include "focuser_state.h"
+#include "bench_mocks.h"
+#include "sim_runner.h"
+
+int main()
+{
+  const uint64_t uSecToRun = 4ull * 60 * 60 * 1000 * 1000;
+
+  std::unique_ptr<NetBenchScripted> net(
+    new NetBenchScripted( { "abs_pos=500000" } ));
+  std::unique_ptr<HWBenchCounter> hardware( new HWBenchCounter );
+  std::unique_ptr<VirtualClock> clock( new VirtualClock );
+  std::unique_ptr<DebugBenchIgnore> debug( new DebugBenchIgnore );
+  HWBenchCounter* hwAlias = hardware.get();
+  VirtualClock* clockAlias = clock.get();
+
+  FS::Focuser focuser(
+    std::move( net ),
+    std::move( hardware ),
+    std::move( clock ),
+    std::move( debug ),
+    FS::BuildParams( FS::Build::LOW_POWER_HYPERSTAR_FOCUSER_MICROSTEP ));
+
+  SimRunner runner( focuser );
+  runner.add( *clockAlias );
+
+  const auto start = std::chrono::steady_clock::now();
+  const uint64_t loopCalls = runner.runUntil( uSecToRun );
+  const auto end = std::chrono::steady_clock::now();
+  const double seconds = std::chrono::duration<double>( end - start ).count();
+
+  std::cout << "Virtual seconds:    " << runner.uSecNow() / 1e6 << "\n";
+  std::cout << "Step pulses:        " << hwAlias->getSteps() << "\n";
+  std::cout << "loop() calls:       " << loopCalls << "\n";
+  std::cout << "Wall clock ms:      " << seconds * 1e3 << "\n";
+  std::cout << "Virtual/wall ratio: "
+            << runner.uSecNow() / 1e6 / seconds << "\n";
+  return 0;
+}
@@ -0,0 +1,55 @@
+///
+/// @brief Step pulse throughput benchmark
+///
+/// Runs a long move on the micro-stepping Hyperstar build and measures
+/// how many step pulses per second Focuser::loop can generate on the
+/// host, ignoring the pauses that loop asks for.  This is the CPU
+/// overhead the focuser adds to every step.
+///
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include "focuser_state.h"
+#include "bench_mocks.h"
+#include "sim_runner.h"
+
+int main()
+{
+  const unsigned int pulsesToRun = 400000;
+
+  std::unique_ptr<NetBenchScripted> net( 
+    new NetBenchScripted( { "abs_pos=500000" } ));
+  std::unique_ptr<HWBenchCounter> hardware( new HWBenchCounter );
+  std::unique_ptr<VirtualClock> clock( new VirtualClock );
+  std::unique_ptr<DebugBenchIgnore> debug( new DebugBenchIgnore );
+  HWBenchCounter* hwAlias = hardware.get();
+  VirtualClock* clockAlias = clock.get();
+
+  FS::Focuser focuser( 
+    std::move( net ), 
+    std::move( hardware ), 
+    std::move( clock ), 
+    std::move( debug ),
+    FS::BuildParams( FS::Build::LOW_POWER_HYPERSTAR_FOCUSER_MICROSTEP ));
+
+  unsigned long long loopCalls = 0;
+  const auto start = std::chrono::steady_clock::now();
+  while ( hwAlias->getSteps() < pulsesToRun )
+  {
+    // Don't wait, but let the focuser think it did.
+    clockAlias->setTime( clockAlias->uSecNow() + focuser.loop() );
+    ++loopCalls;
+  }
+  const auto end = std::chrono::steady_clock::now();
+  const double seconds = std::chrono::duration<double>( end - start ).count();
+
+  std::cout << "Step pulses:        " << hwAlias->getSteps() << "\n";
+  std::cout << "loop() calls:       " << loopCalls << "\n";
+  std::cout << "loop() per pulse:   " 
+            << double( loopCalls ) / hwAlias->getSteps() << "\n";
+  std::cout << "Pulses per second:  " << hwAlias->getSteps() / seconds << "\n";
+  std::cout << "ns per pulse:       " 
+            << seconds * 1e9 / hwAlias->getSteps() << "\n";
+  return 0;
+}
@@ -2,6 +2,7 @@
 #define __BASIC_TYPES_H__
 
 #include <array>
+#include <cstddef>
 
 namespace BeeFocus
 {
@@ -25,6 +26,40 @@ namespace BeeFocus
     }
     return e;
   }
+
+  ///
+  /// @brief Get an enum's value as a table index
+  ///
+  template< typename ENUM >
+  constexpr std::size_t toIndex( ENUM e )
+  {
+    return static_cast<std::size_t>( e );
+  }
+
+  ///
+  /// @brief Check that a table can be indexed by an enum (compile time)
+  ///
+  /// Tables that are indexed by an enum have a key member that holds the
+  /// enum value for each entry.  The table is good if table[i].key == i 
+  /// for every entry.  Use it in a static_assert so missing or out of
+  /// order entries are build errors, i.e.,
+  ///
+  /// @code
+  ///   static_assert( BeeFocus::isEnumIndexed( stateImpl ), 
+  ///     "stateImpl must have one entry per State, in enum order" );
+  /// @endcode
+  ///
+  /// @param[in] table  - The table to check.  Declare it with the 
+  ///                     enum's size so a short initializer leaves 
+  ///                     zeroed entries that fail the check.
+  /// @param[in] i      - Internal - the entry we're checking.
+  ///
+  template< typename T, std::size_t N >
+  constexpr bool isEnumIndexed( const T (&table)[N], std::size_t i = 0 )
+  {
+    return i == N ? true : 
+      ( toIndex( table[i].key ) == i && isEnumIndexed( table, i + 1 ));
+  }
 };
 
 
@@ -0,0 +1,174 @@
+
+#include "binary_protocol.h"
+
+namespace BinaryProtocol
+{
+
+/// @brief Store an int32, little endian
+static uint8_t* putInt( int32_t value, uint8_t* dest )
+{
+  const uint32_t bits = static_cast<uint32_t>( value );
+  for ( int i = 0; i < 4; ++i )
+  {
+    *dest++ = static_cast<uint8_t>( bits >> ( 8 * i ));
+  }
+  return dest;
+}
+
+/// @brief Load an int32, little endian
+static int32_t getInt( const uint8_t* src )
+{
+  uint32_t bits = 0;
+  for ( int i = 0; i < 4; ++i )
+  {
+    bits |= static_cast<uint32_t>( src[i] ) << ( 8 * i );
+  }
+  return static_cast<int32_t>( bits );
+}
+
+///
+/// @brief Put the magic, length and checksum around a payload
+///
+/// @param[in,out] frame  - The payload is already at frame + 2
+/// @param[in]     length - Bytes in the payload
+/// @return        The frame's length
+///
+static std::size_t seal( uint8_t* frame, std::size_t length )
+{
+  frame[0] = magic;
+  frame[1] = static_cast<uint8_t>( length );
+  uint8_t sum = 0;
+  for ( std::size_t i = 1; i < length + 2; ++i )
+  {
+    sum += frame[i];
+  }
+  frame[ length + 2 ] = static_cast<uint8_t>( -sum );
+  return length + overhead;
+}
+
+std::size_t encodeRequest( const CommandParser::CommandPacket& cp,
+                           uint8_t* frame )
+{
+  uint8_t* payload = frame + 2;
+  payload[0] = static_cast<uint8_t>( cp.command );
+  if ( !CommandParser::hasArg( cp.command ))
+  {
+    return seal( frame, 1 );
+  }
+  putInt( cp.optionalArg, payload + 1 );
+  return seal( frame, 5 );
+}
+
+CommandParser::ParseError decodeRequest(
+  const uint8_t* frame, std::size_t length,
+  CommandParser::CommandPacket& cp )
+{
+  using CommandParser::ParseError;
+  using CommandParser::Command;
+
+  if ( length < overhead + 1 || frame[0] != magic 
+       || frame[1] + overhead != length )
+  {
+    return ParseError::BadFrame;
+  }
+  uint8_t sum = 0;
+  for ( std::size_t i = 1; i < length; ++i )
+  {
+    sum += frame[i];
+  }
+  if ( sum != 0 )
+  {
+    return ParseError::BadFrame;
+  }
+
+  const uint8_t* payload = frame + 2;
+  if ( payload[0] >= BeeFocus::toIndex( Command::NoCommand ))
+  {
+    return ParseError::UnknownCommand;
+  }
+  const Command command = static_cast<Command>( payload[0] );
+  int arg = CommandParser::NoArg;
+  if ( CommandParser::hasArg( command ))
+  {
+    if ( frame[1] != 5 )
+    {
+      return ParseError::MissingArg;
+    }
+    arg = getInt( payload + 1 );
+  }
+  cp = CommandParser::CommandPacket( command, arg );
+  return ParseError::None;
+}
+
+std::size_t encodePosition( int32_t position, uint8_t* frame )
+{
+  uint8_t* payload = frame + 2;
+  payload[0] = static_cast<uint8_t>( ResponseType::Position );
+  putInt( position, payload + 1 );
+  return seal( frame, 5 );
+}
+
+std::size_t encodeState( uint8_t state, int32_t arg, uint8_t* frame )
+{
+  uint8_t* payload = frame + 2;
+  payload[0] = static_cast<uint8_t>( ResponseType::State );
+  payload[1] = state;
+  putInt( arg, payload + 2 );
+  return seal( frame, 6 );
+}
+
+std::size_t encodeSynched( bool synched, uint8_t* frame )
+{
+  uint8_t* payload = frame + 2;
+  payload[0] = static_cast<uint8_t>( ResponseType::Synched );
+  payload[1] = synched ? 1 : 0;
+  return seal( frame, 2 );
+}
+
+std::size_t encodeDone( int32_t position, uint8_t* frame )
+{
+  uint8_t* payload = frame + 2;
+  payload[0] = static_cast<uint8_t>( ResponseType::Done );
+  putInt( position, payload + 1 );
+  return seal( frame, 5 );
+}
+
+std::size_t encodeTrace( const Trace::Record* records, std::size_t count,
+                         uint8_t* frame )
+{
+  uint8_t* payload = frame + 2;
+  payload[0] = static_cast<uint8_t>( ResponseType::Trace );
+  uint8_t* dest = payload + 1;
+  for ( std::size_t i = 0; i < count; ++i )
+  {
+    dest = Trace::encode( records[i], dest );
+  }
+  return seal( frame, 1 + count * Trace::recordBytes );
+}
+
+std::size_t encodeTraceEnd( uint32_t lost, uint8_t* frame )
+{
+  uint8_t* payload = frame + 2;
+  payload[0] = static_cast<uint8_t>( ResponseType::TraceEnd );
+  putInt( static_cast<int32_t>( lost ), payload + 1 );
+  return seal( frame, 5 );
+}
+
+std::size_t encodeText( const char* text, std::size_t length,
+                        uint8_t* frame )
+{
+  if ( length > maxPayload - 1 )
+  {
+    length = maxPayload - 1;
+  }
+  uint8_t* payload = frame + 2;
+  payload[0] = static_cast<uint8_t>( ResponseType::Text );
+  for ( std::size_t i = 0; i < length; ++i )
+  {
+    payload[ i + 1 ] = static_cast<uint8_t>( text[i] );
+  }
+  return seal( frame, length + 1 );
+}
+
+}
+
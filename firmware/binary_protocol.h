@@ -0,0 +1,173 @@
+#ifndef __BINARY_PROTOCOL_H__
+#define __BINARY_PROTOCOL_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "command_parser.h"
+#include "trace_ring.h"
+
+///
+/// @brief Compact binary framing for the command protocol
+///
+/// A client switches its connection to binary framing by sending the
+/// text command "binary=1" and waiting for the "Binary: ON" reply.
+/// From then on both directions are frames:
+///
+/// @code
+///   +-------+--------+-------------------+----------+
+///   | magic | length | payload           | checksum |
+///   | 0xB5  | 1 byte | "length" bytes    | 1 byte   |
+///   +-------+--------+-------------------+----------+
+/// @endcode
+///
+/// The checksum makes the 8 bit sum of length, payload and checksum 0.
+/// Multi-byte numbers are little endian.
+///
+/// Request payloads are a Command (one byte, its enum value) followed
+/// by an int32 argument for commands that take one - 1 or 5 bytes.
+///
+/// Response payloads start with a ResponseType.  pstatus, mstatus and
+/// sstatus get fixed layout responses, everything else is sent as Text
+/// frames that hold one line of the text protocol, without the '\n'.
+/// A request frame for "binary" with argument 0 goes back to text.
+/// Motion updates for "subscribe" are pushed as Position, State and
+/// Done frames.  "trace" is answered with Trace frames, oldest records
+/// first, and a TraceEnd frame.
+///
+namespace BinaryProtocol {
+
+  constexpr uint8_t magic = 0xB5;
+
+  /// @brief Bytes in a frame that aren't payload
+  constexpr std::size_t overhead = 3;
+
+  /// @brief Longest payload in a frame.  Fits in a connection's buffer.
+  constexpr std::size_t maxPayload = 128;
+
+  /// @brief Longest frame
+  constexpr std::size_t maxFrame = maxPayload + overhead;
+
+  /// @brief Most Trace::Records in a Trace frame
+  constexpr std::size_t maxTraceRecords = 
+    ( maxPayload - 1 ) / Trace::recordBytes;
+
+  /// @brief The first byte of a response payload
+  enum class ResponseType : uint8_t {
+    Position = 1,   ///<  int32 position
+    State    = 2,   ///<  uint8 State, int32 argument.  -1 for none.
+    Synched  = 3,   ///<  uint8 1 if synched, 0 if not
+    Done     = 4,   ///<  int32 position a move ended at.  Pushed.
+    Trace    = 5,   ///<  Up to maxTraceRecords Trace::Records
+    TraceEnd = 6,   ///<  uint32 records lost.  Ends a trace download.
+    Text     = 0x7F ///<  A line of text
+  };
+
+  ///
+  /// @brief Build a request frame
+  ///
+  /// @param[in]  cp    - The command.  The argument is only sent if
+  ///                     the command takes one.
+  /// @param[out] frame - At least 8 bytes
+  /// @return     The frame's length
+  ///
+  std::size_t encodeRequest( const CommandParser::CommandPacket& cp,
+                             uint8_t* frame );
+
+  ///
+  /// @brief Read a request frame
+  ///
+  /// @param[in]  frame  - The frame, magic byte first
+  /// @param[in]  length - Bytes in the frame
+  /// @param[out] cp     - The command.  Only set if the result is None.
+  /// @return     None, BadFrame, UnknownCommand or MissingArg
+  ///
+  CommandParser::ParseError decodeRequest(
+    const uint8_t* frame, std::size_t length,
+    CommandParser::CommandPacket& cp );
+
+  /// @brief Does a line from getString hold a frame, not text?
+  inline bool isFrame( const std::string& line )
+  {
+    return !line.empty() && static_cast<uint8_t>( line[0] ) == magic;
+  }
+
+  /// @brief Build a Position response.  frame is at least 8 bytes.
+  std::size_t encodePosition( int32_t position, uint8_t* frame );
+
+  /// @brief Build a State response.  frame is at least 9 bytes.
+  std::size_t encodeState( uint8_t state, int32_t arg, uint8_t* frame );
+
+  /// @brief Build a Synched response.  frame is at least 5 bytes.
+  std::size_t encodeSynched( bool synched, uint8_t* frame );
+
+  /// @brief Build a Done event.  frame is at least 8 bytes.
+  std::size_t encodeDone( int32_t position, uint8_t* frame );
+
+  ///
+  /// @brief Build a Trace response
+  ///
+  /// @param[in]  records - The records, oldest first
+  /// @param[in]  count   - How many.  No more than maxTraceRecords.
+  /// @param[out] frame   - At least maxFrame bytes
+  /// @return     The frame's length
+  ///
+  std::size_t encodeTrace( const Trace::Record* records, std::size_t count,
+                           uint8_t* frame );
+
+  /// @brief Build a TraceEnd response.  frame is at least 8 bytes.
+  std::size_t encodeTraceEnd( uint32_t lost, uint8_t* frame );
+
+  ///
+  /// @brief Build a Text response
+  ///
+  /// @param[in]  text   - The line, without '\n'.  Cut short if it
+  ///                      won't fit in a frame.
+  /// @param[in]  length - Characters in the line
+  /// @param[out] frame  - At least maxFrame bytes
+  /// @return     The frame's length
+  ///
+  std::size_t encodeText( const char* text, std::size_t length,
+                          uint8_t* frame );
+
+  ///
+  /// @brief Take the next frame out of a byte buffer
+  ///
+  /// Bytes that can't start a frame are thrown away, so the reader
+  /// finds its feet again after garbage.  The checksum is checked by
+  /// decodeRequest.
+  ///
+  /// @tparam     Buffer - A LineBuffer
+  /// @param[in]  buffer - Where the input is
+  /// @param[out] frame  - The whole frame, magic byte first
+  /// @return     true if there was a complete frame
+  ///
+  template< typename Buffer >
+  bool getFrame( Buffer& buffer, std::string& frame )
+  {
+    for ( ;; )
+    {
+      char header[2];
+      if ( buffer.peek( header, 2 ) < 1 ) return false;
+      if ( static_cast<uint8_t>( header[0] ) != magic )
+      {
+        buffer.drop( 1 );
+        continue;
+      }
+      if ( buffer.size() < 2 ) return false;
+      const std::size_t payload = static_cast<uint8_t>( header[1] );
+      if ( payload > maxPayload )
+      {
+        buffer.drop( 1 );
+        continue;
+      }
+      const std::size_t length = payload + overhead;
+      if ( buffer.size() < length ) return false;
+      buffer.getBytes( frame, length );
+      return true;
+    }
+  }
+}
+
+#endif
+
@@ -0,0 +1,9 @@
+#include <ESP8266WiFi.h>
+#include "clock_esp8266.h"
+
+uint64_t ClockESP8266::uSecNow()
+{
+  // micros() wraps every 71 minutes.  micros64() doesn't.
+  return micros64();
+}
+
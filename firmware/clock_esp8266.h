@@ -0,0 +1,14 @@
+#ifndef __CLOCK_ESP8266_H__
+#define __CLOCK_ESP8266_H__
+
+#include "clock_interface.h"
+
+class ClockESP8266: public Clock
+{
+  public:
+
+  uint64_t uSecNow() override;
+};
+
+#endif
+
@@ -0,0 +1,23 @@
+#ifndef __CLOCK_INTERFACE_H__
+#define __CLOCK_INTERFACE_H__
+
+#include <cstdint>
+
+/// @brief Interface to a monotonic clock
+///
+/// This class's one job is to tell the focuser what time it is.  The
+/// clock is 64 bits of microseconds, so it won't wrap in the lifetime
+/// of the focuser.
+///
+class Clock {
+  public:
+
+  virtual ~Clock() {}
+
+  /// @brief Microseconds since an arbitrary starting point.  Never goes
+  ///        backward.
+  virtual uint64_t uSecNow() = 0;
+};
+
+#endif
+
@@ -2,8 +2,11 @@
 #include "debug_interface.h"
 #include "command_parser.h"
 #include "wifi_debug_ostream.h"
-#include <vector>
-#include <algorithm>
+#include "binary_protocol.h"
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 
 namespace CommandParser
 {
@@ -21,94 +24,445 @@ class CommandTemplate
 {
   public:
 
-  const std::string inputCommand;
-  CommandParser::Command outputCommand;
-  const HasArg hasArg;
+  Command key;          ///< The command
+  const char* name;     ///< The command's name, in lower case
+  HasArg hasArg;        ///< Does the command take an integer argument
 };
 
-const std::vector<CommandTemplate> commandTemplates =
-{
-  { "abort",      Command::Abort,    HasArg::No  },
-  { "home",       Command::Home,     HasArg::No  },
-  { "lazyhome",   Command::LHome,    HasArg::No  },
-  { "pstatus",    Command::PStatus,  HasArg::No  },
-  { "mstatus",    Command::MStatus,  HasArg::No  },
-  { "sstatus",    Command::SStatus,  HasArg::No  },
-  { "abs_pos",    Command::ABSPos,   HasArg::Yes },
-  { "rel_pos",    Command::RELPos,   HasArg::Yes },
-  { "sync",       Command::Sync,     HasArg::Yes },
-  { "firmware",   Command::Firmware, HasArg::No  },
-  { "caps",       Command::Caps,     HasArg::No  },
-  { "debugoff",   Command::DebugOff, HasArg::No  },
+// Indexed by Command, so entries must stay in enum order.
+constexpr CommandTemplate 
+  commandTemplates[ BeeFocus::toIndex( Command::NoCommand ) ] =
+{
+  { Command::Abort,    "abort",    HasArg::No  },
+  { Command::Home,     "home",     HasArg::No  },
+  { Command::LHome,    "lazyhome", HasArg::No  },
+  { Command::PStatus,  "pstatus",  HasArg::No  },
+  { Command::MStatus,  "mstatus",  HasArg::No  },
+  { Command::SStatus,  "sstatus",  HasArg::No  },
+  { Command::ABSPos,   "abs_pos",  HasArg::Yes },
+  { Command::RELPos,   "rel_pos",  HasArg::Yes },
+  { Command::Sync,     "sync",     HasArg::Yes },
+  { Command::Firmware, "firmware", HasArg::No  },
+  { Command::Caps,     "caps",     HasArg::No  },
+  { Command::DebugOff, "debugoff", HasArg::No  },
+  { Command::Perf,     "perf",     HasArg::No  },
+  { Command::Events,   "events",   HasArg::Yes },
+  { Command::Binary,   "binary",   HasArg::Yes },
+  { Command::Subscribe, "subscribe", HasArg::Yes },
+  { Command::Threshold, "threshold", HasArg::Yes },
+  { Command::Verbose,   "verbose",   HasArg::Yes },
+  { Command::Trace,     "trace",     HasArg::No  },
 }; 
 
-/// @brief Process an integer argument
-///
-/// Read an integer argument from a string in a way that's guaranteed
-/// not to allocate memory 
+static_assert( BeeFocus::isEnumIndexed( commandTemplates ),
+  "commandTemplates must have one entry per Command, in enum order" );
+
+constexpr std::size_t numCommands = BeeFocus::toIndex( Command::NoCommand );
+
+class ErrorName
+{
+  public:
+
+  ParseError key;
+  const char* name;
+};
+
+// Indexed by ParseError, so entries must stay in enum order.
+constexpr ErrorName 
+  errorNames[ BeeFocus::toIndex( ParseError::EndOfErrors ) ] =
+{
+  { ParseError::None,           "none" },
+  { ParseError::Empty,          "empty line" },
+  { ParseError::UnknownCommand, "unknown command" },
+  { ParseError::MissingArg,     "missing argument" },
+  { ParseError::BadArg,         "bad argument" },
+  { ParseError::ArgOutOfRange,  "argument out of range" },
+  { ParseError::BadFrame,       "bad frame" },
+  { ParseError::TooManyCommands, "too many commands" },
+};
+
+static_assert( BeeFocus::isEnumIndexed( errorNames ),
+  "errorNames must have one entry per ParseError, in enum order" );
+
+/////////////////////////////////////////////////////////////////////////
+//
+// Command name hash table.
+//
+// A command's hash is a case-insensitive FNV-1a hash of its whole name.
+// Every command gets its own slot, so a lookup is one hash, one table
+// read and one compare.  The table is built by the compiler from 
+// commandTemplates.  If a new command collides with an old one the 
+// static_assert below fails - try another value for hashSlots until it
+// passes.
+//
+/////////////////////////////////////////////////////////////////////////
+
+constexpr std::size_t hashSlots = 55;
+
+/// @brief Lower case an ASCII letter.  Anything else is unchanged.
+constexpr char toLower( char c )
+{
+  return ( c >= 'A' && c <= 'Z' ) ? static_cast<char>( c - 'A' + 'a' ) : c;
+}
+
+/// @brief strlen that works at compile time
+constexpr std::size_t nameLength( const char* name )
+{
+  return *name == 0 ? 0 : 1 + nameLength( name + 1 );
+}
+
+constexpr uint32_t fnvOffsetBasis = 2166136261u;
+constexpr uint32_t fnvPrime = 16777619u;
+
+/// @brief FNV-1a hash of length characters, lower cased
+constexpr uint32_t fnvHash( const char* s, std::size_t length, 
+                            uint32_t hash = fnvOffsetBasis )
+{
+  return length == 0 ? hash : fnvHash( s + 1, length - 1,
+    ( hash ^ static_cast<unsigned char>( toLower( *s ))) * fnvPrime );
+}
+
+/// @brief Hash a command name
+constexpr std::size_t hashName( const char* name, std::size_t length )
+{
+  return fnvHash( name, length ) % hashSlots;
+}
+
+/// @brief The longest command name, from commandTemplates[ i ] on
+constexpr std::size_t longestName( std::size_t i = 0 )
+{
+  return i == numCommands ? 0 : 
+    nameLength( commandTemplates[i].name ) > longestName( i + 1 ) ?
+      nameLength( commandTemplates[i].name ) : longestName( i + 1 );
+}
+
+constexpr std::size_t maxNameLength = longestName();
+
+/// @brief Hash the name of commandTemplates[ i ]
+constexpr std::size_t hashTemplate( std::size_t i )
+{
+  return hashName( commandTemplates[i].name, 
+                   nameLength( commandTemplates[i].name ));
+}
+
+/// @brief The command that hashes to slot.  NoCommand if there's none.
+constexpr Command commandInSlot( std::size_t slot, std::size_t i = 0 )
+{
+  return i == numCommands ? Command::NoCommand :
+    hashTemplate( i ) == slot ? commandTemplates[i].key : 
+    commandInSlot( slot, i + 1 );
+}
+
+/// @brief Does every command hash to a slot of its own?
+constexpr bool isHashPerfect( std::size_t i = 0 )
+{
+  return i == numCommands ? true :
+    ( commandInSlot( hashTemplate( i )) == commandTemplates[i].key 
+      && isHashPerfect( i + 1 ));
+}
+
+static_assert( isHashPerfect(), 
+  "Command names collide in the hash table - change hashSlots" );
+
+/// @brief A list of slot numbers, used to build the hash table
+template< std::size_t... Slot > struct SlotList {};
+
+/// @brief Make SlotList< 0, 1, ..., N-1 >
+template< std::size_t N, std::size_t... Slot > 
+struct MakeSlotList: MakeSlotList< N - 1, N - 1, Slot... > {};
+
+template< std::size_t... Slot > 
+struct MakeSlotList< 0, Slot... > 
+{ 
+  using type = SlotList< Slot... >;
+};
+
+template< std::size_t... Slot >
+constexpr std::array< Command, sizeof...( Slot ) > makeHashTable( 
+  SlotList< Slot... > )
+{
+  return {{ commandInSlot( Slot )... }};
+}
+
+constexpr std::array< Command, hashSlots > hashTable = 
+  makeHashTable( MakeSlotList< hashSlots >::type() );
+
+/// @brief Find a command by name, ignoring case
 ///
-/// @param[in] string - The string
-/// @param[in] pos    - The start position in the string.  i.e., if pos=5
-///   we'll look for the number at string element 5.
-/// @return           - The result.  Currently 0 if there's no number.
+/// @param[in] name   - The name.  Needn't be null terminated.
+/// @param[in] length - Number of characters in the name
+/// @return           - The command's template, or nullptr if there's
+///                     no command with that name.
 ///
-int process_int( const std::string& string,  size_t pos )
+static const CommandTemplate* findCommand( 
+  const char* name, 
+  std::size_t length )
+{
+  if ( length == 0 || length > maxNameLength )
+  {
+    return nullptr;
+  }
+  const Command command = hashTable[ hashName( name, length ) ];
+  if ( command == Command::NoCommand )
+  {
+    return nullptr;
+  }
+  const CommandTemplate& ct = commandTemplates[ BeeFocus::toIndex( command ) ];
+  std::size_t i = 0;
+  for ( ; i < length && ct.name[i] != 0; ++i )
+  {
+    if ( toLower( name[i] ) != ct.name[i] )
+    {
+      return nullptr;
+    }
+  }
+  return ( i == length && ct.name[i] == 0 ) ? &ct : nullptr;
+}
+
+static bool isSpace( char c )
 {
-  size_t end = string.length();
-  if ( pos > end )
-    return 0;
+  return c == ' ' || c == '\t' || c == '\r';
+}
 
-  const bool negative = (string[pos] == '-');
-  if ( negative ) ++pos;
+constexpr std::size_t CommandQueue::capacity;
+constexpr std::size_t CommandQueue::maxCommandsPerLine;
+constexpr std::size_t CommandQueue::storage;
 
-  int result = 0;
-  for ( size_t iter = pos; iter != end; iter++ ) {
-    char current = string[ iter ];
-    if ( current >= '0' && current <= '9' )
-      result = result * 10 + ( current - '0' );
-    else
-      break;
+ParseError parseInt( const char* begin, const char* end, int& value )
+{
+  if ( begin == end )
+  {
+    return ParseError::MissingArg;
   }
-  return negative ? -result : result;
+  const bool negative = ( *begin == '-' );
+  if ( negative ) ++begin;
+  if ( begin == end )
+  {
+    return ParseError::BadArg;
+  }
+
+  // Work in 64 bits so we can see the result leave int's range.
+  const int64_t limit = negative ? 
+    -static_cast<int64_t>( std::numeric_limits<int>::min() ) :
+    std::numeric_limits<int>::max();
+  int64_t result = 0;
+  bool outOfRange = false;
+  for ( ; begin != end; ++begin )
+  {
+    const char current = *begin;
+    if ( current < '0' || current > '9' )
+    {
+      return ParseError::BadArg;
+    }
+    result = result * 10 + ( current - '0' );
+    if ( result > limit )
+    {
+      // Keep checking that the rest are digits, but don't overflow.
+      outOfRange = true;
+      result = limit;
+    }
+  }
+  if ( outOfRange )
+  {
+    return ParseError::ArgOutOfRange;
+  }
+  value = static_cast<int>( negative ? -result : result );
+  return ParseError::None;
 }
 
-const CommandPacket checkForCommands( 
-	DebugInterface& serialLog, 
-	NetInterface& wifi  )
+ParseError parse( const char* line, std::size_t length, CommandPacket& cp )
 {
-	CommandPacket result;
-  
-  WifiDebugOstream log( &serialLog, &wifi );
+  const char* end = line + length;
+  while ( end != line && isSpace( *( end - 1 )))
+  {
+    --end;
+  }
+  if ( end == line )
+  {
+    return ParseError::Empty;
+  }
 
-  // Read the first line of the request.  
+  const char* nameEnd = line;
+  while ( nameEnd != end && *nameEnd != '=' && !isSpace( *nameEnd ))
+  {
+    ++nameEnd;
+  }
 
-  static std::string command;
-  bool dataReady = wifi.getString( log, command );
-  if ( !dataReady )
+  const CommandTemplate* ct = findCommand( line, nameEnd - line );
+  if ( ct == nullptr )
+  {
+    return ParseError::UnknownCommand;
+  }
+
+  int arg = NoArg;
+  if ( ct->hasArg == HasArg::Yes )
+  {
+    // Skip the one '=' or ' ' between the name and the argument.
+    const char* argStart = nameEnd == end ? end : nameEnd + 1;
+    const ParseError error = parseInt( argStart, end, arg );
+    if ( error != ParseError::None )
+    {
+      return error;
+    }
+  }
+  cp = CommandPacket( ct->key, arg );
+  return ParseError::None;
+}
+
+const char* getCommandName( Command command )
+{
+  if ( command >= Command::NoCommand )
   {
-    return result;
+    return "none";
   }
+  return commandTemplates[ BeeFocus::toIndex( command ) ].name;
+}
 
-  std::transform( command.begin(), command.end(), command.begin(), ::tolower);
+bool hasArg( Command command )
+{
+  if ( command >= Command::NoCommand )
+  {
+    return false;
+  }
+  return commandTemplates[ BeeFocus::toIndex( command ) ].hasArg == HasArg::Yes;
+}
 
-  log << "Got: " << command << "\n";
+const char* getErrorName( ParseError error )
+{
+  if ( error >= ParseError::EndOfErrors )
+  {
+    return "unknown error";
+  }
+  return errorNames[ BeeFocus::toIndex( error ) ].name;
+}
 
-  for ( const CommandTemplate& ct : commandTemplates )
+/// @brief Tell a session what was wrong with its input
+///
+/// @param[in] wifi    - Network interface
+/// @param[in] session - Where the input came from
+/// @param[in] error   - What was wrong.  None and Empty aren't reported.
+/// @param[in] text    - The input, or nullptr to leave it out
+/// @param[in] length  - Characters in text
+///
+static void replyError(
+  NetInterface& wifi,
+  unsigned int session,
+  ParseError error,
+  const char* text,
+  std::size_t length )
+{
+  if ( error == ParseError::None || error == ParseError::Empty )
   {
-    if ( command.find(ct.inputCommand ) == 0 )
+    return;
+  }
+  wifi.sendTo( session );
+  wifi << "Error: " << getErrorName( error );
+  if ( text != nullptr )
+  {
+    wifi << " (";
+    wifi.write( text, length );
+    wifi << ")";
+  }
+  wifi << "\n";
+  wifi.sendToSubscribers();
+}
+
+/// @brief Queue the commands on a line from the network
+///
+/// @param[in]  log   - Debug log stream
+/// @param[in]  wifi  - Network interface, for error replies
+/// @param[in]  line  - The line.  Commands are separated by ';'
+/// @param[out] queue - Where the commands go.  Must have room for
+///                     CommandQueue::maxCommandsPerLine more.
+///
+static void queueLine(
+  WifiDebugOstream& log,
+  NetInterface& wifi,
+  const std::string& line,
+  CommandQueue& queue )
+{
+  const unsigned int session = wifi.getSession();
+
+  if ( BinaryProtocol::isFrame( line ))
+  {
+    CommandPacket cp;
+    const ParseError error = BinaryProtocol::decodeRequest( 
+      reinterpret_cast<const uint8_t*>( line.data() ), line.length(), cp );
+    log.info( Log::Category::Parser ) << "Got: frame for " << getCommandName( cp.command ) << "\n";
+    replyError( wifi, session, error, nullptr, 0 );
+    if ( cp.command != Command::NoCommand )
     {
-      result.command = ct.outputCommand;
-      if ( ct.hasArg == HasArg::Yes )
+      cp.session = session;
+      queue.push( cp );
+    }
+    return;
+  }
+
+  log.info( Log::Category::Parser ) << "Got: " << line << "\n";
+
+  const char* next = line.data();
+  const char* const end = next + line.length();
+  // Each command is held back until we know if another one follows.
+  CommandPacket last;
+  std::size_t commands = 0;
+  for ( ;; )
+  {
+    const char* separator = 
+      static_cast<const char*>( memchr( next, ';', end - next ));
+    const char* commandEnd = separator != nullptr ? separator : end;
+
+    CommandPacket cp;
+    const ParseError error = parse( next, commandEnd - next, cp );
+    if ( error == ParseError::None && 
+         commands == CommandQueue::maxCommandsPerLine )
+    {
+      replyError( wifi, session, ParseError::TooManyCommands, 
+                  next, end - next );
+      break;
+    }
+    replyError( wifi, session, error, next, commandEnd - next );
+    if ( error == ParseError::None )
+    {
+      cp.session = session;
+      if ( commands != 0 )
       {
-        result.optionalArg =  process_int( command,  ct.inputCommand.length()+1  );
-      } 
-      return result;
+        last.moreOnLine = true;
+        queue.push( last );
+      }
+      last = cp;
+      ++commands;
     }
-  } 
-  return result;
 
+    if ( separator == nullptr )
+    {
+      break;
+    }
+    next = separator + 1;
+    while ( next != end && isSpace( *next ))
+    {
+      ++next;
+    }
+  }
+  if ( commands != 0 )
+  {
+    queue.push( last );
+  }
 }
 
+bool checkForCommands( 
+	DebugInterface& serialLog, 
+	NetInterface& wifi,
+  CommandQueue& queue )
+{
+  WifiDebugOstream log( &serialLog, &wifi );
 
+  static std::string command;
+  while ( !queue.full() && wifi.getString( log, command ))
+  {
+    queueLine( log, wifi, command, queue );
+  }
+  return queue.full();
 }
 
+
+}
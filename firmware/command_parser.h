@@ -1,6 +1,7 @@
 #ifndef __COMMAND_PARSER_H__
 #define __COMMAND_PARSER_H__
 
+#include <cstddef>
 #include "basic_types.h"
 #include "hardware_interface.h"
 #include "debug_interface.h"
@@ -9,8 +10,6 @@ class NetInterface;
 
 namespace CommandParser {
 
-  int process_int( const std::string& string,  size_t pos );
-
   enum class Command {
     StartOfCommands = 0,  ///<  Start of the command list
     Abort = 0,            ///<  Abort a move
@@ -25,48 +24,223 @@ namespace CommandParser {
     Firmware,             ///<  Get the firmware version
     Caps,                 ///<  Get build specific focuser capabilities
     DebugOff,             ///<  Disable debug interface.
+    Perf,                 ///<  Dump and reset the loop profiler
+    Events,               ///<  1 to get unsolicited output, 0 to stop
+    Binary,               ///<  1 to switch to binary framing, 0 to stop
+    Subscribe,            ///<  Push motion updates every arg ms, 0 to stop
+    Threshold,            ///<  Smallest position change worth a push
+    Verbose,              ///<  Log level for each category.  See doVerbose
+    Trace,                ///<  Download the trace.  See doTrace
     NoCommand,            ///<  No command was specified.
     EndOfCommands         ///<  End of the comand list.
   };
 
   constexpr int NoArg = -1;
 
+  /// @brief Why a line from the network isn't a command
+  enum class ParseError {
+    None = 0,             ///<  The line is a good command
+    Empty,                ///<  Nothing on the line
+    UnknownCommand,       ///<  The first word isn't a command
+    MissingArg,           ///<  Command needs an argument and has none
+    BadArg,               ///<  Argument isn't an integer
+    ArgOutOfRange,        ///<  Argument doesn't fit in an int
+    BadFrame,             ///<  Binary frame is malformed or corrupt
+    TooManyCommands,      ///<  More commands on a line than can be taken
+    EndOfErrors           ///<  End of the error list
+  };
+
   class CommandPacket  {
     public:
-    CommandPacket(): command{Command::NoCommand}, optionalArg{NoArg}
+    CommandPacket(): command{Command::NoCommand}, optionalArg{NoArg},
+      session{0}, moreOnLine{false}
     {
     }
-    CommandPacket( Command c ): command{c}, optionalArg{NoArg}
+    CommandPacket( Command c ): command{c}, optionalArg{NoArg}, session{0},
+      moreOnLine{false}
     {
     }
-    CommandPacket( Command c, int o ): command{c}, optionalArg{o}
+    CommandPacket( Command c, int o ): command{c}, optionalArg{o}, 
+      session{0}, moreOnLine{false}
+    {
+    }
+    CommandPacket( Command c, int o, unsigned int s ): command{c}, 
+      optionalArg{o}, session{s}, moreOnLine{false}
     {
     }
 
     bool operator==( const CommandPacket &rhs ) const 
     {
-      return rhs.command == command && rhs.optionalArg == optionalArg;
+      return rhs.command == command && rhs.optionalArg == optionalArg &&
+        rhs.session == session && rhs.moreOnLine == moreOnLine;
     }
 
     Command command;
     int optionalArg;
+    /// @brief The network session the command came from.  See 
+    ///        NetInterface::getSession.
+    unsigned int session;
+    /// @brief The next command came from the same line as this one, 
+    ///        and its reply goes on the same line.  See checkForCommands.
+    bool moreOnLine;
   };
 
-  /// @brief Get commands from the network interface
   ///
-  /// @param[in] log          - Debug Log stream
-  /// @param[in] netInterface - The network interface that we'll query
-  ///            for the command.
-  /// @return    New requests from netInterface that need to be acted
-  ///            on.
+  /// @brief Fixed capacity queue of CommandPackets
+  ///
+  /// checkForCommands fills the queue with every command that's waiting
+  /// on the network so the focuser can act on all of them in one poll.
+  /// The storage is inline so the queue never touches the heap.
+  ///
+  /// The queue is full at capacity commands, but has room for 
+  /// maxCommandsPerLine - 1 more, so the last line taken always fits.
+  ///
+  /// Example:
+  ///
+  /// @code
+  ///   CommandQueue queue;
+  ///   queue.push( CommandPacket( Command::PStatus ));
+  ///   CommandPacket cp;
+  ///   queue.pop( cp );    // true, cp.command == Command::PStatus
+  ///   queue.pop( cp );    // false, queue is empty
+  /// @endcode
+  ///
+  class CommandQueue {
+    public:
+
+    /// @brief Commands taken from the network in one go before the 
+    ///        queue is full
+    static constexpr std::size_t capacity = 8;
+
+    /// @brief Most commands on one line from the network
+    static constexpr std::size_t maxCommandsPerLine = 4;
+
+    CommandQueue() : head{ 0 }, count{ 0 }
+    {
+    }
+
+    /// @brief Add a command to the back of the queue
+    ///
+    /// @return false if the queue is full
+    ///
+    bool push( const CommandPacket& cp )
+    {
+      if ( count == storage ) return false;
+      ring[ ( head + count ) % storage ] = cp;
+      ++count;
+      return true;
+    }
+
+    /// @brief Remove the command at the front of the queue
+    ///
+    /// @return false if the queue is empty
+    ///
+    bool pop( CommandPacket& cp )
+    {
+      if ( count == 0 ) return false;
+      cp = ring[ head ];
+      head = ( head + 1 ) % storage;
+      --count;
+      return true;
+    }
+
+    /// @brief Number of commands in the queue
+    std::size_t size() const { return count; }
+
+    /// @brief Look at a command without removing it.  0 is the front.
+    const CommandPacket& at( std::size_t i ) const
+    {
+      return ring[ ( head + i ) % storage ];
+    }
+
+    /// @brief Is the queue full?  Stop taking lines if it is.
+    bool full() const { return count >= capacity; }
+
+    /// @brief Is the queue empty?
+    bool empty() const { return count == 0; }
+
+    private:
+
+    static constexpr std::size_t storage = 
+      capacity + maxCommandsPerLine - 1;
+
+    CommandPacket ring[ storage ];
+    std::size_t head;
+    std::size_t count;
+  };
+
+  /// @brief Get a command's name, as typed on the network interface
+  ///
+  /// @param[in] command - The command
+  /// @return    The command's name.  "none" for NoCommand.
+  ///
+  const char* getCommandName( Command command );
+
+  /// @brief Does a command take an integer argument?
+  bool hasArg( Command command );
+
+  /// @brief Get an error's description, as sent on the network interface
+  ///
+  /// @param[in] error - The error
+  /// @return    The description, i.e., "bad argument"
+  ///
+  const char* getErrorName( ParseError error );
+
+  ///
+  /// @brief Read an integer argument
+  ///
+  /// The whole of [begin, end) must be an optional '-' followed by
+  /// decimal digits.  Doesn't allocate memory.
+  ///
+  /// @param[in]  begin - Start of the argument
+  /// @param[in]  end   - One past the end of the argument
+  /// @param[out] value - The integer.  Only set if the result is None.
+  /// @return     None, MissingArg, BadArg or ArgOutOfRange
+  ///
+  ParseError parseInt( const char* begin, const char* end, int& value );
+
+  ///
+  /// @brief Turn a line from the network into a command
+  ///
+  /// The command name is matched without regard to case, using a hash
+  /// table that's built at compile time.  Commands that take an
+  /// argument need exactly one '=' or ' ' between the name and the
+  /// argument, i.e., "abs_pos=100" or "ABS_POS 100".  Commands without
+  /// an argument ignore anything after the name.  Trailing whitespace,
+  /// including the '\r' from a telnet client, is ignored.
+  ///
+  /// Works in place on the line - nothing is copied or allocated.
+  ///
+  /// @param[in]  line   - The line, without the '\n'
+  /// @param[in]  length - Number of characters in the line
+  /// @param[out] cp     - The command.  Only set if the result is None.
+  /// @return     None if the line is a command, or why it isn't.
+  ///
+  ParseError parse( const char* line, std::size_t length, CommandPacket& cp );
+
+  /// @brief Get every waiting command from the network interface
+  ///
+  /// Reads lines until the network interface runs out or the queue is
+  /// full.  Lines that aren't commands are dropped, after an "Error: "
+  /// line is sent back on the network interface.
+  ///
+  /// A line can hold up to CommandQueue::maxCommandsPerLine commands,
+  /// separated by ';', i.e., "pstatus;mstatus; sstatus".  They're
+  /// queued in order, and every one but the last is marked moreOnLine
+  /// so the focuser can answer them with one line.  Commands past the
+  /// limit get a "too many commands" error.
   ///
-  /// TODO 
-  /// - Error handling (has none).
-  /// - Move extra parameters used by the STATUS command.
+  /// @param[in]  log          - Debug Log stream
+  /// @param[in]  netInterface - The network interface that we'll query
+  ///             for commands.
+  /// @param[out] queue        - The new commands are added to the back
+  /// @return     true if the queue filled up, so there may still be
+  ///             commands waiting on the network interface.
   ///
-  const CommandPacket checkForCommands( 
-    DebugInterface& log,				// Input: Debug Log Strem
-    NetInterface& netInterface	// Input: Network Interface
+  bool checkForCommands( 
+    DebugInterface& log,
+    NetInterface& netInterface,
+    CommandQueue& queue
   );
 
 };
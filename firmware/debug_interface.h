@@ -2,8 +2,9 @@
 #define __DEBUG_INTERFACE_H__
 
 #include "simple_ostream.h"
+#include "log_levels.h"
 
-class DebugInterface
+class DebugInterface: public Log::Leveled< DebugInterface >
 {
 	public:
 
@@ -14,6 +15,13 @@ class DebugInterface
   virtual void disable() = 0;
 
   virtual ~DebugInterface() {}
+
+  /// @brief How far each log category is turned up.  See log_levels.h.
+  Log::Masks& getMasks() { return masks; }
+
+  private:
+
+  Log::Masks masks;
 };
 
 #endif
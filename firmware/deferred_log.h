@@ -0,0 +1,195 @@
+#ifndef __DEFERRED_LOG_H__
+#define __DEFERRED_LOG_H__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "basic_types.h"
+#include "log_levels.h"
+
+namespace Log {
+
+  ///
+  /// @brief Log lines that the focuser's motion states can defer
+  ///
+  /// Each one is some text, an int32 and some more text.  Add a
+  /// message by adding it here and to messageFormats.
+  ///
+  enum class Message : uint8_t {
+    Moving = 0,   ///<  Position, while moving
+    Homing,       ///<  Position, while looking for home
+    HitHome,      ///<  Position the home switch was found at
+    End
+  };
+
+  /// @brief How a Message is filtered and formatted
+  struct MessageFormat {
+    Message key;
+    Category category;
+    Level level;
+    /// @brief Text before the argument
+    const char* before;
+    /// @brief Text after the argument, before the '\n'
+    const char* after;
+  };
+
+  /// @brief Formats, indexed by Message.  Checked by isEnumIndexed.
+  constexpr MessageFormat messageFormats[ BeeFocus::toIndex( Message::End ) ] =
+  {
+    { Message::Moving,  Category::Motion, Level::Debug, "Moving ",  "" },
+    { Message::Homing,  Category::Motion, Level::Debug, "Homing ",  "" },
+    { Message::HitHome, Category::Motion, Level::Info,
+      "Hit home at position ", ", resetting position to 0" },
+  };
+
+  static_assert( BeeFocus::isEnumIndexed( messageFormats ),
+    "messageFormats must have one entry per Message, in enum order" );
+
+  /// @brief Is message's level compiled in?  See BEEFOCUS_LOG_LEVEL.
+  constexpr bool isCompiledIn( Message message )
+  {
+    return isCompiledIn( messageFormats[ BeeFocus::toIndex( message ) ].level );
+  }
+
+  ///
+  /// @brief Log lines kept as a Message and its argument until there's
+  ///        time to format them
+  ///
+  /// Formatting a line and pushing it out the serial port can take
+  /// longer than a step pause, so the states that run during a move
+  /// add a Message instead.  Adding one is a mask check and a few
+  /// stores.  The idle states drain the log when they have time to
+  /// spare before their next call.
+  ///
+  /// Lines are filtered when they're added, by the same Masks as the
+  /// sink's other lines, and are formatted with the time they were
+  /// added, i.e., "1010ms: Moving 250".  If the log is full a new line
+  /// replaces the oldest, which is counted as dropped.
+  ///
+  /// Example:
+  ///
+  /// @code
+  ///   DeferredLog< 16 > deferred;
+  ///   deferred.setTime( msNow );
+  ///   deferred.add< Message::Moving >( log.getMasks(), position );
+  ///   ...
+  ///   deferred.drain( log );    // Once there's time
+  /// @endcode
+  ///
+  template< std::size_t N >
+  class DeferredLog {
+    public:
+
+    static constexpr std::size_t capacity = N;
+
+    DeferredLog() : next{ 0 }, count{ 0 }, dropped{ 0 }, msNow{ 0 }
+    {
+    }
+
+    /// @brief Set the time that lines are stamped with, in ms
+    void setTime( uint64_t msTime )
+    {
+      msNow = static_cast<uint32_t>( msTime );
+    }
+
+    ///
+    /// @brief Add a line, if its level is compiled in and turned up
+    ///
+    /// @tparam    M     - The line
+    /// @param[in] masks - How far each category is turned up
+    /// @param[in] arg   - The line's argument
+    ///
+    template< Message M >
+    void add( const Masks& masks, int32_t arg )
+    {
+      constexpr MessageFormat format = messageFormats[ BeeFocus::toIndex( M ) ];
+      if ( isCompiledIn( M ) && masks.isOn( format.category, format.level ))
+      {
+        push( M, arg );
+      }
+    }
+
+    /// @brief Add a line, if it's turned up and limit allows it
+    template< Message M >
+    void add( const Masks& masks, int32_t arg, RateLimit& limit )
+    {
+      constexpr MessageFormat format = messageFormats[ BeeFocus::toIndex( M ) ];
+      if ( isCompiledIn( M ) && masks.isOn( format.category, format.level )
+           && limit.allow( msNow ))
+      {
+        push( M, arg );
+      }
+    }
+
+    /// @brief Are there lines waiting to be formatted?
+    bool isEmpty() const
+    {
+      return count == 0 && dropped == 0;
+    }
+
+    ///
+    /// @brief Format the waiting lines, oldest first, and send them
+    ///
+    /// If lines were dropped since the last drain that's reported
+    /// first, and the count starts again.
+    ///
+    template< typename Sink >
+    void drain( Sink& sink )
+    {
+      if ( dropped != 0 )
+      {
+        sink << "Dropped " << dropped << " deferred log lines\n";
+        dropped = 0;
+      }
+      std::size_t slot = next + N - count;
+      for ( ; count != 0; --count )
+      {
+        if ( slot >= N ) slot -= N;
+        const Entry& entry = entries[ slot++ ];
+        const MessageFormat& format =
+          messageFormats[ BeeFocus::toIndex( entry.message ) ];
+        sink << entry.msTime << "ms: " << format.before << entry.arg
+             << format.after << "\n";
+      }
+    }
+
+    /// @brief Lines replaced since the last drain
+    uint32_t getDropped() const
+    {
+      return dropped;
+    }
+
+    private:
+
+    void push( Message message, int32_t arg )
+    {
+      entries[ next ] = { msNow, arg, message };
+      next = next + 1 == N ? 0 : next + 1;
+      if ( count < N )
+      {
+        ++count;
+      }
+      else
+      {
+        ++dropped;
+      }
+    }
+
+    struct Entry {
+      uint32_t msTime;
+      int32_t arg;
+      Message message;
+    };
+
+    std::array< Entry, N > entries;
+    /// @brief Where the next line goes
+    std::size_t next;
+    std::size_t count;
+    uint32_t dropped;
+    uint32_t msNow;
+  };
+
+  template< std::size_t N > constexpr std::size_t DeferredLog< N >::capacity;
+}
+
+#endif
@@ -1,14 +1,26 @@
 
+#include <algorithm>
+#include <cstring>
 #include <iterator>
 #include <vector>
 #include <string>
 #include <memory>
+#include "binary_protocol.h"
 #include "command_parser.h"
+#include "number_format.h"
 #include "wifi_debug_ostream.h"
 #include "focuser_state.h"
 
 using namespace FS;
 
+/// @brief Build a binary State frame.  StateArgs are sent as an int32.
+static std::size_t encodeBinaryState( State state, StateArg arg, 
+                                      uint8_t* frame )
+{
+  return BinaryProtocol::encodeState( 
+    static_cast<uint8_t>( state ), arg.asInt(), frame );
+}
+
 //
 // Implementation of the Focuser class
 //
@@ -17,10 +29,10 @@ using namespace FS;
 // 1. It accepts new commands from a network interface
 // 2. Over time, it manipulates a hardware interface to implement the commands
 //
-// At construction time the Focuser is provided three interfaces - an
+// At construction time the Focuser is provided four interfaces - an
 // interface to the network (i.e., a Wifi Connection), an interface to the 
-// the hardware (i.e., the pins in a Micro-Controller) an interface for
-// debug logging, and the focuser's hardware parameters
+// the hardware (i.e., the pins in a Micro-Controller), a clock, an 
+// interface for debug logging, and the focuser's hardware parameters
 //
 // Once the focuser is initialized, the loop function is used to real time
 // updates.  The loop function returns a minimum time that the caller should
@@ -40,6 +52,14 @@ using namespace FS;
 // operating finished.  If it isn't, it pushes commands onto the focuser's
 // state stack that will result in the focuser rewinding one step.
 //
+// Step pulses are the one thing that doesn't go through the state stack.
+// State::DO_STEPS hands the whole burst to a StepBurst and emits one edge 
+// per call to loop until the burst is done.  The pause between edges
+// comes from the MotionPlanner, which ramps the speed up and down over
+// the course of a move.  State::MOVING tells the planner how many steps
+// are left before each burst, and anything that brings the motor to 
+// rest (reaching the target, changing direction, an interrupt) stops it.
+//
 
 /////////////////////////////////////////////////////////////////////////
 //
@@ -50,23 +70,42 @@ using namespace FS;
 Focuser::Focuser(
     std::unique_ptr<NetInterface> netArg,
     std::unique_ptr<HWI> hardwareArg,
+    std::unique_ptr<Clock> clockArg,
     std::unique_ptr<DebugInterface> debugArg,
     const BuildParams params
-) : buildParams{ params }
+) : buildParams{ params },
+    motionPlanner{ 
+      (unsigned) params.timingParams.getMicroSecondStepPause(),
+      (unsigned) params.timingParams.getMicroSecondCruisePause(),
+      params.timingParams.getAcceleration(),
+      params.timingParams.getDeceleration() },
+    stepBurst{ motionPlanner },
+    motionLogLimit{ 1000 }
 {
   focuserPosition = 0;
   isSynched = false;
-  time = 0;
-  uSecRemainder = 0;
-  timeLastInterruptingCommandOccured = 0;
   motorState = MotorState::OFF;
+  pushedMove = false;
+  for ( PushSubscription& sub : pushSubscriptions )
+  {
+    sub = { 0, 0, 0, 0, State::ACCEPT_COMMANDS };
+  }
 
   std::swap( net, netArg );
   std::swap( hardware, hardwareArg );
+  std::swap( clock, clockArg );
   std::swap( debugLog, debugArg );
+
+  uSecDeadline = clock->uSecNow();
+  uSecStepQueueDry = uSecDeadline;
+  time = uSecDeadline / 1000;
+  timeLastInterruptingCommandOccured = time;
+  trace.setTime( time );
+  stateStack.setTrace( &trace );
+  profiler.setCyclesPerMicroSecond( hardware->getCyclesPerMicroSecond() );
   
   DebugInterface& dlog = *debugLog;
-  dlog << "Bringing up net interface\n";
+  dlog.info( Log::Category::Net ) << "Bringing up net interface\n";
   
   // Bring up the interface to the controlling computer
 
@@ -87,23 +126,67 @@ Focuser::Focuser(
   setMotor( log, MotorState::ON ); 
 
   dir = Dir::FORWARD;
-  hardware->DigitalWrite( HWI::Pin::DIR, HWI::PinState::DIR_FORWARD); 
+  writePin( HWI::Pin::DIR, HWI::PinState::DIR_FORWARD); 
   hardware->DigitalWrite( HWI::Pin::STEP, HWI::PinState::STEP_INACTIVE );
 
-  log << "Focuser is up\n";
+  log.info( Log::Category::Power ) << "Focuser is up\n";
 }
 
 unsigned int Focuser::loop()
 {
-  ptrToMember function = stateImpl.at( stateStack.topState() );
-  const unsigned uSecToNextCall = (this->*function)();
-  uSecRemainder += uSecToNextCall;
-  time += uSecRemainder / 1000;
-  uSecRemainder = uSecRemainder % 1000;
+  const uint64_t uSecStart = clock->uSecNow();
+  time = uSecStart / 1000;
+  trace.setTime( time );
+  deferredLog.setTime( time );
+
+  const std::size_t state = BeeFocus::toIndex( stateStack.topState() );
+  uint32_t cycleStart = 0;
+  if ( Profiler::enabled )
+  {
+    cycleStart = hardware->getCycleCount();
+    profiler.wake( uSecStart );
+  }
+
+  ptrToMember function = stateImpl[ state ].function;
+  const unsigned int uSecPause = (this->*function)();
   net->flush();
+
+  // The pause is measured from when this call was scheduled, not from
+  // when it ran, so handler time and late wake ups don't add up.  If 
+  // the caller was early (input cut a wait short), measure from now.
+  // A little lateness is made up by running the next calls without a
+  // pause.  Past uSecMaxCatchUp (a WiFi stall) the missed time is 
+  // dropped rather than made up with a long run of back to back steps.
+  const uint64_t uSecBase = std::min( uSecDeadline, uSecStart );
+  const uint64_t uSecEnd = clock->uSecNow();
+  uSecDeadline = std::max( uSecBase + uSecPause + uSecMaxCatchUp, uSecEnd ) 
+    - uSecMaxCatchUp;
+  const unsigned int uSecToNextCall = 
+    uSecDeadline > uSecEnd ? uSecDeadline - uSecEnd : 0;
+
+  if ( Profiler::enabled )
+  {
+    const uint32_t cycleEnd = hardware->getCycleCount();
+    profiler.state( state, cycleEnd - cycleStart );
+    profiler.sleep( uSecEnd, uSecToNextCall );
+  }
   return uSecToNextCall;
 }
 
+unsigned int Focuser::waitForInput( unsigned int uSecPause )
+{
+  const State top = stateStack.topState();
+  const bool isIdle = top == State::ACCEPT_COMMANDS || top == State::SLEEP;
+
+  if ( uSecPause == 0 || !isIdle || !net->canWaitForInput() )
+  {
+    return uSecPause;
+  }
+
+  net->waitForInput( uSecPause );
+  return 0;
+}
+
 /////////////////////////////////////////////////////////////////////////
 //
 // Private Interfaces
@@ -124,14 +207,25 @@ unsigned int Focuser::loop()
 //
 /////////////////////////////////////////////////////////////////////////
 
+constexpr unsigned int Focuser::msMaxIdleWait;
+constexpr unsigned int Focuser::uSecMaxCatchUp;
+constexpr unsigned int Focuser::uSecMinLogSlack;
+constexpr unsigned int Focuser::uSecStepQueueRetry;
+constexpr unsigned int Focuser::maxPushSessions;
+
+// Out of class definitions for StateStack's depth bounds.
+constexpr std::size_t StateStack::baseDepth;
+constexpr std::size_t StateStack::maxCommandDepth;
+constexpr std::size_t StateStack::maxMoveDepth;
+constexpr std::size_t StateStack::maxDepth;
+constexpr std::size_t StateStack::capacity;
+
 // What does the focuser execute if it's in a particular state?
-const std::unordered_map<State,unsigned int (Focuser::*)( void ),EnumHash>
-  Focuser::stateImpl =
+// Indexed by State, so entries must stay in enum order.
+constexpr const Focuser::StateImpl Focuser::stateImpl[] =
 {
   { State::ACCEPT_COMMANDS,           &Focuser::stateAcceptCommands },
   { State::DO_STEPS,                  &Focuser::stateDoingSteps },
-  { State::STEPPER_INACTIVE_AND_WAIT, &Focuser::stateStepInactiveAndWait },
-  { State::STEPPER_ACTIVE_AND_WAIT,   &Focuser::stateStepActiveAndWait },
   { State::SET_DIR,                   &Focuser::stateSetDir },
   { State::MOVING,                    &Focuser::stateMoving },
   { State::STOP_AT_HOME,              &Focuser::stateStopAtHome },
@@ -144,8 +238,6 @@ const StateToString FS::stateNames =
 {
   { State::ACCEPT_COMMANDS,               "ACCEPTING_COMMANDS" },
   { State::DO_STEPS,                      "DO_STEPS"           },
-  { State::STEPPER_INACTIVE_AND_WAIT,     "STEPPER_INACTIVE"   },
-  { State::STEPPER_ACTIVE_AND_WAIT,       "STEPPER_ACTIVE"     },
   { State::SET_DIR,                       "SET_DIR"            },
   { State::MOVING,                        "MOVING"             },
   { State::STOP_AT_HOME,                  "STOP_AT_HOME"       },
@@ -154,9 +246,8 @@ const StateToString FS::stateNames =
 };
 
 // Implementation of the commands that the Focuser Supports 
-const std::unordered_map<CommandParser::Command,
-  void (Focuser::*)( CommandParser::CommandPacket),EnumHash> 
-  Focuser::commandImpl = 
+// Indexed by Command, so entries must stay in enum order.
+constexpr const Focuser::CommandImpl Focuser::commandImpl[] = 
 {
   { CommandParser::Command::Abort,      &Focuser::doAbort },
   { CommandParser::Command::Home,       &Focuser::doHome },
@@ -170,11 +261,19 @@ const std::unordered_map<CommandParser::Command,
   { CommandParser::Command::Firmware,   &Focuser::doFirmware},
   { CommandParser::Command::Caps,       &Focuser::doCaps},
   { CommandParser::Command::DebugOff,   &Focuser::doDebugOff},
+  { CommandParser::Command::Perf,       &Focuser::doPerf},
+  { CommandParser::Command::Events,     &Focuser::doEvents},
+  { CommandParser::Command::Binary,     &Focuser::doBinary},
+  { CommandParser::Command::Subscribe,  &Focuser::doSubscribe},
+  { CommandParser::Command::Threshold,  &Focuser::doThreshold},
+  { CommandParser::Command::Verbose,    &Focuser::doVerbose},
+  { CommandParser::Command::Trace,      &Focuser::doTrace},
   { CommandParser::Command::NoCommand,  &Focuser::doError },
 };
 
 // Can a command be interrupted/aborted?
-const CommandToBool FS::doesCommandInterrupt= 
+// Indexed by Command, so entries must stay in enum order.
+constexpr const CommandToBool FS::commandInterrupts[] = 
 {
   { CommandParser::Command::Abort,         true   },
   { CommandParser::Command::Home,          true   },
@@ -188,6 +287,13 @@ const CommandToBool FS::doesCommandInterrupt=
   { CommandParser::Command::Firmware,      false  },
   { CommandParser::Command::Caps,          false  },
   { CommandParser::Command::DebugOff,      false  },
+  { CommandParser::Command::Perf,          false  },
+  { CommandParser::Command::Events,        false  },
+  { CommandParser::Command::Binary,        false  },
+  { CommandParser::Command::Subscribe,     false  },
+  { CommandParser::Command::Threshold,     false  },
+  { CommandParser::Command::Verbose,       false  },
+  { CommandParser::Command::Trace,         false  },
   { CommandParser::Command::NoCommand,     false  },
 };
 
@@ -202,7 +308,10 @@ BuildParams::BuildParamMap BuildParams::builds = {
         5*60*1000,  // Go to sleep after 5 minutes of inactivity
         1000,       // Check for new input in sleep mode every second
         1000,       // Take 1 second to power up the focuser motor on awaken
-        1000        // Wait 1000 microseconds between steps       
+        1000,       // Wait 1000 microseconds between steps from rest
+        250,        // Cruise at 250 microseconds between steps
+        4000,       // Accelerate at 4000 steps/s^2
+        4000        // Decelerate at 4000 steps/s^2
       },
       true,         // Focuser can use a home switch to synch
       50000         // End of the line for my focuser
@@ -277,12 +386,110 @@ BuildParams::BuildParamMap BuildParams::builds = {
 // Entry point for all commands
 void Focuser::processCommand( CommandParser::CommandPacket cp )
 {
-  if ( doesCommandInterrupt.at( cp.command ))
+  // The dispatch tables are checked here, after their constexpr 
+  // definitions in Section 1.
+  static_assert( BeeFocus::isEnumIndexed( stateImpl ),
+    "stateImpl must have one entry per State, in enum order" );
+  static_assert( BeeFocus::isEnumIndexed( commandImpl ),
+    "commandImpl must have one entry per Command, in enum order" );
+  static_assert( BeeFocus::isEnumIndexed( commandInterrupts ),
+    "commandInterrupts must have one entry per Command, in enum order" );
+
+  if ( doesCommandInterrupt( cp.command ))
   {
     timeLastInterruptingCommandOccured = time;
   }
-  auto function = commandImpl.at( cp.command );
+  const std::size_t command = BeeFocus::toIndex( cp.command );
+  trace.add( Trace::Kind::Command, static_cast<uint8_t>( command ), 
+             cp.optionalArg );
+  const uint32_t cycleStart = Profiler::enabled ? hardware->getCycleCount() : 0;
+  auto function = commandImpl[ command ].function;
+  // Replies only go to the client that sent the command.
+  net->sendTo( cp.session );
   (this->*function)( cp );
+  net->sendToSubscribers();
+  if ( Profiler::enabled )
+  {
+    profiler.command( command, hardware->getCycleCount() - cycleStart );
+  }
+}
+
+bool Focuser::takeCommands()
+{
+  DebugInterface& log = *debugLog;
+  bool interrupted = false;
+  bool moreWaiting = true;
+
+  while ( moreWaiting )
+  {
+    moreWaiting = CommandParser::checkForCommands( log, *net, commandQueue );
+
+    // A new client starts out without the old one's subscription.
+    const uint32_t opened = net->takeOpenedSessions();
+    for ( unsigned int session = 0; session < maxPushSessions; ++session )
+    {
+      if ( opened & ( 1u << session ))
+      {
+        pushSubscriptions[ session ] = { 0, 0, 0, 0, State::ACCEPT_COMMANDS };
+      }
+    }
+
+    // Only the last command in the batch that replaces the motion
+    // matters.  Syncs are all run, in order.
+    std::size_t lastReplace = commandQueue.size();
+    for ( std::size_t i = 0; i < commandQueue.size(); ++i )
+    {
+      if ( doesCommandReplaceMotion( commandQueue.at( i ).command ))
+      {
+        lastReplace = i;
+      }
+    }
+
+    CommandParser::CommandPacket cp;
+    for ( std::size_t i = 0; commandQueue.pop( cp ); ++i )
+    {
+      // Commands from one line get their replies on one line.
+      if ( cp.moreOnLine )
+      {
+        net->joinLines( cp.session, true );
+      }
+      if ( !doesCommandInterrupt( cp.command ))
+      {
+        processCommand( cp );
+      }
+      else if ( i == lastReplace || !doesCommandReplaceMotion( cp.command ))
+      {
+        // Whatever move was going on ends here, once the motor has
+        // slowed down.  The steps that takes go on top of the new
+        // command's states.  They're moved with the position if the
+        // command was a sync.
+        pushMoveDone();
+        const int stopSteps = motionPlanner.stepsToStop();
+        const int stopOffset = dir == Dir::FORWARD ? stopSteps : -stopSteps;
+        stateStack.reset();
+        processCommand( cp );
+        if ( stopSteps != 0 )
+        {
+          stateStack.push( State::MOVING, focuserPosition + stopOffset );
+        }
+        interrupted = true;
+      }
+      else
+      {
+        // A later command replaced this one before it ran.  Say so, so
+        // the client doesn't wait on a move that won't happen.
+        net->sendTo( cp.session );
+        *net << "Error: replaced by a later command ("
+             << CommandParser::getCommandName( cp.command ) << ")\n";
+        net->sendToSubscribers();
+      }
+      if ( !cp.moreOnLine )
+      {
+        net->joinLines( cp.session, false );
+      }
+    }
+  }
+  return interrupted;
 }
 
 void Focuser::doAbort( CommandParser::CommandPacket cp )
@@ -316,7 +523,14 @@ void Focuser::doPStatus( CommandParser::CommandPacket cp )
 {
   (void) cp;
   DebugInterface& log = *debugLog;
-  log << "Processing pstatus request\n";
+  log.debug( Log::Category::Parser ) << "Processing pstatus request\n";
+  if ( net->isBinary( cp.session ))
+  {
+    uint8_t frame[ BinaryProtocol::overhead + 5 ];
+    net->writeFrame( frame, 
+      BinaryProtocol::encodePosition( focuserPosition, frame ));
+    return;
+  }
   *net << "Position: " << focuserPosition << "\n";
 }
 
@@ -325,7 +539,14 @@ void Focuser::doMStatus( CommandParser::CommandPacket cp )
   (void) cp;
   DebugInterface& log = *debugLog;
 
-  log << "Processing mstatus request\n";
+  log.debug( Log::Category::Parser ) << "Processing mstatus request\n";
+  if ( net->isBinary( cp.session ))
+  {
+    uint8_t frame[ BinaryProtocol::overhead + 6 ];
+    net->writeFrame( frame, encodeBinaryState( 
+      stateStack.topState(), stateStack.topArg(), frame ));
+    return;
+  }
   *net << "State: " << stateNames.at(stateStack.topState()) << 
                 " " << stateStack.topArg() << "\n";
 }
@@ -335,7 +556,13 @@ void Focuser::doSStatus( CommandParser::CommandPacket cp )
   (void) cp;
   DebugInterface& log = *debugLog;
 
-  log << "Processing sstatus request\n";
+  log.debug( Log::Category::Parser ) << "Processing sstatus request\n";
+  if ( net->isBinary( cp.session ))
+  {
+    uint8_t frame[ BinaryProtocol::overhead + 2 ];
+    net->writeFrame( frame, BinaryProtocol::encodeSynched( isSynched, frame ));
+    return;
+  }
   *net << "Synched: " << (isSynched ? "YES" : "NO" ) << "\n";
 }
 
@@ -344,7 +571,7 @@ void Focuser::doFirmware( CommandParser::CommandPacket cp )
   (void) cp;
   DebugInterface& log = *debugLog;
 
-  log << "Processing firmware request\n";
+  log.debug( Log::Category::Parser ) << "Processing firmware request\n";
   *net << "Firmware: 1.0\n";
 }
 
@@ -353,9 +580,10 @@ void Focuser::doCaps( CommandParser::CommandPacket cp )
   (void) cp;
   DebugInterface& log = *debugLog;
 
-  log << "Processing capabilities request\n";
+  log.debug( Log::Category::Parser ) << "Processing capabilities request\n";
   *net << "MaxPos: " << buildParams.maxAbsPos << "\n";
   *net << "CanHome: " << (buildParams.focuserHasHome ? "YES\n" : "NO\n" );
+  *net << "Binary: " << (net->hasBinary() ? "YES\n" : "NO\n" );
 }
 
 void Focuser::doDebugOff( CommandParser::CommandPacket cp )
@@ -363,10 +591,239 @@ void Focuser::doDebugOff( CommandParser::CommandPacket cp )
   (void) cp;
   DebugInterface& log = *debugLog;
 
-  log << "Disabling low level debug output";
+  log.info( Log::Category::Parser ) << "Disabling low level debug output\n";
   log.disable();
 }
 
+void Focuser::doEvents( CommandParser::CommandPacket cp )
+{
+  DebugInterface& log = *debugLog;
+
+  log.debug( Log::Category::Parser ) << "Processing events request\n";
+  const bool on = cp.optionalArg != 0;
+  net->subscribe( cp.session, on );
+  *net << "Events: " << ( on ? "ON" : "OFF" ) << "\n";
+}
+
+void Focuser::doBinary( CommandParser::CommandPacket cp )
+{
+  DebugInterface& log = *debugLog;
+
+  log.debug( Log::Category::Parser ) << "Processing binary request\n";
+  const bool on = cp.optionalArg != 0 && net->hasBinary();
+  // The reply goes out in the framing the client asked with.
+  *net << "Binary: " << ( on ? "ON" : "OFF" ) << "\n";
+  if ( net->hasBinary() )
+  {
+    net->setBinary( cp.session, on );
+  }
+}
+
+void Focuser::doSubscribe( CommandParser::CommandPacket cp )
+{
+  DebugInterface& log = *debugLog;
+
+  log.debug( Log::Category::Parser ) << "Processing subscribe request\n";
+  if ( cp.session >= maxPushSessions )
+  {
+    *net << "Subscribe: OFF\n";
+    return;
+  }
+  PushSubscription& sub = pushSubscriptions[ cp.session ];
+  sub.msPeriod = cp.optionalArg > 0 ? cp.optionalArg : 0;
+  sub.lastTime = 0;
+  sub.lastPosition = focuserPosition;
+  sub.lastState = State::ACCEPT_COMMANDS;
+  if ( sub.msPeriod == 0 )
+  {
+    *net << "Subscribe: OFF\n";
+    return;
+  }
+  *net << "Subscribe: " << sub.msPeriod << "\n";
+}
+
+void Focuser::doThreshold( CommandParser::CommandPacket cp )
+{
+  DebugInterface& log = *debugLog;
+
+  log.debug( Log::Category::Parser ) << "Processing threshold request\n";
+  const unsigned int threshold = cp.optionalArg > 0 ? cp.optionalArg : 0;
+  if ( cp.session < maxPushSessions )
+  {
+    pushSubscriptions[ cp.session ].threshold = threshold;
+  }
+  *net << "Threshold: " << threshold << "\n";
+}
+
+void Focuser::doVerbose( CommandParser::CommandPacket cp )
+{
+  DebugInterface& log = *debugLog;
+
+  log.debug( Log::Category::Parser ) << "Processing verbose request\n";
+
+  // One digit per category, Motion first, i.e., verbose=3222 turns
+  // up Motion to Debug and leaves the rest at Info.  Digits past
+  // Debug are Debug.  verbose=-1 only reports the levels.
+  Log::Masks& masks = log.getMasks();
+  if ( cp.optionalArg >= 0 )
+  {
+    int digits = cp.optionalArg;
+    for ( std::size_t c = Log::numCategories; c-- > 0; )
+    {
+      const int level = std::min( digits % 10, 
+        static_cast<int>( Log::Level::Debug ));
+      masks.setLevel( static_cast<Log::Category>( c ), 
+        static_cast<Log::Level>( level ));
+      digits /= 10;
+    }
+  }
+
+  *net << "Verbose: ";
+  for ( std::size_t c = 0; c < Log::numCategories; ++c )
+  {
+    *net << BeeFocus::toIndex( 
+      masks.getLevel( static_cast<Log::Category>( c )));
+  }
+  *net << "\n";
+}
+
+void Focuser::doTrace( CommandParser::CommandPacket cp )
+{
+  DebugInterface& log = *debugLog;
+
+  log.debug( Log::Category::Parser ) << "Processing trace request\n";
+
+  // The trace is sent oldest first and left as it is.  Binary sessions
+  // get Trace frames and a TraceEnd.  Text sessions get a "Trace: 
+  // <records> <lost>" line, then the records in hex, recordsPerLine to
+  // a "Trace: " line.  Either way it's written in one go, so it has to
+  // fit in the reply room the network interface keeps.
+  constexpr std::size_t recordsPerLine = 8;
+  constexpr std::size_t prefixLength = 7;    // "Trace: "
+  constexpr std::size_t lineLength =
+    prefixLength + recordsPerLine * Trace::recordBytes * 2 + 1;
+  constexpr std::size_t headerLength = 29;   // "Trace: " and two uint32s
+  static_assert( headerLength + lineLength *
+    (( FocuserTrace::capacity + recordsPerLine - 1 ) / recordsPerLine ) <=
+    NetInterface::maxReplyBytes, "A text trace is too big for one reply" );
+  static_assert( BinaryProtocol::maxFrame * ( 1 +
+    ( FocuserTrace::capacity + BinaryProtocol::maxTraceRecords - 1 ) /
+    BinaryProtocol::maxTraceRecords ) <= NetInterface::maxReplyBytes,
+    "A binary trace is too big for one reply" );
+
+  if ( net->isBinary( cp.session ))
+  {
+    Trace::Record records[ BinaryProtocol::maxTraceRecords ];
+    uint8_t frame[ BinaryProtocol::maxFrame ];
+    for ( std::size_t i = 0; i < trace.size(); )
+    {
+      std::size_t count = 0;
+      while ( count < BinaryProtocol::maxTraceRecords && i < trace.size() )
+      {
+        records[ count++ ] = trace.at( i++ );
+      }
+      net->writeFrame( frame, 
+        BinaryProtocol::encodeTrace( records, count, frame ));
+    }
+    net->writeFrame( frame, 
+      BinaryProtocol::encodeTraceEnd( trace.getLost(), frame ));
+    return;
+  }
+
+  *net << "Trace: " << trace.size() << " " << trace.getLost() << "\n";
+  for ( std::size_t i = 0; i < trace.size(); )
+  {
+    char line[ lineLength ] = "Trace: ";
+    char* text = line + prefixLength;
+    for ( std::size_t r = 0; r < recordsPerLine && i < trace.size(); ++r )
+    {
+      uint8_t bytes[ Trace::recordBytes ];
+      Trace::encode( trace.at( i++ ), bytes );
+      for ( uint8_t byte : bytes )
+      {
+        text += 2;
+        NumberFormat::hex( byte, text, 2 );
+      }
+    }
+    *text++ = '\n';
+    net->write( line, text - line );
+  }
+}
+
+void Focuser::doPerf( CommandParser::CommandPacket cp )
+{
+  (void) cp;
+  DebugInterface& log = *debugLog;
+
+  log.debug( Log::Category::Parser ) << "Processing perf request\n";
+  if ( !Profiler::enabled )
+  {
+    *net << "Perf: off\n";
+    return;
+  }
+
+  // Every histogram line is budgeted at its longest, so the reply fits
+  // in NetInterface::maxReplyBytes.  Lines that don't fit are left for
+  // the next perf command, and "Perf: more" says there are some.
+  constexpr std::size_t prefixLength = 14;   // "Perf: command "
+  constexpr std::size_t lineLength =
+    prefixLength + maxPerfNameLength + 1 + TimeHistogram::maxTextLength + 1;
+  constexpr std::size_t slipLength = 11 + TimeHistogram::maxTextLength + 1;
+  constexpr std::size_t moreLength = 11;     // "Perf: more\n"
+  static_assert( slipLength + moreLength + lineLength * 4 <=
+    NetInterface::maxReplyBytes, "Too few perf lines fit in one reply" );
+  std::size_t linesLeft =
+    ( NetInterface::maxReplyBytes - slipLength - moreLength ) / lineLength;
+  bool more = false;
+
+  for ( State s = State::START_OF_STATES; s < State::END_OF_STATES; ++s )
+  {
+    const std::size_t state = BeeFocus::toIndex( s );
+    const TimeHistogram& h = profiler.getState( state );
+    if ( h.getCount() == 0 )
+    {
+      continue;
+    }
+    if ( linesLeft == 0 )
+    {
+      more = true;
+      break;
+    }
+    --linesLeft;
+    assert( stateNames.at( s ).length() <= maxPerfNameLength );
+    *net << "Perf: state " << stateNames.at( s ) << " " << h << "\n";
+    profiler.resetState( state );
+  }
+  const std::size_t numCommands = 
+    BeeFocus::toIndex( CommandParser::Command::EndOfCommands );
+  for ( std::size_t c = 0; c < numCommands; ++c )
+  {
+    const TimeHistogram& h = profiler.getCommand( c );
+    if ( h.getCount() == 0 )
+    {
+      continue;
+    }
+    if ( linesLeft == 0 )
+    {
+      more = true;
+      break;
+    }
+    --linesLeft;
+    const char* name =
+      CommandParser::getCommandName( CommandParser::Command( c ));
+    assert( strlen( name ) <= maxPerfNameLength );
+    *net << "Perf: command " << name << " " << h << "\n";
+    profiler.resetCommand( c );
+  }
+  if ( more )
+  {
+    *net << "Perf: more\n";
+    return;
+  }
+  *net << "Perf: slip " << profiler.getSlip() << "\n";
+  profiler.reset();
+}
+
 void Focuser::doRELPos( CommandParser::CommandPacket cp )
 {
   cp.optionalArg += focuserPosition;
@@ -411,110 +868,177 @@ void Focuser::doError( CommandParser::CommandPacket cp )
 
 unsigned int Focuser::stateAcceptCommands()
 {
-  DebugInterface& log = *debugLog;
-  auto cp = CommandParser::checkForCommands( log, *net );
-
-  if ( cp.command != CommandParser::Command::NoCommand )
+  if ( takeCommands() )
   {
-    processCommand( cp );
     return 0;
   }
-  const unsigned int timeSinceLastInterrupt = 
+  const uint64_t timeSinceLastInterrupt = 
       time - timeLastInterruptingCommandOccured;
 
-  if ( timeSinceLastInterrupt > buildParams.timingParams.getInactivityToSleep() )
+  const unsigned int inactivityToSleep = 
+      buildParams.timingParams.getInactivityToSleep();
+
+  if ( timeSinceLastInterrupt > inactivityToSleep )
   {
     stateStack.push( State::SLEEP );
     return 0;
   }
 
+  if ( net->canWaitForInput() )
+  {
+    // No need to poll.  Wait for input or until it's time to sleep.
+    const unsigned int mSecToSleep = 
+      inactivityToSleep - (unsigned int) timeSinceLastInterrupt + 1;
+    return drainLog( std::min( mSecToSleep, msMaxIdleWait ) * 1000 );
+  }
+
   const int timeBetweenChecks = buildParams.timingParams.getEpochBetweenCommandChecks();
   const int mSecToNextEpoch = timeBetweenChecks - ( time % timeBetweenChecks );
 
-  return mSecToNextEpoch * 1000;
+  return drainLog( mSecToNextEpoch * 1000 );
 }
 
 unsigned int Focuser::stateSetDir()
 {
   Dir desiredDir = stateStack.topArg().getDir();
 
-  stateStack.pop();
-
-  if ( desiredDir != dir )
+  if ( desiredDir == dir )
   {
-    dir = desiredDir;
-    if ( dir == Dir::FORWARD )
-      hardware->DigitalWrite( HWI::Pin::DIR, HWI::PinState::DIR_FORWARD); 
-    if ( dir == Dir::REVERSE )       
-      hardware->DigitalWrite( HWI::Pin::DIR, HWI::PinState::DIR_BACKWARD );
-      // Trigger a 1ms pause so the stepper motor controller sees the
-      // state change before we try to do anything.
-    return 1000;
-  }    
+    stateStack.pop();
+    return 0;
+  }
 
-  return 0;
-}
+  const HWI::PinState dirState = desiredDir == Dir::FORWARD ? 
+    HWI::PinState::DIR_FORWARD : HWI::PinState::DIR_BACKWARD;
 
-unsigned int Focuser::stateStepInactiveAndWait()
-{
-  hardware->DigitalWrite( HWI::Pin::STEP, HWI::PinState::STEP_INACTIVE );
-  stateStack.pop();
-  return buildParams.timingParams.getMicroSecondStepPause();
-}
+  // Trigger a 1ms pause so the stepper motor controller sees the
+  // state change before we try to do anything.
+  if ( hardware->hasStepQueue() ) 
+  {
+    // Steps ahead of us may still be in the queue, so the direction
+    // change has to go through the queue too.  If it's full, writing
+    // the pin now would run those steps backwards - wait for room.
+    if ( !queueEdge( { HWI::Pin::DIR, dirState, 1000 } ))
+    {
+      return uSecStepQueueRetry;
+    }
+  }
+  else
+  {
+    hardware->DigitalWrite( HWI::Pin::DIR, dirState );
+  }
 
-unsigned int Focuser::stateStepActiveAndWait()
-{
-  hardware->DigitalWrite( HWI::Pin::STEP, HWI::PinState::STEP_ACTIVE );
   stateStack.pop();
-  return buildParams.timingParams.getMicroSecondStepPause();
+  // Can't reverse at speed.  Moves end at the start-from-rest speed,
+  // and interrupted ones are slowed down first, so this just makes sure.
+  motionPlanner.stop();
+  dir = desiredDir;
+  // Traced now, even if the step queue writes it later.
+  trace.add( Trace::Kind::PinWrite, 
+    static_cast<uint8_t>( HWI::Pin::DIR ), static_cast<int32_t>( dirState ));
+  return 1000;
 }
 
 unsigned int Focuser::stateDoingSteps()
 {
-  if ( stateStack.topArg().getInt() == 0 )
+  if ( stateStack.topArg().getInt() != 0 )
   {
-    // We're done at 0
+    // First call for this State::DO_STEPS - set up the burst. The 
+    // argument is cleared so later calls just run the burst.
+    stepBurst.start( stateStack.topArg().getInt() );
+    stateStack.topArgSet( 0 );
+  }
+
+  if ( stepBurst.isDone() )
+  {
+    // We're done when the burst is.
     stateStack.pop();
     return 0;
   }
-  stateStack.topArgSet( stateStack.topArg().getInt()-1 );
 
-  stateStack.push( State::STEPPER_INACTIVE_AND_WAIT );
-  stateStack.push( State::STEPPER_ACTIVE_AND_WAIT );
+  if ( hardware->hasStepQueue() )
+  {
+    return queueSteps();
+  }
+
+  // Step edges aren't traced.  A move's worth would push everything
+  // else out of the trace, and the position tells where they went.
+  const HWI::PinState edge = stepBurst.nextEdge();
+  hardware->DigitalWrite( HWI::Pin::STEP, edge );
+
+  if ( edge == HWI::PinState::STEP_ACTIVE )
+  {
+    focuserPosition += (dir == Dir::FORWARD) ? 1 : -1;
+  }
+
+  return stepBurst.getPause();
+}
+
+unsigned int Focuser::queueSteps()
+{
+  // Hand the hardware as much of the burst as it can take.  The position
+  // of record is updated when the step is queued.
+  while ( !stepBurst.isDone() && hardware->stepQueueSpace() != 0 )
+  {
+    const HWI::PinState edge = stepBurst.nextEdge();
+    queueEdge( { HWI::Pin::STEP, edge, stepBurst.getPause() } );
+
+    if ( edge == HWI::PinState::STEP_ACTIVE )
+    {
+      focuserPosition += (dir == Dir::FORWARD) ? 1 : -1;
+    }
+  }
+
+  if ( stepBurst.isDone() && hardware->stepQueueSpace() != 0 )
+  {
+    // Room for more - go straight on to the next burst.
+    return 0;
+  }
 
-  focuserPosition += (dir == Dir::FORWARD) ? 1 : -1;
-  //focuserPosition = focuserPosition >= 0 ? focuserPosition : 0;
+  // Come back when half the queue has played, not when it's empty, so
+  // a late loop (a WiFi stall) still finds edges queued and the pulses
+  // don't stop.
+  const uint64_t uSecNow = clock->uSecNow();
+  const uint64_t uSecBacklog =
+    uSecStepQueueDry > uSecNow ? uSecStepQueueDry - uSecNow : 0;
+  return std::max( static_cast<unsigned int>( uSecBacklog / 2 ),
+    stepBurst.getPause() );
+}
 
-  return 0;  
+bool Focuser::queueEdge( const HWI::QueuedEdge& edge )
+{
+  if ( !hardware->queueEdge( edge ))
+  {
+    return false;
+  }
+  const uint64_t uSecNow = clock->uSecNow();
+  uSecStepQueueDry = std::max( uSecStepQueueDry, uSecNow ) + edge.uSecPause;
+  return true;
 }
 
 unsigned int Focuser::stateMoving()
 {
-  WifiDebugOstream log( debugLog.get(), net.get() );
-  log << "Moving " << focuserPosition << "\n";
+  deferredLog.add< Log::Message::Moving >( 
+    debugLog->getMasks(), focuserPosition, motionLogLimit );
   
   if ( stateStack.topArg().getInt() == focuserPosition ) {
     // We're at the target,  exit
+    motionPlanner.stop();
     stateStack.pop();
+    if ( stateStack.topState() != State::MOVING )
+    {
+      // Not a backtrack - the whole move is done.
+      pushMoveDone();
+    }
     return 0;    
   }
 
-  // Check for new commands
-  DebugInterface& debug= *debugLog;
-  auto cp = CommandParser::checkForCommands( debug, *net );
-
-  if ( cp.command != CommandParser::Command::NoCommand )
+  // Check for new commands.  Queries are answered without stopping.
+  if ( takeCommands() )
   {
-    if ( doesCommandInterrupt.at( cp.command ))
-    {
-      stateStack.reset();
-    }
-    processCommand( cp );
-    if ( doesCommandInterrupt.at( cp.command ))
-    {
-      return 0;
-    }
+    return 0;
   }
+  pushMotion();
 
   const int  steps        = stateStack.topArg().getInt() - focuserPosition;
   const Dir  nextDir      = steps > 0 ? Dir::FORWARD : Dir::REVERSE;
@@ -522,6 +1046,7 @@ unsigned int Focuser::stateMoving()
   const int  doStepsMax   = buildParams.timingParams.getMaxStepsBetweenChecks(); 
   const int  clippedSteps = absSteps > doStepsMax ? doStepsMax : absSteps;
 
+  motionPlanner.setStepsToGo( absSteps );
   stateStack.push( State::DO_STEPS, clippedSteps );
   stateStack.push( State::SET_DIR,  nextDir );
   return 0;        
@@ -529,17 +1054,23 @@ unsigned int Focuser::stateMoving()
 
 unsigned int Focuser::stateStopAtHome()
 {
-  WifiDebugOstream log( debugLog.get(), net.get() );
-
   assert ( motorState == MotorState::ON );
 
+  if ( !hardware->isStepQueueIdle() )
+  {
+    // The home input only means something once the last step is done.
+    return buildParams.timingParams.getMicroSecondStepPause();
+  }
+
   if ( hardware->DigitalRead( HWI::Pin::HOME ) == HWI::PinState::HOME_ACTIVE ) 
   {
-    log << "Hit home at position " << focuserPosition << "\n";
-    log << "Resetting position to 0\n";
+    deferredLog.add< Log::Message::HitHome >( 
+      debugLog->getMasks(), focuserPosition );
+    motionPlanner.stop();
     focuserPosition = 0;
     isSynched = true;
     stateStack.pop();
+    pushMoveDone();
     return 0;        
   }
 
@@ -547,26 +1078,20 @@ unsigned int Focuser::stateStopAtHome()
 
   if ( ((focuserPosition) % doStepsMax) == 0 )
   {
-    log << "Homing " << focuserPosition << "\n";
+    deferredLog.add< Log::Message::Homing >( 
+      debugLog->getMasks(), focuserPosition, motionLogLimit );
 
-    // Check for new commands
-    DebugInterface& debug= *debugLog;
-    auto cp = CommandParser::checkForCommands( debug, *net );
-
-    if ( cp.command != CommandParser::Command::NoCommand )
+    // Check for new commands.  Queries are answered without stopping.
+    if ( takeCommands() )
     {
-      if ( doesCommandInterrupt.at( cp.command ))
-      {
-        stateStack.reset();
-      }
-      processCommand( cp );
-      if ( doesCommandInterrupt.at( cp.command ))
-      {
-        return 0;
-      }
+      return 0;
     }
+    pushMotion();
   }
 
+  // Home could be the next step, so plan to stop there.  That keeps
+  // the motor at the start-from-rest speed, or slows it down to it.
+  motionPlanner.setStepsToGo( 0 );
   stateStack.push( State::DO_STEPS, 1 );
   stateStack.push( State::SET_DIR, Dir::REVERSE );
   return 0;        
@@ -575,42 +1100,50 @@ unsigned int Focuser::stateStopAtHome()
 unsigned int Focuser::stateSleep()
 {
   WifiDebugOstream log( debugLog.get(), net.get() );
-  // Check for new commands
-  DebugInterface& debug= *debugLog;
-  auto cp = CommandParser::checkForCommands( debug, *net );
-
-  if ( cp.command != CommandParser::Command::NoCommand )
+  // Check for new commands.  Queries are answered without waking up.
+  if ( takeCommands() )
   {
-    if ( doesCommandInterrupt.at( cp.command ))
-    {
-      stateStack.reset();
-    }
-    processCommand( cp );
-    if ( doesCommandInterrupt.at( cp.command ))
+    if ( motorState != MotorState::ON ) 
     {
-      if ( motorState != MotorState::ON ) 
-      {
-        setMotor( log, MotorState::ON );
-        return buildParams.timingParams.getTimeToPowerStepper() * 1000;
-      }
+      setMotor( log, MotorState::ON );
+      return drainLog( 
+        buildParams.timingParams.getTimeToPowerStepper() * 1000 );
     }
-    return 0;   // Go until we're out of commands.
+    return 0;
   }
 
   if ( motorState != MotorState::OFF )
   {
     setMotor( log, MotorState::OFF );
   }
+  if ( net->canWaitForInput() )
+  {
+    // No need to poll.  Nothing else to do until input arrives.
+    return drainLog( msMaxIdleWait * 1000 );
+  }
+
   const int sleepEpoch = buildParams.timingParams.getEpochForSleepCommandChecks();
   const int mSecToNextEpoch = sleepEpoch - ( time % sleepEpoch ); 
 
-  return mSecToNextEpoch * 1000;
+  return drainLog( mSecToNextEpoch * 1000 );
+}
+
+unsigned int Focuser::drainLog( unsigned int uSecPause )
+{
+  // Only idle states call this, so there's no step pulse to stretch.
+  // Short pauses are left alone so polling stays on schedule.
+  if ( uSecPause >= uSecMinLogSlack && !deferredLog.isEmpty() )
+  {
+    WifiDebugOstream log( debugLog.get(), net.get() );
+    deferredLog.drain( log );
+  }
+  return uSecPause;
 }
 
 unsigned int Focuser::stateError()
 {
   WifiDebugOstream log( debugLog.get(), net.get() );
-  log << "hep hep hep error error error\n";
+  log.error( Log::Category::Motion ) << "hep hep hep error error error\n";
   return 10*1000*1000; // 10 sec pause 
 }
 
@@ -621,14 +1154,110 @@ unsigned int Focuser::stateError()
 /////////////////////////////////////////////////////////////////////////
 
 
+void Focuser::pushMotion()
+{
+  pushedMove = true;
+  const State state = stateStack.topState();
+  for ( unsigned int session = 0; session < maxPushSessions; ++session )
+  {
+    PushSubscription& sub = pushSubscriptions[ session ];
+    if ( sub.msPeriod == 0 )
+    {
+      continue;
+    }
+    const unsigned int moved = focuserPosition > sub.lastPosition ?
+      focuserPosition - sub.lastPosition : sub.lastPosition - focuserPosition;
+    const bool sendState = state != sub.lastState;
+    const bool sendPosition = moved != 0 && moved >= sub.threshold &&
+      time - sub.lastTime >= sub.msPeriod;
+    if ( !sendState && !sendPosition )
+    {
+      continue;
+    }
+
+    net->sendTo( session );
+    const bool binary = net->isBinary( session );
+    if ( sendState )
+    {
+      sub.lastState = state;
+      if ( binary )
+      {
+        uint8_t frame[ BinaryProtocol::overhead + 6 ];
+        net->writeFrame( frame, 
+          encodeBinaryState( state, stateStack.topArg(), frame ));
+      }
+      else
+      {
+        *net << "Event: State " << stateNames.at( state ) << " " 
+             << stateStack.topArg() << "\n";
+      }
+    }
+    if ( sendPosition )
+    {
+      sub.lastTime = time;
+      sub.lastPosition = focuserPosition;
+      if ( binary )
+      {
+        uint8_t frame[ BinaryProtocol::overhead + 5 ];
+        net->writeFrame( frame, 
+          BinaryProtocol::encodePosition( focuserPosition, frame ));
+      }
+      else
+      {
+        *net << "Event: Position " << focuserPosition << "\n";
+      }
+    }
+    net->sendToSubscribers();
+  }
+}
+
+void Focuser::pushMoveDone()
+{
+  if ( !pushedMove )
+  {
+    return;
+  }
+  pushedMove = false;
+  for ( unsigned int session = 0; session < maxPushSessions; ++session )
+  {
+    PushSubscription& sub = pushSubscriptions[ session ];
+    if ( sub.msPeriod == 0 )
+    {
+      continue;
+    }
+    sub.lastPosition = focuserPosition;
+    sub.lastState = State::ACCEPT_COMMANDS;
+
+    net->sendTo( session );
+    if ( net->isBinary( session ))
+    {
+      uint8_t frame[ BinaryProtocol::overhead + 5 ];
+      net->writeFrame( frame, 
+        BinaryProtocol::encodeDone( focuserPosition, frame ));
+    }
+    else
+    {
+      *net << "Event: Done " << focuserPosition << "\n";
+    }
+    net->sendToSubscribers();
+  }
+}
+
 void Focuser::setMotor( WifiDebugOstream& log, MotorState m )
 {
   motorState = m;
 
-  hardware->DigitalWrite( HWI::Pin::MOTOR_ENA, ( m == MotorState::ON ) ?
+  writePin( HWI::Pin::MOTOR_ENA, ( m == MotorState::ON ) ?
       HWI::PinState::MOTOR_ON :
       HWI::PinState::MOTOR_OFF );
 
-  log << "Motor set " << (( m == MotorState::ON ) ? "on" : "off" ) << "\n";
+  log.info( Log::Category::Power ) << "Motor set " << (( m == MotorState::ON ) ? "on" : "off" ) << "\n";
 }
 
+
+void Focuser::writePin( HWI::Pin pin, HWI::PinState state )
+{
+  trace.add( Trace::Kind::PinWrite, static_cast<uint8_t>( pin ), 
+             static_cast<int32_t>( state ));
+  hardware->DigitalWrite( pin, state );
+}
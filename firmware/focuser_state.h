@@ -1,18 +1,19 @@
 #ifndef __FOCUSER_STATE_H__
 #define __FOCUSER_STATE_H__
 
-#include <vector>
+#include <array>
 #include <memory>
 #include <string>
 #include <assert.h>
 #include <unordered_map>
 #include "net_interface.h"
 #include "hardware_interface.h"
+#include "clock_interface.h"
 #include "command_parser.h"
-
-#ifdef GTEST_FOUND
-#include <gtest/gtest_prod.h>
-#endif
+#include "deferred_log.h"
+#include "motion_planner.h"
+#include "loop_profiler.h"
+#include "trace_ring.h"
 
 ///
 /// @brief Focuser Namespace
@@ -40,6 +41,10 @@
 ///       The Hardware Interface (HWI) is how the focuser interacts with
 ///       the actual hardware.  Normally this as the ESP8266 itself, but
 ///       there's a Mock Hardware Interface that's used for testing.
+/// - <b> Clock: </b>
+///       The Clock is where the focuser gets the time.  Focuser::loop 
+///       schedules each call against an absolute deadline, so the time
+///       spent in handlers doesn't turn into drift.
 /// - <b> Debug Interface: </b>
 ///       The Debug Interface (DebugInterface) can be used to send debug
 ///       messages to a host computer.  It's a developer only interface.
@@ -57,11 +62,36 @@
 /// - <b> State Stack: </b>
 ///       The Focuser actually has a stack of states.  The stack is useful
 ///       because it's sometimes easier to describe a complex operation
-///       using simpler operations.  i.e., you can move the stepper motor
-///       one step by running State::STEPPER_ACTIVE_AND_WAIT and then
-///       State::STEPPER_INACTIVE_AND_WAIT.  A move can be done by setting
+///       using simpler operations.  i.e., a move can be done by setting
 ///       a direction using State::SET_DIR and then using State::DO_STEPS
 ///       to take multiple steps.
+/// - <b> Step Bursts: </b>
+///       State::DO_STEPS doesn't push a state for every step pulse.  It
+///       hands the pulses to a StepBurst, which emits the whole burst 
+///       from one state.  This keeps the per-pulse overhead low on 
+///       builds with very short step pauses.
+/// - <b> Profiler: </b>
+///       Focuser::loop keeps call counts and execution time histograms
+///       for every state and command, and a histogram of how late the
+///       caller was getting back to loop.  The perf command dumps and 
+///       resets them.  A dump too long for one reply ends with
+///       "Perf: more", and the next perf carries on from there.  Build
+///       with BEEFOCUS_PROFILER=0 to remove it.
+/// - <b> Step Queue: </b>
+///       If the hardware has a step queue (HWI::hasStepQueue) the bursts 
+///       and direction changes are queued instead of written.  The 
+///       hardware plays the queue from a timer, so pulse spacing doesn't
+///       depend on how promptly Focuser::loop is called.  The queue is
+///       topped up when half of it has played, so a late call doesn't
+///       leave it empty.
+/// - <b> Trace: </b>
+///       State pushes and pops, DIR and MOTOR_ENA writes and commands
+///       are recorded in a FocuserTrace as they happen, a few bytes
+///       each.  The trace command downloads it.  See TraceRing.
+/// - <b> Deferred Log: </b>
+///       The states that run during a move don't format debug lines. 
+///       They add them to a Log::DeferredLog, and State::ACCEPT_COMMANDS
+///       and State::SLEEP format them when they have time to spare.
 ///
 namespace FS {
 
@@ -74,8 +104,6 @@ enum class State
   START_OF_STATES = 0,        ///< Start of States
   ACCEPT_COMMANDS = 0,        ///< Accepting commands from the net interface
   DO_STEPS,                   ///< Doing n Stepper Motor Steps
-  STEPPER_INACTIVE_AND_WAIT,  ///< Set Stepper to Inactive and Pause
-  STEPPER_ACTIVE_AND_WAIT,    ///< Set Stepper to Active and Pause
   SET_DIR,                    ///< Set the Direction Pin
   MOVING,                     ///< Move to an absolute position
   STOP_AT_HOME,               ///< Rewind until the Home input is active
@@ -107,6 +135,15 @@ class StateArg
   int getInt() { assert( type==Type::INT ); return intArg; }
   Dir getDir() { assert( type==Type::DIR ); return dirArg; }
 
+  /// @brief The argument as an int32, for binary frames and the trace.
+  ///        CommandParser::NoArg if there isn't one.
+  int32_t asInt() 
+  { 
+    return type == Type::INT ? intArg :
+           type == Type::DIR ? static_cast<int32_t>( dirArg ) :
+                               CommandParser::NoArg;
+  }
+
   private:
 
   Type type;
@@ -127,14 +164,20 @@ class TimingParams
     unsigned msInactivityToSleepRHS       = 5*60*1000,  // 5 minutes
     int msEpochForSleepCommandChecksRHS   = 1*1000,     // 1 seconds
     int msToPowerStepperRHS               = 1*1000,     // 1 second
-    unsigned microSecondStepPauseRHS      = 1000        // 1 ms
+    unsigned microSecondStepPauseRHS      = 1000,       // 1 ms
+    unsigned microSecondCruisePauseRHS    = 0,          // No ramping
+    unsigned stepsPerSecSqAccelRHS        = 0,          // No ramping
+    unsigned stepsPerSecSqDecelRHS        = 0           // Same as accel
   ) :
     msEpochBetweenCommandChecks{ msEpochBetweenCommandChecksRHS },
     maxStepsBetweenChecks{ maxStepsBetweenChecksRHS },
     msInactivityToSleep{ msInactivityToSleepRHS },
     msEpochForSleepCommandChecks{ msEpochForSleepCommandChecksRHS },
     msToPowerStepper{ msToPowerStepperRHS},
-    microSecondStepPause{ microSecondStepPauseRHS }
+    microSecondStepPause{ microSecondStepPauseRHS },
+    microSecondCruisePause{ microSecondCruisePauseRHS },
+    stepsPerSecSqAccel{ stepsPerSecSqAccelRHS },
+    stepsPerSecSqDecel{ stepsPerSecSqDecelRHS }
   {
   }
 
@@ -162,6 +205,18 @@ class TimingParams
   { 
     return microSecondStepPause;
   }
+  int getMicroSecondCruisePause() const 
+  { 
+    return microSecondCruisePause;
+  }
+  unsigned getAcceleration() const 
+  { 
+    return stepsPerSecSqAccel;
+  }
+  unsigned getDeceleration() const 
+  { 
+    return stepsPerSecSqDecel;
+  }
 
   private:
   int msEpochBetweenCommandChecks;
@@ -170,6 +225,9 @@ class TimingParams
   int msEpochForSleepCommandChecks;
   int msToPowerStepper;
   unsigned microSecondStepPause;
+  unsigned microSecondCruisePause;
+  unsigned stepsPerSecSqAccel;
+  unsigned stepsPerSecSqDecel;
 };
 
 enum class Build
@@ -212,6 +270,9 @@ class BuildParams {
   private:
 };
 
+/// @brief The focuser's trace.  128 records is about 1.5K of RAM.
+using FocuserTrace = TraceRing< 128 >;
+
 ///
 /// @brief Stack of FS:States.
 ///
@@ -220,48 +281,75 @@ class BuildParams {
 /// - In normal operation, the stack's bottom is always an ACCEPT_COMMANDS state
 /// - After construction, the stack can never be empty
 /// - If a pop operation leaves the stack empty an ERROR_STATE is pushed
+/// - If a push would go deeper than maxDepth an ERROR_STATE is pushed 
+///   instead, using a slot that's reserved for it.
+///
+/// The stack lives inline in a fixed size array, so push, pop and reset 
+/// never touch the heap.  If it's given a trace they're recorded there.
 /// 
 class StateStack {
   public:
 
-  StateStack()
+  /// @brief Depth of the stack's bottom, the ACCEPT_COMMANDS state
+  static constexpr std::size_t baseDepth = 1;
+  /// @brief Most states a command pushes (abs_pos - move + backtrack move)
+  static constexpr std::size_t maxCommandDepth = 2;
+  /// @brief Most states a move pushes (DO_STEPS + SET_DIR)
+  static constexpr std::size_t maxMoveDepth = 2;
+  /// @brief Deepest nesting of states in normal operation
+  static constexpr std::size_t maxDepth = 
+    baseDepth + maxCommandDepth + maxMoveDepth;
+  /// @brief Stack capacity.  maxDepth plus a slot for an ERROR_STATE
+  static constexpr std::size_t capacity = maxDepth + 1;
+
+  StateStack() : depth{ 0 }, trace{ nullptr }
   {
     push( State::ACCEPT_COMMANDS, StateArg() );
   }
 
+  /// @brief Record pushes, pops and resets in traceArg from now on
+  void setTrace( FocuserTrace* traceArg )
+  {
+    trace = traceArg;
+  }
+
   /// @brief Reset the stack to the newly initialized state.
   void reset( void )
   {
-    while ( stack.size() > 1 ) pop();
+    depth = 1;
+    record( Trace::Kind::StateReset, stack[0].state, CommandParser::NoArg );
   }
 
   /// @brief Get the top state.
   State topState( void )
   {
-    return stack.back().state;
+    return stack[ depth-1 ].state;
   }
 
   /// @brief Get the top state's argumment.
   StateArg topArg( void )
   {
-    return stack.back().arg;
+    return stack[ depth-1 ].arg;
   }
 
   /// @brief Set the top state's argumment.
   void topArgSet( StateArg newVal )
   {
-    stack.back().arg = newVal;
+    stack[ depth-1 ].arg = newVal;
+  }
+
+  /// @brief How many states are on the stack
+  std::size_t size( void ) const
+  {
+    return depth;
   }
 
   /// @brief Pop the top entry on the stack.
   void pop( void )
   {
-    stack.pop_back();
-    if ( stack.size() > 10 ) 
-    {
-      push( State::ERROR_STATE, StateArg(__LINE__) ); 
-    }
-    if ( stack.empty() ) 
+    record( Trace::Kind::StatePop, topState(), topArg().asInt() );
+    --depth;
+    if ( depth == 0 ) 
     {
       // bug, should never happen.
       push( State::ERROR_STATE, StateArg(__LINE__) ); 
@@ -271,18 +359,117 @@ class StateStack {
   /// @brief Push a new entry onto the stack
   void push( State newState, StateArg newArg = StateArg() )
   {
-    stack.push_back( { newState , newArg } );
+    if ( depth >= maxDepth )
+    {
+      // bug, should never happen.  Report the overflow in the reserved 
+      // slot instead of running off the end of the stack.
+      depth = maxDepth;
+      stack[ depth++ ] = { State::ERROR_STATE, StateArg(__LINE__) };
+      record( Trace::Kind::StatePush, State::ERROR_STATE, __LINE__ );
+      return;
+    }
+    stack[ depth++ ] = { newState , newArg };
+    record( Trace::Kind::StatePush, newState, newArg.asInt() );
   }  
   
   private:
 
+  void record( Trace::Kind kind, State state, int32_t arg )
+  {
+    if ( trace )
+    {
+      trace->add( kind, static_cast<uint8_t>( state ), arg );
+    }
+  }
+
   typedef struct 
   {
     State state;   
     StateArg arg; 
   } CommandPacket;
 
-  std::vector< CommandPacket > stack;
+  std::array< CommandPacket, capacity > stack;
+  std::size_t depth;
+  /// @brief Where pushes, pops and resets are recorded.  Can be null.
+  FocuserTrace* trace;
+};
+
+///
+/// @brief Generates the step pulses for State::DO_STEPS
+///
+/// Each step pulse is two edges on the step pin - an active edge 
+/// followed by an inactive edge, with a pause after each one.  The
+/// number of edges in a burst is computed once, when the burst starts.
+/// The pause for each step comes from a MotionPlanner, which is asked
+/// once per step on the active edge.  
+///
+/// Example:
+///
+/// @code
+///   MotionPlanner planner( 1000, 0, 0, 0 );   // 1000us, no ramping
+///   StepBurst burst( planner );
+///   burst.start( 2 );         // 2 steps
+///   burst.nextEdge();         // STEP_ACTIVE
+///   burst.nextEdge();         // STEP_INACTIVE
+///   burst.nextEdge();         // STEP_ACTIVE
+///   burst.nextEdge();         // STEP_INACTIVE
+///   burst.isDone();           // true
+/// @endcode
+///
+class StepBurst {
+  public:
+
+  StepBurst( MotionPlanner& plannerArg ) : 
+    planner( plannerArg ), edgesLeft{ 0 }, uSecPause{ 0 }
+  {
+  }
+
+  /// @brief Start a new burst
+  ///
+  /// @param[in] steps          - Number of step pulses in the burst
+  ///
+  void start( int steps )
+  {
+    edgesLeft = steps * 2;
+  }
+
+  /// @brief Have all of the burst's edges been emitted?
+  bool isDone() const
+  {
+    return edgesLeft == 0;
+  }
+
+  /// @brief Get the state of the step pin for the next edge
+  ///
+  /// Active edges are the ones where edgesLeft is even before the
+  /// decrement, so every burst starts active and finishes inactive.
+  ///
+  HWI::PinState nextEdge()
+  {
+    assert( edgesLeft > 0 );
+    --edgesLeft;
+    if ( edgesLeft & 1 )
+    {
+      uSecPause = planner.nextStepPause();
+      return HWI::PinState::STEP_ACTIVE;
+    }
+    return HWI::PinState::STEP_INACTIVE;
+  }
+
+  /// @brief The pause after the last edge, in microseconds
+  unsigned int getPause() const
+  {
+    return uSecPause;
+  }
+
+  private:
+
+  /// @brief Where the pause for each step comes from
+  MotionPlanner& planner;
+  /// @brief Edges left in the burst.  Two edges per step.
+  int edgesLeft;
+  /// @brief Pause after the current step's edges in microseconds
+  unsigned int uSecPause;
 };
 
 /// @brief Main Focuser Class
@@ -292,10 +479,10 @@ class StateStack {
 /// 1. It accepts new commands from a network interface
 /// 2. Over time, it manipulates a hardware interface to implement the commands
 ///
-/// At construction time the Focuser is provided three interfaces - an
+/// At construction time the Focuser is provided four interfaces - an
 /// interface to the network (i.e., a Wifi Connection), an interface to the 
-/// the hardware (i.e., the pins in a Micro-Controller) an interface for
-/// debug logging, and the focuser's hardware parameters
+/// the hardware (i.e., the pins in a Micro-Controller), a clock, an 
+/// interface for debug logging, and the focuser's hardware parameters
 ///
 /// Once the focuser is initialized, the loop function is used to real time
 /// updates.  The loop function returns a minimum time that the caller should
@@ -303,7 +490,8 @@ class StateStack {
 ///
 /// the main event loop could look something like the following:
 ///
-/// Focuser( std::move(net), std::move(hardware), std::move(debug), params );
+/// Focuser( std::move(net), std::move(hardware), std::move(clock), 
+///          std::move(debug), params );
 /// for ( ;; ) {
 ///   unsigned int delay = Focuser.loop();
 ///   delayMicroseconds( delay );   
@@ -317,12 +505,14 @@ class Focuser
   ///
   /// @param[in] netArg       - Interface to the network
   /// @param[in] hardwareArg  - Interface to the Hardware
+  /// @param[in] clockArg     - Interface to the Clock
   /// @param[in] debugArg     - Interface to the debug logger.
   /// @param[in] params       - Hardware Parameters 
   ///
   Focuser( 
 		std::unique_ptr<NetInterface> netArg,
 		std::unique_ptr<HWI> hardwareArg,
+		std::unique_ptr<Clock> clockArg,
 		std::unique_ptr<DebugInterface> debugArg,
     const BuildParams params
 	);
@@ -335,21 +525,95 @@ class Focuser
   ///
   unsigned int loop();
 
+  ///
+  /// @brief Wait out the pause that loop asked for, or part of it
+  ///
+  /// If the focuser is idle (waiting on commands) and the net interface
+  /// can wait for input, waits until input arrives or the pause ends.
+  /// Otherwise the caller has to do the waiting.
+  ///
+  /// @param[in] uSecPause - What loop returned
+  /// @return    The part of the pause the caller still has to wait.
+  ///
+  unsigned int waitForInput( unsigned int uSecPause );
+
   private:
 
-#ifdef GTEST_FOUND
-  // So we can unit test the consistency of the class's constant - static 
-  // data without exposing it to everybody
-  FRIEND_TEST(FOCUSER_STATE, allStatesHaveImplementations);
-  FRIEND_TEST(FOCUSER_STATE, allCommandsHaveImplementations);
-#endif
+  /// @brief Longest an idle focuser waits for input before it looks 
+  ///        around again, in ms
+  static constexpr unsigned int msMaxIdleWait = 60*1000;
+
+  /// @brief How far Focuser::loop can fall behind its deadlines and 
+  ///        still catch up, in us.  Past that the missed time is dropped.
+  static constexpr unsigned int uSecMaxCatchUp = 10*1000;
+
+  /// @brief Shortest pause the idle states format deferred log lines
+  ///        in, in us.  About a line at 115200 baud.
+  static constexpr unsigned int uSecMinLogSlack = 5*1000;
 
-  static const std::unordered_map<CommandParser::Command,
-    void (Focuser::*)( CommandParser::CommandPacket),EnumHash> 
-    commandImpl;
+  /// @brief How long SET_DIR waits before it tries a full step queue
+  ///        again, in us
+  static constexpr unsigned int uSecStepQueueRetry = 200;
+
+  /// @brief Sessions that can subscribe to motion updates
+  static constexpr unsigned int maxPushSessions = 4;
+
+  /// @brief Longest state or command name the perf command prints
+  static constexpr std::size_t maxPerfNameLength = 24;
+
+  ///
+  /// @brief A session's subscription to motion updates
+  ///
+  /// Set up by the subscribe and threshold commands.  While the focuser
+  /// moves, a subscribed session is sent its position at most every
+  /// msPeriod, and only if it's changed by threshold steps or more.
+  /// The state is sent when it changes and the final position when the
+  /// move is over, however short the move.  The subscription is 
+  /// cleared when the session goes to a new client.
+  ///
+  struct PushSubscription {
+    /// @brief Shortest time between position updates, in ms.  0 is off.
+    unsigned int msPeriod;
+    /// @brief Smallest position change worth an update, in steps
+    unsigned int threshold;
+    /// @brief When the last position update was sent, in ms
+    uint64_t lastTime;
+    /// @brief The position in the last update
+    int lastPosition;
+    /// @brief The state in the last update.  ACCEPT_COMMANDS if the
+    ///        session hasn't heard about the current move.
+    State lastState;
+  };
 
   using ptrToMember = unsigned int ( Focuser::*) ( void );
-  static const std::unordered_map< State, ptrToMember, EnumHash > stateImpl;
+  using ptrToCommand = void ( Focuser::*) ( CommandParser::CommandPacket );
+
+  /// @brief What the focuser runs in a particular state
+  struct StateImpl {
+    State key;
+    ptrToMember function;
+  };
+
+  /// @brief What the focuser runs for a particular command
+  struct CommandImpl {
+    CommandParser::Command key;
+    ptrToCommand function;
+  };
+
+  /// @brief State handlers, indexed by State.  
+  ///
+  /// Defined constexpr in focuser_state.cpp and checked with 
+  /// BeeFocus::isEnumIndexed, so a missing state is a build error.
+  ///
+  static const StateImpl stateImpl[ BeeFocus::toIndex( State::END_OF_STATES ) ];
+
+  /// @brief Command handlers, indexed by CommandParser::Command.
+  ///
+  /// Defined constexpr in focuser_state.cpp and checked with 
+  /// BeeFocus::isEnumIndexed, so a missing command is a build error.
+  ///
+  static const CommandImpl commandImpl[ 
+    BeeFocus::toIndex( CommandParser::Command::EndOfCommands ) ];
 
   /// @brief Deleted copy constructor
   Focuser( const Focuser& other ) = delete;
@@ -362,18 +626,39 @@ class Focuser
 
   void processCommand( CommandParser::CommandPacket cp );
 
+  /// @brief Take every command that's waiting on the network
+  ///
+  /// Queries (commands that don't interrupt) are answered right away,
+  /// without leaving the current state.  Commands that interrupt reset
+  /// the state stack before they run, so they replace whatever the
+  /// focuser was doing.  Every sync is run, but of the other
+  /// interrupting commands only the last one taken in a batch is -
+  /// the ones it replaced get an error.  Queries taken after an
+  /// interrupting command see its effect.  Commands that came on one
+  /// line are answered with one line.
+  ///
+  /// @return true if an interrupting command was run.
+  ///
+  bool takeCommands( void );
+
+  /// @brief Send motion updates that are due to subscribed sessions
+  void pushMotion( void );
+  /// @brief Tell subscribed sessions the move is over, if they heard
+  ///        it had started
+  void pushMoveDone( void );
+
   /// @brief Wait for commands from the network interface
   unsigned int stateAcceptCommands( void ); 
   /// @brief Move to position @arg
   unsigned int stateMoving( void );
   /// @brief Move the stepper @arg steps 
   unsigned int stateDoingSteps( void );
+  /// @brief Queue as much of the current step burst as the hardware takes
+  unsigned int queueSteps( void );
+  /// @brief Add an edge to the step queue and note when it runs dry
+  bool queueEdge( const HWI::QueuedEdge& edge );
   /// @brief If needed, Change the state of the direction pin and pause
   unsigned int stateSetDir( void );
-  /// @brief Set the Stepper to active (i.e., start step) and wait
-  unsigned int stateStepActiveAndWait( void );
-  /// @brief Set the Stepper to inactive (i.e., finish step) and wait
-  unsigned int stateStepInactiveAndWait( void );
   /// @brief Rewind the focuser until the home input is active.
   unsigned int stateStopAtHome( void );
   /// @brief Low power mode
@@ -381,6 +666,13 @@ class Focuser
   /// @brief If we land in this state, complain a lot.
   unsigned int stateError( void );
 
+  /// @brief Format the deferred log if there's time, then pause
+  ///
+  /// @param[in] uSecPause - The pause an idle state wants
+  /// @return    uSecPause
+  ///
+  unsigned int drainLog( unsigned int uSecPause );
+
   void doAbort( CommandParser::CommandPacket );
   void doHome( CommandParser::CommandPacket );
   void doLHome( CommandParser::CommandPacket );
@@ -393,14 +685,53 @@ class Focuser
   void doFirmware( CommandParser::CommandPacket );
   void doCaps( CommandParser::CommandPacket );
   void doDebugOff( CommandParser::CommandPacket );
+  void doPerf( CommandParser::CommandPacket );
+  void doEvents( CommandParser::CommandPacket );
+  void doBinary( CommandParser::CommandPacket );
+  void doSubscribe( CommandParser::CommandPacket );
+  void doThreshold( CommandParser::CommandPacket );
+  void doVerbose( CommandParser::CommandPacket );
+  void doTrace( CommandParser::CommandPacket );
   void doError( CommandParser::CommandPacket );
 
   std::unique_ptr<NetInterface> net;
   std::unique_ptr<HWI> hardware;
+  std::unique_ptr<Clock> clock;
   std::unique_ptr<DebugInterface> debugLog;
   
   const BuildParams buildParams;
 
+  /// @brief Speed profile for the stepper motor
+  MotionPlanner motionPlanner;
+
+  /// @brief Pulse generator for the current State::DO_STEPS burst
+  StepBurst stepBurst;
+
+  /// @brief Commands taken from the network, used by takeCommands
+  CommandParser::CommandQueue commandQueue;
+
+  using Profiler = LoopProfiler< BEEFOCUS_PROFILER, 
+    BeeFocus::toIndex( State::END_OF_STATES ),
+    BeeFocus::toIndex( CommandParser::Command::EndOfCommands ) >;
+
+  /// @brief Where loop spends its time.  Reported by the perf command.
+  Profiler profiler;
+
+  /// @brief Motion update subscriptions, indexed by session
+  std::array< PushSubscription, maxPushSessions > pushSubscriptions;
+
+  /// @brief Has pushMotion run since the current move started?
+  bool pushedMove;
+
+  /// @brief Keeps the "Moving" and "Homing" debug lines to one a second
+  Log::RateLimit motionLogLimit;
+
+  /// @brief Log lines from the motion states, waiting for drainLog
+  Log::DeferredLog< 16 > deferredLog;
+
+  /// @brief Recent states, pin writes and commands.  See FocuserTrace.
+  FocuserTrace trace;
+
   /// @brief What direction are we going? 
   ///
   /// FORWARD = counting up.
@@ -416,22 +747,29 @@ class Focuser
   /// @brief Is the Stepper Motor On or Off. 
   MotorState motorState;
 
+
   void setMotor( WifiDebugOstream& log, MotorState );
 
+  /// @brief Write a pin and record the write in the trace
+  void writePin( HWI::Pin pin, HWI::PinState state );
+
   /// @brief What is the focuser's position of record
   int focuserPosition;
 
   /// @brief Is the focuser synched to a "known good" position
   bool isSynched;
 
-  /// @brief Focuser uptime in MS
-  unsigned int time;
+  /// @brief Clock time in MS, read at the start of Focuser::loop
+  uint64_t time;
 
-  /// @brief For computing time in Focuser::loop
-  unsigned int uSecRemainder;
+  /// @brief When the current call to Focuser::loop was scheduled, in us
+  uint64_t uSecDeadline;
+
+  /// @brief When the hardware's step queue plays its last edge, in us
+  uint64_t uSecStepQueueDry;
 
   /// @brief Time the last command that could have caused an interrupt happened
-  unsigned int timeLastInterruptingCommandOccured;
+  uint64_t timeLastInterruptingCommandOccured;
 };
 
 /// @brief Increment operator for State enum
@@ -443,17 +781,45 @@ inline State& operator++( State &s )
 
 /// @brief State to std::string Unordered Map
 using StateToString = std::unordered_map< State, const std::string, EnumHash >;
-/// @brief Command to bool Unordered Map
-using CommandToBool = std::unordered_map< CommandParser::Command, bool, EnumHash >;
+
+/// @brief Does a command interrupt the current state? Indexed by Command.
+struct CommandToBool {
+  CommandParser::Command key;
+  bool interrupts;
+};
 
 extern const StateToString stateNames;
+
+/// @brief Table behind doesCommandInterrupt.  
+///
+/// Defined constexpr in focuser_state.cpp and checked with 
+/// BeeFocus::isEnumIndexed, so a missing command is a build error.
+///
+extern const CommandToBool commandInterrupts[
+  BeeFocus::toIndex( CommandParser::Command::EndOfCommands ) ];
+
 ///
 /// @brief Does a particular incoming command interrupt the current state
 ///
 /// Example 1.  A "Status" Command will not interrupt a move sequence
 /// Example 2.  A "Home" Command will interrupt a focuser's move sequence
 ///
-extern const CommandToBool doesCommandInterrupt;
+inline bool doesCommandInterrupt( CommandParser::Command c )
+{
+  return commandInterrupts[ BeeFocus::toIndex( c ) ].interrupts;
+}
+
+///
+/// @brief Does a command only replace whatever the focuser was doing?
+///
+/// Every interrupting command but sync.  Of these, only the last one
+/// in a batch matters.  Sync also sets the position, so every sync is
+/// run, in the order it arrived.
+///
+inline bool doesCommandReplaceMotion( CommandParser::Command c )
+{
+  return doesCommandInterrupt( c ) && c != CommandParser::Command::Sync;
+}
 
 /// @brief Output StateArg
 template <class T,
@@ -0,0 +1,232 @@
+#ifndef __FRAMED_CONNECTION_H__
+#define __FRAMED_CONNECTION_H__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "net_interface.h"
+#include "line_buffer.h"
+#include "binary_protocol.h"
+#include "output_queue.h"
+
+///
+/// @brief The part of a client connection that doesn't care about the
+///        transport
+///
+/// WifiConnectionEthernet and NetConnectionEpoll speak the same
+/// protocol over different sockets.  This holds what they share - the
+/// input ring, the subscription, binary framing, line joining and the
+/// output queue.  A transport adds:
+///
+/// - Reading.  New bytes go into m_incoming, then getBufferedString
+///   takes a line, or in binary mode a frame, out.
+/// - flush.  Drop the client if m_outgoing overflowed, otherwise drain
+///   m_outgoing into the socket without blocking.
+/// - operator bool, i.e., is there a client?
+///
+/// Example:
+///
+/// @code
+///   connection.setBinary( true );
+///   connection << "Position: 5\n";    // Queued as a Text frame
+///   connection.joinLines( true );
+///   connection.setBinary( false );
+///   connection << "A\nB\n";           // "A; B" so far
+///   connection.joinLines( false );    // "A; B\n"
+///   connection.flush();
+/// @endcode
+///
+class FramedConnection: public NetConnection {
+
+  public:
+
+  /// @brief Does the client want unsolicited output?
+  bool isSubscribed( void ) const { return m_subscribed; }
+  void setSubscribed( bool on ) { m_subscribed = on; }
+
+  /// @brief Is the client using binary framing?  See binary_protocol.h
+  bool isBinary( void ) const { return m_binary; }
+  void setBinary( bool on )
+  {
+    m_binary = on;
+    m_textLength = 0;
+    m_incoming.setLineMode( !on );
+  }
+
+  /// @brief Join lines into one.  See NetInterface::joinLines
+  void joinLines( bool on )
+  {
+    m_joinLines = on;
+    if ( !on && m_joinPending )
+    {
+      m_joinPending = false;
+      writeText( "\n", 1 );
+    }
+  }
+
+  std::streamsize write( const char_type* s, std::streamsize n ) override
+  {
+    if ( !*this ) { return n; }
+    if ( !m_joinLines )
+    {
+      writeText( s, n );
+      return n;
+    }
+
+    // Joining lines - a '\n' becomes "; " once we know more text follows.
+    const char_type* const end = s + n;
+    while ( s != end )
+    {
+      if ( m_joinPending )
+      {
+        writeText( "; ", 2 );
+        m_joinPending = false;
+      }
+      const char_type* newLine =
+        static_cast<const char_type*>( memchr( s, '\n', end - s ));
+      if ( newLine == nullptr )
+      {
+        writeText( s, end - s );
+        break;
+      }
+      writeText( s, newLine - s );
+      m_joinPending = true;
+      s = newLine + 1;
+    }
+    return n;
+  }
+
+  /// @brief Send a binary frame as is
+  void writeFrame( const uint8_t* frame, std::size_t length )
+  {
+    if ( !*this ) { return; }
+    m_outgoing.writeBlock( reinterpret_cast<const char_type*>( frame ),
+      length, false );
+  }
+
+  /// @brief Debug lines thrown away because the client wasn't reading
+  uint32_t debugLinesDropped( void ) const
+  {
+    return m_outgoing.getDebugDropped();
+  }
+
+  protected:
+
+  FramedConnection()
+  {
+    resetSession();
+  }
+
+  /// @brief Forget the last client's input, output and settings
+  void resetSession( void )
+  {
+    m_incoming.reset();
+    m_subscribed = false;
+    setBinary( false );
+    m_joinLines = false;
+    m_joinPending = false;
+    m_outgoing.reset();
+  }
+
+  ///
+  /// @brief Tell a client that's about to be dropped why
+  ///
+  /// Output the client hasn't taken is thrown away and the notice is
+  /// queued in its place, so the flush before the drop sends the
+  /// notice first.  It still only goes if the socket has room for it -
+  /// a client that stopped reading isn't told.
+  ///
+  void queueDropNotice( void )
+  {
+    static const char_type notice[] =
+      "# New Client and no free slots - Dropping Your Connection.\n";
+    m_outgoing.reset();
+    m_textLength = 0;
+    m_joinLines = false;
+    m_joinPending = false;
+    write( notice, sizeof( notice ) - 1 );
+  }
+
+  /// @brief Take a line, or in binary mode a frame, that's been read
+  bool getBufferedString( std::string& string )
+  {
+    if ( m_binary )
+    {
+      return BinaryProtocol::getFrame( m_incoming, string );
+    }
+    return m_incoming.getLine( string );
+  }
+
+  /// @brief Is a line, or in binary mode any input, waiting to be taken?
+  bool hasBufferedInput( void )
+  {
+    return m_binary ? m_incoming.size() != 0 : m_incoming.hasLine();
+  }
+
+  /// @brief Longest command line a client can send, plus its '\n'
+  static constexpr std::size_t maxLineLength = 256;
+
+  /// @brief Bytes in each of the output queue's segments
+  static constexpr std::size_t outputSegmentBytes = 128;
+
+  /// @brief Room in the output queue kept for replies.  A segment more
+  ///        than the longest, for the debug line that crosses the high
+  ///        water mark and the part sent of the oldest segment.
+  static constexpr std::size_t outputReplyBytes =
+    NetInterface::maxReplyBytes + outputSegmentBytes;
+
+  /// @brief Room in the output queue for debug lines
+  static constexpr std::size_t outputDebugBytes = 512;
+
+  LineBuffer< maxLineLength > m_incoming;
+  /// @brief Output the client hasn't taken yet.  See flush.
+  OutputQueue< outputSegmentBytes,
+    ( outputReplyBytes + outputDebugBytes ) / outputSegmentBytes,
+    outputReplyBytes > m_outgoing;
+
+  private:
+
+  void writeText( const char_type* s, std::size_t n )
+  {
+    if ( !m_binary )
+    {
+      m_outgoing.writeText( s, n );
+      return;
+    }
+
+    // Binary mode - each line of text goes out as a Text frame.  Lines
+    // that are too long for a frame are cut short.
+    for ( std::size_t i = 0; i < n; ++i )
+    {
+      if ( s[i] != '\n' )
+      {
+        if ( m_textLength < m_text.size() )
+        {
+          m_text[ m_textLength++ ] = s[i];
+        }
+        continue;
+      }
+      uint8_t frame[ BinaryProtocol::maxFrame ];
+      const std::size_t length =
+        BinaryProtocol::encodeText( m_text.data(), m_textLength, frame );
+      const bool isDebug = m_textLength != 0 && m_text[0] == '#';
+      m_outgoing.writeBlock( reinterpret_cast<const char_type*>( frame ),
+        length, isDebug );
+      m_textLength = 0;
+    }
+  }
+
+  bool m_subscribed;
+  bool m_binary;
+  /// @brief In binary mode, text waiting for its '\n' to become a frame
+  std::array< char, BinaryProtocol::maxPayload - 1 > m_text;
+  std::size_t m_textLength;
+  /// @brief Are lines being joined?  See joinLines.
+  bool m_joinLines;
+  /// @brief A joined line ended.  "; " goes out if more text follows.
+  bool m_joinPending;
+};
+
+#endif
@@ -1,41 +1,136 @@
 #include <ESP8266WiFi.h>
 #include "hardware_esp8266.h"
 
-const std::unordered_map<HWI::Pin, int, EnumHash > HardwareESP8266::pinMap = {
+// Indexed by Pin, so entries must stay in enum order.
+constexpr const HardwareESP8266::EnumToInt<HWI::Pin> 
+  HardwareESP8266::pinMap[] = 
+{
   { Pin::STEP,        4 },
   { Pin::DIR,         5 },
   { Pin::MOTOR_ENA,   14},
   { Pin::HOME,        13}
 };
 
-const std::unordered_map<HWI::PinState, int, EnumHash > HardwareESP8266::pinStateMap = {
+// Indexed by PinState, so entries must stay in enum order.
+constexpr const HardwareESP8266::EnumToInt<HWI::PinState> 
+  HardwareESP8266::pinStateMap[] = 
+{
   { PinState::STEP_ACTIVE,    HIGH },
   { PinState::STEP_INACTIVE,  LOW  },
-  { PinState::DIR_BACKWARD,   LOW  },
   { PinState::DIR_FORWARD,    HIGH },
-  { PinState::MOTOR_OFF,      HIGH },    // Active low
+  { PinState::DIR_BACKWARD,   LOW  },
   { PinState::MOTOR_ON,       LOW  },    // Active low
-  { PinState::HOME_INACTIVE,  HIGH },    // Active low
+  { PinState::MOTOR_OFF,      HIGH },    // Active low
   { PinState::HOME_ACTIVE,    LOW},      // Active low
+  { PinState::HOME_INACTIVE,  HIGH },    // Active low
 };
 
+StepQueue<64> HardwareESP8266::stepQueue;
+volatile bool HardwareESP8266::timerRunning = false;
+
+// Timer 1 runs off the 80Mhz clock divided by 16
+constexpr uint32_t timerTicksPerMicroSecond = 5;
+// Shortest timer 1 interval, so the interrupt has time to return.
+constexpr uint32_t minTimerTicks = 50;
+// Timer 1 has a 23 bit counter
+constexpr uint32_t maxTimerTicks = ( 1u << 23 ) - 1;
+
+HardwareESP8266::HardwareESP8266()
+{
+  timer1_isr_init();
+  timer1_attachInterrupt( onTimer );
+  timer1_enable( TIM_DIV16, TIM_EDGE, TIM_SINGLE );
+}
+
 void HardwareESP8266::DigitalWrite( Pin pin, PinState state )
 {
-  int actualPin = pinMap.at( pin );
-  int actualState = pinStateMap.at( state );
+  static_assert( BeeFocus::isEnumIndexed( pinMap ),
+    "pinMap must have one entry per Pin, in enum order" );
+  static_assert( BeeFocus::isEnumIndexed( pinStateMap ),
+    "pinStateMap must have one entry per PinState, in enum order" );
+
+  int actualPin = pinMap[ BeeFocus::toIndex( pin ) ].value;
+  int actualState = pinStateMap[ BeeFocus::toIndex( state ) ].value;
   digitalWrite( actualPin, actualState );
 }
 
 void HardwareESP8266::PinMode( Pin pin, PinIOMode mode )
 {
-  int actualPin = pinMap.at( pin );
+  int actualPin = pinMap[ BeeFocus::toIndex( pin ) ].value;
   pinMode( actualPin, mode == PinIOMode::M_OUTPUT ? OUTPUT : INPUT );
 }
 
 HWI::PinState HardwareESP8266::DigitalRead( Pin pin)
 {
-  int actualPin = pinMap.at( pin );
+  int actualPin = pinMap[ BeeFocus::toIndex( pin ) ].value;
   // Tmp Hack.  It's always the home pin, which is active low
   return digitalRead( actualPin ) ? PinState::HOME_INACTIVE : PinState::HOME_ACTIVE;
 }
 
+bool HardwareESP8266::hasStepQueue()
+{
+  return true;
+}
+
+bool HardwareESP8266::queueEdge( const QueuedEdge& edge )
+{
+  if ( !stepQueue.push( edge )) 
+  {
+    return false;
+  }
+
+  // If the timer has run dry, restart it.  Interrupts are off so the
+  // timer can't stop between the check and the restart.
+  noInterrupts();
+  if ( !timerRunning )
+  {
+    timerRunning = true;
+    timer1_write( minTimerTicks );
+  }
+  interrupts();
+  return true;
+}
+
+std::size_t HardwareESP8266::stepQueueSpace()
+{
+  return stepQueue.space();
+}
+
+bool HardwareESP8266::isStepQueueIdle()
+{
+  return !timerRunning;
+}
+
+uint32_t HardwareESP8266::getCycleCount()
+{
+  return ESP.getCycleCount();
+}
+
+uint32_t HardwareESP8266::getCyclesPerMicroSecond()
+{
+  return ESP.getCpuFreqMHz();
+}
+
+uint32_t ICACHE_RAM_ATTR HardwareESP8266::toTicks( unsigned int uSecPause )
+{
+  const uint32_t ticks = uSecPause * timerTicksPerMicroSecond;
+  if ( ticks < minTimerTicks ) return minTimerTicks;
+  if ( ticks > maxTimerTicks ) return maxTimerTicks;
+  return ticks;
+}
+
+void ICACHE_RAM_ATTR HardwareESP8266::onTimer()
+{
+  QueuedEdge edge;
+  if ( !stepQueue.pop( edge )) 
+  {
+    // The last edge's pause is over and there's nothing left to do.
+    timerRunning = false;
+    return;
+  }
+
+  int actualPin = pinMap[ BeeFocus::toIndex( edge.pin ) ].value;
+  int actualState = pinStateMap[ BeeFocus::toIndex( edge.state ) ].value;
+  digitalWrite( actualPin, actualState );
+  timer1_write( toTicks( edge.uSecPause ));
+}
@@ -2,19 +2,57 @@
 #define __HARDWARE_ARDUINO_H__
 
 #include "hardware_interface.h"
+#include "step_queue.h"
 
 class HardwareESP8266: public HWI
 {
   public:
 
+  HardwareESP8266();
+
   void     DigitalWrite( Pin pin, PinState state ) override;
   void     PinMode( Pin pin, PinIOMode state ) override;
   PinState DigitalRead( Pin pin) override;
 
+  bool        hasStepQueue() override;
+  bool        queueEdge( const QueuedEdge& edge ) override;
+  std::size_t stepQueueSpace() override;
+  bool        isStepQueueIdle() override;
+
+  uint32_t    getCycleCount() override;
+  uint32_t    getCyclesPerMicroSecond() override;
+
   private:
+
+  /// @brief Timer 1 interrupt.  Writes the next queued edge.
+  static void onTimer();
+
+  /// @brief Convert a pause to timer 1 ticks
+  static uint32_t toTicks( unsigned int uSecPause );
+
+  /// @brief Edges waiting for the timer 1 interrupt
+  ///
+  /// Static because the interrupt handler is a plain function.  There's
+  /// only one timer 1, so there's only one queue.
+  ///
+  static StepQueue<64> stepQueue;
+
+  /// @brief Is timer 1 working its way through the queue?
+  static volatile bool timerRunning;
+
+  /// @brief Maps a HWI enum (the key) to an ESP8266 pin or level
+  template< typename ENUM >
+  struct EnumToInt {
+    ENUM key;
+    int value;
+  };
  
-  static const std::unordered_map<HWI::Pin, int, EnumHash > pinMap;
-  static const std::unordered_map<HWI::PinState, int, EnumHash > pinStateMap;
+  /// @brief ESP8266 pin numbers, indexed by Pin
+  static const EnumToInt<HWI::Pin> pinMap[ 
+    BeeFocus::toIndex( HWI::Pin::END_OF_PINS ) ];
+  /// @brief ESP8266 output levels, indexed by PinState
+  static const EnumToInt<HWI::PinState> pinStateMap[ 
+    BeeFocus::toIndex( HWI::PinState::END_OF_PIN_STATES ) ];
 };
 
 #endif
@@ -3,6 +3,7 @@
 
 #include <unordered_map>
 #include <string>
+#include <cstdint>
 #include "basic_types.h"
 
 struct EnumHash
@@ -59,6 +60,45 @@ class HWI
   virtual void DigitalWrite( Pin pin, PinState state ) = 0;
   virtual void PinMode( Pin pin, PinIOMode mode ) = 0;
   virtual PinState DigitalRead( Pin pin) = 0;
+
+  /// @brief An edge for the step queue
+  ///
+  /// The edge is written to the pin, then the queue waits uSecPause
+  /// microseconds before it writes the next edge.
+  ///
+  struct QueuedEdge {
+    Pin pin;
+    PinState state;
+    unsigned int uSecPause;
+  };
+
+  /// @brief Does the hardware have a step queue?
+  ///
+  /// Hardware with a step queue writes queued edges from its own timer,
+  /// so pulse spacing doesn't depend on when the caller gets around to
+  /// the next DigitalWrite.  The rest of the step queue interface is 
+  /// only used if this returns true.
+  ///
+  virtual bool hasStepQueue() { return false; }
+
+  /// @brief Add an edge to the step queue
+  ///
+  /// @param[in] edge  - The pin, its new state, and the pause after it
+  /// @return          - false if the queue is full
+  ///
+  virtual bool queueEdge( const QueuedEdge& edge ) { (void) edge; return false; }
+
+  /// @brief How many more edges the step queue can take
+  virtual std::size_t stepQueueSpace() { return 0; }
+
+  /// @brief Has the last queued edge been written and its pause finished?
+  virtual bool isStepQueueIdle() { return true; }
+
+  /// @brief Free running cycle counter, used for profiling.  Wraps.
+  virtual uint32_t getCycleCount() { return 0; }
+
+  /// @brief How fast getCycleCount counts
+  virtual uint32_t getCyclesPerMicroSecond() { return 1; }
 };
 
 // @brief Increment operator for Hardware Interface Pin
@@ -0,0 +1,167 @@
+#ifndef __INPUT_SCHEDULER_H__
+#define __INPUT_SCHEDULER_H__
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include "net_interface.h"
+
+///
+/// @brief Input counters for one client connection
+///
+/// A poll is a run of InputScheduler::getString calls that ends when it
+/// returns false.  A line that's waiting when its client has used up
+/// its share of a poll waits for the next poll.  deferred counts those
+/// polls, and maxPollsWaited is the most of them in a row before the
+/// client got another turn.  With a fair scheduler that's 1.  A client
+/// with a growing backlog shows up as deferred growing every poll.
+///
+class InputStats {
+  public:
+
+  InputStats()
+  {
+    reset();
+  }
+
+  void reset()
+  {
+    lines = 0;
+    deferred = 0;
+    pollsWaiting = 0;
+    maxPollsWaited = 0;
+  }
+
+  /// @brief Lines taken from the connection
+  unsigned int lines;
+  /// @brief Polls that ended with the connection's input left waiting
+  unsigned int deferred;
+  /// @brief Polls in a row the connection's input has been waiting
+  unsigned int pollsWaiting;
+  /// @brief Most polls in a row the connection's input ever waited
+  unsigned int maxPollsWaited;
+};
+
+///
+/// @brief Share input fairly between client connections
+///
+/// Each getString call starts looking at the connection after the one
+/// that gave the last line, so every client with input gets a turn
+/// before any client gets a second one.  A client can give at most
+/// LinesPerPoll lines in a poll, so a chatty client can't keep a poll
+/// going while the other clients' lines wait.
+///
+/// Example:
+///
+/// @code
+///   std::array< WifiConnectionEthernet, 4 > connections;
+///   InputScheduler< 4, 2 > scheduler;
+///   while ( scheduler.getString( connections, log, line ))
+///   {
+///     // At most 2 lines from each connection, in turn.
+///   }
+/// @endcode
+///
+/// @tparam N            - Number of connections
+/// @tparam LinesPerPoll - Most lines taken from one connection per poll
+///
+template< std::size_t N, unsigned int LinesPerPoll >
+class InputScheduler {
+  static_assert( N != 0, "InputScheduler needs connections" );
+  static_assert( LinesPerPoll != 0, "InputScheduler must take some lines" );
+
+  public:
+
+  InputScheduler() : cursor{ 0 }, last{ 0 }
+  {
+    for ( unsigned int& lines : linesThisPoll ) lines = 0;
+  }
+
+  ///
+  /// @brief Get the next line, taking turns between the connections
+  ///
+  /// @tparam     Connection  - A NetConnection
+  /// @param[in]  connections - The connections
+  /// @param[in]  log         - Debug log stream
+  /// @param[out] line        - The line
+  /// @return     true if there was a line.  false ends the poll.
+  ///
+  template< typename Connection >
+  bool getString(
+    std::array< Connection, N >& connections,
+    WifiDebugOstream& log,
+    std::string& line )
+  {
+    for ( std::size_t k = 0; k < N; ++k )
+    {
+      const std::size_t i = ( cursor + k ) % N;
+      if ( linesThisPoll[i] == LinesPerPoll )
+      {
+        continue;
+      }
+      NetConnection& connection = connections[i];
+      if ( connection.getString( log, line ))
+      {
+        ++linesThisPoll[i];
+        InputStats& s = stats[i];
+        ++s.lines;
+        if ( s.pollsWaiting > s.maxPollsWaited )
+        {
+          s.maxPollsWaited = s.pollsWaiting;
+        }
+        s.pollsWaiting = 0;
+        last = i;
+        cursor = ( i + 1 ) % N;
+        return true;
+      }
+    }
+    endPoll( connections );
+    return false;
+  }
+
+  /// @brief The connection the last line came from
+  std::size_t lastConnection() const
+  {
+    return last;
+  }
+
+  /// @brief Counters for connection i
+  const InputStats& getStats( std::size_t i ) const
+  {
+    return stats[i];
+  }
+
+  /// @brief Start connection i's counters over, i.e., for a new client
+  void reset( std::size_t i )
+  {
+    stats[i].reset();
+    linesThisPoll[i] = 0;
+  }
+
+  private:
+
+  template< typename Connection >
+  void endPoll( std::array< Connection, N >& connections )
+  {
+    for ( std::size_t i = 0; i < N; ++i )
+    {
+      NetConnection& connection = connections[i];
+      if ( linesThisPoll[i] == LinesPerPoll && connection.hasInput() )
+      {
+        ++stats[i].deferred;
+        ++stats[i].pollsWaiting;
+      }
+      linesThisPoll[i] = 0;
+    }
+  }
+
+  /// @brief Where the next getString starts looking
+  std::size_t cursor;
+  /// @brief Where the last line came from
+  std::size_t last;
+  unsigned int linesThisPoll[ N ];
+  InputStats stats[ N ];
+};
+
+#endif
+
@@ -0,0 +1,271 @@
+#ifndef __LINE_BUFFER_H__
+#define __LINE_BUFFER_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+///
+/// @brief Fixed size ring that turns a byte stream into lines
+///
+/// Network input arrives in whatever pieces TCP feels like.  fill reads
+/// the pieces straight into the ring with bulk reads, and getLine hands
+/// back each complete line once its '\n' has arrived.  The ring is
+/// scanned for '\n' with memchr, and bytes that have already been
+/// scanned aren't scanned again.
+///
+/// The longest line is N-1 characters.  If the ring fills up without a
+/// '\n' the client is never going to send a line we can hold, so the
+/// ring is emptied and everything up to the next '\n' is thrown away.
+/// linesDropped counts these.
+///
+/// For binary input setLineMode( false ) turns the dropping off, and
+/// peek, drop and getBytes take bytes out by count instead of by line.
+///
+/// Example:
+///
+/// @code
+///   LineBuffer<256> buffer;
+///   buffer.fill( client );        // Client sent "pstatus\nabs_po"
+///   std::string line;
+///   buffer.getLine( line );       // true, line == "pstatus"
+///   buffer.getLine( line );       // false, "abs_po" waits for its '\n'
+/// @endcode
+///
+/// @tparam N - Capacity in bytes.  Must be a power of two.
+///
+template< std::size_t N >
+class LineBuffer {
+  static_assert( N != 0 && ( N & ( N-1 )) == 0,
+    "LineBuffer capacity must be a power of two" );
+
+  public:
+
+  LineBuffer()
+  {
+    reset();
+  }
+
+  /// @brief Throw away everything in the buffer
+  void reset()
+  {
+    head = 0;
+    tail = 0;
+    scanned = 0;
+    discarding = false;
+    dropped = 0;
+    lineMode = true;
+  }
+
+  /// @brief Is the input lines?  If not, long input isn't dropped.
+  void setLineMode( bool on )
+  {
+    lineMode = on;
+    discarding = false;
+  }
+
+  ///
+  /// @brief Read what's waiting on a stream into the buffer
+  ///
+  /// Stops when the stream runs dry or the buffer is full of complete
+  /// lines.  In the second case the rest stays in the stream until
+  /// getLine makes room.
+  ///
+  /// @tparam    Stream - Anything with WiFiClient's available() and
+  ///                     read( uint8_t*, size_t )
+  /// @param[in] stream - The stream to read
+  /// @return    Number of bytes read
+  ///
+  template< typename Stream >
+  std::size_t fill( Stream& stream )
+  {
+    std::size_t total = 0;
+    while ( stream.available() > 0 )
+    {
+      std::size_t space;
+      char* dest = writeSpace( space );
+      if ( space == 0 )
+      {
+        break;
+      }
+      const int got = stream.read( reinterpret_cast<uint8_t*>( dest ), space );
+      if ( got <= 0 )
+      {
+        break;
+      }
+      commit( static_cast<std::size_t>( got ));
+      total += static_cast<std::size_t>( got );
+    }
+    return total;
+  }
+
+  ///
+  /// @brief Get space for a bulk write into the buffer
+  ///
+  /// @param[out] size - How many bytes can be written at the result.
+  ///                    0 if the buffer is full.
+  /// @return     Where to write them.  Call commit after writing.
+  ///
+  char* writeSpace( std::size_t& size )
+  {
+    const std::size_t offset = head & ( N-1 );
+    size = std::min( N - ( head - tail ), N - offset );
+    return ring + offset;
+  }
+
+  /// @brief Add n bytes that were written at writeSpace
+  void commit( std::size_t n )
+  {
+    head += n;
+    if ( !lineMode )
+    {
+      return;
+    }
+    std::size_t newLine;
+    if ( discarding )
+    {
+      // Throw away the rest of a line that was too long.
+      if ( !findNewLine( newLine ))
+      {
+        tail = head;
+        scanned = 0;
+        return;
+      }
+      tail += newLine + 1;
+      scanned = 0;
+      discarding = false;
+    }
+    if ( head - tail == N && !findNewLine( newLine ))
+    {
+      tail = head;
+      scanned = 0;
+      discarding = true;
+      ++dropped;
+    }
+  }
+
+  ///
+  /// @brief Take the next complete line out of the buffer
+  ///
+  /// @param[out] line - The line, without its '\n'.  Reuses line's
+  ///                    storage.
+  /// @return     true if there was a complete line
+  ///
+  bool getLine( std::string& line )
+  {
+    std::size_t length;
+    if ( !findNewLine( length ))
+    {
+      return false;
+    }
+    const std::size_t start = tail & ( N-1 );
+    const std::size_t firstPart = std::min( length, N - start );
+    line.assign( ring + start, firstPart );
+    line.append( ring, length - firstPart );
+    tail += length + 1;
+    scanned = 0;
+    return true;
+  }
+
+  ///
+  /// @brief Copy bytes from the front of the buffer, leaving them there
+  ///
+  /// @param[out] dest - Where to copy to
+  /// @param[in]  n    - Most bytes to copy
+  /// @return     Bytes copied
+  ///
+  std::size_t peek( char* dest, std::size_t n ) const
+  {
+    n = std::min( n, head - tail );
+    for ( std::size_t i = 0; i < n; ++i )
+    {
+      dest[i] = ring[ ( tail + i ) & ( N-1 ) ];
+    }
+    return n;
+  }
+
+  /// @brief Throw away n bytes from the front of the buffer
+  void drop( std::size_t n )
+  {
+    tail += std::min( n, head - tail );
+    scanned = 0;
+  }
+
+  ///
+  /// @brief Take n bytes from the front of the buffer
+  ///
+  /// @param[out] bytes - The bytes.  Reuses bytes' storage.
+  /// @param[in]  n     - How many.  No more than size().
+  ///
+  void getBytes( std::string& bytes, std::size_t n )
+  {
+    const std::size_t start = tail & ( N-1 );
+    const std::size_t firstPart = std::min( n, N - start );
+    bytes.assign( ring + start, firstPart );
+    bytes.append( ring, n - firstPart );
+    drop( n );
+  }
+
+  /// @brief Is there a complete line in the buffer?
+  bool hasLine()
+  {
+    std::size_t length;
+    return findNewLine( length );
+  }
+
+  /// @brief Number of bytes in the buffer
+  std::size_t size() const
+  {
+    return head - tail;
+  }
+
+  /// @brief Number of lines thrown away for being too long
+  unsigned int linesDropped() const
+  {
+    return dropped;
+  }
+
+  private:
+
+  ///
+  /// @brief Find the first '\n' in the buffer
+  ///
+  /// @param[out] offset - Where the '\n' is, counting from tail
+  /// @return     true if there's a '\n'
+  ///
+  bool findNewLine( std::size_t& offset )
+  {
+    while ( scanned != head - tail )
+    {
+      const std::size_t start = ( tail + scanned ) & ( N-1 );
+      const std::size_t run = std::min( head - tail - scanned, N - start );
+      const void* found = memchr( ring + start, '\n', run );
+      if ( found != nullptr )
+      {
+        scanned += static_cast<const char*>( found ) - ( ring + start );
+        offset = scanned;
+        return true;
+      }
+      scanned += run;
+    }
+    return false;
+  }
+
+  char ring[ N ];
+  /// @brief Bytes ever added.  ring index is head & (N-1).
+  std::size_t head;
+  /// @brief Bytes ever removed.  ring index is tail & (N-1).
+  std::size_t tail;
+  /// @brief Bytes after tail that are known not to be '\n'
+  std::size_t scanned;
+  /// @brief Throwing away input until the next '\n'
+  bool discarding;
+  /// @brief Drop lines that are too long?  See setLineMode.
+  bool lineMode;
+  unsigned int dropped;
+};
+
+#endif
+
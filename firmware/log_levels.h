@@ -0,0 +1,257 @@
+#ifndef __LOG_LEVELS_H__
+#define __LOG_LEVELS_H__
+
+#include <cstddef>
+#include <cstdint>
+#include "basic_types.h"
+
+///
+/// @brief Compile time floor for debug logging
+///
+/// Build with -DBEEFOCUS_LOG_LEVEL=n to compile out every log line
+/// less important than level n - 0 Error, 1 Warn, 2 Info, 3 Debug.  A
+/// line that's compiled out costs nothing, not even formatting its
+/// arguments.
+///
+#ifndef BEEFOCUS_LOG_LEVEL
+#define BEEFOCUS_LOG_LEVEL 3
+#endif
+
+///
+/// @brief Leveled, category filtered debug logging
+///
+/// Debug sinks (DebugInterface, WifiDebugOstream) get error, warn, info
+/// and debug members that return a Line for one category.  The Line
+/// only passes output on if its level is compiled in and the category
+/// is turned up that far at run time, i.e.,
+///
+/// @code
+///   log.debug( Log::Category::Motion ) << "Moving " << position << "\n";
+/// @endcode
+///
+/// How far each category is turned up is kept in a Masks on the
+/// DebugInterface, so the serial port and the WiFi comments are
+/// filtered the same way.  The focuser's "verbose" command sets them.
+///
+namespace Log {
+
+  /// @brief How important a line is.  Lower is more important.
+  enum class Level {
+    Error = 0,    ///<  Something went wrong
+    Warn,         ///<  Something odd, i.e., input was thrown away
+    Info,         ///<  Occasional events, i.e., a client connected
+    Debug,        ///<  Chatty.  Can be every loop.
+    End
+  };
+
+  /// @brief What a line is about
+  enum class Category {
+    Motion = 0,   ///<  Moving and homing
+    Net,          ///<  Clients and connections
+    Parser,       ///<  Commands coming in
+    Power,        ///<  Motor power, sleeping and waking up
+    End
+  };
+
+  constexpr std::size_t numCategories = BeeFocus::toIndex( Category::End );
+
+  /// @brief The least important level that's compiled in
+  constexpr Level floor = static_cast<Level>( BEEFOCUS_LOG_LEVEL );
+
+  /// @brief Is level compiled in?  See BEEFOCUS_LOG_LEVEL.
+  constexpr bool isCompiledIn( Level level )
+  {
+    return BeeFocus::toIndex( level ) <= BeeFocus::toIndex( floor );
+  }
+
+  /// @brief Level each category starts at
+  constexpr Level defaultLevel = Level::Info;
+
+  ///
+  /// @brief How far each category is turned up at run time
+  ///
+  class Masks {
+    public:
+
+    Masks()
+    {
+      reset();
+    }
+
+    /// @brief Put every category back to defaultLevel
+    void reset()
+    {
+      for ( Level& level : levels ) level = defaultLevel;
+    }
+
+    /// @brief Show lines in category up to and including level
+    void setLevel( Category category, Level level )
+    {
+      levels[ BeeFocus::toIndex( category ) ] = level;
+    }
+
+    Level getLevel( Category category ) const
+    {
+      return levels[ BeeFocus::toIndex( category ) ];
+    }
+
+    /// @brief Would a line at level in category be shown?
+    bool isOn( Category category, Level level ) const
+    {
+      return BeeFocus::toIndex( level ) <=
+        BeeFocus::toIndex( levels[ BeeFocus::toIndex( category ) ] );
+    }
+
+    private:
+
+    Level levels[ numCategories ];
+  };
+
+  ///
+  /// @brief One log line's worth of output, maybe thrown away
+  ///
+  /// @tparam Sink       - Where output goes if the line is on
+  /// @tparam CompiledIn - false if the line's level is compiled out.
+  ///                      Then all of the Line's code goes away.
+  ///
+  template< typename Sink, bool CompiledIn >
+  class Line {
+    public:
+
+    Line( Sink& sinkArg, bool onArg ) : sink( sinkArg ), on{ onArg }
+    {
+    }
+
+    template< typename T >
+    Line& operator<<( const T& value )
+    {
+      if ( on )
+      {
+        sink << value;
+      }
+      return *this;
+    }
+
+    private:
+
+    Sink& sink;
+    bool on;
+  };
+
+  /// @brief A Line whose level is compiled out
+  template< typename Sink >
+  class Line< Sink, false > {
+    public:
+
+    Line( Sink&, bool )
+    {
+    }
+
+    template< typename T >
+    Line& operator<<( const T& )
+    {
+      return *this;
+    }
+  };
+
+  ///
+  /// @brief Let repetitive lines out at most once a period
+  ///
+  /// Example:
+  ///
+  /// @code
+  ///   Log::RateLimit limit( 1000 );
+  ///   log.debug( Log::Category::Motion, limit, msNow ) << "Moving\n";
+  /// @endcode
+  ///
+  class RateLimit {
+    public:
+
+    /// @param[in] msPeriodArg - Shortest time between lines
+    RateLimit( unsigned int msPeriodArg )
+      : msPeriod{ msPeriodArg }, msLast{ 0 }, any{ false }, dropped{ 0 }
+    {
+    }
+
+    /// @brief Can a line go out at msNow?  If so, start a new period.
+    bool allow( uint64_t msNow )
+    {
+      if ( any && msNow - msLast < msPeriod )
+      {
+        ++dropped;
+        return false;
+      }
+      any = true;
+      msLast = msNow;
+      return true;
+    }
+
+    /// @brief Lines that weren't allowed out
+    unsigned int getDropped() const
+    {
+      return dropped;
+    }
+
+    private:
+
+    unsigned int msPeriod;
+    uint64_t msLast;
+    /// @brief Has any line been allowed out?
+    bool any;
+    unsigned int dropped;
+  };
+
+  ///
+  /// @brief Give a debug sink error, warn, info and debug members
+  ///
+  /// @tparam Sink - The sink.  Derives from Leveled<Sink> and has a
+  ///                getMasks() that returns the Masks to filter with.
+  ///
+  template< typename Sink >
+  class Leveled {
+    public:
+
+    Line< Sink, isCompiledIn( Level::Error ) > error( Category category )
+    {
+      return line< Level::Error >( category );
+    }
+
+    Line< Sink, isCompiledIn( Level::Warn ) > warn( Category category )
+    {
+      return line< Level::Warn >( category );
+    }
+
+    Line< Sink, isCompiledIn( Level::Info ) > info( Category category )
+    {
+      return line< Level::Info >( category );
+    }
+
+    Line< Sink, isCompiledIn( Level::Debug ) > debug( Category category )
+    {
+      return line< Level::Debug >( category );
+    }
+
+    /// @brief A debug line that only goes out if limit allows it
+    Line< Sink, isCompiledIn( Level::Debug ) > debug(
+      Category category, RateLimit& limit, uint64_t msNow )
+    {
+      Sink& sink = static_cast< Sink& >( *this );
+      return Line< Sink, isCompiledIn( Level::Debug ) >( sink,
+        isCompiledIn( Level::Debug ) &&
+        sink.getMasks().isOn( category, Level::Debug ) &&
+        limit.allow( msNow ));
+    }
+
+    private:
+
+    template< Level L >
+    Line< Sink, isCompiledIn( L ) > line( Category category )
+    {
+      Sink& sink = static_cast< Sink& >( *this );
+      return Line< Sink, isCompiledIn( L ) >( sink,
+        isCompiledIn( L ) && sink.getMasks().isOn( category, L ));
+    }
+  };
+}
+
+#endif
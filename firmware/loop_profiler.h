@@ -0,0 +1,272 @@
+#ifndef __LOOP_PROFILER_H__
+#define __LOOP_PROFILER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include "simple_ostream.h"
+
+///
+/// @brief Compile time switch for the loop profiler
+///
+/// Build with -DBEEFOCUS_PROFILER=0 to compile the profiler out.  The
+/// focuser still accepts the perf command, but only reports that the
+/// profiler is off.
+///
+#ifndef BEEFOCUS_PROFILER
+#define BEEFOCUS_PROFILER 1
+#endif
+
+///
+/// @brief A count and a log2 histogram of times, in microseconds
+///
+/// Bucket 0 counts times of 0us.  Bucket n counts times from 2^(n-1) to
+/// 2^n-1 us.  The last bucket also counts everything that's bigger.
+///
+/// Example:
+///
+/// @code
+///   TimeHistogram h;
+///   h.add( 0 );         // Bucket 0
+///   h.add( 1 );         // Bucket 1
+///   h.add( 100 );       // Bucket 7, 64us to 127us
+///   h.getCount();       // 3
+///   h.getMax();         // 100
+/// @endcode
+///
+class TimeHistogram {
+  public:
+
+  static constexpr std::size_t numBuckets = 16;
+
+  /// @brief Longest a histogram can be as text, i.e., with every bucket
+  ///        used and every number 10 digits long.  See operator<<.
+  static constexpr std::size_t maxTextLength =
+    6 + 10 + 7 + 10 + 6 +                     // "calls=", " maxus=", " hist="
+    numBuckets * ( 2 + 1 + 10 ) + numBuckets - 1;  // "15:count", ","
+
+  TimeHistogram()
+  {
+    reset();
+  }
+
+  /// @brief Add a time to the histogram
+  void add( unsigned int uSec )
+  {
+    ++count;
+    ++buckets[ bucketFor( uSec ) ];
+    if ( uSec > max ) max = uSec;
+  }
+
+  /// @brief Clear the histogram
+  void reset()
+  {
+    count = 0;
+    max = 0;
+    for ( unsigned int& bucket : buckets ) bucket = 0;
+  }
+
+  /// @brief Which bucket does a time go in?
+  static std::size_t bucketFor( unsigned int uSec )
+  {
+    std::size_t bucket = 0;
+    while ( uSec != 0 && bucket < numBuckets - 1 )
+    {
+      uSec >>= 1;
+      ++bucket;
+    }
+    return bucket;
+  }
+
+  unsigned int getCount() const { return count; }
+  unsigned int getMax() const { return max; }
+  unsigned int getBucket( std::size_t bucket ) const { return buckets[ bucket ]; }
+
+  private:
+
+  unsigned int count;
+  unsigned int max;
+  unsigned int buckets[ numBuckets ];
+};
+
+/// @brief Output a TimeHistogram
+///
+/// i.e., "calls=3 maxus=100 hist=0:1,1:1,7:1".  Only buckets that have
+/// something in them are printed.
+///
+template <class T,
+  typename = my_enable_if_t<is_beefocus_sink<T>::value>>
+T& operator<<( T& sink, const TimeHistogram& h )
+{
+  sink << "calls=" << h.getCount() << " maxus=" << h.getMax() << " hist=";
+  const char* separator = "";
+  for ( std::size_t i = 0; i < TimeHistogram::numBuckets; ++i )
+  {
+    if ( h.getBucket( i ) != 0 )
+    {
+      sink << separator << (unsigned int) i << ":" << h.getBucket( i );
+      separator = ",";
+    }
+  }
+  return sink;
+}
+
+///
+/// @brief Profiles Focuser::loop
+///
+/// Keeps a TimeHistogram of execution times for every state handler and
+/// every command, and one for wake slip - how much later than asked for
+/// the caller got back to Focuser::loop.  Execution times come from the
+/// hardware's cycle counter (HWI::getCycleCount), and slip from the
+/// clock.
+///
+/// @tparam ENABLED      - If false, the profiler is empty and does nothing.
+/// @tparam NUM_STATES   - Number of states
+/// @tparam NUM_COMMANDS - Number of commands
+///
+template< bool ENABLED, std::size_t NUM_STATES, std::size_t NUM_COMMANDS >
+class LoopProfiler {
+  public:
+
+  static constexpr bool enabled = true;
+
+  LoopProfiler() :
+    cyclesPerMicroSecond{ 1 }, isSleeping{ false },
+    uSecSleepStart{ 0 }, uSecSleep{ 0 }
+  {
+  }
+
+  /// @brief Set the rate of the cycle counter
+  void setCyclesPerMicroSecond( uint32_t cycles )
+  {
+    cyclesPerMicroSecond = cycles != 0 ? cycles : 1;
+  }
+
+  /// @brief The caller is back.  Record how late it was.
+  ///
+  /// Slip is timed with the clock, not the cycle counter.  At 80MHz
+  /// the 32 bit cycle counter wraps every 53s, and idle waits can be
+  /// longer than that.
+  ///
+  /// @param[in] uSecNow  - The clock, in us
+  ///
+  void wake( uint64_t uSecNow )
+  {
+    if ( !isSleeping ) return;
+    isSleeping = false;
+
+    // Waking early counts as no slip.
+    const uint64_t uSecExpected = uSecSleepStart + uSecSleep;
+    const uint64_t slip = uSecNow > uSecExpected ? uSecNow - uSecExpected : 0;
+    slipTimes.add( slip < UINT32_MAX ? static_cast<unsigned int>( slip ) 
+                                     : UINT32_MAX );
+  }
+
+  /// @brief The caller was asked to come back in uSecPause.
+  ///
+  /// @param[in] uSecNow   - The clock, in us
+  /// @param[in] uSecPause - What Focuser::loop returned
+  ///
+  void sleep( uint64_t uSecNow, unsigned int uSecPause )
+  {
+    isSleeping = true;
+    uSecSleepStart = uSecNow;
+    uSecSleep = uSecPause;
+  }
+
+  /// @brief Record a state handler's execution time
+  void state( std::size_t state, uint32_t cycles )
+  {
+    stateTimes[ state ].add( toMicroSeconds( cycles ));
+  }
+
+  /// @brief Record a command's execution time
+  void command( std::size_t command, uint32_t cycles )
+  {
+    commandTimes[ command ].add( toMicroSeconds( cycles ));
+  }
+
+  const TimeHistogram& getState( std::size_t state ) const
+  {
+    return stateTimes[ state ];
+  }
+  const TimeHistogram& getCommand( std::size_t command ) const
+  {
+    return commandTimes[ command ];
+  }
+  const TimeHistogram& getSlip() const
+  {
+    return slipTimes;
+  }
+
+  /// @brief Clear all of the histograms
+  void reset()
+  {
+    for ( TimeHistogram& h : stateTimes ) h.reset();
+    for ( TimeHistogram& h : commandTimes ) h.reset();
+    slipTimes.reset();
+  }
+
+  /// @brief Clear one state's histogram
+  void resetState( std::size_t state )
+  {
+    stateTimes[ state ].reset();
+  }
+
+  /// @brief Clear one command's histogram
+  void resetCommand( std::size_t command )
+  {
+    commandTimes[ command ].reset();
+  }
+
+  private:
+
+  unsigned int toMicroSeconds( uint32_t cycles ) const
+  {
+    return cycles / cyclesPerMicroSecond;
+  }
+
+  uint32_t cyclesPerMicroSecond;
+  /// @brief Is there a pause that hasn't been checked by wake?
+  bool isSleeping;
+  /// @brief Clock when the last pause started, in us
+  uint64_t uSecSleepStart;
+  /// @brief Length of the last pause.
+  unsigned int uSecSleep;
+
+  TimeHistogram stateTimes[ NUM_STATES ];
+  TimeHistogram commandTimes[ NUM_COMMANDS ];
+  TimeHistogram slipTimes;
+};
+
+///
+/// @brief A LoopProfiler that's been compiled out.
+///
+template< std::size_t NUM_STATES, std::size_t NUM_COMMANDS >
+class LoopProfiler< false, NUM_STATES, NUM_COMMANDS > {
+  public:
+
+  static constexpr bool enabled = false;
+
+  void setCyclesPerMicroSecond( uint32_t ) {}
+  void wake( uint64_t ) {}
+  void sleep( uint64_t, unsigned int ) {}
+  void state( std::size_t, uint32_t ) {}
+  void command( std::size_t, uint32_t ) {}
+  void reset() {}
+  void resetState( std::size_t ) {}
+  void resetCommand( std::size_t ) {}
+
+  const TimeHistogram& getState( std::size_t ) const { return empty; }
+  const TimeHistogram& getCommand( std::size_t ) const { return empty; }
+  const TimeHistogram& getSlip() const { return empty; }
+
+  private:
+
+  static const TimeHistogram empty;
+};
+
+template< std::size_t NUM_STATES, std::size_t NUM_COMMANDS >
+const TimeHistogram LoopProfiler< false, NUM_STATES, NUM_COMMANDS >::empty;
+
+#endif
+
@@ -0,0 +1,117 @@
+#include <assert.h>
+#include "motion_planner.h"
+
+namespace {
+
+/// @brief Convert a pause between edges to a speed in steps/s.
+///
+/// A step is two edges, so the step period is twice the pause.
+///
+uint32_t pauseToSpeed( unsigned int uSecPause )
+{
+  return 500000u / uSecPause;
+}
+
+/// @brief Integer square root (floor), bit by bit.
+///
+/// No floating point - the ESP8266 doesn't have an FPU.
+///
+uint32_t isqrt( uint32_t n )
+{
+  uint32_t root = 0;
+  uint32_t bit = 1u << 30;
+
+  while ( bit > n ) 
+  {
+    bit >>= 2;
+  }
+  while ( bit != 0 )
+  {
+    if ( n >= root + bit )
+    {
+      n -= root + bit;
+      root = ( root >> 1 ) + bit;
+    }
+    else
+    {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+}
+
+MotionPlanner::MotionPlanner(
+  unsigned int uSecStartPauseArg,
+  unsigned int uSecCruisePause,
+  unsigned int accel,
+  unsigned int decel
+) : uSecStartPause{ uSecStartPauseArg }
+{
+  assert( uSecStartPause >= uSecMinPause );
+
+  const uint32_t vStart = pauseToSpeed( uSecStartPause );
+  vStartSq = vStart * vStart;
+
+  ramped = accel != 0 && 
+           uSecCruisePause != 0 && 
+           uSecCruisePause < uSecStartPause;
+
+  if ( ramped )
+  {
+    const unsigned int clippedCruisePause = 
+      uSecCruisePause < uSecMinPause ? uSecMinPause : uSecCruisePause;
+    const uint32_t vCruise = pauseToSpeed( clippedCruisePause );
+    vCruiseSq    = vCruise * vCruise;
+    accelDeltaSq = 2 * accel;
+    decelDeltaSq = 2 * ( decel != 0 ? decel : accel );
+  }
+  else
+  {
+    vCruiseSq    = vStartSq;
+    accelDeltaSq = 0;
+    decelDeltaSq = 0;
+  }
+
+  vSq = vStartSq;
+  stepsToGo = 0;
+}
+
+uint32_t MotionPlanner::stepsToSlow( uint32_t fromSq ) const
+{
+  // Rounded up, so we always start slowing down early enough
+  return ( fromSq - vStartSq + decelDeltaSq - 1 ) / decelDeltaSq;
+}
+
+unsigned int MotionPlanner::nextStepPause()
+{
+  if ( stepsToGo > 0 ) --stepsToGo;
+
+  if ( !ramped ) 
+  {
+    return uSecStartPause;
+  }
+
+  // 1. The pause for this step comes from the current speed.
+  const unsigned int uSecPause = ( vSq == vStartSq ) ? 
+    uSecStartPause : 500000u / isqrt( vSq );
+
+  // 2. Pick the speed for the next step.  Slow down if the steps that
+  //    are left are only just enough to get back to the start speed.
+  //    Only speed up if we could still stop from the faster speed.
+  const uint32_t vFasterSq = ( vCruiseSq - vSq > accelDeltaSq ) ? 
+    vSq + accelDeltaSq : vCruiseSq;
+
+  if ( (uint32_t) stepsToGo <= stepsToSlow( vSq ) )
+  {
+    vSq = ( vSq - vStartSq > decelDeltaSq ) ? vSq - decelDeltaSq : vStartSq;
+  }
+  else if ( (uint32_t) stepsToGo > stepsToSlow( vFasterSq ) )
+  {
+    vSq = vFasterSq;
+  }
+
+  return uSecPause;
+}
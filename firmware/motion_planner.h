@@ -0,0 +1,127 @@
+#ifndef __MOTION_PLANNER_H__
+#define __MOTION_PLANNER_H__
+
+#include <stdint.h>
+
+///
+/// @brief Trapezoidal speed profile for the stepper motor
+///
+/// The planner hands out the pause for each step of a move.  A move 
+/// starts at the start-from-rest speed, accelerates up to the cruise
+/// speed and then decelerates so the last step is back at the start
+/// speed.  Short moves never reach cruise speed and get a triangular 
+/// profile instead.
+///
+/// The planner works on the square of the speed.  Each step at a 
+/// constant acceleration a changes v^2 by 2a, so the profile only 
+/// needs an add or subtract and an integer square root per step.
+///
+/// If the acceleration is 0 (or the cruise pause isn't faster than
+/// the start pause) ramping is disabled and every step uses the start
+/// pause.
+///
+/// Example:
+///
+/// @code
+///   MotionPlanner planner( 1000, 250, 4000, 4000 );
+///   planner.setStepsToGo( 5000 );
+///   for ( int i = 0; i < 5000; ++i ) {
+///     unsigned int pause = planner.nextStepPause();
+///     // active edge, pause, inactive edge, pause.
+///   }
+///   planner.stop();
+/// @endcode
+///
+class MotionPlanner {
+  public:
+
+  /// @brief Constructor
+  ///
+  /// @param[in] uSecStartPause   - Pause between edges when starting from
+  ///                               rest, in microseconds
+  /// @param[in] uSecCruisePause  - Pause between edges at cruise speed,
+  ///                               in microseconds.  0 disables ramping
+  /// @param[in] accel            - Acceleration in steps/s^2.  0 disables
+  ///                               ramping
+  /// @param[in] decel            - Deceleration in steps/s^2.  0 means
+  ///                               "same as accel"
+  ///
+  MotionPlanner( 
+    unsigned int uSecStartPause,
+    unsigned int uSecCruisePause,
+    unsigned int accel,
+    unsigned int decel
+  );
+
+  /// @brief Set the number of steps left in the current move
+  ///
+  /// Called before every burst of steps so the planner knows when to
+  /// start decelerating.  Doesn't change the current speed.
+  ///
+  void setStepsToGo( int steps ) 
+  {
+    stepsToGo = steps > 0 ? steps : 0;
+  }
+
+  /// @brief The motor has come to rest.
+  ///
+  /// The next step will use the start-from-rest pause.  To bring a
+  /// moving motor to rest, plan stepsToStop more steps instead.
+  ///
+  void stop( void ) 
+  {
+    vSq = vStartSq;
+  }
+
+  /// @brief Steps it takes to slow from the current speed to the
+  ///        start-from-rest speed
+  ///
+  /// A move that's interrupted takes this many more steps, so the motor
+  /// slows down instead of stopping dead.
+  ///
+  int stepsToStop( void ) const
+  {
+    return ramped ? static_cast<int>( stepsToSlow( vSq )) : 0;
+  }
+
+  /// @brief Get the pause for the next step and advance the profile
+  ///
+  /// @return The pause after each of the step's two edges, in 
+  ///         microseconds
+  ///
+  unsigned int nextStepPause( void );
+
+  /// @brief Is ramping enabled?
+  bool isRamped( void ) const
+  {
+    return ramped;
+  }
+
+  /// @brief Fastest speed we'll ever step at (i.e., with uSecCruisePause=8)
+  static constexpr unsigned int uSecMinPause = 8;
+
+  private:
+
+  /// @brief Steps needed to get from speed^2 fromSq back to the start speed
+  uint32_t stepsToSlow( uint32_t fromSq ) const;
+
+  /// @brief Pause used when starting from rest
+  const unsigned int uSecStartPause;
+  /// @brief Start speed squared, in (steps/s)^2
+  uint32_t vStartSq;
+  /// @brief Cruise speed squared, in (steps/s)^2
+  uint32_t vCruiseSq;
+  /// @brief Change in v^2 per step while accelerating
+  uint32_t accelDeltaSq;
+  /// @brief Change in v^2 per step while decelerating
+  uint32_t decelDeltaSq;
+  /// @brief Does this planner ramp at all?
+  bool ramped;
+
+  /// @brief Current speed squared, in (steps/s)^2
+  uint32_t vSq;
+  /// @brief Number of steps left in the move
+  int stepsToGo;
+};
+
+#endif
@@ -3,13 +3,16 @@
 #include "wifi_ostream.h"
 #include "wifi_debug_ostream.h"
 
+constexpr std::size_t WifiInterfaceEthernet::maxConnections;
+constexpr unsigned int WifiInterfaceEthernet::linesPerPoll;
+
 void WifiInterfaceEthernet::setup( DebugInterface& log ) {
   delay(10);
 
-  log << "Init Wifi\n";
+  log.info( Log::Category::Net ) << "Init Wifi\n";
 
   // Connect to WiFi network
-  log << "Connecting to " << ssid << "\n";
+  log.info( Log::Category::Net ) << "Connecting to " << ssid << "\n";
 
   // Disable Wifi Persistence.  It's not needed and wears the flash memory.
   // Kudos Erik H. Bakke for pointing this point.
@@ -20,39 +23,82 @@ void WifiInterfaceEthernet::setup( DebugInterface& log ) {
    
   while (WiFi.status() != WL_CONNECTED) {
     delay(500);
-    log << ".";
+    log.info( Log::Category::Net ) << ".";
   }
-  log << "\n";
-  log << "WiFi Connected\n";
+  log.info( Log::Category::Net ) << "\n";
+  log.info( Log::Category::Net ) << "WiFi Connected\n";
    
   // Start the server
   m_server.begin();
-  log << "Server started\n";
+  log.info( Log::Category::Net ) << "Server started\n";
 
   // Print the IP address
   BeeFocus::IpAddress adr;
   auto dsIP = WiFi.localIP();
   for ( int i = 0; i < 4; ++ i )
     adr[i] = dsIP[i];
-  log << "Telnet to this address to connect: " << adr << " " << tcp_port << "\n";
+  log.info( Log::Category::Net ) << "Telnet to this address to connect: " << adr << " " << tcp_port << "\n";
+
+  // The radio can doze between beacons while the CPU runs.  Light sleep
+  // waits until the focuser's idle - see waitForInput.
+  WiFi.setSleepMode( WIFI_MODEM_SLEEP );
+}
 
-  //wifi_set_sleep_type(LIGHT_SLEEP_T);
+void WifiInterfaceEthernet::setLightSleep( bool on )
+{
+  if ( on != m_lightSleep )
+  {
+    WiFi.setSleepMode( on ? WIFI_LIGHT_SLEEP : WIFI_MODEM_SLEEP );
+    m_lightSleep = on;
+  }
 }
 
 bool WifiInterfaceEthernet::getString( WifiDebugOstream& log, std::string& string )
 {
   handleNewConnections( log );
-  return std::any_of( m_connections.begin(), m_connections.end(), [&] ( NetConnection& connection )
+  return m_scheduler.getString( m_connections, log, string );
+}
+
+bool WifiInterfaceEthernet::canWaitForInput()
+{
+  return true;
+}
+
+unsigned int WifiInterfaceEthernet::waitForInput( unsigned int uSecTimeout )
+{
+  // Only the idle focuser waits here, so the radio and CPU can doze 
+  // between beacons in delay().  Light sleep stalls timer1, so it's
+  // turned off again before the focuser can start a move.
+  setLightSleep( true );
+  const unsigned long start = micros();
+  for ( ;; ) 
   {
-    return connection.getString( log, string );
-  });
+    const unsigned long waited = micros() - start;
+    if ( waited >= uSecTimeout )
+    {
+      setLightSleep( false );
+      return 0;
+    }
+    const bool hasInput = m_server.hasClient() || 
+      std::any_of( m_connections.begin(), m_connections.end(), [] ( NetConnection& connection )
+      {
+        return connection.hasInput();
+      });
+    if ( hasInput )
+    {
+      setLightSleep( false );
+      return uSecTimeout - waited;
+    }
+    // delay() is where light sleep happens. 
+    delay( 1 );
+  }
 }
 
 void WifiInterfaceEthernet::handleNewConnections( WifiDebugOstream &log )
 {
   if ( m_server.hasClient() )
   {  
-    log << "New client connecting\n";
+    log.info( Log::Category::Net ) << "New client connecting\n";
    
     ConnectionArray::iterator slot = 
       std::find_if( m_connections.begin(), m_connections.end(), [&] ( NetConnection& connection )
@@ -67,26 +113,108 @@ void WifiInterfaceEthernet::handleNewConnections( WifiDebugOstream &log )
       m_nextToKick = ( m_nextToKick == m_connections.end()) ? m_connections.begin() : m_nextToKick;
     }
     
-    log << "Using slot " << slot - m_connections.begin() << " of " << m_connections.size()-1 << " for the new client\n";
+    log.info( Log::Category::Net ) << "Using slot " << slot - m_connections.begin() << " of " << m_connections.size()-1 << " for the new client\n";
 
+    const std::size_t slotIndex = slot - m_connections.begin();
     if ( *slot )
     {
-      log << "An existing client exists - disconnecting it\n";
+      log.info( Log::Category::Net ) << "An existing client exists - disconnecting it\n";
+      const InputStats& stats = m_scheduler.getStats( slotIndex );
+      log.info( Log::Category::Net ) << "Old client sent " << stats.lines << " lines, waited "
+          << stats.deferred << " polls, at most " 
+          << stats.maxPollsWaited << " in a row\n";
     }
 
+    m_scheduler.reset( slotIndex );
     slot->initConnection( m_server );
+    m_openedSessions |= 1u << slotIndex;
   }
 }
 
 std::streamsize WifiInterfaceEthernet::write(const char_type* s, std::streamsize n)
 {
-  std::for_each( m_connections.begin(), m_connections.end(), [&] ( NetConnection& interface )
+  if ( m_sendToOne )
   {
-    interface.write( s, n );
+    return m_connections[ m_sendTo ].write( s, n );
+  }
+  std::for_each( m_connections.begin(), m_connections.end(), [&] ( WifiConnectionEthernet& interface )
+  {
+    if ( interface.isSubscribed() )
+    {
+      interface.write( s, n );
+    }
   }); 
   return n;
 }
 
+unsigned int WifiInterfaceEthernet::getSession()
+{
+  return m_scheduler.lastConnection();
+}
+
+void WifiInterfaceEthernet::sendTo( unsigned int session )
+{
+  if ( session < m_connections.size() )
+  {
+    m_sendToOne = true;
+    m_sendTo = session;
+  }
+}
+
+void WifiInterfaceEthernet::sendToSubscribers()
+{
+  m_sendToOne = false;
+}
+
+void WifiInterfaceEthernet::subscribe( unsigned int session, bool on )
+{
+  if ( session < m_connections.size() )
+  {
+    m_connections[ session ].setSubscribed( on );
+  }
+}
+
+bool WifiInterfaceEthernet::hasBinary()
+{
+  return true;
+}
+
+bool WifiInterfaceEthernet::isBinary( unsigned int session )
+{
+  return session < m_connections.size() && m_connections[ session ].isBinary();
+}
+
+void WifiInterfaceEthernet::setBinary( unsigned int session, bool on )
+{
+  if ( session < m_connections.size() )
+  {
+    m_connections[ session ].setBinary( on );
+  }
+}
+
+void WifiInterfaceEthernet::writeFrame( const uint8_t* frame, std::size_t length )
+{
+  if ( m_sendToOne )
+  {
+    m_connections[ m_sendTo ].writeFrame( frame, length );
+  }
+}
+
+void WifiInterfaceEthernet::joinLines( unsigned int session, bool on )
+{
+  if ( session < m_connections.size() )
+  {
+    m_connections[ session ].joinLines( on );
+  }
+}
+
+uint32_t WifiInterfaceEthernet::takeOpenedSessions()
+{
+  const uint32_t opened = m_openedSessions;
+  m_openedSessions = 0;
+  return opened;
+}
+
 void WifiInterfaceEthernet::flush()
 {
   std::for_each( m_connections.begin(), m_connections.end(), [&] ( NetConnection& interface )
@@ -107,9 +235,12 @@ void WifiConnectionEthernet::initConnection( WiFiServer &server )
 {
   if ( m_connectedClient )
   {
-      (*this) << "# New Client and no free slots - Dropping Your Connection.\n";
+      // What the client's write takes is sent before stop closes it.
+      queueDropNotice();
+      flush();
       m_connectedClient.stop();
   }
+  resetSession();
   m_connectedClient = server.available();
   m_connectedClient.setNoDelay( true );
   (*this) << "# Bee Focuser is ready for commands\n"; 
@@ -118,74 +249,54 @@ void WifiConnectionEthernet::initConnection( WiFiServer &server )
 bool WifiConnectionEthernet::getString( WifiDebugOstream &log, std::string& string )
 {
   handleNewIncomingData( log );
+  return getBufferedString( string );
+}
 
-  std::string& incomingBuffer = m_incomingBuffers[ m_currentIncomingBuffer ];
-  size_t newLine = incomingBuffer.find('\n');
-  if ( newLine != std::string::npos )
-  {
-    // log << "Found newline at " << newLine << "\n";
-    string.replace( 0, newLine, incomingBuffer );
-    string.resize( newLine );
-    m_currentIncomingBuffer = 1-m_currentIncomingBuffer;
-    std::string& newIncomingBuffer = m_incomingBuffers[ m_currentIncomingBuffer ];
-    size_t rest = incomingBuffer.length() - newLine - 1;
-    newIncomingBuffer.replace( 0, rest, incomingBuffer, newLine+1, rest );
-    newIncomingBuffer.resize( rest );
-    
+bool WifiConnectionEthernet::hasInput( void )
+{
+  if ( m_connectedClient && m_connectedClient.available() )
+  {
     return true;
   }
-  
-  return false;
+  return hasBufferedInput();
 }
 
-
 void WifiConnectionEthernet::handleNewIncomingData( WifiDebugOstream& log )
 {
-  (void) log; // silence argsused warning
-  std::string& incomingBuffer = m_incomingBuffers[ m_currentIncomingBuffer ];
-  
-  if ( !m_connectedClient || !m_connectedClient.available())
+  if ( !m_connectedClient )
   {
     return;
   }
 
-  while (m_connectedClient.available())
+  const unsigned int droppedBefore = m_incoming.linesDropped();
+  m_incoming.fill( m_connectedClient );
+  if ( m_incoming.linesDropped() != droppedBefore )
   {
-    uint8_t byte;
-    m_connectedClient.read( &byte, 1 );
-    incomingBuffer += ((char) byte);
+    log.warn( Log::Category::Net ) << "Dropped a line longer than " << maxLineLength - 1 << " characters\n";
   }
 }
 
-std::streamsize WifiConnectionEthernet::write( const char_type* s, std::streamsize n )
-{
-  if ( !m_connectedClient ) { return n; }
-  if ( n + bytesInOutBuffer > outgoingBuffer.max_size() )
-  {
-    flush();
-  }
-  memcpy( outgoingBuffer.data() + bytesInOutBuffer, s, n );
-  bytesInOutBuffer +=n;
-  return n;
-} 
-
 void WifiConnectionEthernet::flush()
 {
   if ( !m_connectedClient ) { return; }
-
-  if ( bytesInOutBuffer )
-  { 
-    //wifi_set_sleep_type(NONE_SLEEP_T);
-    m_connectedClient.write( outgoingBuffer.data(), bytesInOutBuffer );
-    allOutputFlushed = false;
-    bytesInOutBuffer = 0;
-  }
-  else if ( !allOutputFlushed )
+  if ( m_outgoing.isOverflowed() )
   {
-    allOutputFlushed = m_connectedClient.flush(1);
-  }
-  else {
-    //wifi_set_sleep_type(LIGHT_SLEEP_T);
+    // The client isn't reading, and waiting for it would stall stepping.
+    m_connectedClient.stop();
+    m_outgoing.reset();
+    return;
   }
-} 
 
+  // Only write what fits in the TCP send buffer.  A bigger write waits
+  // for the client to ack.
+  m_outgoing.drain( [&] ( const char_type* s, std::size_t n ) -> std::size_t
+  {
+    const std::size_t room = m_connectedClient.availableForWrite();
+    if ( room == 0 )
+    {
+      return 0;
+    }
+    return m_connectedClient.write(
+      reinterpret_cast<const uint8_t*>( s ), std::min( n, room ));
+  });
+}
@@ -7,12 +7,14 @@
 #include "wifi_ostream.h"
 #include "wifi_secrets.h"
 #include "debug_interface.h"
+#include "framed_connection.h"
+#include "input_scheduler.h"
 
 class WifiOstream;
 
 class WifiDebugOstream;
 
-class WifiConnectionEthernet: public NetConnection {
+class WifiConnectionEthernet: public FramedConnection {
 
   public:
 
@@ -31,9 +33,7 @@ class WifiConnectionEthernet: public NetConnection {
 
   void reset( void ) 
   { 
-    m_currentIncomingBuffer=0;
-    m_incomingBuffers[0].resize(0);
-    m_incomingBuffers[1].resize(0);
+    resetSession();
     if (m_connectedClient)
     {
       m_connectedClient.stop();
@@ -42,23 +42,17 @@ class WifiConnectionEthernet: public NetConnection {
 
   void initConnection( WiFiServer &server );
   bool getString( WifiDebugOstream &log, std::string& string ) override;
+  bool hasInput( void ) override;
   operator bool( void ) override {
     return m_connectedClient;
   }
-
-  std::streamsize write( const char_type* s, std::streamsize n ) override; 
   void flush() override;
 
   private:
 
   void handleNewIncomingData( WifiDebugOstream& log );    
 
-  int m_currentIncomingBuffer;
-  std::string m_incomingBuffers[2];
   WiFiClient m_connectedClient;
-  std::array< char, 1500> outgoingBuffer;
-  size_t bytesInOutBuffer = 0;
-  bool allOutputFlushed = true;
 };
 
 /// @brief Interface to the client
@@ -68,7 +62,7 @@ class WifiConnectionEthernet: public NetConnection {
 class WifiInterfaceEthernet: public NetInterface {
   public:
 
-  WifiInterfaceEthernet() : m_lastSlotAllocated{0}, m_kickout{0}, m_nextToKick{m_connections.begin()}
+  WifiInterfaceEthernet() : m_lastSlotAllocated{0}, m_kickout{0}, m_nextToKick{m_connections.begin()}, m_sendToOne{false}, m_sendTo{0}, m_openedSessions{0}, m_lightSleep{false}
   {
     reset();
   }
@@ -83,10 +77,24 @@ class WifiInterfaceEthernet: public NetInterface {
   bool getString( WifiDebugOstream &log, std::string& string ) override;
   std::streamsize write( const char_type* s, std::streamsize n ) override;
   void flush() override;
+  bool canWaitForInput() override;
+  unsigned int waitForInput( unsigned int uSecTimeout ) override;
+  unsigned int getSession() override;
+  void sendTo( unsigned int session ) override;
+  void sendToSubscribers() override;
+  void subscribe( unsigned int session, bool on ) override;
+  bool hasBinary() override;
+  bool isBinary( unsigned int session ) override;
+  void setBinary( unsigned int session, bool on ) override;
+  void writeFrame( const uint8_t* frame, std::size_t length ) override;
+  void joinLines( unsigned int session, bool on ) override;
+  uint32_t takeOpenedSessions() override;
 
   private:
 
   void handleNewConnections( WifiDebugOstream &log );
+  /// @brief Let the radio and CPU light sleep in delay(), or not
+  void setLightSleep( bool on );
 
   // Make a CI Test to lock these defaults in?
   static constexpr const char* ssid = WifiSecrets::ssid; 
@@ -94,12 +102,25 @@ class WifiInterfaceEthernet: public NetInterface {
   static constexpr const char* hostname = WifiSecrets::hostname;
   const uint16_t tcp_port{4999};
 
+  /// @brief Most clients that can be connected at once
+  static constexpr std::size_t maxConnections = 4;
+  /// @brief Most lines taken from one client each time input is polled
+  static constexpr unsigned int linesPerPoll = 2;
+
   WiFiServer m_server{tcp_port};
-  typedef std::array< WifiConnectionEthernet, 4 > ConnectionArray;
+  typedef std::array< WifiConnectionEthernet, maxConnections > ConnectionArray;
   ConnectionArray m_connections;
+  InputScheduler< maxConnections, linesPerPoll > m_scheduler;
   int m_lastSlotAllocated;
   int m_kickout;
   ConnectionArray::iterator m_nextToKick;
+  /// @brief Is output going to one session (m_sendTo) or subscribers?
+  bool m_sendToOne;
+  unsigned int m_sendTo;
+  /// @brief Sessions given to a new client.  See takeOpenedSessions.
+  uint32_t m_openedSessions;
+  /// @brief Is light sleep on?  Only while waitForInput waits.
+  bool m_lightSleep;
 };
 
 #endif
@@ -1,6 +1,7 @@
 #ifndef __NetInterface_H__
 #define __NetInterface_H__
 
+#include <cstddef>
 #include <string>
 #include "hardware_interface.h"
 #include "debug_interface.h"
@@ -18,6 +19,16 @@ class NetInterface {
   struct category : public beefocus_tag {};
   using char_type = char;
 
+  ///
+  /// @brief Longest reply one command can write, in bytes
+  ///
+  /// Interfaces that queue output always have room for a reply this
+  /// long, however many debug lines are waiting.  Commands with long
+  /// replies check theirs against it - the text trace of a full ring is
+  /// about 2.7K, and perf stops at this many bytes and says there's more.
+  ///
+  static constexpr std::size_t maxReplyBytes = 2816;
+
   NetInterface()
   {
   }
@@ -31,6 +42,109 @@ class NetInterface {
   virtual std::streamsize write( const char_type* s, std::streamsize n ) = 0;
   virtual void flush() = 0;
 
+  /// @brief Can the interface wait for input?
+  ///
+  /// Interfaces that can wait let the focuser sleep until a command
+  /// arrives instead of polling for one.  waitForInput is only used if
+  /// this returns true.
+  ///
+  virtual bool canWaitForInput() { return false; }
+
+  /// @brief Wait until there's input or the timeout passes
+  ///
+  /// @param[in] uSecTimeout - Longest time to wait, in microseconds
+  /// @return    Time that was left of uSecTimeout when the input arrived.
+  ///            0 if the wait timed out.
+  ///
+  virtual unsigned int waitForInput( unsigned int uSecTimeout ) 
+  { 
+    (void) uSecTimeout; 
+    return 0; 
+  }
+
+  ///
+  /// @brief Which session did getString's last line come from?
+  ///
+  /// Interfaces with several clients number their sessions from 0.
+  /// Interfaces with one client leave all of this alone - everything
+  /// goes to that client.
+  ///
+  virtual unsigned int getSession() { return 0; }
+
+  /// @brief Write only to session, until sendToSubscribers is called
+  ///
+  /// Used so a reply only goes to the client that asked for it.
+  ///
+  virtual void sendTo( unsigned int session ) { (void) session; }
+
+  /// @brief Write to the sessions that asked for unsolicited output
+  ///
+  /// This is where output goes by default - debug log lines and events
+  /// that aren't a reply to anything.  See subscribe.
+  ///
+  virtual void sendToSubscribers() {}
+
+  /// @brief Start (on == true) or stop sending unsolicited output to a
+  ///        session.  Sessions start out not subscribed.
+  virtual void subscribe( unsigned int session, bool on ) 
+  { 
+    (void) session; 
+    (void) on; 
+  }
+
+  /// @brief Can sessions switch to binary framing?  See binary_protocol.h
+  virtual bool hasBinary() { return false; }
+
+  /// @brief Is a session using binary framing?
+  virtual bool isBinary( unsigned int session ) 
+  { 
+    (void) session; 
+    return false; 
+  }
+
+  ///
+  /// @brief Switch a session to (on == true) or from binary framing
+  ///
+  /// Only used if hasBinary is true.  In binary mode getString returns
+  /// whole request frames, and text that's written is sent as Text
+  /// frames, one per line.
+  ///
+  virtual void setBinary( unsigned int session, bool on ) 
+  { 
+    (void) session; 
+    (void) on; 
+  }
+
+  /// @brief Write a frame as is, to the session picked with sendTo
+  virtual void writeFrame( const uint8_t* frame, std::size_t length )
+  {
+    (void) frame;
+    (void) length;
+  }
+
+  ///
+  /// @brief Join (on == true) the lines written to a session into one
+  ///
+  /// While it's on, each '\n' written to the session becomes "; " if
+  /// more text follows.  Turning it off ends the joined line with a
+  /// '\n'.  Used to answer a line of several commands with one line.
+  /// Interfaces that don't join send the lines as they are.
+  ///
+  virtual void joinLines( unsigned int session, bool on )
+  {
+    (void) session;
+    (void) on;
+  }
+
+  ///
+  /// @brief Sessions given to a new client since the last call
+  ///
+  /// Bit n is set if session n has a new client, i.e., one that took
+  /// over a free slot or kicked an old client out of it.  Lets the 
+  /// caller forget what it knew about the session's old client.
+  ///
+  virtual uint32_t takeOpenedSessions() { return 0; }
+
   private:
 };
 
@@ -41,6 +155,8 @@ class NetConnection {
   using char_type = char;
 
   virtual bool getString( WifiDebugOstream& lot, std::string& string )=0;
+  /// @brief Is there input waiting on the connection?
+  virtual bool hasInput( void ) = 0;
   virtual operator bool( void ) = 0;
   virtual void reset( void ) = 0;
   virtual std::streamsize write( const char_type* s, std::streamsize n ) = 0;
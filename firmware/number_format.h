@@ -0,0 +1,140 @@
+#ifndef __NUMBER_FORMAT_H__
+#define __NUMBER_FORMAT_H__
+
+#include <cstddef>
+#include <cstdint>
+
+///
+/// @brief Turn numbers into text without <iostream> or printf
+///
+/// Each function writes its digits backward, ending just before end,
+/// and returns where the text starts, so the caller can hand the whole
+/// number to a sink in one write.  Decimal digits are made two at a
+/// time from a table, so a 10 digit number takes 5 divides.
+///
+/// Example:
+///
+/// @code
+///   char buffer[ NumberFormat::maxLength ];
+///   char* const end = buffer + sizeof( buffer );
+///   const char* start = NumberFormat::decimal( -1234, end );
+///   sink.write( start, end - start );      // "-1234"
+/// @endcode
+///
+namespace NumberFormat {
+
+  /// @brief Longest text any of these functions make, i.e., "-" and
+  ///        the 19 digits of INT64_MIN, or 64 bits of fixed point.
+  constexpr std::size_t maxLength = 24;
+
+  /// @brief "00" to "99", for making decimal digits two at a time
+  constexpr const char* digitPairs =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+  /// @brief Write an unsigned number in decimal
+  inline char* decimal( uint64_t value, char* end )
+  {
+    // 32 bit divides are much cheaper than 64 bit ones on the ESP8266.
+    while ( value > UINT32_MAX )
+    {
+      const unsigned int pair = static_cast<unsigned int>( value % 100 );
+      value /= 100;
+      *--end = digitPairs[ pair * 2 + 1 ];
+      *--end = digitPairs[ pair * 2 ];
+    }
+    uint32_t small = static_cast<uint32_t>( value );
+    while ( small >= 100 )
+    {
+      const unsigned int pair = small % 100;
+      small /= 100;
+      *--end = digitPairs[ pair * 2 + 1 ];
+      *--end = digitPairs[ pair * 2 ];
+    }
+    if ( small >= 10 )
+    {
+      *--end = digitPairs[ small * 2 + 1 ];
+      *--end = digitPairs[ small * 2 ];
+    }
+    else
+    {
+      *--end = static_cast<char>( '0' + small );
+    }
+    return end;
+  }
+
+  /// @brief Write a signed number in decimal.  Negatives get a '-'.
+  inline char* decimal( int64_t value, char* end )
+  {
+    if ( value >= 0 )
+    {
+      return decimal( static_cast<uint64_t>( value ), end );
+    }
+    // 0 - value as unsigned, so INT64_MIN doesn't overflow.
+    end = decimal( 0 - static_cast<uint64_t>( value ), end );
+    *--end = '-';
+    return end;
+  }
+
+  ///
+  /// @brief Write an unsigned number in lower case hex, without "0x"
+  ///
+  /// @param[in] value     - The number
+  /// @param[in] end       - Where the text ends
+  /// @param[in] minDigits - Pad with leading 0s to this many digits.
+  ///                        No more than 16.
+  ///
+  inline char* hex( uint64_t value, char* end, unsigned int minDigits )
+  {
+    const char* const hexDigits = "0123456789abcdef";
+    char* const stop = end - minDigits;
+    do
+    {
+      *--end = hexDigits[ value & 0xf ];
+      value >>= 4;
+    } while ( value != 0 || end > stop );
+    return end;
+  }
+
+  ///
+  /// @brief Write a fixed point number, i.e., microns as millimeters
+  ///
+  /// @param[in] value    - The number in units of 10^-decimals
+  /// @param[in] decimals - Digits after the '.'.  No more than 19.
+  /// @param[in] end      - Where the text ends
+  ///
+  /// fixed( -1250, 3, end ) writes "-1.250".  With 0 decimals it's the
+  /// same as decimal.
+  ///
+  inline char* fixed( int64_t value, unsigned int decimals, char* end )
+  {
+    const bool negative = value < 0;
+    uint64_t magnitude = negative ? 0 - static_cast<uint64_t>( value ) :
+                                    static_cast<uint64_t>( value );
+    if ( decimals != 0 )
+    {
+      for ( unsigned int i = 0; i < decimals; ++i )
+      {
+        *--end = static_cast<char>( '0' + magnitude % 10 );
+        magnitude /= 10;
+      }
+      *--end = '.';
+    }
+    end = decimal( magnitude, end );
+    if ( negative )
+    {
+      *--end = '-';
+    }
+    return end;
+  }
+}
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef __OUTPUT_QUEUE_H__
+#define __OUTPUT_QUEUE_H__
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+///
+/// @brief Output waiting for a client to take it
+///
+/// Writing never blocks - output is copied into a ring of fixed size
+/// segments, and drain sends whole segments, or as much of the oldest
+/// one as the client will take without blocking.  A slow or vanished
+/// client can't stall stepping, it can only fill its queue.
+///
+/// When the client falls behind:
+///
+/// - Once more than debugHighWater bytes are waiting, new debug lines,
+///   the ones that start with '#', are dropped and counted.  That
+///   leaves ReplyBytes of the queue for replies and events.
+/// - If a reply or event still doesn't fit the queue overflows.  What's
+///   queued stays and nothing more is taken.  The client isn't reading,
+///   so the connection should drop it - see isOverflowed.
+///
+/// Text is queued with writeText, which finds the debug lines.  Binary
+/// frames are queued whole with writeBlock, or not at all.
+///
+/// Example:
+///
+/// @code
+///   OutputQueue< 128, 12 > queue;
+///   queue.writeText( "# Got: pstatus\nPosition: 5\n", 27 );
+///   queue.drain( [&] ( const char* s, std::size_t n ) {
+///     return client.write( s, std::min( n, client.availableForWrite() ));
+///   });
+///   if ( queue.isOverflowed() ) client.stop();
+/// @endcode
+///
+/// @tparam SegmentBytes - Bytes in a segment
+/// @tparam Segments     - Segments in the queue
+/// @tparam ReplyBytes   - Room that debug lines leave for replies.
+///                        Half the queue by default.
+///
+template< std::size_t SegmentBytes, std::size_t Segments,
+  std::size_t ReplyBytes = SegmentBytes * Segments / 2 >
+class OutputQueue {
+  static_assert( SegmentBytes != 0 && Segments != 0,
+    "OutputQueue needs room for some output" );
+  static_assert( ReplyBytes <= SegmentBytes * Segments,
+    "OutputQueue can't leave more room for replies than it has" );
+
+  public:
+
+  static constexpr std::size_t capacity = SegmentBytes * Segments;
+  /// @brief Bytes waiting past which debug lines are dropped
+  static constexpr std::size_t debugHighWater = capacity - ReplyBytes;
+
+  OutputQueue()
+  {
+    reset();
+  }
+
+  /// @brief Throw the output away and start again
+  void reset()
+  {
+    head = 0;
+    used = 0;
+    headSent = 0;
+    queued = 0;
+    lineStart = true;
+    droppingLine = false;
+    overflowed = false;
+    debugDropped = 0;
+  }
+
+  ///
+  /// @brief Queue text
+  ///
+  /// Whether a debug line is dropped is decided when its first byte
+  /// comes in, so a line goes out whole or not at all.
+  ///
+  void writeText( const char* s, std::size_t n )
+  {
+    const char* const end = s + n;
+    while ( s != end && !overflowed )
+    {
+      if ( lineStart )
+      {
+        droppingLine = *s == '#' && queued > debugHighWater;
+        debugDropped += droppingLine ? 1 : 0;
+        lineStart = false;
+      }
+      const char* newLine =
+        static_cast<const char*>( memchr( s, '\n', end - s ));
+      const char* const runEnd = newLine ? newLine + 1 : end;
+      if ( !droppingLine && !append( s, runEnd - s ))
+      {
+        overflowed = true;
+      }
+      lineStart = newLine != nullptr;
+      s = runEnd;
+    }
+  }
+
+  ///
+  /// @brief Queue bytes that have to go together, i.e., a frame
+  ///
+  /// @param[in] s       - The bytes
+  /// @param[in] n       - How many
+  /// @param[in] isDebug - Can the bytes be dropped like a debug line?
+  ///
+  void writeBlock( const char* s, std::size_t n, bool isDebug )
+  {
+    if ( overflowed )
+    {
+      return;
+    }
+    if ( isDebug && queued > debugHighWater )
+    {
+      ++debugDropped;
+      return;
+    }
+    overflowed = !append( s, n );
+  }
+
+  ///
+  /// @brief Send what the client will take
+  ///
+  /// @tparam    Send - Callable as Send( const char* s, std::size_t n ).
+  ///                   Returns the bytes it took.  Taking fewer than n
+  ///                   means the client is full for now.
+  /// @param[in] send - Where the output goes.  Mustn't block.
+  ///
+  template< typename Send >
+  void drain( Send send )
+  {
+    while ( used != 0 )
+    {
+      Segment& segment = segments[ head ];
+      const std::size_t waiting = segment.length - headSent;
+      if ( waiting == 0 )
+      {
+        // The last segment, and it's empty.
+        break;
+      }
+      const std::size_t taken = send( segment.bytes.data() + headSent, waiting );
+      headSent += taken;
+      queued -= taken;
+      if ( taken < waiting )
+      {
+        break;
+      }
+      headSent = 0;
+      head = head + 1 == Segments ? 0 : head + 1;
+      --used;
+    }
+  }
+
+  /// @brief Bytes waiting to be sent
+  std::size_t size() const
+  {
+    return queued;
+  }
+
+  bool isEmpty() const
+  {
+    return queued == 0;
+  }
+
+  /// @brief Did a reply or event not fit?  If so the client's not reading.
+  bool isOverflowed() const
+  {
+    return overflowed;
+  }
+
+  /// @brief Debug lines and frames dropped since the last reset
+  uint32_t getDebugDropped() const
+  {
+    return debugDropped;
+  }
+
+  private:
+
+  /// @brief Copy bytes in, if they all fit
+  bool append( const char* s, std::size_t n )
+  {
+    const std::size_t lastFree =
+      used == 0 ? 0 : SegmentBytes - segments[ last() ].length;
+    if ( n > lastFree + ( Segments - used ) * SegmentBytes )
+    {
+      return false;
+    }
+    queued += n;
+    while ( n != 0 )
+    {
+      if ( used == 0 || segments[ last() ].length == SegmentBytes )
+      {
+        ++used;
+        segments[ last() ].length = 0;
+      }
+      Segment& segment = segments[ last() ];
+      const std::size_t chunk = std::min( n, SegmentBytes - segment.length );
+      memcpy( segment.bytes.data() + segment.length, s, chunk );
+      segment.length += chunk;
+      s += chunk;
+      n -= chunk;
+    }
+    return true;
+  }
+
+  /// @brief The segment that's being filled
+  std::size_t last() const
+  {
+    const std::size_t slot = head + used - 1;
+    return slot < Segments ? slot : slot - Segments;
+  }
+
+  struct Segment {
+    std::array< char, SegmentBytes > bytes;
+    std::size_t length;
+  };
+
+  std::array< Segment, Segments > segments;
+  /// @brief The oldest segment - the one being sent
+  std::size_t head;
+  /// @brief Segments holding output
+  std::size_t used;
+  /// @brief Bytes of the oldest segment already sent
+  std::size_t headSent;
+  /// @brief Bytes waiting to be sent
+  std::size_t queued;
+  /// @brief Is the next byte of text the start of a line?
+  bool lineStart;
+  /// @brief Is the text line being written a dropped debug line?
+  bool droppingLine;
+  bool overflowed;
+  uint32_t debugDropped;
+};
+
+template< std::size_t SegmentBytes, std::size_t Segments,
+  std::size_t ReplyBytes >
+constexpr std::size_t
+  OutputQueue< SegmentBytes, Segments, ReplyBytes >::capacity;
+template< std::size_t SegmentBytes, std::size_t Segments,
+  std::size_t ReplyBytes >
+constexpr std::size_t
+  OutputQueue< SegmentBytes, Segments, ReplyBytes >::debugHighWater;
+
+#endif
@@ -2,11 +2,13 @@
 #define __SIMPLE_OSTREAM__
 
 #include <cstddef>  // for std::size_t
+#include <cstdint>
 #include <string.h>
 #include <string>
 #include <ios>      // for std::streamsize
 #include <type_traits>
 #include "basic_types.h"  // for BeeFocus::IpAddress.
+#include "number_format.h"
 
 //
 // Like std::enable_if_t, but works in C++ 11.
@@ -73,40 +75,136 @@ T& operator<<( T& sink, const char* string )
   return sink;
 } 
 
+///
+/// @brief Output an integer in decimal, in one write
+///
+/// Every integer type goes through here, so a number costs one virtual
+/// write however many digits it has.
+///
+template< class T, typename I,
+  typename = my_enable_if_t<is_beefocus_sink<T>::value>>
+T& writeDecimal( T& sink, I i )
+{
+  char buffer[ NumberFormat::maxLength ];
+  char* const end = buffer + sizeof( buffer );
+  const char* const start = std::is_signed<I>::value ? 
+    NumberFormat::decimal( static_cast<int64_t>( i ), end ) :
+    NumberFormat::decimal( static_cast<uint64_t>( i ), end );
+  sink.write( start, end - start );
+  return sink;
+}
+
 /// @brief Output an unsigned number of a SIMPLE_ISTREAM.
 template <class T,
   typename = my_enable_if_t<is_beefocus_sink<T>::value>>
 T& operator<<( T& sink, unsigned int i )
 {
-  // Handle digits that aren't the lowest digit (if any)
-  if ( i >= 10 )
-  {
-    sink << i/10;
-  }
-
-  // Handle the lowest digit
-  char c = '0' + (i % 10);
-  sink.write( &c, 1 );
-
-  return sink;
+  return writeDecimal( sink, i );
 }
 
-
 /// @brief Output an signed number of a SIMPLE_ISTREAM.
 template<class T,
   typename = my_enable_if_t<is_beefocus_sink<T>::value>>
 T& operator<<( T& sink, int i )
 {
-  // Handle -
-  if ( i < 0 )
+  return writeDecimal( sink, i );
+}  
+
+/// @brief Output an unsigned long, i.e., a uint32_t on the ESP8266
+template<class T,
+  typename = my_enable_if_t<is_beefocus_sink<T>::value>>
+T& operator<<( T& sink, unsigned long i )
+{
+  return writeDecimal( sink, i );
+}  
+
+/// @brief Output a long
+template<class T,
+  typename = my_enable_if_t<is_beefocus_sink<T>::value>>
+T& operator<<( T& sink, long i )
+{
+  return writeDecimal( sink, i );
+}  
+
+/// @brief Output an unsigned long long, i.e., a uint64_t time
+template<class T,
+  typename = my_enable_if_t<is_beefocus_sink<T>::value>>
+T& operator<<( T& sink, unsigned long long i )
+{
+  return writeDecimal( sink, i );
+}  
+
+/// @brief Output a long long
+template<class T,
+  typename = my_enable_if_t<is_beefocus_sink<T>::value>>
+T& operator<<( T& sink, long long i )
+{
+  return writeDecimal( sink, i );
+}  
+
+namespace BeeFocus
+{
+  /// @brief A number to output in hex.  See BeeFocus::hex.
+  struct HexNumber {
+    uint64_t value;
+    unsigned int minDigits;
+  };
+
+  /// @brief A fixed point number to output.  See BeeFocus::fixed.
+  struct FixedNumber {
+    int64_t value;
+    unsigned int decimals;
+  };
+
+  ///
+  /// @brief Output a number in lower case hex, i.e., sink << hex( 255 )
+  ///
+  /// @param[in] value     - The number.  There's no "0x".
+  /// @param[in] minDigits - Pad with leading 0s to this many digits
+  ///
+  inline HexNumber hex( uint64_t value, unsigned int minDigits = 1 )
+  {
+    return HexNumber{ value, minDigits > 16 ? 16 : minDigits };
+  }
+
+  ///
+  /// @brief Output a fixed point number, i.e., sink << fixed( um, 3 ) 
+  ///        to output microns as millimeters
+  ///
+  /// @param[in] value    - The number in units of 10^-decimals
+  /// @param[in] decimals - Digits after the '.'
+  ///
+  inline FixedNumber fixed( int64_t value, unsigned int decimals )
   {
-    sink << "-";   
-    i = -i;
+    return FixedNumber{ value, decimals > 19 ? 19 : decimals };
   }
+}
 
-  sink << (unsigned int) i;
+/// @brief Output a number in hex.  See BeeFocus::hex.
+template<class T,
+  typename = my_enable_if_t<is_beefocus_sink<T>::value>>
+T& operator<<( T& sink, BeeFocus::HexNumber number )
+{
+  char buffer[ NumberFormat::maxLength ];
+  char* const end = buffer + sizeof( buffer );
+  const char* const start = 
+    NumberFormat::hex( number.value, end, number.minDigits );
+  sink.write( start, end - start );
   return sink;
-}  
+}
+
+/// @brief Output a fixed point number.  See BeeFocus::fixed.
+template<class T,
+  typename = my_enable_if_t<is_beefocus_sink<T>::value>>
+T& operator<<( T& sink, BeeFocus::FixedNumber number )
+{
+  char buffer[ NumberFormat::maxLength ];
+  char* const end = buffer + sizeof( buffer );
+  const char* const start = 
+    NumberFormat::fixed( number.value, number.decimals, end );
+  sink.write( start, end - start );
+  return sink;
+}
 
 /// @brief Output an std::string
 template<class T, 
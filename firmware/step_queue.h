@@ -0,0 +1,97 @@
+#ifndef __STEP_QUEUE_H__
+#define __STEP_QUEUE_H__
+
+#include <cstddef>
+#include <atomic>
+#include "hardware_interface.h"
+
+///
+/// @brief Fixed size ring of HWI::QueuedEdge
+///
+/// There's one producer - the focuser, through HWI::queueEdge - and one
+/// consumer - a timer interrupt, or a mock that plays the queue against
+/// virtual time.  head is only written by the producer and tail is only 
+/// written by the consumer, so on a single core micro-controller the 
+/// queue doesn't need a lock.  The signal fences keep the compiler from
+/// moving the ring access past the index update.
+///
+/// Example:
+///
+/// @code
+///   StepQueue<4> queue;
+///   queue.push( { HWI::Pin::STEP, HWI::PinState::STEP_ACTIVE, 100 } );
+///   queue.space();            // 3
+///   HWI::QueuedEdge edge;
+///   queue.pop( edge );        // true, edge.uSecPause == 100 
+///   queue.pop( edge );        // false, queue is empty
+/// @endcode
+///
+/// @tparam N - Capacity in edges.  Must be a power of two.
+///
+template< std::size_t N >
+class StepQueue {
+  static_assert( N != 0 && ( N & ( N-1 )) == 0, 
+    "StepQueue capacity must be a power of two" );
+
+  public:
+
+  StepQueue() : head{ 0 }, tail{ 0 }
+  {
+  }
+
+  /// @brief Add an edge.  Producer side.
+  ///
+  /// @return false if the queue is full
+  ///
+  bool push( const HWI::QueuedEdge& edge )
+  {
+    const std::size_t h = head;
+    if ( h - tail == N ) return false;
+    ring[ h & ( N-1 ) ] = edge;
+    std::atomic_signal_fence( std::memory_order_release );
+    head = h + 1;
+    return true;
+  }
+
+  /// @brief Remove the oldest edge.  Consumer side.
+  ///
+  /// Always inlined, so it ends up in the caller's section.  On the 
+  /// ESP8266 the caller is an ICACHE_RAM_ATTR interrupt handler, and a
+  /// call out to flash from there can crash if the cache is busy.
+  ///
+  /// @return false if the queue is empty
+  ///
+  inline __attribute__(( always_inline )) bool pop( HWI::QueuedEdge& edge )
+  {
+    const std::size_t t = tail;
+    if ( head == t ) return false;
+    std::atomic_signal_fence( std::memory_order_acquire );
+    edge = ring[ t & ( N-1 ) ];
+    std::atomic_signal_fence( std::memory_order_release );
+    tail = t + 1;
+    return true;
+  }
+
+  /// @brief How many more edges can be pushed
+  std::size_t space() const
+  {
+    return N - ( head - tail );
+  }
+
+  /// @brief Is the queue empty?
+  bool empty() const
+  {
+    return head == tail;
+  }
+
+  private:
+
+  HWI::QueuedEdge ring[ N ];
+  /// @brief Count of pushed edges.  Only written by the producer.
+  volatile std::size_t head;
+  /// @brief Count of popped edges.  Only written by the consumer.
+  volatile std::size_t tail;
+};
+
+#endif
+
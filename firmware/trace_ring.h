@@ -0,0 +1,169 @@
+#ifndef __TRACE_RING_H__
+#define __TRACE_RING_H__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+///
+/// @brief A binary record of what the focuser did, kept in RAM
+///
+/// The focuser adds a Record for every state push and pop, every write
+/// to the DIR and MOTOR_ENA pins and every command it runs.  Adding a
+/// record is a few stores - nothing is formatted until the "trace"
+/// command downloads the ring, so tracing is always on.
+///
+/// Records go over the wire as recordBytes bytes each, little endian:
+///
+/// @code
+///   +-----------+------+------+-----------+
+///   | msTime    | kind | code | arg       |
+///   | uint32    | 1    | 1    | int32     |
+///   +-----------+------+------+-----------+
+/// @endcode
+///
+namespace Trace {
+
+  /// @brief What a Record is about.  Says what code and arg hold.
+  enum class Kind : uint8_t {
+    StatePush  = 1,   ///<  code is the FS::State, arg its argument
+    StatePop   = 2,   ///<  code is the FS::State popped, arg its argument
+    StateReset = 3,   ///<  An interrupt emptied the stack.  arg is -1.
+    PinWrite   = 4,   ///<  code is the HWI::Pin, arg the HWI::PinState
+    Command    = 5    ///<  code is the Command, arg its argument
+  };
+
+  /// @brief One traced event
+  struct Record {
+    /// @brief When it happened - Focuser::loop's time, in ms.  Wraps.
+    uint32_t msTime;
+    /// @brief What it's about.  Depends on kind.
+    int32_t arg;
+    Kind kind;
+    uint8_t code;
+  };
+
+  /// @brief Bytes in an encoded Record
+  constexpr std::size_t recordBytes = 10;
+
+  /// @brief Encode a record into recordBytes bytes at dest
+  inline uint8_t* encode( const Record& record, uint8_t* dest )
+  {
+    const uint32_t arg = static_cast<uint32_t>( record.arg );
+    for ( int i = 0; i < 4; ++i )
+    {
+      *dest++ = static_cast<uint8_t>( record.msTime >> ( 8 * i ));
+    }
+    *dest++ = static_cast<uint8_t>( record.kind );
+    *dest++ = record.code;
+    for ( int i = 0; i < 4; ++i )
+    {
+      *dest++ = static_cast<uint8_t>( arg >> ( 8 * i ));
+    }
+    return dest;
+  }
+
+  /// @brief Decode the recordBytes bytes at src
+  inline Record decode( const uint8_t* src )
+  {
+    uint32_t msTime = 0;
+    uint32_t arg = 0;
+    for ( int i = 0; i < 4; ++i )
+    {
+      msTime |= static_cast<uint32_t>( src[i] ) << ( 8 * i );
+      arg |= static_cast<uint32_t>( src[ i + 6 ] ) << ( 8 * i );
+    }
+    return { msTime, static_cast<int32_t>( arg ),
+             static_cast<Kind>( src[4] ), src[5] };
+  }
+}
+
+///
+/// @brief The last N trace records
+///
+/// When the ring is full a new record replaces the oldest, and the
+/// oldest is counted as lost.  Records are stamped with the time from
+/// the last setTime, so adding one doesn't read the clock.
+///
+/// Example:
+///
+/// @code
+///   TraceRing< 4 > ring;
+///   ring.setTime( 10 );
+///   ring.add( Trace::Kind::Command, 6, 1000 );   // abs_pos=1000 at 10ms
+///   ring.at( 0 ).msTime;                         // 10
+/// @endcode
+///
+template< std::size_t N >
+class TraceRing {
+  public:
+
+  static constexpr std::size_t capacity = N;
+
+  TraceRing() : msNow{ 0 }
+  {
+    clear();
+  }
+
+  /// @brief Set the time that records are stamped with, in ms
+  void setTime( uint64_t msTime )
+  {
+    msNow = static_cast<uint32_t>( msTime );
+  }
+
+  /// @brief Add a record.  Replaces the oldest if the ring is full.
+  void add( Trace::Kind kind, uint8_t code, int32_t arg )
+  {
+    records[ next ] = { msNow, arg, kind, code };
+    next = next + 1 == N ? 0 : next + 1;
+    if ( count < N )
+    {
+      ++count;
+    }
+    else
+    {
+      ++lost;
+    }
+  }
+
+  /// @brief Records in the ring
+  std::size_t size() const
+  {
+    return count;
+  }
+
+  /// @brief Get a record.  at( 0 ) is the oldest.
+  const Trace::Record& at( std::size_t i ) const
+  {
+    const std::size_t oldest = count < N ? 0 : next;
+    const std::size_t slot = oldest + i;
+    return records[ slot < N ? slot : slot - N ];
+  }
+
+  /// @brief Records that were replaced before anyone read them
+  uint32_t getLost() const
+  {
+    return lost;
+  }
+
+  /// @brief Throw the records away
+  void clear()
+  {
+    next = 0;
+    count = 0;
+    lost = 0;
+  }
+
+  private:
+
+  std::array< Trace::Record, N > records;
+  /// @brief Where the next record goes
+  std::size_t next;
+  std::size_t count;
+  uint32_t lost;
+  uint32_t msNow;
+};
+
+template< std::size_t N > constexpr std::size_t TraceRing< N >::capacity;
+
+#endif
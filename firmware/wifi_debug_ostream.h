@@ -1,13 +1,14 @@
 #ifndef __WIFI_DEBUG_OSTREAM__
 #define __WIFI_DEBUG_OSTREAM__
 
+#include <cstring>
 #include "simple_ostream.h"
 #include "net_interface.h"
 #include "debug_interface.h"
 
 /// @brief Wifi target debug ostream
 ///
-class WifiDebugOstream	
+class WifiDebugOstream: public Log::Leveled< WifiDebugOstream >
 {
   public:
 
@@ -21,29 +22,39 @@ class WifiDebugOstream
   {
   }
 
+  ///
+  /// @brief Send debug text to the serial port and, as comments, the net
+  ///
+  /// Each line that goes to the net starts with "# ", so clients can
+  /// tell it from replies.  The text is sent a line at a time, not a
+  /// character at a time, so a line costs a few virtual calls however
+  /// long it is.
+  ///
   std::streamsize write( const char_type* s, std::streamsize n )
   {
-    for ( std::streamsize i = 0; i < n; ++i )
+    m_serialDebug->write( s, n );
+
+    const char_type* const end = s + n;
+    while ( s != end )
     {
-      onechar( s[i] );
+      if ( m_lastWasNewline && *s != '\n' )
+      {
+        m_wifiDebug->write( "# ", 2 );
+      }
+      const char_type* newLine =
+        static_cast<const char_type*>( memchr( s, '\n', end - s ));
+      const char_type* const runEnd = newLine != nullptr ? newLine + 1 : end;
+      m_wifiDebug->write( s, runEnd - s );
+      m_lastWasNewline = newLine != nullptr;
+      s = runEnd;
     }
     return n;
   }
 
-  private:
-
-  void onechar(char c )
-  { 
-    m_serialDebug->write( &c, 1 );
-    bool isNewLine = ( c == '\n' );
-    if ( m_lastWasNewline && !isNewLine )
-    {
-      (*m_wifiDebug) << "# ";
-    }
-    m_wifiDebug->write( &c, 1 );
-    m_lastWasNewline = isNewLine;
-  }
+  /// @brief The serial debug interface's log masks.  See log_levels.h.
+  Log::Masks& getMasks() { return m_serialDebug->getMasks(); }
 
+  private:
 
   NetInterface* m_wifiDebug;
   DebugInterface* m_serialDebug;
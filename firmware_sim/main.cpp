@@ -1,10 +1,19 @@
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <unistd.h>
+#include <vector>
 
 #include "focuser_state.h"
 #include "hardware_interface.h"
+#include "net_epoll.h"
+#include "sim_runner.h"
+#include "trace_decode.h"
 
 std::unique_ptr<FS::Focuser> focuser;
 
@@ -46,6 +55,109 @@ class NetInterfaceSim: public NetInterface {
   void flush() override
   {
   }
+  bool canWaitForInput() override
+  {
+    return true;
+  }
+  unsigned int waitForInput( unsigned int uSecTimeout ) override
+  {
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    FD_SET(STDIN_FILENO, &readfds );
+
+    struct timeval timeout;
+    timeout.tv_sec = uSecTimeout / 1000000;
+    timeout.tv_usec = uSecTimeout % 1000000;
+
+    // Linux's select leaves the time that wasn't used in timeout.
+    if ( select(1, &readfds, nullptr, nullptr, &timeout ) > 0 )
+    {
+      return timeout.tv_sec * 1000000 + timeout.tv_usec;
+    }
+    return 0;
+  }
+};
+
+///
+/// @brief Net interface that plays a script against virtual time
+///
+/// The script is read from a stream, one "<time in ms> <command>" per
+/// line, in time order, i.e.,
+///
+/// @code
+///   0 abs_pos=1000
+///   500 pstatus
+///   3600000 home
+/// @endcode
+///
+class NetInterfaceScript: public NetInterface, public SimParticipant {
+  public:
+
+  NetInterfaceScript( std::istream& script ) : uSecTime{ 0 }, next{ 0 }
+  {
+    uint64_t ms;
+    std::string command;
+    while ( script >> ms >> command )
+    {
+      lines.push_back( { ms * 1000, command } );
+    }
+  }
+
+  void setup( DebugInterface& debugLog ) override
+  {
+    debugLog << "Script Net Interface Init\n";
+  }
+  bool getString( WifiDebugOstream& log, std::string& input ) override
+  {
+    if ( next == lines.size() || lines[ next ].uSecTime > uSecTime )
+    {
+      input = "";
+      return false;
+    }
+    input = lines[ next++ ].command;
+    return true;
+  }
+  std::streamsize write( const char_type* s, std::streamsize n ) override
+  {
+    std::cout.write( s, n );
+    return n;
+  }
+  void flush() override
+  {
+  }
+  bool canWaitForInput() override
+  {
+    return true;
+  }
+  unsigned int waitForInput( unsigned int uSecTimeout ) override
+  {
+    // The SimRunner does the waiting.  Just say if input will end it.
+    const uint64_t uSecInput = nextEvent();
+    if ( uSecInput >= uSecTime + uSecTimeout )
+    {
+      return 0;
+    }
+    return uSecTime + uSecTimeout - std::max( uSecInput, uSecTime );
+  }
+  void advanceTo( uint64_t uSecNow ) override
+  {
+    uSecTime = uSecNow;
+  }
+  uint64_t nextEvent() const override
+  {
+    return next == lines.size() ? never : lines[ next ].uSecTime;
+  }
+
+  private:
+
+  struct Line {
+    uint64_t uSecTime;
+    std::string command;
+  };
+
+  std::vector<Line> lines;
+  uint64_t uSecTime;
+  std::size_t next;
 };
 
 class HWISim: public HWI
@@ -70,6 +182,17 @@ class HWISim: public HWI
   }
 };
 
+class ClockSim: public Clock
+{
+  public:
+
+  uint64_t uSecNow() override
+  {
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>( now ).count();
+  }
+};
+
 class DebugInterfaceSim: public DebugInterface
 {
   struct category: virtual beefocus_tag {};
@@ -87,11 +210,18 @@ class DebugInterfaceSim: public DebugInterface
 };
 
 void loop() {
-  focuser->loop();
+  unsigned int pause = focuser->loop();
+  pause = focuser->waitForInput( pause );
+  if ( pause != 0 )
+  {
+    usleep( pause );
+  }
 }
 
-void setup() {
-  std::unique_ptr<NetInterface> wifi( new NetInterfaceSim );
+void setup( 
+  std::unique_ptr<NetInterface> wifi,
+  std::unique_ptr<Clock> clock ) 
+{
   std::unique_ptr<HWI> hardware( new HWISim );
   std::unique_ptr<DebugInterface> debug( new DebugInterfaceSim );
   FS::BuildParams params( FS::Build::LOW_POWER_HYPERSTAR_FOCUSER );
@@ -99,14 +229,98 @@ void setup() {
      new FS::Focuser( 
         std::move(wifi), 
         std::move(hardware),
+        std::move(clock),
 				std::move(debug),
         params )
   );
 }
 
+/// @brief Run a script from stdin in virtual time, as fast as we can
+///
+/// @param[in] uSecEnd - How much virtual time to simulate
+///
+void runVirtual( uint64_t uSecEnd )
+{
+  std::unique_ptr<NetInterfaceScript> wifi( new NetInterfaceScript( std::cin ));
+  std::unique_ptr<VirtualClock> clock( new VirtualClock );
+  NetInterfaceScript* wifiAlias = wifi.get();
+  VirtualClock* clockAlias = clock.get();
+  setup( std::move( wifi ), std::move( clock ));
+
+  SimRunner runner( *focuser );
+  runner.add( *clockAlias );
+  runner.add( *wifiAlias );
+  runner.runUntil( uSecEnd );
+}
+
+/// @brief Print a trace that was captured from a focuser, one record
+///        a line
+///
+/// The input is the focuser's replies to the trace command, i.e., a
+/// log of a telnet session.  Other lines are skipped.
+///
+int decodeTrace( std::istream& input )
+{
+  TraceDecoder decoder;
+  std::string line;
+  while ( !decoder.isDone() && std::getline( input, line ))
+  {
+    if ( !line.empty() && line.back() == '\r' )
+    {
+      line.pop_back();
+    }
+    decoder.addLine( line );
+  }
+  for ( const Trace::Record& record : decoder.getRecords() )
+  {
+    std::cout << "Time: " << record.msTime << " " 
+              << TraceDecoder::describe( record ) << "\n";
+  }
+  std::cout << "Lost: " << decoder.getLost() << "\n";
+  return decoder.isDone() ? 0 : 1;
+}
+
+///
+/// Usage:
+///
+///   firware_sim                      - Interactive, in real time
+///   firware_sim --virtual <seconds>  - Play a script from stdin in
+///                                      virtual time.  See 
+///                                      NetInterfaceScript.
+///   firware_sim --tcp [port]         - Serve clients on a TCP port, 
+///                                      4999 by default, in real time.
+///                                      See NetInterfaceEpoll.
+///   firware_sim --trace              - Decode a trace command's 
+///                                      output from stdin.
+///
 int main(int argc, char* argv[])
 {
-  setup();
+  if ( argc == 2 && strcmp( argv[1], "--trace" ) == 0 )
+  {
+    return decodeTrace( std::cin );
+  }
+  if ( argc == 3 && strcmp( argv[1], "--virtual" ) == 0 )
+  {
+    runVirtual( std::strtoull( argv[2], nullptr, 10 ) * 1000 * 1000 );
+    return 0;
+  }
+
+  std::unique_ptr<NetInterface> wifi( new NetInterfaceSim );
+  if (( argc == 2 || argc == 3 ) && strcmp( argv[1], "--tcp" ) == 0 )
+  {
+    const uint16_t port = argc == 3 ? 
+      static_cast<uint16_t>( std::strtoul( argv[2], nullptr, 10 )) : 4999;
+    std::unique_ptr<NetInterfaceEpoll> tcp( new NetInterfaceEpoll( port ));
+    if ( !tcp->open() )
+    {
+      perror( "Can't listen for clients" );
+      return 1;
+    }
+    std::cout << "Listening on port " << tcp->getPort() << "\n";
+    wifi = std::move( tcp );
+  }
+
+  setup( std::move( wifi ), std::unique_ptr<Clock>( new ClockSim ));
   for ( ;; ) 
   {
     loop();
@@ -0,0 +1,493 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include "net_epoll.h"
+#include "wifi_debug_ostream.h"
+
+constexpr std::size_t NetInterfaceEpoll::maxConnections;
+constexpr unsigned int NetInterfaceEpoll::linesPerPoll;
+
+/////////////////////////////////////////////////////////////////////////
+//
+// NetConnectionEpoll
+//
+/////////////////////////////////////////////////////////////////////////
+
+NetConnectionEpoll::NetConnectionEpoll() : m_fd{ -1 }, m_epollFd{ -1 }
+{
+  reset();
+}
+
+NetConnectionEpoll::~NetConnectionEpoll()
+{
+  reset();
+}
+
+void NetConnectionEpoll::reset()
+{
+  close();
+  resetSession();
+}
+
+void NetConnectionEpoll::close()
+{
+  if ( m_fd >= 0 )
+  {
+    epoll_ctl( m_epollFd, EPOLL_CTL_DEL, m_fd, nullptr );
+    ::close( m_fd );
+    m_fd = -1;
+  }
+  m_watchingOutput = false;
+  m_outgoing.reset();
+}
+
+void NetConnectionEpoll::initConnection( int fd, int epollFd )
+{
+  reset();
+  m_fd = fd;
+  m_epollFd = epollFd;
+
+  epoll_event event;
+  event.events = EPOLLIN | EPOLLRDHUP;
+  event.data.fd = m_fd;
+  epoll_ctl( m_epollFd, EPOLL_CTL_ADD, m_fd, &event );
+
+  const int noDelay = 1;
+  setsockopt( m_fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof( noDelay ));
+  (*this) << "# Bee Focuser is ready for commands\n";
+}
+
+void NetConnectionEpoll::kick()
+{
+  // What send takes is still delivered after the socket's closed.
+  queueDropNotice();
+  flush();
+  reset();
+}
+
+bool NetConnectionEpoll::getString( WifiDebugOstream& log, std::string& string )
+{
+  handleNewIncomingData( log );
+  return getBufferedString( string );
+}
+
+bool NetConnectionEpoll::hasInput()
+{
+  int waiting = 0;
+  if ( m_fd >= 0 && ioctl( m_fd, FIONREAD, &waiting ) == 0 && waiting > 0 )
+  {
+    return true;
+  }
+  return hasBufferedInput();
+}
+
+void NetConnectionEpoll::handleNewIncomingData( WifiDebugOstream& log )
+{
+  if ( m_fd < 0 )
+  {
+    return;
+  }
+
+  const unsigned int droppedBefore = m_incoming.linesDropped();
+  for ( ;; )
+  {
+    std::size_t space;
+    char* dest = m_incoming.writeSpace( space );
+    if ( space == 0 )
+    {
+      // Full of lines.  The rest waits in the socket.
+      break;
+    }
+    const ssize_t got = recv( m_fd, dest, space, MSG_DONTWAIT );
+    if ( got > 0 )
+    {
+      m_incoming.commit( static_cast<std::size_t>( got ));
+      continue;
+    }
+    if ( got < 0 && errno == EINTR )
+    {
+      continue;
+    }
+    if ( got == 0 || ( errno != EAGAIN && errno != EWOULDBLOCK ))
+    {
+      log.info( Log::Category::Net ) << "Client disconnected\n";
+      close();
+    }
+    break;
+  }
+  if ( m_incoming.linesDropped() != droppedBefore )
+  {
+    log.warn( Log::Category::Net ) << "Dropped a line longer than "
+        << static_cast<unsigned int>( maxLineLength - 1 ) << " characters\n";
+  }
+}
+
+void NetConnectionEpoll::flush()
+{
+  if ( m_fd < 0 ) { return; }
+  if ( m_outgoing.isOverflowed() )
+  {
+    // The client isn't reading, and waiting for it would stall stepping.
+    close();
+    return;
+  }
+
+  bool gone = false;
+  m_outgoing.drain( [&] ( const char_type* s, std::size_t n ) -> std::size_t
+  {
+    for ( ;; )
+    {
+      const ssize_t sent = send( m_fd, s, n, MSG_DONTWAIT | MSG_NOSIGNAL );
+      if ( sent >= 0 )
+      {
+        return static_cast<std::size_t>( sent );
+      }
+      if ( errno == EINTR )
+      {
+        continue;
+      }
+      gone = errno != EAGAIN && errno != EWOULDBLOCK;
+      return 0;
+    }
+  });
+  if ( gone )
+  {
+    close();
+    return;
+  }
+
+  // Whatever the socket didn't take goes when epoll says it can.
+  watchForOutput( !m_outgoing.isEmpty() );
+}
+
+void NetConnectionEpoll::watchForOutput( bool on )
+{
+  if ( on == m_watchingOutput )
+  {
+    return;
+  }
+  epoll_event event;
+  event.events = EPOLLIN | EPOLLRDHUP;
+  if ( on )
+  {
+    event.events |= EPOLLOUT;
+  }
+  event.data.fd = m_fd;
+  epoll_ctl( m_epollFd, EPOLL_CTL_MOD, m_fd, &event );
+  m_watchingOutput = on;
+}
+
+/////////////////////////////////////////////////////////////////////////
+//
+// NetInterfaceEpoll
+//
+/////////////////////////////////////////////////////////////////////////
+
+NetInterfaceEpoll::NetInterfaceEpoll( uint16_t port )
+  : m_port{ port }, m_listenFd{ -1 }, m_epollFd{ -1 }, m_nextToKick{ 0 },
+    m_sendToOne{ false }, m_sendTo{ 0 }, m_openedSessions{ 0 }
+{
+}
+
+NetInterfaceEpoll::~NetInterfaceEpoll()
+{
+  for ( NetConnectionEpoll& connection : m_connections )
+  {
+    connection.reset();
+  }
+  if ( m_listenFd >= 0 ) ::close( m_listenFd );
+  if ( m_epollFd >= 0 ) ::close( m_epollFd );
+}
+
+bool NetInterfaceEpoll::open()
+{
+  if ( m_listenFd >= 0 )
+  {
+    return true;
+  }
+
+  const int listenFd = socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+  const int epollFd = epoll_create1( EPOLL_CLOEXEC );
+
+  const int reuse = 1;
+  sockaddr_in address;
+  memset( &address, 0, sizeof( address ));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl( INADDR_ANY );
+  address.sin_port = htons( m_port );
+  socklen_t addressLength = sizeof( address );
+
+  epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = listenFd;
+
+  const bool ok = listenFd >= 0 && epollFd >= 0 &&
+    setsockopt( listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof( reuse )) == 0 &&
+    bind( listenFd, reinterpret_cast<sockaddr*>( &address ), sizeof( address )) == 0 &&
+    listen( listenFd, static_cast<int>( maxConnections )) == 0 &&
+    getsockname( listenFd, reinterpret_cast<sockaddr*>( &address ), &addressLength ) == 0 &&
+    epoll_ctl( epollFd, EPOLL_CTL_ADD, listenFd, &event ) == 0;
+
+  if ( !ok )
+  {
+    const int error = errno;
+    if ( listenFd >= 0 ) ::close( listenFd );
+    if ( epollFd >= 0 ) ::close( epollFd );
+    errno = error;
+    return false;
+  }
+
+  m_listenFd = listenFd;
+  m_epollFd = epollFd;
+  m_port = ntohs( address.sin_port );
+  return true;
+}
+
+void NetInterfaceEpoll::setup( DebugInterface& log )
+{
+  log.info( Log::Category::Net ) << "Simulator TCP Net Interface Init\n";
+  if ( open() )
+  {
+    log.info( Log::Category::Net )
+      << "Telnet to this address to connect: localhost " << m_port << "\n";
+  }
+  else
+  {
+    log.error( Log::Category::Net )
+      << "Can't listen on port " << m_port << ": " << strerror( errno ) << "\n";
+  }
+}
+
+bool NetInterfaceEpoll::getString( WifiDebugOstream& log, std::string& string )
+{
+  handleNewConnections( log );
+  return m_scheduler.getString( m_connections, log, string );
+}
+
+void NetInterfaceEpoll::handleNewConnections( WifiDebugOstream& log )
+{
+  if ( m_listenFd < 0 )
+  {
+    return;
+  }
+  for ( ;; )
+  {
+    const int fd = accept4( m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC );
+    if ( fd < 0 )
+    {
+      if ( errno == EINTR ) continue;
+      return;
+    }
+
+    log.info( Log::Category::Net ) << "New client connecting\n";
+
+    std::size_t slot = 0;
+    while ( slot < m_connections.size() && m_connections[ slot ] )
+    {
+      ++slot;
+    }
+    if ( slot == m_connections.size() )
+    {
+      slot = m_nextToKick;
+      m_nextToKick = ( m_nextToKick + 1 ) % m_connections.size();
+    }
+
+    log.info( Log::Category::Net )
+        << "Using slot " << static_cast<unsigned int>( slot ) << " of "
+        << static_cast<unsigned int>( m_connections.size() - 1 )
+        << " for the new client\n";
+
+    if ( m_connections[ slot ] )
+    {
+      log.info( Log::Category::Net ) << "An existing client exists - disconnecting it\n";
+      const InputStats& stats = m_scheduler.getStats( slot );
+      log.info( Log::Category::Net ) << "Old client sent " << stats.lines << " lines, waited "
+          << stats.deferred << " polls, at most "
+          << stats.maxPollsWaited << " in a row\n";
+      m_connections[ slot ].kick();
+    }
+
+    m_scheduler.reset( slot );
+    m_connections[ slot ].initConnection( fd, m_epollFd );
+    m_openedSessions |= 1u << slot;
+  }
+}
+
+bool NetInterfaceEpoll::hasBufferedInput()
+{
+  for ( NetConnectionEpoll& connection : m_connections )
+  {
+    if ( connection.hasInput() )
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool NetInterfaceEpoll::canWaitForInput()
+{
+  return true;
+}
+
+unsigned int NetInterfaceEpoll::waitForInput( unsigned int uSecTimeout )
+{
+  if ( m_epollFd < 0 )
+  {
+    usleep( uSecTimeout );
+    return 0;
+  }
+  if ( hasBufferedInput() )
+  {
+    return uSecTimeout;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  const Clock::time_point start = Clock::now();
+  for ( ;; )
+  {
+    const uint64_t waited = std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now() - start ).count();
+    if ( waited >= uSecTimeout )
+    {
+      return 0;
+    }
+    const uint64_t uSecLeft = uSecTimeout - waited;
+    // epoll_wait counts in ms.  Round up so we don't wake early.
+    const int msLeft = static_cast<int>(( uSecLeft + 999 ) / 1000 );
+
+    epoll_event events[ maxConnections + 1 ];
+    const int count = epoll_wait( m_epollFd, events, maxConnections + 1, msLeft );
+    bool hasInput = false;
+    for ( int i = 0; i < count; ++i )
+    {
+      if ( events[i].events & EPOLLOUT )
+      {
+        // A client that was behind has room for more output.
+        for ( NetConnectionEpoll& connection : m_connections )
+        {
+          if ( connection.getFd() == events[i].data.fd )
+          {
+            connection.flush();
+          }
+        }
+      }
+      if ( events[i].events & ( EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR ))
+      {
+        hasInput = true;
+      }
+    }
+    if ( hasInput )
+    {
+      const uint64_t used = std::chrono::duration_cast<std::chrono::microseconds>(
+        Clock::now() - start ).count();
+      return used < uSecTimeout ? static_cast<unsigned int>( uSecTimeout - used ) : 0;
+    }
+    if ( count < 0 && errno != EINTR )
+    {
+      return 0;
+    }
+  }
+}
+
+std::streamsize NetInterfaceEpoll::write( const char_type* s, std::streamsize n )
+{
+  if ( m_sendToOne )
+  {
+    return m_connections[ m_sendTo ].write( s, n );
+  }
+  for ( NetConnectionEpoll& connection : m_connections )
+  {
+    if ( connection.isSubscribed() )
+    {
+      connection.write( s, n );
+    }
+  }
+  return n;
+}
+
+void NetInterfaceEpoll::flush()
+{
+  for ( NetConnectionEpoll& connection : m_connections )
+  {
+    connection.flush();
+  }
+}
+
+unsigned int NetInterfaceEpoll::getSession()
+{
+  return static_cast<unsigned int>( m_scheduler.lastConnection() );
+}
+
+void NetInterfaceEpoll::sendTo( unsigned int session )
+{
+  if ( session < m_connections.size() )
+  {
+    m_sendToOne = true;
+    m_sendTo = session;
+  }
+}
+
+void NetInterfaceEpoll::sendToSubscribers()
+{
+  m_sendToOne = false;
+}
+
+void NetInterfaceEpoll::subscribe( unsigned int session, bool on )
+{
+  if ( session < m_connections.size() )
+  {
+    m_connections[ session ].setSubscribed( on );
+  }
+}
+
+bool NetInterfaceEpoll::hasBinary()
+{
+  return true;
+}
+
+bool NetInterfaceEpoll::isBinary( unsigned int session )
+{
+  return session < m_connections.size() && m_connections[ session ].isBinary();
+}
+
+void NetInterfaceEpoll::setBinary( unsigned int session, bool on )
+{
+  if ( session < m_connections.size() )
+  {
+    m_connections[ session ].setBinary( on );
+  }
+}
+
+void NetInterfaceEpoll::writeFrame( const uint8_t* frame, std::size_t length )
+{
+  if ( m_sendToOne )
+  {
+    m_connections[ m_sendTo ].writeFrame( frame, length );
+  }
+}
+
+void NetInterfaceEpoll::joinLines( unsigned int session, bool on )
+{
+  if ( session < m_connections.size() )
+  {
+    m_connections[ session ].joinLines( on );
+  }
+}
+
+uint32_t NetInterfaceEpoll::takeOpenedSessions()
+{
+  const uint32_t opened = m_openedSessions;
+  m_openedSessions = 0;
+  return opened;
+}
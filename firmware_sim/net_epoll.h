@@ -0,0 +1,160 @@
+///
+/// @brief TCP network interface for the simulator, using epoll
+///
+
+#ifndef __NET_EPOLL_H__
+#define __NET_EPOLL_H__
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include "net_interface.h"
+#include "framed_connection.h"
+#include "input_scheduler.h"
+
+///
+/// @brief One client of a NetInterfaceEpoll
+///
+/// The Linux version of WifiConnectionEthernet - a non-blocking TCP
+/// socket under the same FramedConnection.  Output waits in the queue
+/// until flush, which sends what the socket will take without blocking.
+/// If the client stops reading its debug lines are dropped, and if 
+/// replies still don't fit the client is dropped.
+///
+class NetConnectionEpoll: public FramedConnection {
+
+  public:
+
+  struct category: beefocus_tag {};
+  using char_type = char;
+
+  NetConnectionEpoll();
+  ~NetConnectionEpoll();
+
+  /// @brief Take over a newly accepted socket
+  ///
+  /// @param[in] fd      - The socket.  Non-blocking.
+  /// @param[in] epollFd - Where the socket's events are watched
+  ///
+  void initConnection( int fd, int epollFd );
+
+  /// @brief Drop the client, telling it why if its socket has room
+  ///        for the notice.  See queueDropNotice.
+  void kick( void );
+
+  bool getString( WifiDebugOstream& log, std::string& string ) override;
+  bool hasInput( void ) override;
+  operator bool( void ) override {
+    return m_fd >= 0;
+  }
+  void reset( void ) override;
+  void flush() override;
+
+  /// @brief The client's socket.  -1 if there's no client.
+  int getFd( void ) const { return m_fd; }
+
+  private:
+
+  NetConnectionEpoll( const NetConnectionEpoll& ) = delete;
+  NetConnectionEpoll& operator=( const NetConnectionEpoll& ) = delete;
+
+  void handleNewIncomingData( WifiDebugOstream& log );
+  /// @brief Close the socket.  Input that's already buffered stays.
+  void close( void );
+  /// @brief Ask epoll to say when the socket can take output, or not
+  void watchForOutput( bool on );
+
+  int m_fd;
+  int m_epollFd;
+  /// @brief Is epoll watching for the socket to take output?
+  bool m_watchingOutput;
+};
+
+///
+/// @brief Serve the focuser protocol on a TCP port, on Linux
+///
+/// Serves the same protocol as WifiInterfaceEthernet - the same port,
+/// the same number of client slots and, when a client connects and the
+/// slots are full, the same round robin choice of client to drop.  The
+/// sockets are non-blocking, and waitForInput sleeps in epoll_wait, so
+/// the simulator can be driven and load tested with real clients.
+///
+/// Example:
+///
+/// @code
+///   std::unique_ptr<NetInterfaceEpoll> net( new NetInterfaceEpoll );
+///   if ( !net->open() ) perror( "Can't listen on port 4999" );
+///   // Hand net to a Focuser, then telnet localhost 4999
+/// @endcode
+///
+class NetInterfaceEpoll: public NetInterface {
+  public:
+
+  /// @param[in] port - The port to listen on.  0 for any free port.
+  NetInterfaceEpoll( uint16_t port = 4999 );
+  ~NetInterfaceEpoll();
+
+  /// @brief Start listening, if setup hasn't already
+  ///
+  /// @return false if the port can't be listened on.  errno says why.
+  ///
+  bool open( void );
+
+  /// @brief The port we're listening on.  See the constructor.
+  uint16_t getPort( void ) const { return m_port; }
+
+  /// @brief A client slot, i.e., to see how a slow client is doing
+  const NetConnectionEpoll& getConnection( unsigned int session ) const
+  {
+    return m_connections.at( session );
+  }
+
+  void setup( DebugInterface& debugLog ) override;
+
+  bool getString( WifiDebugOstream& log, std::string& string ) override;
+  std::streamsize write( const char_type* s, std::streamsize n ) override;
+  void flush() override;
+  bool canWaitForInput() override;
+  unsigned int waitForInput( unsigned int uSecTimeout ) override;
+  unsigned int getSession() override;
+  void sendTo( unsigned int session ) override;
+  void sendToSubscribers() override;
+  void subscribe( unsigned int session, bool on ) override;
+  bool hasBinary() override;
+  bool isBinary( unsigned int session ) override;
+  void setBinary( unsigned int session, bool on ) override;
+  void writeFrame( const uint8_t* frame, std::size_t length ) override;
+  void joinLines( unsigned int session, bool on ) override;
+  uint32_t takeOpenedSessions() override;
+
+  /// @brief Most clients that can be connected at once
+  static constexpr std::size_t maxConnections = 4;
+  /// @brief Most lines taken from one client each time input is polled
+  static constexpr unsigned int linesPerPoll = 2;
+
+  private:
+
+  NetInterfaceEpoll( const NetInterfaceEpoll& ) = delete;
+  NetInterfaceEpoll& operator=( const NetInterfaceEpoll& ) = delete;
+
+  void handleNewConnections( WifiDebugOstream& log );
+  /// @brief Is there input we've already read, waiting to be taken?
+  bool hasBufferedInput( void );
+
+  typedef std::array< NetConnectionEpoll, maxConnections > ConnectionArray;
+
+  uint16_t m_port;
+  int m_listenFd;
+  int m_epollFd;
+  ConnectionArray m_connections;
+  InputScheduler< maxConnections, linesPerPoll > m_scheduler;
+  /// @brief The slot to take when a client connects and all are in use
+  std::size_t m_nextToKick;
+  /// @brief Is output going to one session (m_sendTo) or subscribers?
+  bool m_sendToOne;
+  unsigned int m_sendTo;
+  /// @brief Sessions given to a new client.  See takeOpenedSessions.
+  uint32_t m_openedSessions;
+};
+
+#endif
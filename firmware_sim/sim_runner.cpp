@@ -0,0 +1,52 @@
+
+#include <algorithm>
+#include "sim_runner.h"
+#include "focuser_state.h"
+
+constexpr uint64_t SimParticipant::never;
+
+SimRunner::SimRunner( FS::Focuser& focuserArg )
+  : focuser{ focuserArg }, uSecTime{ 0 }
+{
+}
+
+void SimRunner::add( SimParticipant& participant )
+{
+  participants.push_back( &participant );
+  participant.advanceTo( uSecTime );
+}
+
+uint64_t SimRunner::runUntil( uint64_t uSecEnd )
+{
+  uint64_t loopCalls = 0;
+  while ( uSecTime < uSecEnd )
+  {
+    const unsigned int uSecPause = focuser.loop();
+    ++loopCalls;
+
+    uint64_t uSecWake = uSecTime + uSecPause;
+    if ( uSecPause != 0 && focuser.waitForInput( uSecPause ) == 0 )
+    {
+      // The focuser is waiting on input, so input can end the pause.
+      uSecWake = std::max( uSecTime, std::min( uSecWake, nextEvent() ));
+    }
+
+    uSecTime = uSecWake;
+    for ( SimParticipant* participant : participants )
+    {
+      participant->advanceTo( uSecTime );
+    }
+  }
+  return loopCalls;
+}
+
+uint64_t SimRunner::nextEvent() const
+{
+  uint64_t uSecNext = SimParticipant::never;
+  for ( const SimParticipant* participant : participants )
+  {
+    uSecNext = std::min( uSecNext, participant->nextEvent() );
+  }
+  return uSecNext;
+}
+
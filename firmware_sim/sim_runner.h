@@ -0,0 +1,129 @@
+///
+/// @brief Virtual time simulation of the focuser
+///
+
+#ifndef __SIM_RUNNER_H__
+#define __SIM_RUNNER_H__
+
+#include <cstdint>
+#include <vector>
+#include "clock_interface.h"
+
+namespace FS {
+  class Focuser;
+}
+
+///
+/// @brief Something that lives in simulated time
+///
+/// The network and hardware stand ins used by the simulation implement
+/// this so the SimRunner can move them forward, and so it knows when
+/// they'll next have input for the focuser.
+///
+class SimParticipant
+{
+  public:
+
+  /// @brief nextEvent's answer when there's nothing coming
+  static constexpr uint64_t never = UINT64_MAX;
+
+  virtual ~SimParticipant() {}
+
+  /// @brief Move simulated time forward to uSecNow
+  virtual void advanceTo( uint64_t uSecNow ) = 0;
+
+  /// @brief When the next input arrives, in us.  never if there's none.
+  virtual uint64_t nextEvent() const { return never; }
+};
+
+///
+/// @brief A clock that only moves when the simulation moves it
+///
+class VirtualClock: public Clock, public SimParticipant
+{
+  public:
+
+  VirtualClock() : uSecTime{ 0 }
+  {
+  }
+
+  uint64_t uSecNow() override
+  {
+    return uSecTime;
+  }
+
+  void advanceTo( uint64_t uSecNow ) override
+  {
+    uSecTime = uSecNow;
+  }
+
+  /// @brief Set the time, in microseconds
+  void setTime( uint64_t uSecTimeArg )
+  {
+    uSecTime = uSecTimeArg;
+  }
+
+  private:
+
+  /// @brief Current time in microseconds
+  uint64_t uSecTime;
+};
+
+///
+/// @brief Run a focuser against virtual time
+///
+/// Nothing waits.  After each call to Focuser::loop the runner jumps
+/// straight to the time loop asked to be called again at.  If the
+/// focuser is idle and can wait for input, it jumps to the next input
+/// event instead, if that's sooner.  Hours of simulated time take
+/// milliseconds.
+///
+/// Example:
+///
+/// @code
+///   VirtualClock* clock = ...;   // Owned by the focuser
+///   NetSim* net = ...;           // Some SimParticipant net interface
+///   SimRunner runner( *focuser );
+///   runner.add( *clock );
+///   runner.add( *net );
+///   runner.runUntil( 60ull*60*1000*1000 );   // One hour
+/// @endcode
+///
+/// Participants are moved forward in the order they were added.  Add
+/// the clock first.
+///
+class SimRunner
+{
+  public:
+
+  SimRunner( FS::Focuser& focuserArg );
+
+  SimRunner( const SimRunner& ) = delete;
+  SimRunner& operator=( const SimRunner& ) = delete;
+
+  /// @brief Add something the runner moves forward with time
+  void add( SimParticipant& participant );
+
+  ///
+  /// @brief Run the focuser
+  ///
+  /// @param[in] uSecEnd - Stop once virtual time reaches this, in us
+  /// @return    The number of calls to Focuser::loop
+  ///
+  uint64_t runUntil( uint64_t uSecEnd );
+
+  /// @brief Current virtual time, in us
+  uint64_t uSecNow() const { return uSecTime; }
+
+  private:
+
+  /// @brief Soonest input event of all the participants
+  uint64_t nextEvent() const;
+
+  FS::Focuser& focuser;
+  std::vector<SimParticipant*> participants;
+  uint64_t uSecTime;
+};
+
+#endif
+
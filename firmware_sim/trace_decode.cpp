@@ -0,0 +1,164 @@
+#include <cstdlib>
+#include "trace_decode.h"
+#include "binary_protocol.h"
+#include "focuser_state.h"
+
+TraceDecoder::TraceDecoder() : expected{ 0 }, lost{ 0 }, done{ false }
+{
+}
+
+bool TraceDecoder::addLine( const std::string& line )
+{
+  bool any = false;
+  std::size_t start = 0;
+  for ( ;; )
+  {
+    const std::size_t end = line.find( "; ", start );
+    any = addReply( line.substr( start, end - start )) || any;
+    if ( end == std::string::npos )
+    {
+      return any;
+    }
+    start = end + 2;
+  }
+}
+
+bool TraceDecoder::addReply( const std::string& reply )
+{
+  static const std::string prefix = "Trace: ";
+  if ( reply.compare( 0, prefix.size(), prefix ) != 0 )
+  {
+    return false;
+  }
+  const std::string body = reply.substr( prefix.size() );
+
+  // The header - "<records> <lost>".  It starts a new trace.
+  if ( body.find( ' ' ) != std::string::npos )
+  {
+    char* end;
+    expected = std::strtoul( body.c_str(), &end, 10 );
+    lost = std::strtoul( end, nullptr, 10 );
+    records.clear();
+    done = expected == 0;
+    return true;
+  }
+
+  // Records, two hex digits a byte.
+  constexpr std::size_t hexPerRecord = Trace::recordBytes * 2;
+  if ( body.empty() || body.size() % hexPerRecord != 0 ||
+       body.find_first_not_of( "0123456789abcdef" ) != std::string::npos )
+  {
+    return false;
+  }
+  for ( std::size_t r = 0; r < body.size(); r += hexPerRecord )
+  {
+    uint8_t bytes[ Trace::recordBytes ];
+    for ( std::size_t b = 0; b < Trace::recordBytes; ++b )
+    {
+      bytes[b] = static_cast<uint8_t>( std::strtoul(
+        body.substr( r + b * 2, 2 ).c_str(), nullptr, 16 ));
+    }
+    records.push_back( Trace::decode( bytes ));
+  }
+  done = records.size() >= expected;
+  return true;
+}
+
+bool TraceDecoder::addFrame( const uint8_t* frame, std::size_t length )
+{
+  using BinaryProtocol::ResponseType;
+
+  if ( length < BinaryProtocol::overhead + 1 ||
+       frame[0] != BinaryProtocol::magic ||
+       frame[1] + BinaryProtocol::overhead != length )
+  {
+    return false;
+  }
+  uint8_t sum = 0;
+  for ( std::size_t i = 1; i < length; ++i )
+  {
+    sum += frame[i];
+  }
+  if ( sum != 0 )
+  {
+    return false;
+  }
+
+  const uint8_t* payload = frame + 2;
+  const std::size_t payloadLength = frame[1];
+  if ( payload[0] == static_cast<uint8_t>( ResponseType::Trace ))
+  {
+    if (( payloadLength - 1 ) % Trace::recordBytes != 0 )
+    {
+      return false;
+    }
+    if ( done )
+    {
+      // A new download
+      records.clear();
+      done = false;
+    }
+    for ( std::size_t i = 1; i < payloadLength; i += Trace::recordBytes )
+    {
+      records.push_back( Trace::decode( payload + i ));
+    }
+    return true;
+  }
+  if ( payload[0] == static_cast<uint8_t>( ResponseType::TraceEnd ) &&
+       payloadLength == 5 )
+  {
+    lost = 0;
+    for ( int i = 0; i < 4; ++i )
+    {
+      lost |= static_cast<uint32_t>( payload[ i + 1 ] ) << ( 8 * i );
+    }
+    done = true;
+    return true;
+  }
+  return false;
+}
+
+std::string TraceDecoder::describe( const Trace::Record& record )
+{
+  const std::string arg = std::to_string( record.arg );
+  switch ( record.kind )
+  {
+    case Trace::Kind::StatePush:
+    case Trace::Kind::StatePop:
+    {
+      const std::string what =
+        record.kind == Trace::Kind::StatePush ? "push " : "pop ";
+      if ( record.code >= BeeFocus::toIndex( FS::State::END_OF_STATES ))
+      {
+        return what + "? " + arg;
+      }
+      return what + FS::stateNames.at( FS::State( record.code )) + " " + arg;
+    }
+    case Trace::Kind::StateReset:
+      return "reset";
+    case Trace::Kind::PinWrite:
+    {
+      if ( record.code >= BeeFocus::toIndex( HWI::Pin::END_OF_PINS ) ||
+           record.arg < 0 || static_cast<std::size_t>( record.arg ) >=
+             BeeFocus::toIndex( HWI::PinState::END_OF_PIN_STATES ))
+      {
+        return "DW ? " + arg;
+      }
+      return "DW (" + HWI::pinNames.at( HWI::Pin( record.code )) + ") = " +
+        HWI::pinStateNames.at( HWI::PinState( record.arg ));
+    }
+    case Trace::Kind::Command:
+    {
+      using CommandParser::Command;
+      if ( record.code >= BeeFocus::toIndex( Command::EndOfCommands ))
+      {
+        return "command ? " + arg;
+      }
+      const Command command = Command( record.code );
+      const std::string name = CommandParser::getCommandName( command );
+      return "command " + name +
+        ( CommandParser::hasArg( command ) ? "=" + arg : "" );
+    }
+  }
+  return "? " + std::to_string( record.code ) + " " + arg;
+}
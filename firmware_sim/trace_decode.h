@@ -0,0 +1,96 @@
+///
+/// @brief Host side decoder for the focuser's trace
+///
+
+#ifndef __TRACE_DECODE_H__
+#define __TRACE_DECODE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "trace_ring.h"
+
+///
+/// @brief Turns a "trace" command's output back into Trace::Records
+///
+/// Feed it the focuser's output a line or a frame at a time, in the
+/// order it came.  Output that isn't part of the trace is ignored, so
+/// debug lines and events can be fed in too.
+///
+/// Example:
+///
+/// @code
+///   TraceDecoder decoder;
+///   while ( !decoder.isDone() && getLine( line ))
+///   {
+///     decoder.addLine( line );
+///   }
+///   for ( const Trace::Record& record : decoder.getRecords() )
+///   {
+///     std::cout << TraceDecoder::describe( record ) << "\n";
+///   }
+/// @endcode
+///
+class TraceDecoder {
+  public:
+
+  TraceDecoder();
+
+  ///
+  /// @brief Take a line of text protocol output, without the '\n'
+  ///
+  /// Lines with several replies joined by "; " are split up.
+  ///
+  /// @return false if the line wasn't part of a trace, or was garbled
+  ///
+  bool addLine( const std::string& line );
+
+  ///
+  /// @brief Take a binary protocol response frame
+  ///
+  /// @param[in] frame  - The frame, magic byte first
+  /// @param[in] length - Bytes in the frame
+  /// @return    false if the frame wasn't part of a trace, or was bad
+  ///
+  bool addFrame( const uint8_t* frame, std::size_t length );
+
+  /// @brief Has the whole trace come in?
+  bool isDone() const
+  {
+    return done;
+  }
+
+  /// @brief The records so far, oldest first
+  const std::vector<Trace::Record>& getRecords() const
+  {
+    return records;
+  }
+
+  /// @brief Records the focuser lost before the trace was taken
+  uint32_t getLost() const
+  {
+    return lost;
+  }
+
+  ///
+  /// @brief Describe a record, i.e., "push MOVING 1000"
+  ///
+  /// Pin writes are described the way the simulator prints them, i.e.,
+  /// "DW (Direction) = Dir Forward"
+  ///
+  static std::string describe( const Trace::Record& record );
+
+  private:
+
+  /// @brief Take one "Trace: " reply
+  bool addReply( const std::string& reply );
+
+  std::vector<Trace::Record> records;
+  /// @brief Records the text header said are coming
+  std::size_t expected;
+  uint32_t lost;
+  bool done;
+};
+
+#endif
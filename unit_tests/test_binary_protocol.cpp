@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include "binary_protocol.h"
+#include "line_buffer.h"
+
+using namespace CommandParser;
+
+/// @brief Encode a request and decode it again
+static ParseError roundTrip( const CommandPacket& in, CommandPacket& out )
+{
+  uint8_t frame[ BinaryProtocol::maxFrame ];
+  const std::size_t length = BinaryProtocol::encodeRequest( in, frame );
+  return BinaryProtocol::decodeRequest( frame, length, out );
+}
+
+TEST( BINARY_PROTOCOL, requestLayout )
+{
+  uint8_t frame[ BinaryProtocol::maxFrame ];
+
+  // pstatus has no argument
+  ASSERT_EQ( 4u, BinaryProtocol::encodeRequest(
+    CommandPacket( Command::PStatus ), frame ));
+  const uint8_t pstatus[] = { 0xb5, 0x01, 0x03, 0xfc };
+  ASSERT_EQ( 0, memcmp( pstatus, frame, sizeof( pstatus )));
+
+  // abs_pos=1000, little endian
+  ASSERT_EQ( 8u, BinaryProtocol::encodeRequest(
+    CommandPacket( Command::ABSPos, 1000 ), frame ));
+  const uint8_t absPos[] = { 0xb5, 0x05, 0x06, 0xe8, 0x03, 0x00, 0x00, 0x0a };
+  ASSERT_EQ( 0, memcmp( absPos, frame, sizeof( absPos )));
+}
+
+TEST( BINARY_PROTOCOL, everyCommandRoundTrips )
+{
+  for ( Command c = Command::StartOfCommands; c != Command::NoCommand; ++c )
+  {
+    const CommandPacket in( c, hasArg( c ) ? -123456 : NoArg );
+    CommandPacket out;
+    ASSERT_EQ( ParseError::None, roundTrip( in, out ));
+    ASSERT_EQ( in, out );
+  }
+}
+
+TEST( BINARY_PROTOCOL, badRequests )
+{
+  uint8_t frame[ BinaryProtocol::maxFrame ];
+  CommandPacket cp;
+  std::size_t length = BinaryProtocol::encodeRequest(
+    CommandPacket( Command::Sync, 5 ), frame );
+
+  // Any flipped bit is caught by the checksum
+  frame[3] ^= 0x10;
+  ASSERT_EQ( ParseError::BadFrame,
+    BinaryProtocol::decodeRequest( frame, length, cp ));
+  frame[3] ^= 0x10;
+  ASSERT_EQ( ParseError::BadFrame,
+    BinaryProtocol::decodeRequest( frame, length - 1, cp ));
+  ASSERT_EQ( ParseError::None,
+    BinaryProtocol::decodeRequest( frame, length, cp ));
+
+  // Commands that take an argument must have one
+  const uint8_t noArg[] = { 0xb5, 0x01, 0x08, 0xf7 };
+  ASSERT_EQ( ParseError::MissingArg,
+    BinaryProtocol::decodeRequest( noArg, sizeof( noArg ), cp ));
+
+  const uint8_t unknown[] = { 0xb5, 0x01, 0x7f, 0x80 };
+  ASSERT_EQ( ParseError::UnknownCommand,
+    BinaryProtocol::decodeRequest( unknown, sizeof( unknown ), cp ));
+}
+
+TEST( BINARY_PROTOCOL, responseLayout )
+{
+  uint8_t frame[ BinaryProtocol::maxFrame ];
+
+  ASSERT_EQ( 8u, BinaryProtocol::encodePosition( -2, frame ));
+  const uint8_t position[] = { 0xb5, 0x05, 0x01, 0xfe, 0xff, 0xff, 0xff, 0xff };
+  ASSERT_EQ( 0, memcmp( position, frame, sizeof( position )));
+
+  ASSERT_EQ( 9u, BinaryProtocol::encodeState( 3, 100, frame ));
+  const uint8_t state[] = { 0xb5, 0x06, 0x02, 0x03, 0x64, 0, 0, 0, 0x91 };
+  ASSERT_EQ( 0, memcmp( state, frame, sizeof( state )));
+
+  ASSERT_EQ( 5u, BinaryProtocol::encodeSynched( true, frame ));
+  const uint8_t synched[] = { 0xb5, 0x02, 0x03, 0x01, 0xfa };
+  ASSERT_EQ( 0, memcmp( synched, frame, sizeof( synched )));
+
+  ASSERT_EQ( 8u, BinaryProtocol::encodeDone( 100, frame ));
+  const uint8_t done[] = { 0xb5, 0x05, 0x04, 0x64, 0x00, 0x00, 0x00, 0x93 };
+  ASSERT_EQ( 0, memcmp( done, frame, sizeof( done )));
+
+  ASSERT_EQ( 8u, BinaryProtocol::encodeText( "Hi!!", 4, frame ));
+  const uint8_t text[] = { 0xb5, 0x05, 0x7f, 'H', 'i', '!', '!', 0x89 };
+  ASSERT_EQ( 0, memcmp( text, frame, sizeof( text )));
+
+  // Text that's too long is cut to fit
+  const std::string longText( 500, 'x' );
+  ASSERT_EQ( BinaryProtocol::maxFrame,
+    BinaryProtocol::encodeText( longText.data(), longText.length(), frame ));
+}
+
+/// @brief Frames come out of a LineBuffer whole, after any garbage
+TEST( BINARY_PROTOCOL, getFrame )
+{
+  uint8_t frame[ BinaryProtocol::maxFrame ];
+  const std::size_t length = BinaryProtocol::encodeRequest(
+    CommandPacket( Command::RELPos, 10 ), frame );
+
+  LineBuffer<16> buffer;
+  buffer.setLineMode( false );
+  std::string got;
+  std::size_t space;
+
+  // Garbage, then the first half of a frame
+  char* dest = buffer.writeSpace( space );
+  const char garbage[] = { 'x', '\n', char( 0xb5 ), char( 0xff ) };
+  memcpy( dest, garbage, sizeof( garbage ));
+  memcpy( dest + sizeof( garbage ), frame, 4 );
+  buffer.commit( sizeof( garbage ) + 4 );
+  ASSERT_FALSE( BinaryProtocol::getFrame( buffer, got ));
+  ASSERT_EQ( 4u, buffer.size() );
+
+  // The rest of the frame wraps around the end of the ring
+  for ( std::size_t done = 4; done != length; )
+  {
+    dest = buffer.writeSpace( space );
+    const std::size_t n = std::min( space, length - done );
+    memcpy( dest, frame + done, n );
+    buffer.commit( n );
+    done += n;
+  }
+  ASSERT_TRUE( BinaryProtocol::getFrame( buffer, got ));
+  ASSERT_TRUE( BinaryProtocol::isFrame( got ));
+  ASSERT_EQ( std::string( reinterpret_cast<char*>( frame ), length ), got );
+  ASSERT_EQ( 0u, buffer.size() );
+
+  // A full buffer with no newline isn't thrown away in binary mode
+  while (( dest = buffer.writeSpace( space )), space != 0 )
+  {
+    memset( dest, 0, space );
+    buffer.commit( space );
+  }
+  ASSERT_EQ( 16u, buffer.size() );
+  ASSERT_EQ( 0u, buffer.linesDropped() );
+}
@@ -9,19 +9,106 @@
 namespace CommandParser
 {
 
-TEST( COMMAND_PARSER, should_process_int )
+/// @brief parseInt on a whole string
+static ParseError parseIntString( const std::string& string, int& value )
 {
-  ASSERT_EQ( process_int( std::string("123") , 0 ), 123 );
-  ASSERT_EQ( process_int( std::string("123") , 1 ), 23 );
-  ASSERT_EQ( process_int( std::string("123") , 2 ), 3 );
-  ASSERT_EQ( process_int( std::string("123 "), 2 ), 3 );
-  ASSERT_EQ( process_int( std::string("4567890") , 0 ), 4567890);
-  ASSERT_EQ( process_int( std::string("cheese") , 0 ), 0 );
-  ASSERT_EQ( process_int( std::string("ABS_POS=500") , 8 ), 500 );
-  ASSERT_EQ( process_int( std::string("ABS_POS") , 8 ), 0 );
-  ASSERT_EQ( process_int( std::string("ABS_POS") , 7 ), 0 );
-  ASSERT_EQ( process_int( std::string("REL_POS=500") , 8 ), 500 );
-  ASSERT_EQ( process_int( std::string("REL_POS=-500") , 8 ), -500 );
+  return parseInt( string.data(), string.data() + string.length(), value );
+}
+
+TEST( COMMAND_PARSER, should_parse_int )
+{
+  int value = 0;
+  ASSERT_EQ( ParseError::None, parseIntString( "123", value ));
+  ASSERT_EQ( 123, value );
+  ASSERT_EQ( ParseError::None, parseIntString( "4567890", value ));
+  ASSERT_EQ( 4567890, value );
+  ASSERT_EQ( ParseError::None, parseIntString( "-500", value ));
+  ASSERT_EQ( -500, value );
+  ASSERT_EQ( ParseError::None, parseIntString( "2147483647", value ));
+  ASSERT_EQ( 2147483647, value );
+  ASSERT_EQ( ParseError::None, parseIntString( "-2147483648", value ));
+  ASSERT_EQ( -2147483647 - 1, value );
+
+  // Errors leave value alone
+  value = 7;
+  ASSERT_EQ( ParseError::MissingArg, parseIntString( "", value ));
+  ASSERT_EQ( ParseError::BadArg, parseIntString( "-", value ));
+  ASSERT_EQ( ParseError::BadArg, parseIntString( "cheese", value ));
+  ASSERT_EQ( ParseError::BadArg, parseIntString( "123 ", value ));
+  ASSERT_EQ( ParseError::BadArg, parseIntString( "12x3", value ));
+  ASSERT_EQ( ParseError::BadArg, parseIntString( " 123", value ));
+  ASSERT_EQ( ParseError::ArgOutOfRange, parseIntString( "2147483648", value ));
+  ASSERT_EQ( ParseError::ArgOutOfRange, parseIntString( "-2147483649", value ));
+  ASSERT_EQ( ParseError::ArgOutOfRange, 
+    parseIntString( "99999999999999999999999", value ));
+  ASSERT_EQ( ParseError::BadArg, 
+    parseIntString( "99999999999999999999999x", value ));
+  ASSERT_EQ( 7, value );
+}
+
+/// @brief Take the first command that's waiting on net, if there is one
+static CommandPacket nextCommand( DebugInterface& log, NetInterface& net )
+{
+  CommandQueue queue;
+  checkForCommands( log, net, queue );
+  CommandPacket cp;
+  queue.pop( cp );
+  return cp;
+}
+
+TEST( COMMAND_PARSER, parseFindsEveryCommand )
+{
+  for ( Command c = Command::StartOfCommands; c != Command::NoCommand; ++c )
+  {
+    std::string name = getCommandName( c );
+    CommandPacket cp;
+    if ( parse( name.data(), name.length(), cp ) == ParseError::MissingArg )
+    {
+      name += "=1";
+    }
+    ASSERT_EQ( ParseError::None, parse( name.data(), name.length(), cp ));
+    ASSERT_EQ( c, cp.command );
+
+    std::string upper = name;
+    for ( char& ch : upper ) ch = static_cast<char>( toupper( ch ));
+    cp = CommandPacket();
+    ASSERT_EQ( ParseError::None, parse( upper.data(), upper.length(), cp ));
+    ASSERT_EQ( c, cp.command );
+
+    // Prefixes and extensions of the name aren't commands.
+    ASSERT_EQ( ParseError::UnknownCommand, parse( name.data(), 1, cp ));
+    name.insert( 1, "x" );
+    ASSERT_EQ( ParseError::UnknownCommand, 
+      parse( name.data(), name.length(), cp ));
+  }
+}
+
+TEST( COMMAND_PARSER, parseErrors )
+{
+  CommandPacket cp;
+  const auto parseString = [&cp]( const std::string& line )
+  {
+    return parse( line.data(), line.length(), cp );
+  };
+  ASSERT_EQ( ParseError::Empty, parseString( "" ));
+  ASSERT_EQ( ParseError::Empty, parseString( " \r" ));
+  ASSERT_EQ( ParseError::UnknownCommand, parseString( "junk" ));
+  ASSERT_EQ( ParseError::UnknownCommand, parseString( "homer" ));
+  ASSERT_EQ( ParseError::UnknownCommand, parseString( "hom" ));
+  ASSERT_EQ( ParseError::UnknownCommand, parseString( "=100" ));
+  ASSERT_EQ( ParseError::MissingArg, parseString( "abs_pos" ));
+  ASSERT_EQ( ParseError::MissingArg, parseString( "abs_pos=" ));
+  ASSERT_EQ( ParseError::BadArg, parseString( "abs_pos=abc" ));
+  ASSERT_EQ( ParseError::BadArg, parseString( "abs_pos==100" ));
+  ASSERT_EQ( ParseError::BadArg, parseString( "rel_pos=100 200" ));
+  ASSERT_EQ( ParseError::ArgOutOfRange, parseString( "sync=3000000000" ));
+  ASSERT_EQ( CommandPacket(), cp );
+
+  // A telnet client's '\r' is fine.
+  ASSERT_EQ( ParseError::None, parseString( "abs_pos=100\r" ));
+  ASSERT_EQ( CommandPacket( Command::ABSPos, 100 ), cp );
+
+  ASSERT_STREQ( "bad argument", getErrorName( ParseError::BadArg ));
 }
 
 TEST( COMMAND_PARSER, checkForCommands)
@@ -29,48 +116,48 @@ TEST( COMMAND_PARSER, checkForCommands)
   DebugInterfaceIgnoreMock dbgmock;
 
   NetMockSimpleTimed empty;
-  ASSERT_EQ( checkForCommands(dbgmock, empty), CommandPacket() );
+  ASSERT_EQ( nextCommand( dbgmock, empty ), CommandPacket() );
 
   NetMockSimpleTimed junk("junk");
-  ASSERT_EQ( checkForCommands(dbgmock, junk), CommandPacket());
+  ASSERT_EQ( nextCommand( dbgmock, junk ), CommandPacket());
 
   NetMockSimpleTimed abort("abort");
-  ASSERT_EQ( checkForCommands(dbgmock, abort), CommandPacket( Command::Abort));
+  ASSERT_EQ( nextCommand( dbgmock, abort ), CommandPacket( Command::Abort));
 
   NetMockSimpleTimed home("hOmE");
-  ASSERT_EQ( checkForCommands(dbgmock, home), CommandPacket( Command::Home));
+  ASSERT_EQ( nextCommand( dbgmock, home ), CommandPacket( Command::Home));
 
   NetMockSimpleTimed pstatus("PStatus");
-  ASSERT_EQ( checkForCommands(dbgmock, pstatus), CommandPacket( Command::PStatus ));
+  ASSERT_EQ( nextCommand( dbgmock, pstatus ), CommandPacket( Command::PStatus ));
 
   NetMockSimpleTimed pstatus2("pStatus with training garbage");
-  ASSERT_EQ( checkForCommands(dbgmock, pstatus2), CommandPacket( Command::PStatus ));
+  ASSERT_EQ( nextCommand( dbgmock, pstatus2 ), CommandPacket( Command::PStatus ));
 
 
   NetMockSimpleTimed mstatus("mstatus");
-  ASSERT_EQ( checkForCommands(dbgmock, mstatus), CommandPacket( Command::MStatus ));
+  ASSERT_EQ( nextCommand( dbgmock, mstatus ), CommandPacket( Command::MStatus ));
 
-  // Argument defaults to 0 if not given
+  // The argument is needed
   NetMockSimpleTimed abs_pos0("ABS_POS");
-  ASSERT_EQ( checkForCommands(dbgmock, abs_pos0), CommandPacket( Command::ABSPos, 0));
+  ASSERT_EQ( nextCommand( dbgmock, abs_pos0 ), CommandPacket());
 
   NetMockSimpleTimed abs_pos1("ABS_POS=100");
-  ASSERT_EQ( checkForCommands(dbgmock, abs_pos1), CommandPacket( Command::ABSPos, 100));
+  ASSERT_EQ( nextCommand( dbgmock, abs_pos1 ), CommandPacket( Command::ABSPos, 100));
 
   NetMockSimpleTimed abs_pos2("ABS_POS 100");
-  ASSERT_EQ( checkForCommands(dbgmock, abs_pos2), CommandPacket( Command::ABSPos, 100));
+  ASSERT_EQ( nextCommand( dbgmock, abs_pos2 ), CommandPacket( Command::ABSPos, 100));
 
   // Sadly, whitespace matters
   NetMockSimpleTimed abs_pos3("ABS_POS  100");
-  ASSERT_EQ( checkForCommands(dbgmock, abs_pos3), CommandPacket( Command::ABSPos, 0));
+  ASSERT_EQ( nextCommand( dbgmock, abs_pos3 ), CommandPacket());
 
   // Negatives supported now
   NetMockSimpleTimed abs_pos4("ABS_POS -100");
-  ASSERT_EQ( checkForCommands(dbgmock, abs_pos4), CommandPacket( Command::ABSPos, -100));
+  ASSERT_EQ( nextCommand( dbgmock, abs_pos4 ), CommandPacket( Command::ABSPos, -100));
 
   // A real use case for negatives.
   NetMockSimpleTimed rel_pos("REL_POS -100");
-  ASSERT_EQ( checkForCommands(dbgmock, rel_pos), CommandPacket( Command::RELPos, -100));
+  ASSERT_EQ( nextCommand( dbgmock, rel_pos ), CommandPacket( Command::RELPos, -100));
 
 }
 
@@ -85,13 +172,13 @@ TEST( COMMAND_PARSER, testGot)
 
   // Time 0, should be a sleep
   NetMockSimpleTimed netMock( input );
-  ASSERT_EQ( checkForCommands(dbgmock, netMock ), CommandPacket( Command::Abort));
+  ASSERT_EQ( nextCommand( dbgmock, netMock ), CommandPacket( Command::Abort));
   // Time 1, should be nothing
   netMock.advanceTime(1);
-  ASSERT_EQ( checkForCommands(dbgmock, netMock ), CommandPacket());
+  ASSERT_EQ( nextCommand( dbgmock, netMock ), CommandPacket());
   // Time 2, should be a wake.
   netMock.advanceTime(1);
-  ASSERT_EQ( checkForCommands(dbgmock, netMock ), CommandPacket( Command::ABSPos, 100 ));
+  ASSERT_EQ( nextCommand( dbgmock, netMock ), CommandPacket( Command::ABSPos, 100 ));
  
   // Golden output - should have messages saying that the firmware
   // got the sleep and wake command
@@ -104,5 +191,143 @@ TEST( COMMAND_PARSER, testGot)
   ASSERT_EQ( golden, netMock.getOutput() ); 
 }
 
+TEST( COMMAND_PARSER, errorsGoBackToTheClient )
+{
+  DebugInterfaceIgnoreMock dbgmock;
+
+  TimedStringEvents input = {
+    { 0, "junk" },
+    { 1, "ABS_POS" },
+    { 2, "abs_pos=12ab" },
+    { 3, "rel_pos=-3000000000" },
+    { 4, "" },                    // Nothing to complain about
+  };
+  NetMockSimpleTimed netMock( input );
+  for ( int time = 0; time <= 4; ++time )
+  {
+    ASSERT_EQ( CommandPacket(), nextCommand( dbgmock, netMock ));
+    netMock.advanceTime( 1 );
+  }
+
+  TimedStringEvents golden = {
+    { 0, "Error: unknown command (junk)" },
+    { 1, "Error: missing argument (ABS_POS)" },
+    { 2, "Error: bad argument (abs_pos=12ab)" },
+    { 3, "Error: argument out of range (rel_pos=-3000000000)" },
+  };
+  ASSERT_EQ( golden, testFilterComments( netMock.getOutput() ));
+}
+
+TEST( COMMAND_PARSER, checkForCommandsDrainsAll )
+{
+  DebugInterfaceIgnoreMock dbgmock;
+
+  TimedStringEvents input = {
+    { 0, "pstatus" },
+    { 0, "junk" },          // Dropped
+    { 0, "abs_pos=100" },
+    { 5, "mstatus" },       // Not here yet
+  };
+  NetMockSimpleTimed netMock( input );
+  CommandQueue queue;
+
+  ASSERT_FALSE( checkForCommands( dbgmock, netMock, queue ));
+  ASSERT_EQ( 2u, queue.size() );
+  ASSERT_EQ( CommandPacket( Command::PStatus ), queue.at( 0 ));
+  ASSERT_EQ( CommandPacket( Command::ABSPos, 100 ), queue.at( 1 ));
+
+  CommandPacket cp;
+  ASSERT_TRUE( queue.pop( cp ));
+  ASSERT_EQ( CommandPacket( Command::PStatus ), cp );
+  ASSERT_TRUE( queue.pop( cp ));
+  ASSERT_FALSE( queue.pop( cp ));
+}
+
+TEST( COMMAND_PARSER, severalCommandsOnALine )
+{
+  DebugInterfaceIgnoreMock dbgmock;
+
+  TimedStringEvents input = {
+    { 0, "pstatus;mstatus; sstatus" },
+    { 0, "abs_pos=5;junk;;rel_pos 3;" },
+    { 0, "perf;perf;perf;perf;perf;caps" },
+  };
+  NetMockSimpleTimed netMock( input );
+  CommandQueue queue;
+
+  // 9 commands, so the queue is full.
+  ASSERT_TRUE( checkForCommands( dbgmock, netMock, queue ));
+
+  // Every command on a line but the last is marked moreOnLine
+  CommandPacket pstatus( Command::PStatus );
+  pstatus.moreOnLine = true;
+  CommandPacket mstatus( Command::MStatus );
+  mstatus.moreOnLine = true;
+  CommandPacket absPos( Command::ABSPos, 5 );
+  absPos.moreOnLine = true;
+  CommandPacket perf( Command::Perf );
+  perf.moreOnLine = true;
+  const std::vector<CommandPacket> golden = {
+    pstatus, mstatus, CommandPacket( Command::SStatus ),
+    absPos, CommandPacket( Command::RELPos, 3 ),
+    perf, perf, perf, CommandPacket( Command::Perf ),
+  };
+  std::vector<CommandPacket> got;
+  CommandPacket cp;
+  while ( queue.pop( cp ))
+  {
+    got.push_back( cp );
+  }
+  ASSERT_EQ( golden, got );
+
+  TimedStringEvents goldenNet = {
+    { 0, "Error: unknown command (junk)" },
+    { 0, "Error: too many commands (perf;caps)" },
+  };
+  ASSERT_EQ( goldenNet, testFilterComments( netMock.getOutput() ));
+}
+
+/// @brief The last line taken always fits, even in a nearly full queue
+TEST( COMMAND_PARSER, lineFitsInNearlyFullQueue )
+{
+  DebugInterfaceIgnoreMock dbgmock;
+
+  TimedStringEvents input;
+  for ( std::size_t i = 0; i < CommandQueue::capacity - 1; ++i )
+  {
+    input.push_back( { 0, "pstatus" } );
+  }
+  input.push_back( { 0, "mstatus;mstatus;mstatus;mstatus" } );
+  input.push_back( { 0, "sstatus" } );
+  NetMockSimpleTimed netMock( input );
+  CommandQueue queue;
+
+  ASSERT_TRUE( checkForCommands( dbgmock, netMock, queue ));
+  ASSERT_EQ( CommandQueue::capacity + 3, queue.size() );
+  ASSERT_EQ( Command::MStatus, queue.at( queue.size() - 1 ).command );
+}
+
+TEST( COMMAND_PARSER, checkForCommandsStopsWhenFull )
+{
+  DebugInterfaceIgnoreMock dbgmock;
+
+  TimedStringEvents input;
+  for ( std::size_t i = 0; i < CommandQueue::capacity + 1; ++i )
+  {
+    input.push_back( { 0, "pstatus" } );
+  }
+  NetMockSimpleTimed netMock( input );
+  CommandQueue queue;
+
+  // Full, so there may be more waiting.  The extra line stays put.
+  ASSERT_TRUE( checkForCommands( dbgmock, netMock, queue ));
+  ASSERT_TRUE( queue.full() );
+
+  CommandPacket cp;
+  while ( queue.pop( cp ));
+  ASSERT_FALSE( checkForCommands( dbgmock, netMock, queue ));
+  ASSERT_EQ( 1u, queue.size() );
+}
+
 }
 
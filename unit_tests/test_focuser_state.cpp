@@ -1,10 +1,37 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <vector>
 
+#include "binary_protocol.h"
 #include "focuser_state.h"
 #include "test_mock_debug.h"
 #include "test_mock_event.h"
 #include "test_mock_hardware.h"
 #include "test_mock_net.h"
+#include "sim_runner.h"
+#include "step_queue.h"
+#include "trace_decode.h"
+
+/// @brief Number of calls to the global operator new
+///
+/// Used by the noHeapAllocationsHomeAndMove test.
+///
+static unsigned long allocationCount = 0;
+
+void* operator new( std::size_t size )
+{
+  ++allocationCount;
+  void* p = std::malloc( size ? size : 1 );
+  if ( p == nullptr ) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete( void* p ) noexcept
+{
+  std::free( p );
+}
 
 HWTimedEvents goldenHWStart = {
   {  0, { HWI::Pin::STEP,       HWI::PinIOMode::M_OUTPUT     } },
@@ -21,22 +48,30 @@ std::unique_ptr<FS::Focuser> make_focuser(
   const TimedStringEvents& wifiIn,
   const HWTimedEvents& hwIn,
   NetMockSimpleTimed* &net_interface,
-  HWMockTimed* &hw_interface
+  HWMockTimed* &hw_interface,
+  VirtualClock* &clock_interface,
+  bool hasStepQueue = false,
+  bool netCanWait = false,
+  FS::Build build = FS::Build::UNIT_TEST_BUILD_HYPERSTAR
 )
 {
-  std::unique_ptr<NetMockSimpleTimed> wifi( new NetMockSimpleTimed( wifiIn ));
+  std::unique_ptr<NetMockSimpleTimed> wifi( 
+    new NetMockSimpleTimed( wifiIn, netCanWait ));
   std::unique_ptr<DebugInterfaceIgnoreMock> debug( new DebugInterfaceIgnoreMock);
-  std::unique_ptr<HWMockTimed> hardware( new HWMockTimed( hwIn ));
+  std::unique_ptr<VirtualClock> clock( new VirtualClock );
+  std::unique_ptr<HWMockTimed> hardware( new HWMockTimed( hwIn, hasStepQueue ));
   
   net_interface = wifi.get();
   hw_interface = hardware.get();
+  clock_interface = clock.get();
 
-  FS::BuildParams params( FS::Build::UNIT_TEST_BUILD_HYPERSTAR );
+  FS::BuildParams params( build );
 
   auto focuser = std::unique_ptr<FS::Focuser>(
      new FS::Focuser(
         std::move(wifi),
         std::move(hardware),
+        std::move(clock),
         std::move(debug),
         params )
   );
@@ -46,75 +81,487 @@ std::unique_ptr<FS::Focuser> make_focuser(
 
 /// @brief Simulate the focuser
 ///
+/// Runs in virtual time with a SimRunner.  If the network mock can wait
+/// for input, an idle focuser jumps straight to the next input event.
+///
 /// @param[out] Focuser  - A pointer to the focuser.
 /// @param[in] wifiAlisa - A pointer to the WIFI/ Network Mock
+/// @param[in] clockAlias - A pointer to the virtual clock
 /// @param[in] end_time  - How long (in MS) to run the focuser for.
 /// 
 void simulateFocuser( 
   FS::Focuser* focuser,
   NetMockSimpleTimed* wifiAlias,
   HWMockTimed* hwMockAlias,
+  VirtualClock* clockAlias,
   unsigned int endTime
 )
 {
-  unsigned int time = 0;
-  unsigned int lastMockAdvanceTime = 0;
-  while ( time < endTime*1000 )
+  SimRunner runner( *focuser );
+  runner.add( *clockAlias );
+  runner.add( *wifiAlias );
+  runner.add( *hwMockAlias );
+  runner.runUntil( endTime * 1000ull );
+}
+
+/// @brief Spot check the interrupt table
+///
+/// Completeness and order of the table are checked at compile time.
+///
+TEST( FOCUSER_STATE, commandInterruptStatus )
+{
+  ASSERT_TRUE( FS::doesCommandInterrupt( CommandParser::Command::Abort ));
+  ASSERT_TRUE( FS::doesCommandInterrupt( CommandParser::Command::ABSPos ));
+  ASSERT_FALSE( FS::doesCommandInterrupt( CommandParser::Command::PStatus ));
+  ASSERT_FALSE( FS::doesCommandInterrupt( CommandParser::Command::NoCommand ));
+  ASSERT_TRUE( FS::doesCommandReplaceMotion( CommandParser::Command::Home ));
+  ASSERT_FALSE( FS::doesCommandReplaceMotion( CommandParser::Command::Sync ));
+}
+
+TEST( FOCUSER_STATE, allStatesHaveDebugNames )
+{
+  for ( FS::State s = FS::State::START_OF_STATES;
+        s < FS::State::END_OF_STATES; ++s )
   {
-    time = time + focuser->loop();
-    unsigned int mockAdvanceTime = time/1000;
-    wifiAlias->advanceTime( mockAdvanceTime - lastMockAdvanceTime );
-    hwMockAlias->advanceTime( mockAdvanceTime - lastMockAdvanceTime );
-    lastMockAdvanceTime = mockAdvanceTime;
+    ASSERT_NE( 
+      FS::stateNames.find( s ),
+      FS::stateNames.end());
   }
+} 
+
+
+/// @brief A step burst alternates active and inactive edges
+///
+TEST( FOCUSER_STATE, stepBurstEdges )
+{
+  MotionPlanner planner( 31, 0, 0, 0 );
+  FS::StepBurst burst( planner );
+  ASSERT_TRUE( burst.isDone() );
+
+  burst.start( 2 );
+  ASSERT_EQ( HWI::PinState::STEP_ACTIVE,    burst.nextEdge() );
+  ASSERT_EQ( 31u, burst.getPause() );
+  ASSERT_EQ( HWI::PinState::STEP_INACTIVE,  burst.nextEdge() );
+  ASSERT_FALSE( burst.isDone() );
+  ASSERT_EQ( HWI::PinState::STEP_ACTIVE,    burst.nextEdge() );
+  ASSERT_EQ( HWI::PinState::STEP_INACTIVE,  burst.nextEdge() );
+  ASSERT_TRUE( burst.isDone() );
 }
 
-TEST( FOCUSER_STATE, allCommandsHaveInterruptStatus)
+/// @brief Pushing past the depth bound leaves an error on top
+///
+TEST( FOCUSER_STATE, stateStackOverflow )
 {
-  for ( CommandParser::Command c = CommandParser::Command::StartOfCommands;
-        c < CommandParser::Command::EndOfCommands; ++c )
+  FS::StateStack stack;
+  ASSERT_EQ( 1u, stack.size() );
+  ASSERT_EQ( FS::State::ACCEPT_COMMANDS, stack.topState() );
+
+  while ( stack.size() < FS::StateStack::maxDepth )
   {
-    ASSERT_NE( FS::doesCommandInterrupt.find( c ),
-               FS::doesCommandInterrupt.end());
+    stack.push( FS::State::MOVING, 100 );
   }
+  ASSERT_EQ( FS::State::MOVING, stack.topState() );
+
+  stack.push( FS::State::DO_STEPS, 1 );
+  ASSERT_EQ( FS::State::ERROR_STATE, stack.topState() );
+  ASSERT_EQ( FS::StateStack::capacity, stack.size() );
+
+  stack.push( FS::State::DO_STEPS, 1 );
+  ASSERT_EQ( FS::State::ERROR_STATE, stack.topState() );
+  ASSERT_EQ( FS::StateStack::capacity, stack.size() );
+
+  stack.reset();
+  ASSERT_EQ( 1u, stack.size() );
+  ASSERT_EQ( FS::State::ACCEPT_COMMANDS, stack.topState() );
 }
 
-namespace FS {
+/// @brief Network mock that doesn't allocate
+///
+/// Returns one pending input string, set by the test, and throws away
+/// all output.
+///
+class NetMockNoAlloc: public NetInterface
+{
+  public:
+
+  NetMockNoAlloc() : input{ nullptr } {}
+
+  void setup( DebugInterface& debugLog ) override { (void) debugLog; }
+
+  bool getString( WifiDebugOstream& log, std::string& string ) override
+  {
+    (void) log;
+    if ( input == nullptr ) return false;
+    string = input;
+    input = nullptr;
+    return true;
+  }
+
+  std::streamsize write( const char_type* s, std::streamsize n ) override
+  {
+    (void) s;
+    return n;
+  }
+
+  void flush() override {}
+
+  /// @brief Input returned by the next getString
+  const char* input;
+};
+
+/// @brief Hardware mock that doesn't allocate
+///
+/// Tracks the stepper's position.  The home input goes active once the
+/// stepper has backed up homeAt steps.
+///
+class HWMockNoAlloc: public HWI
+{
+  public:
+
+  HWMockNoAlloc( int homeAtArg ) : 
+    homeAt{ homeAtArg }, position{ 0 }, forward{ true } {}
+
+  void DigitalWrite( Pin pin, PinState state ) override
+  {
+    if ( pin == Pin::DIR ) forward = ( state == PinState::DIR_FORWARD );
+    if ( pin == Pin::STEP && state == PinState::STEP_ACTIVE ) 
+    {
+      position += forward ? 1 : -1;
+    }
+  }
+
+  void PinMode( Pin pin, PinIOMode mode ) override
+  {
+    (void) pin;
+    (void) mode;
+  }
+
+  PinState DigitalRead( Pin pin ) override
+  {
+    (void) pin;
+    return position <= -homeAt ? PinState::HOME_ACTIVE : PinState::HOME_INACTIVE;
+  }
+
+  const int homeAt;
+  int position;
+  bool forward;
+};
 
-TEST( FOCUSER_STATE, allCommandsHaveImplementations )
+/// @brief The focuser shouldn't touch the heap once it's running
+///
+/// Counts calls to the global operator new across a home followed by 
+/// a move.  Allocations while the focuser is constructed don't count.
+///
+TEST( FOCUSER_STATE, noHeapAllocationsHomeAndMove )
 {
-  for ( CommandParser::Command c = CommandParser::Command::StartOfCommands;
-        c < CommandParser::Command::EndOfCommands; ::operator++(c) )
+  std::unique_ptr<NetMockNoAlloc> wifi( new NetMockNoAlloc );
+  std::unique_ptr<HWMockNoAlloc> hardware( new HWMockNoAlloc( 50 ));
+  std::unique_ptr<VirtualClock> clock( new VirtualClock );
+  std::unique_ptr<DebugInterfaceIgnoreMock> debug( new DebugInterfaceIgnoreMock);
+  NetMockNoAlloc* net = wifi.get();
+  HWMockNoAlloc* hw = hardware.get();
+  VirtualClock* clockAlias = clock.get();
+
+  FS::Focuser focuser( 
+    std::move(wifi), 
+    std::move(hardware), 
+    std::move(clock), 
+    std::move(debug), 
+    FS::BuildParams( FS::Build::UNIT_TEST_BUILD_HYPERSTAR ));
+
+  allocationCount = 0;
+
+  net->input = "home";
+  for ( int i = 0; i < 5000; ++i )
   {
-    ASSERT_NE( 
-      FS::Focuser::commandImpl.find( c ),
-      FS::Focuser::commandImpl.end());
+    clockAlias->setTime( clockAlias->uSecNow() + focuser.loop() );
+  }
+  ASSERT_EQ( -50, hw->position );
+
+  net->input = "abs_pos=100";
+  for ( int i = 0; i < 5000; ++i )
+  {
+    clockAlias->setTime( clockAlias->uSecNow() + focuser.loop() );
   }
+  ASSERT_EQ( 50, hw->position );
+
+  ASSERT_EQ( 0u, allocationCount );
 }
- 
-TEST( FOCUSER_STATE, allStatesHaveImplementations )
+
+/// @brief StepQueue is first in, first out and refuses edges when full
+///
+TEST( FOCUSER_STATE, stepQueueFifo )
 {
-  for ( FS::State s = FS::State::START_OF_STATES;
-        s < FS::State::END_OF_STATES; ++s )
+  StepQueue<2> queue;
+  HWI::QueuedEdge edge;
+  ASSERT_TRUE( queue.empty() );
+  ASSERT_FALSE( queue.pop( edge ));
+
+  ASSERT_TRUE( queue.push( { HWI::Pin::DIR,  HWI::PinState::DIR_FORWARD, 10 } ));
+  ASSERT_TRUE( queue.push( { HWI::Pin::STEP, HWI::PinState::STEP_ACTIVE, 20 } ));
+  ASSERT_EQ( 0u, queue.space() );
+  ASSERT_FALSE( queue.push( { HWI::Pin::STEP, HWI::PinState::STEP_INACTIVE, 30 } ));
+
+  ASSERT_TRUE( queue.pop( edge ));
+  ASSERT_EQ( HWI::Pin::DIR, edge.pin );
+  ASSERT_EQ( 10u, edge.uSecPause );
+  ASSERT_TRUE( queue.push( { HWI::Pin::STEP, HWI::PinState::STEP_INACTIVE, 30 } ));
+  ASSERT_TRUE( queue.pop( edge ));
+  ASSERT_EQ( HWI::PinState::STEP_ACTIVE, edge.state );
+  ASSERT_TRUE( queue.pop( edge ));
+  ASSERT_EQ( HWI::PinState::STEP_INACTIVE, edge.state );
+  ASSERT_TRUE( queue.empty() );
+}
+
+/// @brief Run a session with and without a step queue.  The hardware 
+///        and network output should be the same.
+///
+void expectStepQueueMatchesDirect( 
+  const TimedStringEvents& netInput,
+  const HWTimedEvents& hwInput 
+)
+{
+  NetMockSimpleTimed* directWifi;
+  HWMockTimed* directHW;
+  VirtualClock* directClock;
+  auto direct = make_focuser( netInput, hwInput, directWifi, directHW, 
+                             directClock );
+  simulateFocuser( direct.get(), directWifi, directHW, directClock, 1000 );
+
+  NetMockSimpleTimed* queuedWifi;
+  HWMockTimed* queuedHW;
+  VirtualClock* queuedClock;
+  auto queued = make_focuser( netInput, hwInput, queuedWifi, queuedHW, 
+                             queuedClock, true );
+  simulateFocuser( queued.get(), queuedWifi, queuedHW, queuedClock, 1000 );
+
+  EXPECT_EQ( directHW->getOutEvents(), queuedHW->getOutEvents() );
+  EXPECT_EQ( testFilterComments( directWifi->getOutput() ), 
+             testFilterComments( queuedWifi->getOutput() ));
+}
+
+TEST( FOCUSER_STATE, stepQueueMoveMatchesDirect )
+{
+  TimedStringEvents netInput = {
+    { 10, "abs_pos=3" },      // Forward 3 steps
+    { 50, "abs_pos=2" },      // Reverse, then backlash correction
+    { 80, "pstatus" },
+  };
+
+  HWTimedEvents hwInput= {
+    { 0,  { HWI::Pin::HOME,        HWI::PinState::HOME_INACTIVE} },
+  };
+
+  expectStepQueueMatchesDirect( netInput, hwInput );
+}
+
+TEST( FOCUSER_STATE, stepQueueHomeMatchesDirect )
+{
+  TimedStringEvents netInput = {
+    { 10, "home" },           
+    { 20, "sstatus" },        
+    { 30, "abs_pos=1" },      
+    { 40, "pstatus" },        
+  };
+
+  HWTimedEvents hwInput= {
+    { 0,  { HWI::Pin::HOME,        HWI::PinState::HOME_INACTIVE} },
+    { 18, { HWI::Pin::HOME,        HWI::PinState::HOME_ACTIVE } },
+  }; 
+
+  expectStepQueueMatchesDirect( netInput, hwInput );
+}
+
+/// @brief Where the hardware's steps took the motor, from its output
+int hardwarePosition( const HWTimedEvents& events )
+{
+  int position = 0;
+  int stepSign = 1;
+  for ( const HWTimedEvent& timed : events )
   {
-    ASSERT_NE( 
-      FS::Focuser::stateImpl.find( s ),
-      FS::Focuser::stateImpl.end());
+    const HWEvent& event = timed.event;
+    if ( !event.isIO() ) continue;
+    if ( event.getPin() == HWI::Pin::DIR &&
+         event.getIO() == HWI::PinState::DIR_FORWARD ) stepSign = 1;
+    if ( event.getPin() == HWI::Pin::DIR &&
+         event.getIO() == HWI::PinState::DIR_BACKWARD ) stepSign = -1;
+    if ( event.getPin() == HWI::Pin::STEP &&
+         event.getIO() == HWI::PinState::STEP_ACTIVE ) position += stepSign;
   }
-} 
+  return position;
 }
 
-TEST( FOCUSER_STATE, allStatesHaveDebugNames )
+/// @brief When each of the hardware's steps happened, from its output
+std::vector<int> stepTimes( const HWTimedEvents& events )
 {
-  for ( FS::State s = FS::State::START_OF_STATES;
-        s < FS::State::END_OF_STATES; ++s )
+  std::vector<int> times;
+  for ( const HWTimedEvent& timed : events )
   {
-    ASSERT_NE( 
-      FS::stateNames.find( s ),
-      FS::stateNames.end());
+    if ( timed.event.isIO() && timed.event.getPin() == HWI::Pin::STEP &&
+         timed.event.getIO() == HWI::PinState::STEP_ACTIVE )
+    {
+      times.push_back( timed.time );
+    }
   }
-} 
+  return times;
+}
+
+/// @brief A reverse that finds the step queue full waits for room
+///
+/// The queue's timer stalls while the first burst fills the queue, and
+/// the reverse comes in before the timer restarts.  Writing DIR straight
+/// away would run the queued steps backwards.
+///
+TEST( FOCUSER_STATE, stepQueueFullDelaysReverse )
+{
+  TimedStringEvents netInput = {
+    { 10, "abs_pos=20" },
+    { 12, "abs_pos=1" },
+    { 150, "pstatus" },
+  };
+
+  HWTimedEvents hwInput= {
+    { 0,  { HWI::Pin::HOME,        HWI::PinState::HOME_INACTIVE} },
+  };
+
+  NetMockSimpleTimed* wifiAlias;
+  HWMockTimed* hwMockAlias;
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias, true );
+  hwMockAlias->setStepQueueLimit( 4 );
+  hwMockAlias->stallStepQueue( 40 );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 200 );
+
+  ASSERT_EQ( 1, hardwarePosition( hwMockAlias->getOutEvents() ));
+  const TimedStringEvents output = testFilterComments( wifiAlias->getOutput() );
+  ASSERT_FALSE( output.empty() );
+  ASSERT_EQ( "Position: 1", output.back().event );
+}
+
+/// @brief Queued steps keep playing while the loop is called late
+///
+/// Every third pause the focuser asks for runs 3ms long, as if WiFi
+/// held the loop up.  The step queue should have enough queued to cover
+/// for it, so the steps play back a step apart with no gaps.
+///
+TEST( FOCUSER_STATE, stepQueueCoversLateLoop )
+{
+  TimedStringEvents netInput = {
+    { 10, "abs_pos=40" },
+  };
+
+  HWTimedEvents hwInput= {
+    { 0,  { HWI::Pin::HOME,        HWI::PinState::HOME_INACTIVE} },
+  };
+
+  NetMockSimpleTimed* wifiAlias;
+  HWMockTimed* hwMockAlias;
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias, true );
+
+  const unsigned int uSecLate = 3000;
+  unsigned int wakes = 0;
+  uint64_t uSecNow = 0;
+  while ( uSecNow < 300 * 1000 )
+  {
+    const unsigned int uSecPause = focuser->loop();
+    if ( uSecPause != 0 )
+    {
+      ++wakes;
+      uSecNow += uSecPause + ( wakes % 3 == 0 ? uSecLate : 0 );
+    }
+    clockAlias->advanceTo( uSecNow );
+    wifiAlias->advanceTo( uSecNow );
+    hwMockAlias->advanceTo( uSecNow );
+  }
+
+  const std::vector<int> times = stepTimes( hwMockAlias->getOutEvents() );
+  ASSERT_EQ( 40u, times.size() );
+  for ( std::size_t i = 1; i < times.size(); ++i )
+  {
+    // A step is two edges, a step pause apart.
+    ASSERT_EQ( 2, times[i] - times[i-1] ) << "Gap before step " << i;
+  }
+}
+
+/// @brief An interrupted move slows down before the motor stops
+///
+/// The hyperstar build ramps up to cruise speed.  An abort part way
+/// through the move takes the steps it needs to get back to the
+/// start-from-rest speed, so the steps after it only ever get further
+/// apart, and the last is a start-from-rest step.
+///
+TEST( FOCUSER_STATE, interruptRampsDown )
+{
+  TimedStringEvents netInput = {
+    { 10,   "abs_pos=5000" },
+    { 1500, "abort" },
+  };
+
+  HWTimedEvents hwInput= {
+    { 0,  { HWI::Pin::HOME,        HWI::PinState::HOME_INACTIVE} },
+  };
+
+  NetMockSimpleTimed* wifiAlias;
+  HWMockTimed* hwMockAlias;
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+    clockAlias, false, false, FS::Build::LOW_POWER_HYPERSTAR_FOCUSER );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 4000 );
+
+  // Count the steps in each 50ms after the abort's been seen.  The
+  // count should only go down.
+  const std::vector<int> times = stepTimes( hwMockAlias->getOutEvents() );
+  ASSERT_GT( times.back(), 1700 );
+  std::vector<int> stepsPer50ms;
+  for ( int t : times )
+  {
+    if ( t < 1600 ) continue;
+    const std::size_t window = ( t - 1600 ) / 50;
+    stepsPer50ms.resize( std::max( stepsPer50ms.size(), window + 1 ));
+    ++stepsPer50ms[ window ];
+  }
+  for ( std::size_t i = 1; i < stepsPer50ms.size(); ++i )
+  {
+    ASSERT_LE( stepsPer50ms[i], stepsPer50ms[i-1] ) << "Window " << i;
+  }
+
+  // The last step is from rest - two 1000us pauses after the one before.
+  ASSERT_EQ( 2, times[ times.size() - 1 ] - times[ times.size() - 2 ] );
+}
+
+/// @brief Homing stays at the start-from-rest speed
+///
+/// The home switch could be the next step, so the hyperstar build
+/// doesn't speed up while it looks for it.
+///
+TEST( FOCUSER_STATE, homeAtStartSpeed )
+{
+  TimedStringEvents netInput = {
+    { 10,   "home" },
+  };
+
+  HWTimedEvents hwInput= {
+    { 0,    { HWI::Pin::HOME,        HWI::PinState::HOME_INACTIVE} },
+    { 1500, { HWI::Pin::HOME,        HWI::PinState::HOME_ACTIVE} },
+  };
 
+  NetMockSimpleTimed* wifiAlias;
+  HWMockTimed* hwMockAlias;
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+    clockAlias, false, false, FS::Build::LOW_POWER_HYPERSTAR_FOCUSER );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 2000 );
+
+  const std::vector<int> times = stepTimes( hwMockAlias->getOutEvents() );
+  ASSERT_GT( times.size(), 100u );
+  for ( std::size_t i = 1; i < times.size(); ++i )
+  {
+    ASSERT_EQ( 2, times[i] - times[i-1] ) << "Step " << i;
+  }
+}
 
 /// @brief Init the focuser
 ///
@@ -128,8 +575,10 @@ TEST( FOCUSER_STATE, init_Focuser )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     { 0, "# Motor set on" },
@@ -157,8 +606,10 @@ TEST( FOCUSER_STATE, run_status)
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     {  0, "State: ACCEPTING_COMMANDS NoArg"},
@@ -171,6 +622,34 @@ TEST( FOCUSER_STATE, run_status)
   ASSERT_EQ( goldenHWStart, hwMockAlias->getOutEvents() );
 }
 
+/// @brief Several commands on a line are answered with one line
+TEST( FOCUSER_STATE, multiCommandLine )
+{
+  TimedStringEvents netInput = {
+    { 0,   "pstatus;mstatus;sstatus" },
+    { 50,  "abs_pos=3; pstatus" },      // abs_pos has no reply
+    { 100, "pstatus;junk" },
+  };
+  HWTimedEvents hwInput= {
+    { 0,  { HWI::Pin::HOME,        HWI::PinState::HOME_INACTIVE} },
+  };
+
+  NetMockSimpleTimed* wifiAlias;
+  HWMockTimed* hwMockAlias;
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
+
+  TimedStringEvents goldenNet = {
+    {   0, "Position: 0; State: ACCEPTING_COMMANDS NoArg; Synched: NO" },
+    {  50, "Position: 0" },
+    { 100, "Error: unknown command (junk)" },
+    { 100, "Position: 3" },
+  };
+  ASSERT_EQ( goldenNet, testFilterComments(wifiAlias->getOutput() ));
+}
+
 ///
 /// @brief A basic absolute position command test
 ///
@@ -189,8 +668,10 @@ TEST( FOCUSER_STATE, run_abs_pos )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet;
 
@@ -230,8 +711,10 @@ TEST( FOCUSER_STATE, run_rel_pos)
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet;
 
@@ -273,8 +756,10 @@ TEST( FOCUSER_STATE, run_abs_pos_negative )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   // Should go back 1, to 0, then stop.  -3 is right now.
   TimedStringEvents goldenNet;
@@ -313,8 +798,10 @@ TEST( FOCUSER_STATE, run_abs_pos_double_forward )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet;
 
@@ -356,8 +843,10 @@ TEST( FOCUSER_STATE, run_abs_pos_with_backlash_correction )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet;
 
@@ -405,8 +894,10 @@ TEST( FOCUSER_STATE, home_focuser )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     {  0, "Synched: NO" },
@@ -454,8 +945,10 @@ TEST( FOCUSER_STATE, lazy_home_focuser )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     {  0, "Synched: NO" },
@@ -501,8 +994,10 @@ TEST( FOCUSER_STATE, lazy_home_should_be_lazy )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     {  0, "Synched: NO" },
@@ -531,8 +1026,10 @@ TEST( FOCUSER_STATE, sync_focuser )
   HWTimedEvents hwInput;
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     {  0, "Synched: NO" },
@@ -560,8 +1057,10 @@ TEST( FOCUSER_STATE, mstatus_while_moving )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   HWTimedEvents goldenHW = {
     { 10, { HWI::Pin::STEP,       HWI::PinState::STEP_ACTIVE} },
@@ -584,7 +1083,7 @@ TEST( FOCUSER_STATE, mstatus_while_moving )
   TimedStringEvents goldenNet = {
     { 14, "State: MOVING 7" },
     { 18, "Synched: NO" },
-    { 22, "Position: 6" }
+    { 18, "Position: 4" }       // Taken with sstatus, between step bursts
   };
 
   ASSERT_EQ( goldenNet, testFilterComments(wifiAlias->getOutput() ));
@@ -604,8 +1103,10 @@ TEST( FOCUSER_STATE, abort_while_moving )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   HWTimedEvents goldenHW = {
     { 10, { HWI::Pin::STEP,       HWI::PinState::STEP_ACTIVE} },
@@ -633,7 +1134,7 @@ TEST( FOCUSER_STATE, sync_while_moving )
   TimedStringEvents netInput = {
     { 10, "abs_pos=7" },        // Start the focuser moving
     { 15, "sync=100" },         // Actually, just sync it.
-    { 16, "mstatus" },          // What state are we in?
+    { 16, "mstatus" },          // Taken with sync, before its move ends
     { 20, "pstatus" },          // Where did we end up?
   };
 
@@ -641,8 +1142,10 @@ TEST( FOCUSER_STATE, sync_while_moving )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   HWTimedEvents goldenHW = {
     { 10, { HWI::Pin::STEP,       HWI::PinState::STEP_ACTIVE} },
@@ -657,7 +1160,7 @@ TEST( FOCUSER_STATE, sync_while_moving )
 
   goldenHW.insert( goldenHW.begin(), goldenHWStart.begin(), goldenHWStart.end());
   TimedStringEvents goldenNet = {
-    { 18, "State: ACCEPTING_COMMANDS NoArg" },
+    { 18, "State: MOVING 100" },
     { 20, "Position: 100" }
   };
 
@@ -683,8 +1186,10 @@ TEST( FOCUSER_STATE, abort_while_homing )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     {  0, "Synched: NO" },
@@ -728,8 +1233,10 @@ TEST( FOCUSER_STATE, sync_while_homing )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     {  0, "Synched: NO" },
@@ -770,8 +1277,10 @@ TEST( FOCUSER_STATE, new_move_while_moving )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   HWTimedEvents goldenHW = {
     { 10, { HWI::Pin::STEP,       HWI::PinState::STEP_ACTIVE} },
@@ -813,8 +1322,10 @@ TEST( FOCUSER_STATE, new_move_while_homing )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     {  0, "Synched: NO" },
@@ -853,6 +1364,138 @@ TEST( FOCUSER_STATE, new_move_while_homing )
 }
 
 
+/// @brief Queries that arrive together are answered together
+///
+/// The move has 2 steps between checks, so answering one query per
+/// check would spread the answers out over three step bursts.
+///
+TEST( FOCUSER_STATE, queriesWhileMovingAnsweredTogether )
+{
+  TimedStringEvents netInput = {
+    { 10, "abs_pos=7" },        // Start the focuser moving
+    { 11, "pstatus" },          // All three are waiting at the next check
+    { 11, "mstatus" },
+    { 11, "sstatus" },
+  };
+
+  HWTimedEvents hwInput;
+
+  NetMockSimpleTimed* wifiAlias;
+  HWMockTimed* hwMockAlias;
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
+
+  TimedStringEvents goldenNet = {
+    { 14, "Position: 2" },
+    { 14, "State: MOVING 7" },
+    { 14, "Synched: NO" },
+  };
+
+  ASSERT_EQ( goldenNet, testFilterComments(wifiAlias->getOutput() ));
+}
+
+/// @brief When interrupting commands arrive together, the last one wins
+///
+/// The ones it replaced get an error, so their clients know.
+///
+TEST( FOCUSER_STATE, lastInterruptWins )
+{
+  TimedStringEvents netInput = {
+    { 10, "home" },             // Never happens
+    { 10, "abs_pos=2" },        // Never happens
+    { 10, "pstatus" },          // Answered before the move starts
+    { 10, "abs_pos=1" },        // The move we get
+    { 10, "mstatus" },          // Sees the new move
+  };
+
+  HWTimedEvents hwInput= {
+    { 0,  { HWI::Pin::HOME,        HWI::PinState::HOME_INACTIVE} },
+  };
+
+  NetMockSimpleTimed* wifiAlias;
+  HWMockTimed* hwMockAlias;
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 100 );
+
+  HWTimedEvents goldenHW = {
+    { 10, { HWI::Pin::STEP,       HWI::PinState::STEP_ACTIVE} },
+    { 11, { HWI::Pin::STEP,       HWI::PinState::STEP_INACTIVE} },
+  };
+  goldenHW.insert( goldenHW.begin(), goldenHWStart.begin(), goldenHWStart.end());
+
+  TimedStringEvents goldenNet = {
+    { 10, "Error: replaced by a later command (home)" },
+    { 10, "Error: replaced by a later command (abs_pos)" },
+    { 10, "Position: 0" },
+    { 10, "State: MOVING 1" },
+  };
+
+  ASSERT_EQ( goldenNet, testFilterComments(wifiAlias->getOutput() ));
+  ASSERT_EQ( goldenHW, hwMockAlias->getOutEvents() );
+}
+
+/// @brief A move replaced by a later command on its line gets an error
+///
+/// The error goes on the line with the rest of the line's replies.
+///
+TEST( FOCUSER_STATE, twoInterruptsOnALine )
+{
+  TimedStringEvents netInput = {
+    { 10, "abs_pos=5;pstatus;abs_pos=1" },
+  };
+
+  HWTimedEvents hwInput= {
+    { 0,  { HWI::Pin::HOME,        HWI::PinState::HOME_INACTIVE} },
+  };
+
+  NetMockSimpleTimed* wifiAlias;
+  HWMockTimed* hwMockAlias;
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 100 );
+
+  TimedStringEvents goldenNet = {
+    { 10, "Error: replaced by a later command (abs_pos); Position: 0" },
+  };
+  ASSERT_EQ( goldenNet, testFilterComments(wifiAlias->getOutput() ));
+  ASSERT_EQ( 1, hardwarePosition( hwMockAlias->getOutEvents() ));
+}
+
+/// @brief A sync is never dropped for a later interrupting command
+///
+TEST( FOCUSER_STATE, syncThenMoveInOnePoll )
+{
+  TimedStringEvents netInput = {
+    { 10, "sync=100" },         // Sets the position the move starts from
+    { 10, "abs_pos=103" },      // Three steps forward
+    { 50, "pstatus" },
+    { 50, "sstatus" },
+  };
+
+  HWTimedEvents hwInput= {
+    { 0,  { HWI::Pin::HOME,        HWI::PinState::HOME_INACTIVE} },
+  };
+
+  NetMockSimpleTimed* wifiAlias;
+  HWMockTimed* hwMockAlias;
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 100 );
+
+  TimedStringEvents goldenNet = {
+    { 50, "Position: 103" },
+    { 50, "Synched: YES" },
+  };
+  ASSERT_EQ( goldenNet, testFilterComments(wifiAlias->getOutput() ));
+  ASSERT_EQ( 3, hardwarePosition( hwMockAlias->getOutEvents() ));
+}
+
 TEST( FOCUSER_STATE, new_home_while_moving )
 {
   TimedStringEvents netInput = {
@@ -872,8 +1515,10 @@ TEST( FOCUSER_STATE, new_home_while_moving )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   HWTimedEvents goldenHW = {
     { 10, { HWI::Pin::STEP,       HWI::PinState::STEP_ACTIVE} },
@@ -923,8 +1568,10 @@ TEST( FOCUSER_STATE, new_home_while_homing )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   HWTimedEvents goldenHW = {
     { 10, { HWI::Pin::DIR,        HWI::PinState::DIR_BACKWARD } },
@@ -969,8 +1616,10 @@ TEST( FOCUSER_STATE, interrupt_during_backlash_correction )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet;
 
@@ -1010,7 +1659,7 @@ TEST( FOCUSER_STATE, enterSleepModeAndWake )
     { 1500, "sstatus" },          // Should also happen at 1500
     { 1501, "mstatus" },          // Should happen at 2000
     { 2001, "abs_pos=2" },        // Should happen at 2500
-    { 2500, "mstatus" },
+    { 2500, "mstatus" },          // Taken with abs_pos
     { 4200, "abort" },            // should cause a wake @ 4500
     { 5600, "home" },             // should cause a wake @ 6000
   };
@@ -1022,8 +1671,10 @@ TEST( FOCUSER_STATE, enterSleepModeAndWake )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 10000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 10000 );
 
   TimedStringEvents goldenNet = {
     { 50,   "State: MOVING 1"},
@@ -1034,7 +1685,7 @@ TEST( FOCUSER_STATE, enterSleepModeAndWake )
     { 1500, "Position: 1" },
     { 1500, "Synched: NO" },
     { 2000, "State: LOW_POWER NoArg" },
-    { 2700, "State: MOVING 2" },
+    { 2500, "State: MOVING 2" },
   };
 
   HWTimedEvents goldenHW = {
@@ -1063,6 +1714,108 @@ TEST( FOCUSER_STATE, enterSleepModeAndWake )
   ASSERT_EQ( goldenNet, testFilterComments(wifiAlias->getOutput() ));
 }
 
+/// @brief An idle focuser that can wait for input answers right away
+///
+/// Compare to enterSleepModeAndWake, where commands wait for the next
+/// 10ms (awake) or 500ms (asleep) epoch.
+///
+TEST( FOCUSER_STATE, ticklessIdle )
+{
+  TimedStringEvents netInput = {
+    { 5,    "pstatus" },          // Answered right away
+    { 15,   "abs_pos=1" },        // Starts right away
+    { 1000, "mstatus" },          // Still awake
+    { 1200, "mstatus" },          // Asleep at 1016
+    { 1300, "abs_pos=2" },        // Wake up and power the motor
+  };
+
+  HWTimedEvents hwInput= {
+    { 0,    { HWI::Pin::HOME,        HWI::PinState::HOME_INACTIVE} },
+  };
+
+  NetMockSimpleTimed* wifiAlias;
+  HWMockTimed* hwMockAlias;
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias, false, true ); 
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 100000 );
+
+  TimedStringEvents goldenNet = {
+    { 5,    "Position: 0" },
+    { 1000, "State: ACCEPTING_COMMANDS NoArg" },
+    { 1200, "State: LOW_POWER NoArg" },
+  };
+
+  HWTimedEvents goldenHW = {
+    { 15,   { HWI::Pin::STEP,       HWI::PinState::STEP_ACTIVE} },
+    { 16,   { HWI::Pin::STEP,       HWI::PinState::STEP_INACTIVE} },
+    { 1016, { HWI::Pin::MOTOR_ENA,  HWI::PinState::MOTOR_OFF} },
+    { 1300, { HWI::Pin::MOTOR_ENA,  HWI::PinState::MOTOR_ON} },
+    { 1500, { HWI::Pin::STEP,       HWI::PinState::STEP_ACTIVE} },
+    { 1501, { HWI::Pin::STEP,       HWI::PinState::STEP_INACTIVE} },
+    { 2301, { HWI::Pin::MOTOR_ENA,  HWI::PinState::MOTOR_OFF} },
+  };
+  goldenHW.insert( goldenHW.begin(), goldenHWStart.begin(), goldenHWStart.end());
+
+  EXPECT_EQ( goldenHW, hwMockAlias->getOutEvents() );
+  EXPECT_EQ( goldenNet, testFilterComments(wifiAlias->getOutput() ));
+}
+
+/// @brief Late wake ups shouldn't add up
+///
+/// Runs a move where every pause ends uSecLate after it was asked for.
+/// Focuser::loop schedules against absolute deadlines, so the whole
+/// move should only be uSecLate behind a focuser that's always on
+/// time.  The mocks round to the ms, so allow 1ms either way.
+///
+TEST( FOCUSER_STATE, lateWakeUpsDontDrift )
+{
+  const unsigned int uSecLate = 300;
+  TimedStringEvents netInput = {
+    { 10,   "abs_pos=20" },
+    { 500,  "abs_pos=5" },
+  };
+  HWTimedEvents hwInput= {
+    { 0,    { HWI::Pin::HOME,        HWI::PinState::HOME_INACTIVE} },
+  };
+
+  NetMockSimpleTimed* onTimeWifi;
+  HWMockTimed* onTimeHW;
+  VirtualClock* onTimeClock;
+  auto onTime = make_focuser( netInput, hwInput, onTimeWifi, onTimeHW, 
+                              onTimeClock );
+  simulateFocuser( onTime.get(), onTimeWifi, onTimeHW, onTimeClock, 3000 );
+
+  NetMockSimpleTimed* wifiAlias;
+  HWMockTimed* hwMockAlias;
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+
+  unsigned int time = 0;
+  unsigned int lastMockAdvanceTime = 0;
+  while ( time < 3000*1000 )
+  {
+    const unsigned int pause = focuser->loop();
+    time = time + ( pause != 0 ? pause + uSecLate : 0 );
+    clockAlias->setTime( time );
+    unsigned int mockAdvanceTime = time/1000;
+    wifiAlias->advanceTime( mockAdvanceTime - lastMockAdvanceTime );
+    hwMockAlias->advanceTime( mockAdvanceTime - lastMockAdvanceTime );
+    lastMockAdvanceTime = mockAdvanceTime;
+  }
+
+  const HWTimedEvents& golden = onTimeHW->getOutEvents();
+  const HWTimedEvents& late = hwMockAlias->getOutEvents();
+  ASSERT_EQ( golden.size(), late.size() );
+  for ( std::size_t i = 0; i < golden.size(); ++i )
+  {
+    EXPECT_EQ( golden[i].event, late[i].event );
+    EXPECT_LE( golden[i].time, late[i].time );
+    EXPECT_GE( golden[i].time + 1, late[i].time );
+  }
+}
+
 TEST( FOCUSER_STATE, getFirmwareAndCaps )
 {
   TimedStringEvents netInput = {
@@ -1073,19 +1826,334 @@ TEST( FOCUSER_STATE, getFirmwareAndCaps )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     { 0,  "Firmware: 1.0"},
     { 50, "MaxPos: 35000"},
-    { 50, "CanHome: YES" }
+    { 50, "CanHome: YES" },
+    { 50, "Binary: NO" }
   };
 
   ASSERT_EQ( goldenNet, testFilterComments(wifiAlias->getOutput() ));
   ASSERT_EQ( goldenHWStart, hwMockAlias->getOutEvents() );
 }
 
+/// @brief Replies go to the client that asked, debug output to
+///        clients that subscribed with events=1
+///
+TEST( FOCUSER_STATE, repliesGoToTheirSession )
+{
+  std::unique_ptr<NetMockSessions> wifi( new NetMockSessions( {
+    { { 0, "pstatus" }, { 20, "events=1" }, { 40, "events=0" } },
+    { { 10, "mstatus" }, { 30, "junk" } },
+    { { 30, "sstatus" } },
+  }));
+  std::unique_ptr<HWMockTimed> hardware( new HWMockTimed( HWTimedEvents() ));
+  std::unique_ptr<VirtualClock> clock( new VirtualClock );
+  NetMockSessions* wifiAlias = wifi.get();
+  HWMockTimed* hwMockAlias = hardware.get();
+  VirtualClock* clockAlias = clock.get();
+
+  FS::Focuser focuser(
+    std::move( wifi ),
+    std::move( hardware ),
+    std::move( clock ),
+    std::unique_ptr<DebugInterface>( new DebugInterfaceIgnoreMock ),
+    FS::BuildParams( FS::Build::UNIT_TEST_BUILD_HYPERSTAR ));
+
+  SimRunner runner( focuser );
+  runner.add( *clockAlias );
+  runner.add( *wifiAlias );
+  runner.add( *hwMockAlias );
+  runner.runUntil( 100 * 1000 );
+
+  // Session 0 gets its replies, and the "Got:" debug lines while it's
+  // subscribed.
+  TimedStringEvents golden0 = {
+    { 0,  "Position: 0" },
+    { 20, "Events: ON" },
+    { 30, "# Got: junk" },
+    { 30, "# Got: sstatus" },
+    { 40, "# Got: events=0" },
+    { 40, "Events: OFF" },
+  };
+  TimedStringEvents golden1 = {
+    { 10, "State: ACCEPTING_COMMANDS NoArg" },
+    { 30, "Error: unknown command (junk)" },
+  };
+  TimedStringEvents golden2 = {
+    { 30, "Synched: NO" },
+  };
+  ASSERT_EQ( golden0, wifiAlias->getOutput( 0 ));
+  ASSERT_EQ( golden1, wifiAlias->getOutput( 1 ));
+  ASSERT_EQ( golden2, wifiAlias->getOutput( 2 ));
+}
+
+/// @brief Subscribers get motion updates pushed while the focuser moves
+///
+/// Session 0 subscribes and session 1 moves the focuser, then homes it.
+/// Session 2 subscribes but asks for big position changes only.
+///
+TEST( FOCUSER_STATE, subscribePushesMotion )
+{
+  std::unique_ptr<NetMockSessions> wifi( new NetMockSessions( {
+    { { 0, "subscribe=20" } },
+    { { 10, "abs_pos=100" }, { 400, "home" } },
+    { { 0, "threshold=50" }, { 0, "subscribe=1" }, { 300, "subscribe=0" } },
+  }));
+  std::unique_ptr<HWMockTimed> hardware( new HWMockTimed( HWTimedEvents( {
+    { 0,   { HWI::Pin::HOME, HWI::PinState::HOME_INACTIVE } },
+    { 500, { HWI::Pin::HOME, HWI::PinState::HOME_ACTIVE } },
+  })));
+  std::unique_ptr<VirtualClock> clock( new VirtualClock );
+  NetMockSessions* wifiAlias = wifi.get();
+  HWMockTimed* hwMockAlias = hardware.get();
+  VirtualClock* clockAlias = clock.get();
+
+  FS::Focuser focuser(
+    std::move( wifi ),
+    std::move( hardware ),
+    std::move( clock ),
+    std::unique_ptr<DebugInterface>( new DebugInterfaceIgnoreMock ),
+    FS::BuildParams( FS::Build::UNIT_TEST_BUILD_HYPERSTAR ));
+
+  SimRunner runner( focuser );
+  runner.add( *clockAlias );
+  runner.add( *wifiAlias );
+  runner.add( *hwMockAlias );
+  runner.runUntil( 1000 * 1000 );
+
+  // Position every 20ms, the state when it changes, and where each
+  // move ended.
+  TimedStringEvents golden0 = {
+    { 0,   "Subscribe: 20" },
+    { 10,  "Event: State MOVING 100" },
+    { 22,  "Event: Position 6" },
+    { 42,  "Event: Position 16" },
+    { 62,  "Event: Position 26" },
+    { 82,  "Event: Position 36" },
+    { 102, "Event: Position 46" },
+    { 122, "Event: Position 56" },
+    { 142, "Event: Position 66" },
+    { 162, "Event: Position 76" },
+    { 182, "Event: Position 86" },
+    { 202, "Event: Position 96" },
+    { 210, "Event: Done 100" },
+    { 400, "Event: State STOP_AT_HOME NoArg" },
+    { 405, "Event: Position 98" },
+    { 425, "Event: Position 88" },
+    { 445, "Event: Position 78" },
+    { 465, "Event: Position 68" },
+    { 485, "Event: Position 58" },
+    { 501, "Event: Done 0" },
+  };
+  // Nothing is pushed to the session that asked for the moves.
+  TimedStringEvents golden1 = {};
+  // Only changes of 50 steps or more.
+  TimedStringEvents golden2 = {
+    { 0,   "Threshold: 50" },
+    { 0,   "Subscribe: 1" },
+    { 10,  "Event: State MOVING 100" },
+    { 110, "Event: Position 50" },
+    { 210, "Event: Done 100" },
+    { 300, "Subscribe: OFF" },
+  };
+  ASSERT_EQ( golden0, wifiAlias->getOutput( 0 ));
+  ASSERT_EQ( golden1, wifiAlias->getOutput( 1 ));
+  ASSERT_EQ( golden2, wifiAlias->getOutput( 2 ));
+}
+
+/// @brief A client that takes over a session doesn't get the old 
+///        client's updates
+TEST( FOCUSER_STATE, newClientStartsUnsubscribed )
+{
+  std::unique_ptr<NetMockSessions> wifi( new NetMockSessions( {
+    { { 0, "subscribe=20" } },
+    { { 10, "abs_pos=100" } },
+  }));
+  wifi->reconnect( 0, 5 );
+  std::unique_ptr<HWMockTimed> hardware( new HWMockTimed( HWTimedEvents( {
+    { 0,   { HWI::Pin::HOME, HWI::PinState::HOME_INACTIVE } },
+  })));
+  std::unique_ptr<VirtualClock> clock( new VirtualClock );
+  NetMockSessions* wifiAlias = wifi.get();
+  HWMockTimed* hwMockAlias = hardware.get();
+  VirtualClock* clockAlias = clock.get();
+
+  FS::Focuser focuser(
+    std::move( wifi ),
+    std::move( hardware ),
+    std::move( clock ),
+    std::unique_ptr<DebugInterface>( new DebugInterfaceIgnoreMock ),
+    FS::BuildParams( FS::Build::UNIT_TEST_BUILD_HYPERSTAR ));
+
+  SimRunner runner( focuser );
+  runner.add( *clockAlias );
+  runner.add( *wifiAlias );
+  runner.add( *hwMockAlias );
+  runner.runUntil( 300 * 1000 );
+
+  TimedStringEvents golden0 = {
+    { 0,   "Subscribe: 20" },
+  };
+  ASSERT_EQ( golden0, wifiAlias->getOutput( 0 ));
+}
+
+/// @brief A request packed into a binary frame, as getString returns it
+static std::string requestFrame( const CommandParser::CommandPacket& cp )
+{
+  uint8_t frame[ BinaryProtocol::maxFrame ];
+  const std::size_t length = BinaryProtocol::encodeRequest( cp, frame );
+  return std::string( reinterpret_cast<char*>( frame ), length );
+}
+
+/// @brief A session switches to binary and back
+///
+/// The status queries get fixed layout frames.  The mock records text
+/// as text - putting it in Text frames is the real interface's job.
+///
+TEST( FOCUSER_STATE, binaryProtocolSession )
+{
+  using CommandParser::CommandPacket;
+  using CommandParser::Command;
+
+  std::string corrupt = requestFrame( CommandPacket( Command::PStatus ));
+  corrupt[2] ^= 1;
+
+  std::unique_ptr<NetMockSessions> wifi( new NetMockSessions( {
+    { 
+      { 0,  "binary=1" },
+      { 10, requestFrame( CommandPacket( Command::PStatus )) },
+      { 20, requestFrame( CommandPacket( Command::SStatus )) },
+      { 30, requestFrame( CommandPacket( Command::MStatus )) },
+      { 40, requestFrame( CommandPacket( Command::Firmware )) },
+      { 50, corrupt },
+      { 60, requestFrame( CommandPacket( Command::Binary, 0 )) },
+      { 70, "pstatus" },
+    },
+    { { 10, "pstatus" } },
+  }));
+  std::unique_ptr<HWMockTimed> hardware( new HWMockTimed( HWTimedEvents() ));
+  std::unique_ptr<VirtualClock> clock( new VirtualClock );
+  NetMockSessions* wifiAlias = wifi.get();
+  HWMockTimed* hwMockAlias = hardware.get();
+  VirtualClock* clockAlias = clock.get();
+
+  FS::Focuser focuser(
+    std::move( wifi ),
+    std::move( hardware ),
+    std::move( clock ),
+    std::unique_ptr<DebugInterface>( new DebugInterfaceIgnoreMock ),
+    FS::BuildParams( FS::Build::UNIT_TEST_BUILD_HYPERSTAR ));
+
+  SimRunner runner( focuser );
+  runner.add( *clockAlias );
+  runner.add( *wifiAlias );
+  runner.add( *hwMockAlias );
+  runner.runUntil( 100 * 1000 );
+
+  TimedStringEvents golden0 = {
+    { 0,  "Binary: ON" },
+    { 10, "frame: b5 05 01 00 00 00 00 fa" },       // Position 0
+    { 20, "frame: b5 02 03 00 fb" },                // Not synched
+    { 30, "frame: b5 06 02 00 ff ff ff ff fc" },    // ACCEPT_COMMANDS
+    { 40, "Firmware: 1.0" },
+    { 50, "Error: bad frame" },
+    { 60, "Binary: OFF" },
+    { 70, "Position: 0" },
+  };
+  TimedStringEvents golden1 = {
+    { 10, "Position: 0" },
+  };
+  ASSERT_EQ( golden0, wifiAlias->getOutput( 0 ));
+  ASSERT_EQ( golden1, wifiAlias->getOutput( 1 ));
+}
+
+/// @brief perf reports what ran since the last perf, then resets
+///
+/// The mock's cycle counter only moves between calls to loop, so every
+/// execution time is 0us.
+///
+TEST( FOCUSER_STATE, perfReportsAndResets )
+{
+  TimedStringEvents netInput = {
+    { 10, "abs_pos=2" },
+    { 30, "perf" },
+    { 40, "perf" },
+  };
+  HWTimedEvents hwInput = {
+    { 0,  { HWI::Pin::HOME,        HWI::PinState::HOME_INACTIVE} },
+  };
+
+  NetMockSimpleTimed* wifiAlias;
+  HWMockTimed* hwMockAlias;
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 100 );
+
+  TimedStringEvents goldenNet = {
+    { 30, "Perf: state ACCEPTING_COMMANDS calls=4 maxus=0 hist=0:4" },
+    { 30, "Perf: state DO_STEPS calls=5 maxus=0 hist=0:5" },
+    { 30, "Perf: state SET_DIR calls=1 maxus=0 hist=0:1" },
+    { 30, "Perf: state MOVING calls=2 maxus=0 hist=0:2" },
+    { 30, "Perf: command abs_pos calls=1 maxus=0 hist=0:1" },
+    { 30, "Perf: slip calls=12 maxus=0 hist=0:12" },
+    { 40, "Perf: state ACCEPTING_COMMANDS calls=1 maxus=0 hist=0:1" },
+    { 40, "Perf: command perf calls=1 maxus=0 hist=0:1" },
+    { 40, "Perf: slip calls=1 maxus=0 hist=0:1" },
+  };
+
+  ASSERT_EQ( goldenNet, testFilterComments(wifiAlias->getOutput() ));
+}
+
+/// @brief A perf report too big for one reply is finished by the next perf
+///
+/// Each line is budgeted at its longest, so 8 histograms fit in a
+/// reply.  The rest are kept, and "Perf: more" says so.
+///
+TEST( FOCUSER_STATE, perfReportsTheRestNextTime )
+{
+  TimedStringEvents netInput = {
+    { 10, "abs_pos=2" },
+    { 30, "pstatus;mstatus;sstatus" },
+    { 31, "firmware;caps" },
+    { 40, "perf" },
+    { 50, "perf" },
+  };
+  HWTimedEvents hwInput = {
+    { 0,  { HWI::Pin::HOME,        HWI::PinState::HOME_INACTIVE} },
+  };
+
+  NetMockSimpleTimed* wifiAlias;
+  HWMockTimed* hwMockAlias;
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 100 );
+
+  std::vector<std::string> perf40;
+  std::vector<std::string> perf50;
+  for ( const TimedStringEvent& event : testFilterComments( wifiAlias->getOutput() ))
+  {
+    if ( event.event.compare( 0, 6, "Perf: " ) != 0 ) continue;
+    ( event.time == 40 ? perf40 : perf50 ).push_back( event.event );
+  }
+  ASSERT_EQ( 9u, perf40.size() );
+  ASSERT_EQ( "Perf: more", perf40.back() );
+  // The second perf has the commands the first didn't get to
+  const std::string firmware =
+    "Perf: command firmware calls=1 maxus=0 hist=0:1";
+  const std::string caps = "Perf: command caps calls=1 maxus=0 hist=0:1";
+  ASSERT_NE( perf50.end(), std::find( perf50.begin(), perf50.end(), firmware ));
+  ASSERT_NE( perf50.end(), std::find( perf50.begin(), perf50.end(), caps ));
+  ASSERT_EQ( 0u, perf50.back().find( "Perf: slip " ));
+}
+
 TEST( FOCUSER_STATE, doesNotGoBeyoundMax)
 {
   TimedStringEvents netInput = {
@@ -1096,8 +2164,10 @@ TEST( FOCUSER_STATE, doesNotGoBeyoundMax)
   HWTimedEvents hwInput;
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 95000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 95000 );
 
   TimedStringEvents goldenNet = {
     { 90000,  "Position: 35000" },
@@ -1107,3 +2177,147 @@ TEST( FOCUSER_STATE, doesNotGoBeyoundMax)
 }
 
 
+/// @brief "Moving" lines are Motion Debug, so they're off by default
+TEST( FOCUSER_STATE, verboseDefaultsToInfo )
+{
+  TimedStringEvents netInput = {
+    { 0,   "verbose=-1" },
+    { 10,  "abs_pos=100" },
+  };
+
+  HWTimedEvents hwInput;
+  NetMockSimpleTimed* wifiAlias;
+  HWMockTimed* hwMockAlias;
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 500 );
+
+  TimedStringEvents goldenNet = {
+    { 0, "# Motor set on" },
+    { 0, "# Focuser is up" },
+    { 0, "# Got: verbose=-1" },
+    { 0, "Verbose: 2222" },
+    { 10, "# Got: abs_pos=100" },
+  };
+  ASSERT_EQ( goldenNet, wifiAlias->getOutput() );
+}
+
+/// @brief verbose turns a category up or down, and repetitive lines
+///        are rate limited
+TEST( FOCUSER_STATE, verboseSetsLevels )
+{
+  TimedStringEvents netInput = {
+    { 0,    "verbose=3122" },
+    { 10,   "abs_pos=1200" },
+  };
+
+  HWTimedEvents hwInput;
+  NetMockSimpleTimed* wifiAlias;
+  HWMockTimed* hwMockAlias;
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 3000 );
+
+  // The move takes 2.4 seconds, and "Moving" gets out once a second.
+  // The lines are held until the move's over, and carry the time they
+  // were logged at.
+  TimedStringEvents moving;
+  for ( const TimedStringEvent& e : wifiAlias->getOutput() )
+  {
+    const std::size_t ms = e.event.find( "ms: Moving " );
+    if ( ms != std::string::npos )
+    {
+      ASSERT_LE( 2400u, e.time );
+      moving.push_back( { std::stoi( e.event.substr( 2, ms - 2 )), e.event } );
+    }
+  }
+  ASSERT_EQ( 3u, moving.size() );
+  ASSERT_EQ( "# 10ms: Moving 0", moving[0].event );
+  ASSERT_LE( 1000u, moving[1].time - moving[0].time );
+  ASSERT_LE( 1000u, moving[2].time - moving[1].time );
+
+  // Net is down to Warn.  Parser and Power are still at Info.
+  TimedStringEvents goldenNet = {
+    { 0, "# Motor set on" },
+    { 0, "# Focuser is up" },
+    { 0, "# Got: verbose=3122" },
+    { 0, "Verbose: 3122" },
+    { 10, "# Got: abs_pos=1200" },
+    { 2410, "# Motor set off" },
+  };
+  TimedStringEvents notMoving;
+  for ( const TimedStringEvent& e : wifiAlias->getOutput() )
+  {
+    if ( e.event.find( "ms: Moving " ) == std::string::npos )
+    {
+      notMoving.push_back( e );
+    }
+  }
+  ASSERT_EQ( goldenNet, notMoving );
+}
+
+/// @brief The trace's pin writes are the hardware's, less the step
+///        pulses, and its states and commands are in order
+TEST( FOCUSER_STATE, traceMatchesHardware )
+{
+  TimedStringEvents netInput = {
+    { 10,   "abs_pos=3" },      // Forward 3 steps
+    { 50,   "abs_pos=1" },      // Reverse, then backlash correction
+    { 2000, "trace" },          // After the motor's gone to sleep
+  };
+
+  HWTimedEvents hwInput= {
+    { 0,  { HWI::Pin::HOME,        HWI::PinState::HOME_INACTIVE} },
+  };
+
+  NetMockSimpleTimed* wifiAlias;
+  HWMockTimed* hwMockAlias;
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 2100 );
+
+  TraceDecoder decoder;
+  for ( const TimedStringEvent& e : wifiAlias->getOutput() )
+  {
+    decoder.addLine( e.event );
+  }
+  ASSERT_TRUE( decoder.isDone() );
+  ASSERT_EQ( 0u, decoder.getLost() );
+
+  HWTimedEvents golden;
+  for ( const HWTimedEvent& e : hwMockAlias->getOutEvents() )
+  {
+    if ( e.event.isIO() && e.event.getPin() != HWI::Pin::STEP )
+    {
+      golden.push_back( e );
+    }
+  }
+  ASSERT_LT( 3u, golden.size() );
+  ASSERT_EQ( golden, traceToHWTimedEvents( decoder.getRecords() ));
+
+  // The first move, as the focuser saw it
+  std::vector<std::string> firstMove;
+  for ( const Trace::Record& record : decoder.getRecords() )
+  {
+    if ( record.msTime == 10 )
+    {
+      firstMove.push_back( TraceDecoder::describe( record ));
+    }
+  }
+  const std::vector<std::string> goldenFirstMove = {
+    "reset",
+    "command abs_pos=3",
+    "push MOVING 3",
+    "push DO_STEPS 2",      // 2 steps between command checks
+    "push SET_DIR 0",
+    "pop SET_DIR 0",
+  };
+  ASSERT_EQ( goldenFirstMove, firstMove );
+
+  // The last record is the trace command itself.
+  ASSERT_EQ( "command trace", 
+             TraceDecoder::describe( decoder.getRecords().back() ));
+}
@@ -5,6 +5,7 @@
 #include "test_mock_event.h"
 #include "test_mock_hardware.h"
 #include "test_mock_net.h"
+#include "sim_runner.h"
 
 HWTimedEvents goldenHWStart = {
   {  0, { HWI::Pin::STEP,       HWI::PinIOMode::M_OUTPUT     } },
@@ -21,15 +22,18 @@ std::unique_ptr<FS::Focuser> make_focuser(
   const TimedStringEvents& wifiIn,
   const HWTimedEvents& hwIn,
   NetMockSimpleTimed* &net_interface,
-  HWMockTimed* &hw_interface
+  HWMockTimed* &hw_interface,
+  VirtualClock* &clock_interface
 )
 {
   std::unique_ptr<NetMockSimpleTimed> wifi( new NetMockSimpleTimed( wifiIn ));
   std::unique_ptr<DebugInterfaceIgnoreMock> debug( new DebugInterfaceIgnoreMock);
+  std::unique_ptr<VirtualClock> clock( new VirtualClock );
   std::unique_ptr<HWMockTimed> hardware( new HWMockTimed( hwIn ));
   
   net_interface = wifi.get();
   hw_interface = hardware.get();
+  clock_interface = clock.get();
 
   FS::BuildParams params( FS::Build::UNIT_TEST_TRADITIONAL_FOCUSER );
 
@@ -37,6 +41,7 @@ std::unique_ptr<FS::Focuser> make_focuser(
      new FS::Focuser(
         std::move(wifi),
         std::move(hardware),
+        std::move(clock),
         std::move(debug),
         params )
   );
@@ -46,62 +51,39 @@ std::unique_ptr<FS::Focuser> make_focuser(
 
 /// @brief Simulate the focuser
 ///
+/// Runs in virtual time with a SimRunner.  If the network mock can wait
+/// for input, an idle focuser jumps straight to the next input event.
+///
 /// @param[out] Focuser  - A pointer to the focuser.
 /// @param[in] wifiAlisa - A pointer to the WIFI/ Network Mock
+/// @param[in] clockAlias - A pointer to the virtual clock
 /// @param[in] end_time  - How long (in MS) to run the focuser for.
 /// 
 void simulateFocuser( 
   FS::Focuser* focuser,
   NetMockSimpleTimed* wifiAlias,
   HWMockTimed* hwMockAlias,
+  VirtualClock* clockAlias,
   unsigned int endTime
 )
 {
-  unsigned int time = 0;
-  unsigned int lastMockAdvanceTime = 0;
-  while ( time < endTime*1000 )
-  {
-    time = time + focuser->loop();
-    unsigned int mockAdvanceTime = time/1000;
-    wifiAlias->advanceTime( mockAdvanceTime - lastMockAdvanceTime );
-    hwMockAlias->advanceTime( mockAdvanceTime - lastMockAdvanceTime );
-    lastMockAdvanceTime = mockAdvanceTime;
-  }
-}
-
-TEST( FOCUSER_STATE, allCommandsHaveInterruptStatus)
-{
-  for ( CommandParser::Command c = CommandParser::Command::StartOfCommands;
-        c < CommandParser::Command::EndOfCommands; ++c )
-  {
-    ASSERT_NE( FS::doesCommandInterrupt.find( c ),
-               FS::doesCommandInterrupt.end());
-  }
+  SimRunner runner( *focuser );
+  runner.add( *clockAlias );
+  runner.add( *wifiAlias );
+  runner.add( *hwMockAlias );
+  runner.runUntil( endTime * 1000ull );
 }
 
-namespace FS {
-
-TEST( FOCUSER_STATE, allCommandsHaveImplementations )
-{
-  for ( CommandParser::Command c = CommandParser::Command::StartOfCommands;
-        c < CommandParser::Command::EndOfCommands; ::operator++(c) )
-  {
-    ASSERT_NE( 
-      Focuser::commandImpl.find( c ),
-      Focuser::commandImpl.end());
-  }
-}
- 
-TEST( FOCUSER_STATE, allStatesHaveImplementations )
+/// @brief Spot check the interrupt table
+///
+/// Completeness and order of the table are checked at compile time.
+///
+TEST( FOCUSER_STATE, commandInterruptStatus )
 {
-  for ( FS::State s = FS::State::START_OF_STATES;
-        s < FS::State::END_OF_STATES; ++s )
-  {
-    ASSERT_NE( 
-      FS::Focuser::stateImpl.find( s ),
-      FS::Focuser::stateImpl.end());
-  }
-} 
+  ASSERT_TRUE( FS::doesCommandInterrupt( CommandParser::Command::Abort ));
+  ASSERT_TRUE( FS::doesCommandInterrupt( CommandParser::Command::ABSPos ));
+  ASSERT_FALSE( FS::doesCommandInterrupt( CommandParser::Command::PStatus ));
+  ASSERT_FALSE( FS::doesCommandInterrupt( CommandParser::Command::NoCommand ));
 }
 
 TEST( FOCUSER_STATE, allStatesHaveDebugNames )
@@ -128,8 +110,10 @@ TEST( FOCUSER_STATE, init_Focuser )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     { 0, "# Motor set on" },
@@ -157,8 +141,10 @@ TEST( FOCUSER_STATE, run_status)
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     {  0, "State: ACCEPTING_COMMANDS NoArg"},
@@ -189,8 +175,10 @@ TEST( FOCUSER_STATE, run_abs_pos )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet;
 
@@ -230,8 +218,10 @@ TEST( FOCUSER_STATE, run_rel_pos)
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias );
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet;
 
@@ -273,8 +263,10 @@ TEST( FOCUSER_STATE, run_abs_pos_negative )
 
   NetMockSimpleTimed* wifiAlias;  
   HWMockTimed* hwMockAlias;       
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias );
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   // Should go back 1, to 0, then stop.  -3 is right now.
   TimedStringEvents goldenNet;
@@ -314,8 +306,10 @@ TEST( FOCUSER_STATE, run_abs_pos_double_forward )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet;
 
@@ -357,8 +351,10 @@ TEST( FOCUSER_STATE, run_abs_pos_with_backlash_correction )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet;
 
@@ -406,8 +402,10 @@ TEST( FOCUSER_STATE, ignore_home )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     {  0, "Synched: NO" },
@@ -439,8 +437,10 @@ TEST( FOCUSER_STATE, sync_focuser )
   HWTimedEvents hwInput;
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias );
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     {  0, "Synched: NO" },
@@ -467,8 +467,10 @@ TEST( FOCUSER_STATE, mstatus_while_moving )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   HWTimedEvents goldenHW = {
     { 10, { HWI::Pin::STEP,       HWI::PinState::STEP_ACTIVE} },
@@ -491,7 +493,7 @@ TEST( FOCUSER_STATE, mstatus_while_moving )
   TimedStringEvents goldenNet = {
     { 14, "State: MOVING 7" },
     { 18, "Synched: NO" },
-    { 22, "Position: 6" }
+    { 18, "Position: 4" }       // Taken with sstatus, between step bursts
   };
 
   ASSERT_EQ( goldenNet, testFilterComments(wifiAlias->getOutput() ));
@@ -511,8 +513,10 @@ TEST( FOCUSER_STATE, abort_while_moving )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   HWTimedEvents goldenHW = {
     { 10, { HWI::Pin::STEP,       HWI::PinState::STEP_ACTIVE} },
@@ -540,7 +544,7 @@ TEST( FOCUSER_STATE, sync_while_moving )
   TimedStringEvents netInput = {
     { 10, "abs_pos=7" },        // Start the focuser moving
     { 15, "sync=100" },         // Actually, just synch it
-    { 16, "mstatus" },          // What state are we in?
+    { 16, "mstatus" },          // Taken with sync, before its move ends
     { 20, "pstatus" },          // Where did we end up?
   };
 
@@ -548,8 +552,10 @@ TEST( FOCUSER_STATE, sync_while_moving )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   HWTimedEvents goldenHW = {
     { 10, { HWI::Pin::STEP,       HWI::PinState::STEP_ACTIVE} },
@@ -564,7 +570,7 @@ TEST( FOCUSER_STATE, sync_while_moving )
 
   goldenHW.insert( goldenHW.begin(), goldenHWStart.begin(), goldenHWStart.end());
   TimedStringEvents goldenNet = {
-    { 18, "State: ACCEPTING_COMMANDS NoArg" },
+    { 18, "State: MOVING 100" },
     { 20, "Position: 100" }
   };
 
@@ -589,8 +595,10 @@ TEST( FOCUSER_STATE, abort_on_ignored_home )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     {  0, "Synched: NO" },
@@ -620,8 +628,10 @@ TEST( FOCUSER_STATE, new_move_while_moving )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   HWTimedEvents goldenHW = {
     { 10, { HWI::Pin::STEP,       HWI::PinState::STEP_ACTIVE} },
@@ -663,8 +673,10 @@ TEST( FOCUSER_STATE, move_after_ignored_home )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     {  0, "Synched: NO" },
@@ -704,8 +716,10 @@ TEST( FOCUSER_STATE, mostly_ignore_home_while_moving )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   HWTimedEvents goldenHW = {
     { 10, { HWI::Pin::STEP,       HWI::PinState::STEP_ACTIVE} },
@@ -750,8 +764,10 @@ TEST( FOCUSER_STATE, ignore_multiple_homes )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   HWTimedEvents goldenHW = {
   };
@@ -783,8 +799,10 @@ TEST( FOCUSER_STATE, interrupt_during_backlash_correction )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet;
 
@@ -824,7 +842,7 @@ TEST( FOCUSER_STATE, enterSleepModeAndWake )
     { 1500, "sstatus" },          // Should also happen at 1500
     { 1501, "mstatus" },          // Should happen at 2000
     { 2001, "abs_pos=2" },        // Should happen at 2500
-    { 2500, "mstatus" },
+    { 2500, "mstatus" },          // Taken with abs_pos
     { 4200, "abort" },            // should cause a wake @ 4500
     { 5600, "home" },             // Even though home isn't supported, will wake
   };
@@ -836,8 +854,10 @@ TEST( FOCUSER_STATE, enterSleepModeAndWake )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias ); 
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 10000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 10000 );
 
   TimedStringEvents goldenNet = {
     { 50,   "State: MOVING 1"},
@@ -848,7 +868,7 @@ TEST( FOCUSER_STATE, enterSleepModeAndWake )
     { 1500, "Position: 1" },
     { 1500, "Synched: NO" },
     { 2000, "State: LOW_POWER NoArg" },
-    { 2700, "State: MOVING 2" },
+    { 2500, "State: MOVING 2" },
   };
 
   HWTimedEvents goldenHW = {
@@ -880,13 +900,16 @@ TEST( FOCUSER_STATE, getFirmwareAndCaps )
 
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias );
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 1000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 1000 );
 
   TimedStringEvents goldenNet = {
     { 0,  "Firmware: 1.0"},
     { 50, "MaxPos: 5000"},
-    { 50, "CanHome: NO" }
+    { 50, "CanHome: NO" },
+    { 50, "Binary: NO" }
   };
 
   ASSERT_EQ( goldenNet, testFilterComments(wifiAlias->getOutput() ));
@@ -903,8 +926,10 @@ TEST( FOCUSER_STATE, doesNotGoBeyoundMax)
   HWTimedEvents hwInput;
   NetMockSimpleTimed* wifiAlias;
   HWMockTimed* hwMockAlias;
-  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias );
-  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, 70000 );
+  VirtualClock* clockAlias;
+  auto focuser = make_focuser( netInput, hwInput, wifiAlias, hwMockAlias,
+                               clockAlias );
+  simulateFocuser( focuser.get(), wifiAlias, hwMockAlias, clockAlias, 70000 );
     
   TimedStringEvents goldenNet = {
     { 60000,  "Position: 5000" },
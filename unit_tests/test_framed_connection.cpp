@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include "framed_connection.h"
+
+namespace {
+
+/// @brief A connection whose socket takes everything it's sent
+class TestConnection: public FramedConnection {
+  public:
+
+  bool getString( WifiDebugOstream& log, std::string& string ) override
+  {
+    (void) log;
+    return getBufferedString( string );
+  }
+
+  bool hasInput( void ) override
+  {
+    return hasBufferedInput();
+  }
+
+  operator bool( void ) override
+  {
+    return connected;
+  }
+
+  void reset( void ) override
+  {
+    resetSession();
+  }
+
+  void flush() override
+  {
+    m_outgoing.drain( [&] ( const char_type* s, std::size_t n )
+    {
+      sent.append( s, n );
+      return n;
+    });
+  }
+
+  void write( const std::string& text )
+  {
+    FramedConnection::write( text.data(), text.size() );
+  }
+
+  using FramedConnection::queueDropNotice;
+
+  bool connected = true;
+  std::string sent;
+};
+
+/// @brief The Text frame a line should go out as
+std::string textFrame( const std::string& text )
+{
+  uint8_t frame[ BinaryProtocol::maxFrame ];
+  const std::size_t length =
+    BinaryProtocol::encodeText( text.data(), text.size(), frame );
+  return std::string( reinterpret_cast<char*>( frame ), length );
+}
+
+}
+
+/// @brief Joined lines go out as one, "; " between them
+TEST( FRAMED_CONNECTION, joinLines )
+{
+  TestConnection connection;
+  connection.joinLines( true );
+  connection.write( "Position: 5\n" );
+  connection.write( "Done\n" );
+  connection.flush();
+  ASSERT_EQ( "Position: 5; Done", connection.sent );
+
+  connection.joinLines( false );
+  connection.write( "State: ACCEPT_COMMANDS\n" );
+  connection.flush();
+  ASSERT_EQ( "Position: 5; Done\nState: ACCEPT_COMMANDS\n", connection.sent );
+}
+
+/// @brief In binary mode each line is a Text frame, however it's written
+TEST( FRAMED_CONNECTION, binaryText )
+{
+  TestConnection connection;
+  connection.setBinary( true );
+  connection.write( "Posi" );
+  connection.write( "tion: 5\n# Moving\n" );
+  connection.flush();
+  ASSERT_EQ( textFrame( "Position: 5" ) + textFrame( "# Moving" ),
+    connection.sent );
+
+  // A line too long for a frame is cut short
+  const std::string longLine( BinaryProtocol::maxPayload * 2, 'x' );
+  connection.sent.clear();
+  connection.write( longLine + "\n" );
+  connection.flush();
+  ASSERT_EQ( textFrame( longLine.substr( 0, BinaryProtocol::maxPayload - 1 )),
+    connection.sent );
+}
+
+/// @brief Nothing is queued without a client, and a new client starts over
+TEST( FRAMED_CONNECTION, newSession )
+{
+  TestConnection connection;
+  connection.connected = false;
+  connection.write( "Position: 5\n" );
+  connection.flush();
+  ASSERT_EQ( "", connection.sent );
+
+  connection.connected = true;
+  connection.setSubscribed( true );
+  connection.setBinary( true );
+  connection.write( "Half a line" );
+  connection.reset();
+  ASSERT_FALSE( connection.isSubscribed() );
+  ASSERT_FALSE( connection.isBinary() );
+  connection.write( "Done\n" );
+  connection.flush();
+  ASSERT_EQ( "Done\n", connection.sent );
+}
+
+/// @brief The drop notice goes ahead of output the client hasn't taken
+TEST( FRAMED_CONNECTION, dropNotice )
+{
+  const std::string notice =
+    "# New Client and no free slots - Dropping Your Connection.";
+  TestConnection connection;
+  connection.write( "Position: 5\n" );
+  connection.joinLines( true );
+  connection.write( "Done\n" );
+  connection.queueDropNotice();
+  connection.flush();
+  ASSERT_EQ( notice + "\n", connection.sent );
+
+  connection.sent.clear();
+  connection.setBinary( true );
+  connection.write( "Half a line" );
+  connection.queueDropNotice();
+  connection.flush();
+  ASSERT_EQ( textFrame( notice ), connection.sent );
+}
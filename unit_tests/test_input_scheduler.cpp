@@ -0,0 +1,204 @@
+#include <gtest/gtest.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+#include "input_scheduler.h"
+#include "wifi_debug_ostream.h"
+#include "test_mock_debug.h"
+#include "test_mock_event.h"
+#include "test_mock_hardware.h"
+#include "test_mock_net.h"
+
+///
+/// @brief Client connection with lines already waiting on it
+///
+class NetConnectionMock: public NetConnection
+{
+  public:
+
+  /// @brief A line arrives from the client
+  void send( const std::string& line )
+  {
+    lines.push_back( line );
+  }
+  bool getString( WifiDebugOstream& log, std::string& string ) override
+  {
+    (void) log;
+    if ( lines.empty() ) return false;
+    string = lines.front();
+    lines.pop_front();
+    return true;
+  }
+  bool hasInput() override
+  {
+    return !lines.empty();
+  }
+  operator bool() override
+  {
+    return true;
+  }
+  void reset() override
+  {
+    lines.clear();
+  }
+  std::streamsize write( const char_type* s, std::streamsize n ) override
+  {
+    (void) s;
+    return n;
+  }
+  void flush() override
+  {
+  }
+
+  private:
+
+  std::deque<std::string> lines;
+};
+
+class INPUT_SCHEDULER: public ::testing::Test
+{
+  protected:
+
+  INPUT_SCHEDULER() : log( &debug, &net )
+  {
+  }
+
+  /// @brief Run one poll and return the lines it got
+  template< unsigned int LinesPerPoll >
+  std::vector<std::string> poll( InputScheduler< 4, LinesPerPoll >& s )
+  {
+    std::vector<std::string> result;
+    std::string line;
+    while ( s.getString( connections, log, line ))
+    {
+      result.push_back( line );
+    }
+    return result;
+  }
+
+  DebugInterfaceIgnoreMock debug;
+  NetMockSimpleTimed net;
+  WifiDebugOstream log;
+  std::array< NetConnectionMock, 4 > connections;
+};
+
+/// @brief Every client with input gets a turn before any gets two
+TEST_F( INPUT_SCHEDULER, takesTurns )
+{
+  InputScheduler< 4, 8 > scheduler;
+  connections[0].send( "a1" );
+  connections[0].send( "a2" );
+  connections[0].send( "a3" );
+  connections[2].send( "c1" );
+  connections[3].send( "d1" );
+  connections[3].send( "d2" );
+
+  const std::vector<std::string> golden = {
+    "a1", "c1", "d1", "a2", "d2", "a3"
+  };
+  ASSERT_EQ( golden, poll( scheduler ));
+  ASSERT_EQ( 3u, scheduler.getStats( 0 ).lines );
+  ASSERT_EQ( 0u, scheduler.getStats( 1 ).lines );
+  ASSERT_EQ( 0u, scheduler.getStats( 0 ).deferred );
+}
+
+/// @brief The next poll starts after the client that went last
+TEST_F( INPUT_SCHEDULER, cursorRotates )
+{
+  InputScheduler< 4, 8 > scheduler;
+  connections[1].send( "b1" );
+  ASSERT_EQ( std::vector<std::string>( { "b1" } ), poll( scheduler ));
+
+  connections[0].send( "a1" );
+  connections[1].send( "b2" );
+  connections[2].send( "c1" );
+  const std::vector<std::string> golden = { "c1", "a1", "b2" };
+  ASSERT_EQ( golden, poll( scheduler ));
+}
+
+/// @brief A chatty client is capped, and its backlog is counted
+TEST_F( INPUT_SCHEDULER, linesPerPollCap )
+{
+  InputScheduler< 4, 2 > scheduler;
+  for ( int i = 0; i < 5; ++i )
+  {
+    connections[0].send( "a" + std::to_string( i ));
+  }
+  connections[1].send( "b0" );
+
+  ASSERT_EQ( std::vector<std::string>( { "a0", "b0", "a1" } ),
+    poll( scheduler ));
+  ASSERT_EQ( std::vector<std::string>( { "a2", "a3" } ), poll( scheduler ));
+  ASSERT_EQ( std::vector<std::string>( { "a4" } ), poll( scheduler ));
+  ASSERT_EQ( std::vector<std::string>(), poll( scheduler ));
+
+  const InputStats& stats = scheduler.getStats( 0 );
+  ASSERT_EQ( 5u, stats.lines );
+  ASSERT_EQ( 2u, stats.deferred );
+  ASSERT_EQ( 1u, stats.maxPollsWaited );
+  ASSERT_EQ( 0u, stats.pollsWaiting );
+
+  scheduler.reset( 0 );
+  ASSERT_EQ( 0u, scheduler.getStats( 0 ).lines );
+}
+
+/// @brief Four clients, one flooding: everyone's latency stays bounded
+///
+/// Client 0 sends 10 lines every poll, far more than it can be given.
+/// Clients 1-3 send a line now and then.  Lines are tagged with the
+/// poll they arrived in, so we can see how many polls each waited.
+///
+TEST_F( INPUT_SCHEDULER, boundedLatencyWithFourClients )
+{
+  constexpr unsigned int linesPerPoll = 2;
+  InputScheduler< 4, linesPerPoll > scheduler;
+  const int polls = 100;
+
+  std::array< unsigned int, 4 > maxLatency = {{ 0, 0, 0, 0 }};
+  std::array< unsigned int, 4 > served = {{ 0, 0, 0, 0 }};
+  for ( int p = 0; p < polls; ++p )
+  {
+    for ( int i = 0; i < 10; ++i )
+    {
+      connections[0].send( "0 " + std::to_string( p ));
+    }
+    for ( int c = 1; c < 4; ++c )
+    {
+      if ( p % ( c + 2 ) == 0 )
+      {
+        connections[c].send( std::to_string( c ) + " " + std::to_string( p ));
+      }
+    }
+
+    const std::vector<std::string> lines = poll( scheduler );
+    ASSERT_GE( 4 * linesPerPoll, lines.size() );
+    std::array< unsigned int, 4 > perClient = {{ 0, 0, 0, 0 }};
+    for ( const std::string& line : lines )
+    {
+      const int client = std::stoi( line.substr( 0, 1 ));
+      const int arrived = std::stoi( line.substr( 2 ));
+      ++perClient[ client ];
+      ++served[ client ];
+      maxLatency[ client ] = std::max( maxLatency[ client ],
+        static_cast<unsigned int>( p - arrived ));
+    }
+    for ( unsigned int count : perClient )
+    {
+      ASSERT_GE( linesPerPoll, count );
+    }
+  }
+
+  // The quiet clients never wait, whatever client 0 does.
+  for ( int c = 1; c < 4; ++c )
+  {
+    ASSERT_EQ( 0u, maxLatency[c] ) << "client " << c;
+    ASSERT_EQ( 0u, scheduler.getStats( c ).deferred );
+    ASSERT_EQ( served[c], scheduler.getStats( c ).lines );
+  }
+  // Client 0 gets its share every poll, and its backlog shows up.
+  ASSERT_EQ( polls * linesPerPoll, served[0] );
+  ASSERT_EQ( static_cast<unsigned int>( polls ),
+    scheduler.getStats( 0 ).deferred );
+  ASSERT_LT( 0u, maxLatency[0] );
+}
@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+#include "line_buffer.h"
+
+///
+/// @brief Stream that hands its input out in awkward sized pieces
+///
+/// Looks like a WiFiClient to LineBuffer::fill.  Each read returns at
+/// most the next size from the fragment list (cycling), like TCP
+/// segments arriving one at a time.
+///
+class FragmentingStream
+{
+  public:
+
+  FragmentingStream( const std::string& inputArg,
+                     std::vector<std::size_t> fragmentsArg )
+    : input{ inputArg }, fragments{ fragmentsArg }, pos{ 0 },
+      nextFragment{ 0 }, segmentLeft{ 0 }
+  {
+    startSegment();
+  }
+
+  /// @brief Bytes that can be read before the next segment "arrives"
+  int available()
+  {
+    return static_cast<int>( segmentLeft );
+  }
+
+  int read( uint8_t* buffer, std::size_t size )
+  {
+    const std::size_t n = std::min( size, segmentLeft );
+    memcpy( buffer, input.data() + pos, n );
+    pos += n;
+    segmentLeft -= n;
+    return static_cast<int>( n );
+  }
+
+  /// @brief Let the next segment arrive
+  void startSegment()
+  {
+    if ( segmentLeft != 0 ) return;
+    segmentLeft = std::min( fragments[ nextFragment ], input.length() - pos );
+    nextFragment = ( nextFragment + 1 ) % fragments.size();
+  }
+
+  bool done() const
+  {
+    return pos == input.length();
+  }
+
+  private:
+
+  std::string input;
+  std::vector<std::size_t> fragments;
+  std::size_t pos;
+  std::size_t nextFragment;
+  std::size_t segmentLeft;
+};
+
+/// @brief Run a stream through a LineBuffer and collect the lines
+template< std::size_t N >
+static std::vector<std::string> frame(
+  LineBuffer<N>& buffer,
+  FragmentingStream& stream )
+{
+  std::vector<std::string> lines;
+  std::string line;
+  for ( ;; )
+  {
+    buffer.fill( stream );
+    while ( buffer.getLine( line ))
+    {
+      lines.push_back( line );
+    }
+    if ( stream.done() ) break;
+    stream.startSegment();
+  }
+  return lines;
+}
+
+/// @brief Lines come out whole however the input is cut up
+TEST( LINE_BUFFER, fragmentedInput )
+{
+  const std::string input =
+    "pstatus\nabs_pos=1000\n\nmstatus\r\nrel_pos -5\nhalf a li";
+  const std::vector<std::string> golden = {
+    "pstatus", "abs_pos=1000", "", "mstatus\r", "rel_pos -5"
+  };
+
+  const std::vector< std::vector<std::size_t> > cuts = {
+    { 1 }, { 2 }, { 3, 1, 7 }, { 13 }, { 100 }
+  };
+  for ( const auto& cut : cuts )
+  {
+    // 16 bytes, so lines wrap around the end of the ring
+    LineBuffer<16> buffer;
+    FragmentingStream stream( input, cut );
+    ASSERT_EQ( golden, frame( buffer, stream ));
+    ASSERT_EQ( 9u, buffer.size() );
+    ASSERT_FALSE( buffer.hasLine() );
+  }
+}
+
+/// @brief A line that can't fit is thrown away, up to its '\n'
+TEST( LINE_BUFFER, overlongLineDropped )
+{
+  const std::string input =
+    "home\n" + std::string( 40, 'x' ) + "\nsync=1\n" +
+    std::string( 15, 'y' ) + "\n" + std::string( 16, 'z' ) + "\nperf\n";
+  const std::vector<std::string> golden = {
+    "home", "sync=1", std::string( 15, 'y' ), "perf"
+  };
+
+  for ( std::size_t cut : { 1, 5, 16 } )
+  {
+    LineBuffer<16> buffer;
+    FragmentingStream stream( input, { cut } );
+    ASSERT_EQ( golden, frame( buffer, stream ));
+    ASSERT_EQ( 2u, buffer.linesDropped() );
+    ASSERT_EQ( 0u, buffer.size() );
+  }
+}
+
+/// @brief A buffer full of lines leaves the rest in the stream
+TEST( LINE_BUFFER, fullBufferPushesBack )
+{
+  LineBuffer<8> buffer;
+  FragmentingStream stream( "abc\ndef\nghi\n", { 100 } );
+
+  ASSERT_EQ( 8u, buffer.fill( stream ));
+  ASSERT_EQ( 4, stream.available() );
+  ASSERT_EQ( 0u, buffer.linesDropped() );
+
+  std::string line;
+  ASSERT_TRUE( buffer.getLine( line ));
+  ASSERT_EQ( "abc", line );
+  ASSERT_EQ( 4u, buffer.fill( stream ));
+  ASSERT_TRUE( buffer.getLine( line ));
+  ASSERT_EQ( "def", line );
+  ASSERT_TRUE( buffer.getLine( line ));
+  ASSERT_EQ( "ghi", line );
+  ASSERT_FALSE( buffer.getLine( line ));
+
+  buffer.reset();
+  ASSERT_EQ( 0u, buffer.size() );
+}
+
+/// @brief Bulk writes without a stream
+TEST( LINE_BUFFER, writeSpaceAndCommit )
+{
+  LineBuffer<8> buffer;
+  std::size_t space;
+  char* dest = buffer.writeSpace( space );
+  ASSERT_EQ( 8u, space );
+  memcpy( dest, "ab\ncd", 5 );
+  buffer.commit( 5 );
+
+  std::string line;
+  ASSERT_TRUE( buffer.getLine( line ));
+  ASSERT_EQ( "ab", line );
+
+  // Only the space up to the end of the ring is contiguous
+  dest = buffer.writeSpace( space );
+  ASSERT_EQ( 3u, space );
+  memcpy( dest, "efg", 3 );
+  buffer.commit( 3 );
+  dest = buffer.writeSpace( space );
+  ASSERT_EQ( 3u, space );
+  memcpy( dest, "\n", 1 );
+  buffer.commit( 1 );
+
+  ASSERT_TRUE( buffer.getLine( line ));
+  ASSERT_EQ( "cdefg", line );
+}
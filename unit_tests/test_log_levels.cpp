@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <type_traits>
+#include "deferred_log.h"
+#include "log_levels.h"
+#include "wifi_debug_ostream.h"
+#include "test_mock_debug.h"
+#include "test_mock_hardware.h"
+#include "test_mock_net.h"
+
+TEST( LOG_LEVELS, masksStartAtInfo )
+{
+  Log::Masks masks;
+  ASSERT_TRUE( masks.isOn( Log::Category::Motion, Log::Level::Error ));
+  ASSERT_TRUE( masks.isOn( Log::Category::Motion, Log::Level::Info ));
+  ASSERT_FALSE( masks.isOn( Log::Category::Motion, Log::Level::Debug ));
+
+  masks.setLevel( Log::Category::Net, Log::Level::Error );
+  ASSERT_FALSE( masks.isOn( Log::Category::Net, Log::Level::Warn ));
+  ASSERT_TRUE( masks.isOn( Log::Category::Parser, Log::Level::Warn ));
+  ASSERT_EQ( Log::Level::Error, masks.getLevel( Log::Category::Net ));
+
+  masks.reset();
+  ASSERT_EQ( Log::Level::Info, masks.getLevel( Log::Category::Net ));
+}
+
+/// @brief Lines go out only if their category is turned up far enough
+TEST( LOG_LEVELS, linesAreFiltered )
+{
+  DebugInterfaceRecordMock debug;
+  debug.getMasks().setLevel( Log::Category::Motion, Log::Level::Debug );
+  debug.getMasks().setLevel( Log::Category::Net, Log::Level::Warn );
+
+  debug.debug( Log::Category::Motion ) << "Moving " << 10 << "\n";
+  debug.debug( Log::Category::Parser ) << "Processing pstatus request\n";
+  debug.info( Log::Category::Net ) << "New client connecting\n";
+  debug.warn( Log::Category::Net ) << "Dropped a line\n";
+  debug.error( Log::Category::Power ) << "Motor fault\n";
+
+  ASSERT_EQ( "Moving 10\nDropped a line\nMotor fault\n", debug.text );
+}
+
+/// @brief The WiFi comments use the serial port's masks
+TEST( LOG_LEVELS, wifiUsesTheSameMasks )
+{
+  DebugInterfaceRecordMock debug;
+  NetMockSimpleTimed net;
+  WifiDebugOstream log( &debug, &net );
+
+  log.debug( Log::Category::Motion ) << "Moving 1\n";
+  debug.getMasks().setLevel( Log::Category::Motion, Log::Level::Debug );
+  log.debug( Log::Category::Motion ) << "Moving 2\n";
+
+  ASSERT_EQ( "Moving 2\n", debug.text );
+  TimedStringEvents golden = { { 0, "# Moving 2" } };
+  ASSERT_EQ( golden, net.getOutput() );
+}
+
+/// @brief A line whose level is compiled out is a type that does nothing
+TEST( LOG_LEVELS, compiledOutLinesAreEmpty )
+{
+  DebugInterfaceRecordMock debug;
+  Log::Line< DebugInterface, false > line( debug, true );
+  line << "Never " << 1 << "\n";
+  ASSERT_EQ( "", debug.text );
+  ASSERT_TRUE( std::is_empty< decltype( line ) >::value );
+
+  ASSERT_EQ( BEEFOCUS_LOG_LEVEL >= 3, 
+    Log::isCompiledIn( Log::Level::Debug ));
+  ASSERT_TRUE( Log::isCompiledIn( Log::Level::Error ));
+}
+
+/// @brief A rate limited line goes out at most once a period
+TEST( LOG_LEVELS, rateLimit )
+{
+  DebugInterfaceRecordMock debug;
+  debug.getMasks().setLevel( Log::Category::Motion, Log::Level::Debug );
+  Log::RateLimit limit( 1000 );
+
+  for ( uint64_t ms = 0; ms < 2500; ms += 100 )
+  {
+    debug.debug( Log::Category::Motion, limit, ms ) << ms << "\n";
+  }
+  ASSERT_EQ( "0\n1000\n2000\n", debug.text );
+  ASSERT_EQ( 22u, limit.getDropped() );
+
+  // Lines that are filtered out don't use up the limit.
+  Log::RateLimit unused( 1000 );
+  debug.getMasks().setLevel( Log::Category::Motion, Log::Level::Info );
+  debug.debug( Log::Category::Motion, unused, 0 ) << "Off\n";
+  ASSERT_EQ( 0u, unused.getDropped() );
+  ASSERT_TRUE( unused.allow( 1 ));
+}
+
+/// @brief Deferred lines are filtered when added and formatted on drain
+TEST( LOG_LEVELS, deferredLinesWaitForDrain )
+{
+  DebugInterfaceRecordMock debug;
+  Log::DeferredLog< 4 > deferred;
+
+  deferred.setTime( 10 );
+  deferred.add< Log::Message::Moving >( debug.getMasks(), 100 );
+  deferred.add< Log::Message::HitHome >( debug.getMasks(), 7 );
+  debug.getMasks().setLevel( Log::Category::Motion, Log::Level::Debug );
+  deferred.setTime( 20 );
+  deferred.add< Log::Message::Homing >( debug.getMasks(), 5 );
+  ASSERT_EQ( "", debug.text );
+  ASSERT_FALSE( deferred.isEmpty() );
+
+  deferred.drain( debug );
+  ASSERT_EQ( 
+    "10ms: Hit home at position 7, resetting position to 0\n"
+    "20ms: Homing 5\n", debug.text );
+  ASSERT_TRUE( deferred.isEmpty() );
+}
+
+/// @brief A full deferred log drops its oldest lines and says so
+TEST( LOG_LEVELS, deferredDropsOldest )
+{
+  DebugInterfaceRecordMock debug;
+  debug.getMasks().setLevel( Log::Category::Motion, Log::Level::Debug );
+  Log::DeferredLog< 2 > deferred;
+  Log::RateLimit limit( 100 );
+
+  for ( int i = 0; i < 10; ++i )
+  {
+    deferred.setTime( i * 50 );
+    deferred.add< Log::Message::Moving >( debug.getMasks(), i, limit );
+  }
+  ASSERT_EQ( 3u, deferred.getDropped() );
+
+  deferred.drain( debug );
+  ASSERT_EQ( 
+    "Dropped 3 deferred log lines\n"
+    "300ms: Moving 6\n"
+    "400ms: Moving 8\n", debug.text );
+  ASSERT_EQ( 0u, deferred.getDropped() );
+  ASSERT_TRUE( deferred.isEmpty() );
+}
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include "loop_profiler.h"
+#include "test_mock_event.h"
+#include "test_mock_hardware.h"
+#include "test_mock_net.h"
+
+/// @brief Times go in log2 buckets
+TEST( LOOP_PROFILER, histogramBuckets )
+{
+  ASSERT_EQ( 0u, TimeHistogram::bucketFor( 0 ));
+  ASSERT_EQ( 1u, TimeHistogram::bucketFor( 1 ));
+  ASSERT_EQ( 2u, TimeHistogram::bucketFor( 2 ));
+  ASSERT_EQ( 2u, TimeHistogram::bucketFor( 3 ));
+  ASSERT_EQ( 7u, TimeHistogram::bucketFor( 100 ));
+  ASSERT_EQ( TimeHistogram::numBuckets-1, TimeHistogram::bucketFor( 0xffffffff ));
+}
+
+/// @brief Histograms print as calls, max, and the buckets that are used
+TEST( LOOP_PROFILER, histogramOutput )
+{
+  TimeHistogram h;
+  h.add( 0 );
+  h.add( 100 );
+  h.add( 120 );
+
+  NetMockSimpleTimed net;
+  net << h << "\n";
+  h.reset();
+  net << h << "\n";
+
+  TimedStringEvents golden = {
+    { 0, "calls=3 maxus=120 hist=0:1,7:2" },
+    { 0, "calls=0 maxus=0 hist=" },
+  };
+  ASSERT_EQ( golden, net.getOutput() );
+}
+
+/// @brief Execution times are converted from cycles to microseconds
+TEST( LOOP_PROFILER, cyclesToMicroSeconds )
+{
+  LoopProfiler< true, 2, 2 > profiler;
+  profiler.setCyclesPerMicroSecond( 80 );
+  profiler.state( 1, 80*100 );
+  profiler.command( 0, 79 );
+
+  ASSERT_EQ( 0u, profiler.getState( 0 ).getCount() );
+  ASSERT_EQ( 1u, profiler.getState( 1 ).getCount() );
+  ASSERT_EQ( 100u, profiler.getState( 1 ).getMax() );
+  ASSERT_EQ( 1u, profiler.getCommand( 0 ).getBucket( 0 ));
+}
+
+/// @brief Wake slip is how late the caller got back, early counts as 0
+TEST( LOOP_PROFILER, wakeSlip )
+{
+  LoopProfiler< true, 1, 1 > profiler;
+  profiler.setCyclesPerMicroSecond( 10 );
+
+  profiler.wake( 1000 );       // Nothing asked for yet, nothing recorded
+  ASSERT_EQ( 0u, profiler.getSlip().getCount() );
+
+  profiler.sleep( 1000, 50 );  // Come back at 1050us
+  profiler.wake( 1080 );       // 30us late
+  profiler.sleep( 2000, 50 );  // Come back at 2050us
+  profiler.wake( 2040 );       // Early
+
+  ASSERT_EQ( 2u, profiler.getSlip().getCount() );
+  ASSERT_EQ( 30u, profiler.getSlip().getMax() );
+  ASSERT_EQ( 1u, profiler.getSlip().getBucket( 0 ));
+
+  // A long idle wait is longer than the 80MHz cycle counter's wrap
+  const uint64_t uSecMinute = 60ull * 1000 * 1000;
+  profiler.sleep( uSecMinute, 60 * 1000 * 1000 ); 
+  profiler.wake( 2 * uSecMinute + 1 );   // 1us late
+  ASSERT_EQ( 1u, profiler.getSlip().getBucket( 1 ));
+
+  profiler.reset();
+  ASSERT_EQ( 0u, profiler.getSlip().getCount() );
+}
+
+/// @brief A compiled out profiler has nothing to report
+TEST( LOOP_PROFILER, disabled )
+{
+  LoopProfiler< false, 2, 2 > profiler;
+  ASSERT_FALSE( profiler.enabled );
+  profiler.sleep( 0, 10 );
+  profiler.wake( 1000 );
+  profiler.state( 1, 100 );
+  ASSERT_EQ( 0u, profiler.getSlip().getCount() );
+  ASSERT_EQ( 0u, profiler.getState( 1 ).getCount() );
+}
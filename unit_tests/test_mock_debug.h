@@ -5,6 +5,7 @@
 #ifndef __TEST_MOCK_DEBUG__
 #define __TEST_MOCK_DEBUG__
 
+#include <string>
 #include "debug_interface.h"
 
 ///
@@ -33,5 +34,26 @@ class DebugInterfaceIgnoreMock: public DebugInterface
 
 };
 
+///
+/// @brief Debug interface that keeps what's written
+///
+class DebugInterfaceRecordMock: public DebugInterface
+{
+  public:
+
+  std::streamsize write( const char_type* s, std::streamsize n ) override
+  {
+    text.append( s, n );
+    return n;
+  }
+
+  void disable() override
+  {
+  }
+
+  /// @brief Everything written so far
+  std::string text;
+};
+
 #endif
 
@@ -2,9 +2,11 @@
 #define __TEST_MOCK_EVENTS__
 
 #include <iostream>
+#include <vector>
 #include <gtest/gtest.h>
 
 #include "hardware_interface.h"
+#include "trace_ring.h"
 
 /// @brief a Hardware Event
 ///
@@ -212,5 +214,27 @@ using HWTimedEvent = TimedEvent<HWEvent>;
 ///
 using HWTimedEvents = std::vector<HWTimedEvent>;
 
+///
+/// @brief The pin writes in a decoded trace, as HWTimedEvents
+///
+/// Lets a trace from the focuser be compared with HWMockTimed's output.
+/// The trace doesn't have the step pin's writes, so filter them out of
+/// the mock's events first.
+///
+inline HWTimedEvents traceToHWTimedEvents( 
+  const std::vector<Trace::Record>& records )
+{
+  HWTimedEvents events;
+  for ( const Trace::Record& record : records )
+  {
+    if ( record.kind == Trace::Kind::PinWrite )
+    {
+      events.emplace_back( HWTimedEvent( record.msTime, HWEvent( 
+        HWI::Pin( record.code ), HWI::PinState( record.arg ))));
+    }
+  }
+  return events;
+}
+
 #endif
 
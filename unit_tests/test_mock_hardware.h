@@ -6,6 +6,8 @@
 #define __TEST_MOCK_HARDWARE__
 
 #include "hardware_interface.h"
+#include "sim_runner.h"
+#include "step_queue.h"
 #include "test_mock_event.h"
 
 ///
@@ -18,7 +20,7 @@
 ///
 /// - Maintain Time.  
 ///     The class simulates the passage of time.  advanceTime is called to 
-///     "move" time forward
+///     "move" time forward, or a SimRunner calls advanceTo.
 /// - Record Output.  
 ///     Whenever an output pin is changed on the hardware mock the event and
 ///     event time are recorded.  Tests can use this to verify that the 
@@ -27,8 +29,13 @@
 ///     On class construction, the caller can specify a series of input
 ///     events and the time those events occur at.  i.e.,  the caller can
 ///     see "at time 20ms the HOME input will change state to active"
+/// - Play the Step Queue.
+///     If the mock is built with a step queue, queued edges are recorded
+///     at the time they would have been written, as time advances.  Tests 
+///     can use this to check that the queued output matches the golden 
+///     result for direct writes.
 /// 
-class HWMockTimed: public HWI
+class HWMockTimed: public HWI, public SimParticipant
 {
   public:
 
@@ -37,11 +44,16 @@ class HWMockTimed: public HWI
   /// @param[in] HWTimedEvents - Simulated Input Events.  A vector of
   ///   input events and they time they take place at.  See 
   ///   HWTimedEvents for examples. 
+  /// @param[in] hasStepQueueArg - Give the mock a step queue
   ///
-  HWMockTimed( const HWTimedEvents& hwIn ) : 
+  HWMockTimed( const HWTimedEvents& hwIn, bool hasStepQueueArg = false ) : 
       time{ 0 }, 
       inEvents{ hwIn },
-      nextInputEvent{inEvents.begin()}
+      nextInputEvent{inEvents.begin()},
+      stepQueueEnabled{ hasStepQueueArg },
+      stepQueueLimit{ stepQueueCapacity },
+      msStallUntil{ 0 },
+      uSecQueueClock{ 0 }
   {
     // Advance time by 0.  This causes any input events at "time 0"
     // to be processed and recorded in the inputStates map.
@@ -110,6 +122,62 @@ class HWMockTimed: public HWI
     return inputStates.at( pin );
   }
 
+  /// @brief Mock step queue interface.  On if the mock was built with one.
+  bool hasStepQueue() override
+  {
+    return stepQueueEnabled;
+  }
+
+  ///
+  /// @brief Mock queueEdge hardware interface
+  ///
+  /// @param[in] edge - The edge to write and the pause after it
+  /// @return         - false if the queue is full
+  ///
+  /// If the queue was idle the edge is played right away, just like a
+  /// DigitalWrite would be.
+  ///
+  bool queueEdge( const QueuedEdge& edge ) override
+  {
+    assert( stepQueueEnabled );
+    if ( isStepQueueIdle() )
+    {
+      uSecQueueClock = uSecNow();
+    }
+    if ( stepQueueSpace() == 0 || !stepQueue.push( edge )) return false;
+    playStepQueue();
+    return true;
+  }
+
+  std::size_t stepQueueSpace() override
+  {
+    const std::size_t used = stepQueueCapacity - stepQueue.space();
+    return used >= stepQueueLimit ? 0 : stepQueueLimit - used;
+  }
+
+  /// @brief Make the step queue act as if it only holds limit edges
+  void setStepQueueLimit( std::size_t limit )
+  {
+    stepQueueLimit = limit;
+  }
+
+  /// @brief Hold queued edges until msTime, like a timer that stopped
+  void stallStepQueue( int msTime )
+  {
+    msStallUntil = msTime;
+  }
+
+  bool isStepQueueIdle() override
+  {
+    return stepQueue.empty() && uSecQueueClock <= uSecNow();
+  }
+
+  /// @brief Mock cycle counter.  Counts microseconds of simulated time.
+  uint32_t getCycleCount() override
+  {
+    return static_cast<uint32_t>( uSecNow() );
+  }
+
   ///
   /// @brief Advance simulated time
   ///
@@ -118,14 +186,18 @@ class HWMockTimed: public HWI
   /// Does the following:
   /// 
   /// 1. Advance the official time of the hardware mock by tick ms.
-  /// 2. Process all input events up to the new time. 
+  /// 2. Play all queued edges up to the new time.
+  /// 3. Process all input events up to the new time. 
   /// 
   void advanceTime( int ticks )
   {
     // 1. Advances the official time of the hardware mock by tick ms.
     time+=ticks;
 
-    // 2. Process all input events up to the new time. 
+    // 2. Play all queued edges up to the new time.
+    playStepQueue();
+
+    // 3. Process all input events up to the new time. 
     while ( nextInputEvent != inEvents.end() && 
             nextInputEvent->time <= time )
     {
@@ -135,6 +207,12 @@ class HWMockTimed: public HWI
     }
   }
 
+  /// @brief Move to uSecNow.  The mock's time is in whole ms.
+  void advanceTo( uint64_t uSecNow ) override
+  {
+    advanceTime( static_cast<int>( uSecNow / 1000 ) - time );
+  }
+
   ///
   /// @brief  Get output events for golden result comparison
   ///
@@ -172,6 +250,33 @@ class HWMockTimed: public HWI
 
   private:
 
+  /// @brief Current time in microseconds
+  long long uSecNow() const
+  {
+    return static_cast<long long>( time ) * 1000;
+  }
+
+  /// @brief Record every queued edge that's due by the current time
+  void playStepQueue()
+  {
+    if ( time < msStallUntil )
+    {
+      return;
+    }
+    if ( uSecQueueClock < msStallUntil * 1000ll )
+    {
+      uSecQueueClock = msStallUntil * 1000ll;
+    }
+    QueuedEdge edge;
+    while ( uSecQueueClock <= uSecNow() && stepQueue.pop( edge ))
+    {
+      const int edgeTime = static_cast<int>( uSecQueueClock / 1000 );
+      outEvents.emplace_back( 
+        HWTimedEvent( edgeTime, HWEvent( edge.pin, edge.state ))); 
+      uSecQueueClock += edge.uSecPause;
+    }
+  }
+
   /// @brief  Current tIme
   int time;
   /// @brief  Recorded output events
@@ -182,6 +287,17 @@ class HWMockTimed: public HWI
   HWTimedEvents::const_iterator nextInputEvent;
   /// @brief  The current state of each input pin.
   std::unordered_map<Pin,PinState,EnumHash> inputStates;
+  /// @brief  Does the mock have a step queue?
+  const bool stepQueueEnabled;
+  static constexpr std::size_t stepQueueCapacity = 8;
+  /// @brief  Most edges the queue holds.  See setStepQueueLimit.
+  std::size_t stepQueueLimit;
+  /// @brief  Queued edges aren't played before this time, in ms
+  int msStallUntil;
+  /// @brief  Edges waiting to be played
+  StepQueue< stepQueueCapacity > stepQueue;
+  /// @brief  When the next queued edge is due, in microseconds
+  long long uSecQueueClock;
 };
 
 #endif
@@ -5,7 +5,11 @@
 #ifndef __TEST_MOCK_NET_H__
 #define __TEST_MOCK_NET_H__
 
+#include <algorithm>
+#include <memory>
+#include <vector>
 #include "net_interface.h"
+#include "sim_runner.h"
 #include "test_mock_event.h"
 
 ///
@@ -18,7 +22,8 @@
 ///
 /// - Maintain Time.  
 ///     The class simulates the passage of time.  advanceTime is called to 
-///     "move" time forward
+///     "move" time forward.  The mock is also a SimParticipant, so a
+///     SimRunner can move it forward and jump to its next input.
 /// - Record Output.  
 ///     Whenever a caller outputs a string to the network interface,
 ///     the string and the time the string was outputted are recorded
@@ -29,7 +34,7 @@
 ///     events and the time those events occur at.  i.e.,  the caller can
 ///     say 'at time 20ms the string "HOME" will arrive from the network'
 /// 
-class NetMockSimpleTimed: public NetInterface
+class NetMockSimpleTimed: public NetInterface, public SimParticipant
 {
   public:
 
@@ -42,11 +47,18 @@ class NetMockSimpleTimed: public NetInterface
   ///   interface.  A vector of input strings and the time those
   ///   strings arrive at.
   ///
-  NetMockSimpleTimed( const TimedStringEvents& inputEventsArg)
+  /// @param[in] canWaitArg - Can the mock wait for input?  See
+  ///   waitForInput.
+  ///
+  NetMockSimpleTimed( const TimedStringEvents& inputEventsArg, 
+                      bool canWaitArg = false )
     : inputEvents{inputEventsArg}, 
       time{0},
       nextInputEvent{inputEvents.begin()},
-      currentOutput{}
+      currentOutput{},
+      canWait{ canWaitArg },
+      joining{ false },
+      joinPending{ false }
   {
   }
   
@@ -59,7 +71,10 @@ class NetMockSimpleTimed: public NetInterface
     : inputEvents{ TimedStringEvents( {{ 0, std::string( string ) }}) },
       time{0},
       nextInputEvent{inputEvents.begin()},
-      currentOutput{}
+      currentOutput{},
+      canWait{ false },
+      joining{ false },
+      joinPending{ false }
   {
   }
 
@@ -70,7 +85,10 @@ class NetMockSimpleTimed: public NetInterface
     : inputEvents{},
       time{0},
       nextInputEvent{inputEvents.begin()},
-      currentOutput{}
+      currentOutput{},
+      canWait{ false },
+      joining{ false },
+      joinPending{ false }
   {
   }
 
@@ -125,13 +143,25 @@ class NetMockSimpleTimed: public NetInterface
   /// 1.  If c != 'n', append it to the currentOutput string.
   /// 2.  If c == 'n', append the currentOutput to the outputEvents.
   ///
+  /// While lines are joined (see joinLines) a '\n' becomes "; " if
+  /// more text follows.
+  ///
   void onechar(char c ) 
   {
     if ( c != '\n' )
     {
       // 1.  If c != 'n', append it to the currentOutput string.
+      if ( joinPending )
+      {
+        currentOutput += "; ";
+        joinPending = false;
+      }
       currentOutput  += c;
     }
+    else if ( joining )
+    {
+      joinPending = true;
+    }
     else
     {
       // 2.  If c == 'n', append the currentOutput to the outputEvents.
@@ -153,6 +183,50 @@ class NetMockSimpleTimed: public NetInterface
   {
   }
 
+  /// @brief Join lines.  The mock has one session, so session is ignored.
+  void joinLines( unsigned int session, bool on ) override
+  {
+    (void) session;
+    joining = on;
+    if ( !on && joinPending )
+    {
+      joinPending = false;
+      onechar( '\n' );
+    }
+  }
+
+  /// @brief Can the mock wait for input?  Set at construction.
+  bool canWaitForInput() override
+  {
+    return canWait;
+  }
+
+  ///
+  /// @brief Wait for the next input event, or the timeout
+  ///
+  /// @param[in] uSecTimeout - Longest time to wait, in microseconds
+  /// @return    Time left of uSecTimeout when the next input event 
+  ///            arrives, or 0 if there's no input within uSecTimeout
+  ///
+  /// The mock doesn't move its own time forward.  A SimRunner jumps
+  /// to the input with nextEvent.
+  ///
+  unsigned int waitForInput( unsigned int uSecTimeout ) override
+  {
+    assert( canWait );
+    unsigned int uSecLeft = 0;
+    if ( nextInputEvent != inputEvents.end() )
+    {
+      const long long uSecToInput = 
+        ( (long long) nextInputEvent->time - time ) * 1000;
+      if ( uSecToInput < uSecTimeout )
+      {
+        uSecLeft = uSecTimeout - ( uSecToInput > 0 ? uSecToInput : 0 );
+      }
+    }
+    return uSecLeft;
+  }
+
   ///
   /// @brief      Advance network mock time by "ticks" ms
   /// @param[in]  The amount of time by, in ms
@@ -162,6 +236,22 @@ class NetMockSimpleTimed: public NetInterface
     time+=ticks;
   }
 
+  /// @brief Move to uSecNow.  The mock's time is in whole ms.
+  void advanceTo( uint64_t uSecNow ) override
+  {
+    time = static_cast<int>( uSecNow / 1000 );
+  }
+
+  /// @brief When the next input event arrives, in us
+  uint64_t nextEvent() const override
+  {
+    if ( nextInputEvent == inputEvents.end() )
+    {
+      return never;
+    }
+    return static_cast<uint64_t>( nextInputEvent->time ) * 1000;
+  }
+
   ///
   /// @brief  Get output events for golden result comparison
   ///
@@ -201,6 +291,207 @@ class NetMockSimpleTimed: public NetInterface
   std::string currentOutput;
   /// @brief  Recorded output events
   TimedStringEvents outputEvents;
+  /// @brief  Can the mock wait for input?
+  const bool canWait;
+  /// @brief  Are lines being joined?  See joinLines.
+  bool joining;
+  /// @brief  A joined line ended, and "; " goes out if more text follows
+  bool joinPending;
+};
+
+///
+/// @brief Network mock with several client sessions
+///
+/// Each session is a NetMockSimpleTimed with its own input and output.
+/// getString takes lines from the sessions in order, and writes go to
+/// the session picked with sendTo, or to every subscribed session.
+/// Sessions can switch to binary framing.  Binary frames are recorded
+/// as a line of hex, i.e., "frame: b5 02 03 01 fa".  Text isn't put in
+/// frames - that's the real interface's job.
+///
+/// Example:
+///
+/// @code
+///   NetMockSessions net( { { { 0, "pstatus" } }, {} } );
+///   net.getString( log, line );   // "pstatus", net.getSession() == 0
+///   net.sendTo( 0 );
+///   net << "Position: 0\n";       // Session 0 only
+///   net.sendToSubscribers();
+///   net << "# debug\n";           // Nobody, nobody subscribed
+/// @endcode
+///
+class NetMockSessions: public NetInterface, public SimParticipant
+{
+  public:
+
+  ///
+  /// @param[in] inputs - Input for each session.  One entry per session.
+  ///
+  NetMockSessions( const std::vector<TimedStringEvents>& inputs )
+    : subscribed( inputs.size(), false ), binary( inputs.size(), false ),
+      session{ 0 }, sendToOne{ false }, sendToSession{ 0 },
+      openedSessions{ 0 }
+  {
+    for ( const TimedStringEvents& input : inputs )
+    {
+      sessions.emplace_back( new NetMockSimpleTimed( input ));
+    }
+  }
+
+  void setup( DebugInterface& debugLog ) override
+  {
+  }
+
+  bool getString( WifiDebugOstream& log, std::string& string ) override
+  {
+    for ( std::size_t i = 0; i < sessions.size(); ++i )
+    {
+      if ( sessions[i]->getString( log, string ))
+      {
+        session = static_cast<unsigned int>( i );
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::streamsize write( const char_type* s, std::streamsize n ) override
+  {
+    for ( std::size_t i = 0; i < sessions.size(); ++i )
+    {
+      if ( sendToOne ? i == sendToSession : subscribed[i] )
+      {
+        sessions[i]->write( s, n );
+      }
+    }
+    return n;
+  }
+
+  void flush() override
+  {
+  }
+
+  unsigned int getSession() override
+  {
+    return session;
+  }
+
+  void sendTo( unsigned int sessionArg ) override
+  {
+    sendToOne = true;
+    sendToSession = sessionArg;
+  }
+
+  void sendToSubscribers() override
+  {
+    sendToOne = false;
+  }
+
+  void subscribe( unsigned int sessionArg, bool on ) override
+  {
+    subscribed.at( sessionArg ) = on;
+  }
+
+  bool hasBinary() override
+  {
+    return true;
+  }
+
+  bool isBinary( unsigned int sessionArg ) override
+  {
+    return binary.at( sessionArg );
+  }
+
+  void setBinary( unsigned int sessionArg, bool on ) override
+  {
+    binary.at( sessionArg ) = on;
+  }
+
+  void writeFrame( const uint8_t* frame, std::size_t length ) override
+  {
+    if ( !sendToOne ) return;
+    static const char hex[] = "0123456789abcdef";
+    std::string line = "frame:";
+    for ( std::size_t i = 0; i < length; ++i )
+    {
+      line += ' ';
+      line += hex[ frame[i] >> 4 ];
+      line += hex[ frame[i] & 0xf ];
+    }
+    line += '\n';
+    sessions.at( sendToSession )->write( line.data(), line.length() );
+  }
+
+  void joinLines( unsigned int sessionArg, bool on ) override
+  {
+    sessions.at( sessionArg )->joinLines( 0, on );
+  }
+
+  uint32_t takeOpenedSessions() override
+  {
+    const uint32_t opened = openedSessions;
+    openedSessions = 0;
+    return opened;
+  }
+
+  ///
+  /// @brief A new client takes over a session at msTime
+  ///
+  /// Like the real interfaces, the session starts over unsubscribed 
+  /// and in text mode.  Its output keeps being recorded in one list.
+  ///
+  void reconnect( unsigned int sessionArg, int msTime )
+  {
+    reconnects.push_back( { msTime, sessionArg } );
+  }
+
+  void advanceTo( uint64_t uSecNow ) override
+  {
+    for ( auto& s : sessions ) s->advanceTo( uSecNow );
+    auto reconnected = std::remove_if( reconnects.begin(), reconnects.end(), 
+      [&] ( const Reconnect& r ) 
+      {
+        if ( static_cast<uint64_t>( r.msTime ) * 1000 > uSecNow ) return false;
+        subscribed.at( r.session ) = false;
+        binary.at( r.session ) = false;
+        openedSessions |= 1u << r.session;
+        return true;
+      });
+    reconnects.erase( reconnected, reconnects.end() );
+  }
+
+  uint64_t nextEvent() const override
+  {
+    uint64_t next = never;
+    for ( const auto& s : sessions ) next = std::min( next, s->nextEvent() );
+    for ( const Reconnect& r : reconnects )
+    {
+      next = std::min( next, static_cast<uint64_t>( r.msTime ) * 1000 );
+    }
+    return next;
+  }
+
+  /// @brief Output recorded for one session
+  const TimedStringEvents& getOutput( std::size_t sessionArg )
+  {
+    return sessions.at( sessionArg )->getOutput();
+  }
+
+  private:
+
+  std::vector< std::unique_ptr<NetMockSimpleTimed> > sessions;
+  std::vector< bool > subscribed;
+  std::vector< bool > binary;
+  /// @brief Where the last line came from
+  unsigned int session;
+  bool sendToOne;
+  unsigned int sendToSession;
+  struct Reconnect {
+    int msTime;
+    unsigned int session;
+  };
+  std::vector< Reconnect > reconnects;
+  uint32_t openedSessions;
 };
 
 ///
@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "motion_planner.h"
+#include "focuser_state.h"
+
+/// @brief Run a move through the planner and record every step's pause
+std::vector<unsigned int> planMove( MotionPlanner& planner, int steps )
+{
+  std::vector<unsigned int> pauses;
+  planner.setStepsToGo( steps );
+  for ( int i = 0; i < steps; ++i )
+  {
+    pauses.push_back( planner.nextStepPause() );
+  }
+  planner.stop();
+  return pauses;
+}
+
+/// @brief Total time a move takes, in microseconds (2 edges per step)
+unsigned long long moveTime( const std::vector<unsigned int>& pauses )
+{
+  unsigned long long total = 0;
+  for ( unsigned int pause : pauses )
+  {
+    total += 2 * pause;
+  }
+  return total;
+}
+
+/// @brief No acceleration means a constant pause
+TEST( MOTION_PLANNER, noRampIsConstant )
+{
+  MotionPlanner planner( 1000, 0, 0, 0 );
+  ASSERT_FALSE( planner.isRamped() );
+  for ( unsigned int pause : planMove( planner, 100 ))
+  {
+    ASSERT_EQ( 1000u, pause );
+  }
+}
+
+/// @brief A cruise pause that's slower than the start pause is ignored
+TEST( MOTION_PLANNER, slowCruiseIsIgnored )
+{
+  MotionPlanner planner( 250, 1000, 4000, 4000 );
+  ASSERT_FALSE( planner.isRamped() );
+}
+
+/// @brief Long moves ramp up, cruise, and ramp back down
+TEST( MOTION_PLANNER, trapezoid )
+{
+  MotionPlanner planner( 1000, 250, 4000, 4000 );
+  ASSERT_TRUE( planner.isRamped() );
+
+  const std::vector<unsigned int> pauses = planMove( planner, 5000 );
+
+  // Start and end from rest
+  ASSERT_EQ( 1000u, pauses.front() );
+  ASSERT_EQ( 1000u, pauses.back() );
+
+  // Reach the cruise speed in the middle
+  ASSERT_EQ( 250u, pauses[ 2500 ] );
+
+  // Speed never goes down while accelerating, never up while decelerating
+  for ( size_t i = 1; i <= 2500; ++i )
+  {
+    ASSERT_LE( pauses[i], pauses[i-1] );
+  }
+  for ( size_t i = 2501; i < pauses.size(); ++i )
+  {
+    ASSERT_GE( pauses[i], pauses[i-1] );
+  }
+
+  // Never faster than cruise, never slower than start
+  for ( unsigned int pause : pauses )
+  {
+    ASSERT_GE( pause, 250u );
+    ASSERT_LE( pause, 1000u );
+  }
+}
+
+/// @brief Short moves never reach cruise speed, but still end at rest
+TEST( MOTION_PLANNER, triangle )
+{
+  MotionPlanner planner( 1000, 250, 4000, 4000 );
+  const std::vector<unsigned int> pauses = planMove( planner, 100 );
+
+  ASSERT_EQ( 1000u, pauses.front() );
+  ASSERT_EQ( 1000u, pauses.back() );
+  for ( unsigned int pause : pauses )
+  {
+    ASSERT_GT( pause, 250u );
+  }
+}
+
+/// @brief stop() puts the planner back at the start-from-rest speed
+TEST( MOTION_PLANNER, stopResetsSpeed )
+{
+  MotionPlanner planner( 1000, 250, 4000, 4000 );
+  planner.setStepsToGo( 10000 );
+  for ( int i = 0; i < 1000; ++i ) 
+  {
+    planner.nextStepPause();
+  }
+  ASSERT_LT( planner.nextStepPause(), 1000u );
+  planner.stop();
+  ASSERT_EQ( 1000u, planner.nextStepPause() );
+}
+
+/// @brief Planning stepsToStop more steps brings the motor back to rest
+TEST( MOTION_PLANNER, stepsToStopSlowsDown )
+{
+  MotionPlanner planner( 1000, 250, 4000, 4000 );
+  ASSERT_EQ( 0, planner.stepsToStop() );
+  planner.setStepsToGo( 10000 );
+  for ( int i = 0; i < 1000; ++i )
+  {
+    planner.nextStepPause();
+  }
+  const int stopSteps = planner.stepsToStop();
+  ASSERT_GT( stopSteps, 0 );
+
+  planner.setStepsToGo( stopSteps );
+  unsigned int lastPause = 0;
+  for ( int i = 0; i < stopSteps; ++i )
+  {
+    const unsigned int pause = planner.nextStepPause();
+    ASSERT_GE( pause, lastPause );
+    lastPause = pause;
+  }
+  ASSERT_EQ( 0, planner.stepsToStop() );
+  ASSERT_EQ( 1000u, planner.nextStepPause() );
+}
+
+/// @brief The hyperstar build's long moves should be a lot faster
+TEST( MOTION_PLANNER, hyperstarLongMoveIsFaster )
+{
+  const FS::TimingParams timing = 
+    FS::BuildParams( FS::Build::LOW_POWER_HYPERSTAR_FOCUSER ).timingParams;
+  MotionPlanner ramped( 
+    timing.getMicroSecondStepPause(), 
+    timing.getMicroSecondCruisePause(),
+    timing.getAcceleration(),
+    timing.getDeceleration() );
+  MotionPlanner fixed( timing.getMicroSecondStepPause(), 0, 0, 0 );
+
+  const unsigned long long rampedTime = moveTime( planMove( ramped, 50000 ));
+  const unsigned long long fixedTime  = moveTime( planMove( fixed,  50000 ));
+
+  // 100 seconds without ramping
+  ASSERT_EQ( 100000000ull, fixedTime );
+  // Under 30 seconds with ramping
+  ASSERT_LT( rampedTime, 30000000ull );
+}
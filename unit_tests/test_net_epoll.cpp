@@ -0,0 +1,320 @@
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "focuser_state.h"
+#include "net_epoll.h"
+#include "sim_runner.h"
+#include "wifi_debug_ostream.h"
+#include "test_mock_debug.h"
+#include "test_mock_hardware.h"
+#include "test_mock_net.h"
+
+///
+/// @brief A blocking TCP client on the loopback interface
+///
+class LoopbackClient
+{
+  public:
+
+  LoopbackClient( uint16_t port ) : fd{ socket( AF_INET, SOCK_STREAM, 0 ) }
+  {
+    timeval timeout{ 1, 0 };
+    setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ));
+
+    sockaddr_in address;
+    memset( &address, 0, sizeof( address ));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    address.sin_port = htons( port );
+    connected = connect( fd,
+      reinterpret_cast<sockaddr*>( &address ), sizeof( address )) == 0;
+  }
+
+  ~LoopbackClient()
+  {
+    close();
+  }
+
+  void close()
+  {
+    if ( fd >= 0 ) ::close( fd );
+    fd = -1;
+  }
+
+  void send( const std::string& text )
+  {
+    ::send( fd, text.data(), text.size(), MSG_NOSIGNAL );
+  }
+
+  /// @brief Read until text has arrived.  Gives up after a second.
+  std::string readUntil( const std::string& text )
+  {
+    while ( received.find( text ) == std::string::npos )
+    {
+      char buffer[ 256 ];
+      const ssize_t got = recv( fd, buffer, sizeof( buffer ), 0 );
+      if ( got <= 0 ) break;
+      received.append( buffer, got );
+    }
+    return received;
+  }
+
+  /// @brief Take what's arrived, without waiting for more
+  void readWaiting()
+  {
+    char buffer[ 256 ];
+    ssize_t got;
+    while (( got = recv( fd, buffer, sizeof( buffer ), MSG_DONTWAIT )) > 0 )
+    {
+      received.append( buffer, got );
+    }
+  }
+
+  int fd;
+  bool connected;
+  std::string received;
+};
+
+class NET_EPOLL: public ::testing::Test
+{
+  protected:
+
+  NET_EPOLL() : net( 0 ), log( &debug, &logNet )
+  {
+  }
+
+  void SetUp() override
+  {
+    ASSERT_TRUE( net.open() );
+    ASSERT_NE( 0, net.getPort() );
+  }
+
+  /// @brief Wait for input and take every line it brings
+  std::vector<std::string> poll()
+  {
+    std::vector<std::string> lines;
+    net.waitForInput( 200000 );
+    std::string line;
+    while ( net.getString( log, line ))
+    {
+      lines.push_back( line );
+    }
+    return lines;
+  }
+
+  /// @brief Accept clients that are waiting and send their greetings
+  void accept()
+  {
+    poll();
+    net.flush();
+  }
+
+  NetInterfaceEpoll net;
+  DebugInterfaceIgnoreMock debug;
+  NetMockSimpleTimed logNet;
+  WifiDebugOstream log;
+};
+
+/// @brief A new client is greeted and its lines come back with its session
+TEST_F( NET_EPOLL, linesAndReplies )
+{
+  LoopbackClient a( net.getPort() );
+  LoopbackClient b( net.getPort() );
+  ASSERT_TRUE( a.connected );
+  ASSERT_TRUE( b.connected );
+  accept();
+  a.readUntil( "ready for commands\n" );
+  b.readUntil( "ready for commands\n" );
+
+  b.send( "pstatus\n" );
+  ASSERT_EQ( std::vector<std::string>{ "pstatus" }, poll() );
+  ASSERT_EQ( 1u, net.getSession() );
+
+  net.sendTo( net.getSession() );
+  net << "Position: 100\n";
+  net.flush();
+  ASSERT_NE( std::string::npos, b.readUntil( "Position: 100\n" ).find( "Position: 100\n" ));
+  ASSERT_EQ( std::string::npos, a.received.find( "Position" ));
+}
+
+/// @brief Output that isn't a reply only goes to subscribers
+TEST_F( NET_EPOLL, subscribers )
+{
+  LoopbackClient a( net.getPort() );
+  LoopbackClient b( net.getPort() );
+  accept();
+  a.readUntil( "ready for commands\n" );
+  b.readUntil( "ready for commands\n" );
+
+  net.subscribe( 0, true );
+  net.sendToSubscribers();
+  net << "Event: Position 5\n";
+  net.flush();
+  net.sendTo( 1 );
+  net << "Done\n";
+  net.flush();
+
+  ASSERT_NE( std::string::npos, b.readUntil( "Done\n" ).find( "Done\n" ));
+  ASSERT_NE( std::string::npos, a.readUntil( "Event: Position 5\n" ).find( "Event" ));
+  ASSERT_EQ( std::string::npos, b.received.find( "Event" ));
+}
+
+/// @brief With every slot in use, a new client takes the oldest's slot
+TEST_F( NET_EPOLL, fullSlotsDropAClient )
+{
+  std::vector< std::unique_ptr< LoopbackClient >> clients;
+  for ( std::size_t i = 0; i < NetInterfaceEpoll::maxConnections; ++i )
+  {
+    clients.emplace_back( new LoopbackClient( net.getPort() ));
+  }
+  accept();
+
+  LoopbackClient late( net.getPort() );
+  accept();
+  ASSERT_NE( std::string::npos,
+    clients[0]->readUntil( "Dropping Your Connection.\n" ).find( "Dropping" ));
+  late.readUntil( "ready for commands\n" );
+
+  late.send( "sstatus\n" );
+  ASSERT_EQ( std::vector<std::string>{ "sstatus" }, poll() );
+  ASSERT_EQ( 0u, net.getSession() );
+}
+
+/// @brief waitForInput wakes for input and times out without it
+TEST_F( NET_EPOLL, waitForInput )
+{
+  LoopbackClient a( net.getPort() );
+  accept();
+  ASSERT_EQ( 0u, net.waitForInput( 20000 ));
+
+  a.send( "firmware\n" );
+  ASSERT_NE( 0u, net.waitForInput( 1000000 ));
+  std::string line;
+  ASSERT_TRUE( net.getString( log, line ));
+  ASSERT_EQ( "firmware", line );
+}
+
+/// @brief A client that goes away frees its slot
+TEST_F( NET_EPOLL, disconnectFreesTheSlot )
+{
+  LoopbackClient a( net.getPort() );
+  LoopbackClient b( net.getPort() );
+  accept();
+  a.close();
+  poll();
+
+  LoopbackClient c( net.getPort() );
+  accept();
+  c.send( "caps\n" );
+  ASSERT_EQ( std::vector<std::string>{ "caps" }, poll() );
+  ASSERT_EQ( 0u, net.getSession() );
+  b.send( "caps\n" );
+  ASSERT_EQ( std::vector<std::string>{ "caps" }, poll() );
+  ASSERT_EQ( 1u, net.getSession() );
+}
+
+/// @brief A client that stops reading loses debug lines, then is dropped
+TEST_F( NET_EPOLL, slowClientIsDropped )
+{
+  LoopbackClient slow( net.getPort() );
+  accept();
+  slow.readUntil( "ready for commands\n" );
+
+  // Writes never block, however far behind the client is
+  bool droppedDebug = false;
+  for ( int i = 0; i < 1000000 && net.getConnection( 0 ).getFd() >= 0; ++i )
+  {
+    droppedDebug = droppedDebug ||
+      net.getConnection( 0 ).debugLinesDropped() != 0;
+    net.sendTo( 0 );
+    net << "# Moving " << i << "\n";
+    net << "Position: " << i << "\n";
+    net.flush();
+  }
+  ASSERT_TRUE( droppedDebug );
+  ASSERT_LT( net.getConnection( 0 ).getFd(), 0 );
+
+  // The client gets what the socket took, then sees the close
+  char buffer[ 4096 ];
+  ssize_t got;
+  while (( got = recv( slow.fd, buffer, sizeof( buffer ), 0 )) > 0 )
+  {
+  }
+  ASSERT_EQ( 0, got );
+}
+
+/// @brief A text trace of a full ring goes out whole to a client that
+///        reads it
+TEST( NET_EPOLL_FOCUSER, fullTextTrace )
+{
+  std::unique_ptr<NetInterfaceEpoll> net( new NetInterfaceEpoll( 0 ));
+  ASSERT_TRUE( net->open() );
+  NetInterfaceEpoll* netAlias = net.get();
+  std::unique_ptr<VirtualClock> clock( new VirtualClock );
+  VirtualClock* clockAlias = clock.get();
+  std::unique_ptr<HWMockTimed> hardware( new HWMockTimed( HWTimedEvents( {
+    { 0, { HWI::Pin::HOME, HWI::PinState::HOME_INACTIVE } },
+  })));
+
+  FS::Focuser focuser(
+    std::move( net ),
+    std::move( hardware ),
+    std::move( clock ),
+    std::unique_ptr<DebugInterface>( new DebugInterfaceIgnoreMock ),
+    FS::BuildParams( FS::Build::UNIT_TEST_BUILD_HYPERSTAR ));
+
+  LoopbackClient client( netAlias->getPort() );
+  ASSERT_TRUE( client.connected );
+  auto runUntil = [&] ( const std::string& text )
+  {
+    for ( int i = 0; i < 1000 &&
+      client.received.find( text ) == std::string::npos; ++i )
+    {
+      clockAlias->setTime( clockAlias->uSecNow() + focuser.loop() + 1000 );
+      client.readWaiting();
+    }
+  };
+  runUntil( "ready for commands\n" );
+
+  // Each command adds a record, so this overfills the ring
+  for ( std::size_t i = 0; i <= FS::FocuserTrace::capacity; ++i )
+  {
+    client.received.clear();
+    client.send( "pstatus\n" );
+    runUntil( "Position: 0\n" );
+  }
+
+  client.received.clear();
+  client.send( "trace\npstatus\n" );
+  runUntil( "Position: 0\n" );
+  ASSERT_GE( netAlias->getConnection( 0 ).getFd(), 0 );
+
+  // The header, then the records in hex, 8 to a line
+  std::vector<std::string> traceLines;
+  std::size_t start = 0;
+  for ( std::size_t end;
+    ( end = client.received.find( '\n', start )) != std::string::npos;
+    start = end + 1 )
+  {
+    const std::string line = client.received.substr( start, end - start );
+    if ( line.compare( 0, 7, "Trace: " ) == 0 )
+    {
+      traceLines.push_back( line );
+    }
+  }
+  ASSERT_EQ( 1 + FS::FocuserTrace::capacity / 8, traceLines.size() );
+  ASSERT_EQ( 0u, traceLines[0].find( "Trace: 128 " ));
+  for ( std::size_t i = 1; i < traceLines.size(); ++i )
+  {
+    ASSERT_EQ( 7 + 8 * Trace::recordBytes * 2, traceLines[i].size() );
+  }
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include "simple_ostream.h"
+
+///
+/// @brief Sink that keeps what's written and counts the writes
+///
+class SinkRecord
+{
+  public:
+
+  struct category: beefocus_tag {};
+  using char_type = char;
+
+  SinkRecord() : writes{ 0 }
+  {
+  }
+  std::streamsize write( const char_type* s, std::streamsize n )
+  {
+    text.append( s, n );
+    ++writes;
+    return n;
+  }
+
+  std::string text;
+  unsigned int writes;
+};
+
+template< typename N >
+std::string format( N number )
+{
+  SinkRecord sink;
+  sink << number;
+  return sink.text;
+}
+
+TEST( NUMBER_FORMAT, decimal )
+{
+  ASSERT_EQ( "0", format( 0 ));
+  ASSERT_EQ( "7", format( 7u ));
+  ASSERT_EQ( "10", format( 10 ));
+  ASSERT_EQ( "99", format( 99 ));
+  ASSERT_EQ( "100", format( 100 ));
+  ASSERT_EQ( "-1", format( -1 ));
+  ASSERT_EQ( "-50000", format( -50000 ));
+  ASSERT_EQ( "4294967295", format( std::numeric_limits<unsigned int>::max() ));
+  ASSERT_EQ( "-2147483648", format( std::numeric_limits<int>::min() ));
+  ASSERT_EQ( "4294967296", format( 4294967296ull ));
+  ASSERT_EQ( "18446744073709551615", 
+    format( std::numeric_limits<unsigned long long>::max() ));
+  ASSERT_EQ( "-9223372036854775808", 
+    format( std::numeric_limits<long long>::min() ));
+  ASSERT_EQ( "123456789", format( 123456789l ));
+  ASSERT_EQ( "42", format( static_cast<std::size_t>( 42 )));
+  ASSERT_EQ( "-3", format( static_cast<int64_t>( -3 )));
+}
+
+TEST( NUMBER_FORMAT, hex )
+{
+  ASSERT_EQ( "0", format( BeeFocus::hex( 0 )));
+  ASSERT_EQ( "ff", format( BeeFocus::hex( 255 )));
+  ASSERT_EQ( "00ff", format( BeeFocus::hex( 255, 4 )));
+  ASSERT_EQ( "b5", format( BeeFocus::hex( 0xB5, 2 )));
+  ASSERT_EQ( "123456789abcdef0", format( BeeFocus::hex( 0x123456789abcdef0ull )));
+  ASSERT_EQ( "ffffffffffffffff", format( BeeFocus::hex( UINT64_MAX, 20 )));
+}
+
+TEST( NUMBER_FORMAT, fixed )
+{
+  ASSERT_EQ( "1.250", format( BeeFocus::fixed( 1250, 3 )));
+  ASSERT_EQ( "-1.250", format( BeeFocus::fixed( -1250, 3 )));
+  ASSERT_EQ( "0.005", format( BeeFocus::fixed( 5, 3 )));
+  ASSERT_EQ( "-0.5", format( BeeFocus::fixed( -5, 1 )));
+  ASSERT_EQ( "0.0", format( BeeFocus::fixed( 0, 1 )));
+  ASSERT_EQ( "12", format( BeeFocus::fixed( 12, 0 )));
+  ASSERT_EQ( "-0.9223372036854775808", 
+    format( BeeFocus::fixed( INT64_MIN, 19 )));
+}
+
+/// @brief A number goes to the sink in one write
+TEST( NUMBER_FORMAT, oneWrite )
+{
+  SinkRecord sink;
+  sink << -1234567890;
+  ASSERT_EQ( 1u, sink.writes );
+  sink << BeeFocus::hex( 0xdeadbeef ) << BeeFocus::fixed( 31415, 4 );
+  ASSERT_EQ( 3u, sink.writes );
+  ASSERT_EQ( "-1234567890deadbeef3.1415", sink.text );
+}
@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string>
+#include "output_queue.h"
+
+namespace {
+
+using Queue = OutputQueue< 8, 4 >;
+
+/// @brief A client that takes up to room bytes, then is full
+struct Client {
+  std::size_t operator()( const char* s, std::size_t n )
+  {
+    const std::size_t taken = std::min( n, room );
+    received.append( s, taken );
+    room -= taken;
+    return taken;
+  }
+
+  std::size_t room;
+  std::string received;
+};
+
+void writeText( Queue& queue, const std::string& text )
+{
+  queue.writeText( text.data(), text.size() );
+}
+
+}
+
+/// @brief Output comes out in order, across segments
+TEST( OUTPUT_QUEUE, queueAndDrain )
+{
+  Queue queue;
+  writeText( queue, "Position: 100\n" );
+  writeText( queue, "Done\n" );
+  ASSERT_EQ( 19u, queue.size() );
+
+  Client client{ 1000, "" };
+  queue.drain( std::ref( client ));
+  ASSERT_EQ( "Position: 100\nDone\n", client.received );
+  ASSERT_TRUE( queue.isEmpty() );
+  ASSERT_FALSE( queue.isOverflowed() );
+}
+
+/// @brief A client that takes part of the output gets the rest later
+TEST( OUTPUT_QUEUE, partialDrain )
+{
+  Queue queue;
+  writeText( queue, "0123456789abcdef\n" );
+
+  Client client{ 5, "" };
+  queue.drain( std::ref( client ));
+  ASSERT_EQ( "01234", client.received );
+  ASSERT_EQ( 12u, queue.size() );
+
+  // Room freed by the drain is used again
+  writeText( queue, "0123456789\n" );
+  client.room = 1000;
+  queue.drain( std::ref( client ));
+  ASSERT_EQ( "0123456789abcdef\n0123456789\n", client.received );
+  ASSERT_TRUE( queue.isEmpty() );
+}
+
+/// @brief Past the high water mark debug lines go, replies still fit
+TEST( OUTPUT_QUEUE, debugLinesDropFirst )
+{
+  Queue queue;
+  ASSERT_EQ( 16u, Queue::debugHighWater );
+
+  writeText( queue, "# 0123456789abcdef\n" );
+  ASSERT_EQ( 19u, queue.size() );
+
+  // Dropped whole, even when it comes in pieces
+  writeText( queue, "# Moving" );
+  writeText( queue, " 100\n" );
+  ASSERT_EQ( 19u, queue.size() );
+  ASSERT_EQ( 1u, queue.getDebugDropped() );
+
+  writeText( queue, "Done\n" );
+  ASSERT_EQ( 24u, queue.size() );
+  queue.writeBlock( "#frame", 6, true );
+  ASSERT_EQ( 2u, queue.getDebugDropped() );
+  ASSERT_FALSE( queue.isOverflowed() );
+
+  Client client{ 1000, "" };
+  queue.drain( std::ref( client ));
+  ASSERT_EQ( "# 0123456789abcdef\nDone\n", client.received );
+
+  // Once the client catches up debug lines go out again
+  writeText( queue, "# Hello\n" );
+  ASSERT_EQ( 8u, queue.size() );
+}
+
+/// @brief A reply that doesn't fit overflows the queue, and it stays full
+TEST( OUTPUT_QUEUE, repliesOverflow )
+{
+  Queue queue;
+  writeText( queue, "0123456789012345678901234567\n" );
+  ASSERT_FALSE( queue.isOverflowed() );
+  writeText( queue, "Done\n" );
+  ASSERT_TRUE( queue.isOverflowed() );
+  ASSERT_EQ( 29u, queue.size() );
+
+  // Even after a drain nothing more goes in - the client's too far behind
+  Client client{ 1000, "" };
+  queue.drain( std::ref( client ));
+  writeText( queue, "More\n" );
+  ASSERT_TRUE( queue.isEmpty() );
+
+  queue.reset();
+  ASSERT_FALSE( queue.isOverflowed() );
+  writeText( queue, "More\n" );
+  ASSERT_EQ( 5u, queue.size() );
+}
+
+/// @brief A frame goes in whole or not at all
+TEST( OUTPUT_QUEUE, blocksAreWhole )
+{
+  Queue queue;
+  const char frame[ 20 ] = { 0x7e, 18 };
+  queue.writeBlock( frame, sizeof( frame ), false );
+  ASSERT_EQ( 20u, queue.size() );
+  queue.writeBlock( frame, sizeof( frame ), false );
+  ASSERT_TRUE( queue.isOverflowed() );
+  ASSERT_EQ( 20u, queue.size() );
+
+  Client client{ 1000, "" };
+  queue.drain( std::ref( client ));
+  ASSERT_EQ( std::string( frame, sizeof( frame )), client.received );
+}
+
+/// @brief Debug lines can leave more than half the queue for replies
+TEST( OUTPUT_QUEUE, replyRoom )
+{
+  using BigReplies = OutputQueue< 8, 4, 24 >;
+  ASSERT_EQ( 8u, BigReplies::debugHighWater );
+
+  BigReplies queue;
+  queue.writeText( "# 01234567\n", 11 );
+  queue.writeText( "# Dropped\n", 10 );
+  ASSERT_EQ( 1u, queue.getDebugDropped() );
+
+  // The 21 bytes left take a reply of that size
+  const std::string reply( 20, 'x' );
+  queue.writeText( ( reply + "\n" ).data(), reply.size() + 1 );
+  ASSERT_FALSE( queue.isOverflowed() );
+  ASSERT_EQ( 32u, queue.size() );
+}
@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "binary_protocol.h"
+#include "focuser_state.h"
+#include "trace_decode.h"
+#include "trace_ring.h"
+
+namespace {
+
+bool operator==( const Trace::Record& a, const Trace::Record& b )
+{
+  return a.msTime == b.msTime && a.arg == b.arg &&
+         a.kind == b.kind && a.code == b.code;
+}
+
+}
+
+/// @brief Records come back oldest first, with the time they were added
+TEST( TRACE_RING, addAndRead )
+{
+  TraceRing< 4 > ring;
+  ASSERT_EQ( 0u, ring.size() );
+
+  ring.setTime( 10 );
+  ring.add( Trace::Kind::Command, 6, 1000 );
+  ring.setTime( 12 );
+  ring.add( Trace::Kind::StatePush, 3, 1000 );
+
+  ASSERT_EQ( 2u, ring.size() );
+  ASSERT_EQ( 0u, ring.getLost() );
+  ASSERT_EQ( 10u, ring.at( 0 ).msTime );
+  ASSERT_EQ( Trace::Kind::Command, ring.at( 0 ).kind );
+  ASSERT_EQ( 12u, ring.at( 1 ).msTime );
+  ASSERT_EQ( 3u, ring.at( 1 ).code );
+}
+
+/// @brief A full ring replaces its oldest records and counts them lost
+TEST( TRACE_RING, wrapsAround )
+{
+  TraceRing< 4 > ring;
+  for ( int i = 0; i < 10; ++i )
+  {
+    ring.setTime( i );
+    ring.add( Trace::Kind::PinWrite, 1, i );
+  }
+  ASSERT_EQ( 4u, ring.size() );
+  ASSERT_EQ( 6u, ring.getLost() );
+  for ( std::size_t i = 0; i < ring.size(); ++i )
+  {
+    ASSERT_EQ( static_cast<int32_t>( i + 6 ), ring.at( i ).arg );
+  }
+
+  ring.clear();
+  ASSERT_EQ( 0u, ring.size() );
+  ASSERT_EQ( 0u, ring.getLost() );
+}
+
+/// @brief Records survive encoding, including negative arguments
+TEST( TRACE_RING, encodeDecode )
+{
+  const Trace::Record records[] = {
+    { 0, -1, Trace::Kind::StateReset, 0 },
+    { 0xfedcba98, INT32_MIN, Trace::Kind::StatePop, 7 },
+    { 1, INT32_MAX, Trace::Kind::Command, 255 },
+  };
+  for ( const Trace::Record& record : records )
+  {
+    uint8_t bytes[ Trace::recordBytes ];
+    ASSERT_EQ( bytes + Trace::recordBytes, Trace::encode( record, bytes ));
+    ASSERT_TRUE( record == Trace::decode( bytes ));
+  }
+
+  // Little endian, time first
+  uint8_t bytes[ Trace::recordBytes ];
+  Trace::encode( { 0x04030201, 0x08070605, Trace::Kind::PinWrite, 9 },
+                 bytes );
+  const std::vector<uint8_t> golden =
+    { 1, 2, 3, 4, 4, 9, 5, 6, 7, 8 };
+  ASSERT_EQ( golden, std::vector<uint8_t>( bytes, bytes + sizeof( bytes )));
+}
+
+/// @brief The text form decodes, even joined with other replies
+TEST( TRACE_RING, decodeText )
+{
+  TraceDecoder decoder;
+  ASSERT_FALSE( decoder.addLine( "# Got: trace" ));
+  ASSERT_TRUE( decoder.addLine( "Position: 5; Trace: 2 3" ));
+  ASSERT_FALSE( decoder.isDone() );
+  ASSERT_FALSE( decoder.addLine( "Trace: 0a0000000405ffffffff12" ));
+  ASSERT_TRUE( decoder.addLine(
+    "Trace: 0a000000040102000000" "0b0000000505e8030000" ));
+  ASSERT_TRUE( decoder.isDone() );
+  ASSERT_EQ( 3u, decoder.getLost() );
+
+  ASSERT_EQ( 2u, decoder.getRecords().size() );
+  const Trace::Record pin{ 10, 2, Trace::Kind::PinWrite, 1 };
+  const Trace::Record command{ 11, 1000, Trace::Kind::Command, 5 };
+  ASSERT_TRUE( pin == decoder.getRecords()[0] );
+  ASSERT_TRUE( command == decoder.getRecords()[1] );
+  ASSERT_EQ( "DW (Direction) = Dir Forward",
+             TraceDecoder::describe( decoder.getRecords()[0] ));
+}
+
+/// @brief An empty trace is done after its header
+TEST( TRACE_RING, decodeEmptyText )
+{
+  TraceDecoder decoder;
+  ASSERT_TRUE( decoder.addLine( "Trace: 0 0" ));
+  ASSERT_TRUE( decoder.isDone() );
+  ASSERT_EQ( 0u, decoder.getRecords().size() );
+}
+
+/// @brief Trace frames decode until the TraceEnd frame
+TEST( TRACE_RING, decodeFrames )
+{
+  std::vector<Trace::Record> records;
+  for ( int i = 0; i < 20; ++i )
+  {
+    records.push_back( { static_cast<uint32_t>( i ), -i,
+                         Trace::Kind::StatePush, 3 } );
+  }
+
+  TraceDecoder decoder;
+  uint8_t frame[ BinaryProtocol::maxFrame ];
+  std::size_t sent = 0;
+  while ( sent < records.size() )
+  {
+    const std::size_t count = std::min( BinaryProtocol::maxTraceRecords,
+                                        records.size() - sent );
+    const std::size_t length =
+      BinaryProtocol::encodeTrace( records.data() + sent, count, frame );
+    ASSERT_LE( length, BinaryProtocol::maxFrame );
+    ASSERT_TRUE( decoder.addFrame( frame, length ));
+    sent += count;
+  }
+  ASSERT_FALSE( decoder.isDone() );
+
+  // A bad checksum isn't taken
+  std::size_t length = BinaryProtocol::encodeTraceEnd( 7, frame );
+  frame[ length - 1 ] ^= 1;
+  ASSERT_FALSE( decoder.addFrame( frame, length ));
+  length = BinaryProtocol::encodeTraceEnd( 7, frame );
+  ASSERT_TRUE( decoder.addFrame( frame, length ));
+
+  ASSERT_TRUE( decoder.isDone() );
+  ASSERT_EQ( 7u, decoder.getLost() );
+  ASSERT_EQ( records.size(), decoder.getRecords().size() );
+  for ( std::size_t i = 0; i < records.size(); ++i )
+  {
+    ASSERT_TRUE( records[i] == decoder.getRecords()[i] );
+  }
+}
+
+/// @brief Each kind of record gets a readable description
+TEST( TRACE_RING, describe )
+{
+  ASSERT_EQ( "push MOVING 1000", TraceDecoder::describe(
+    { 0, 1000, Trace::Kind::StatePush,
+      static_cast<uint8_t>( FS::State::MOVING ) } ));
+  ASSERT_EQ( "pop SET_DIR 1", TraceDecoder::describe(
+    { 0, 1, Trace::Kind::StatePop,
+      static_cast<uint8_t>( FS::State::SET_DIR ) } ));
+  ASSERT_EQ( "reset", TraceDecoder::describe(
+    { 0, -1, Trace::Kind::StateReset, 0 } ));
+  ASSERT_EQ( "command abs_pos=1000", TraceDecoder::describe(
+    { 0, 1000, Trace::Kind::Command,
+      static_cast<uint8_t>( CommandParser::Command::ABSPos ) } ));
+  ASSERT_EQ( "command pstatus", TraceDecoder::describe(
+    { 0, -1, Trace::Kind::Command,
+      static_cast<uint8_t>( CommandParser::Command::PStatus ) } ));
+  ASSERT_EQ( "DW ? 99", TraceDecoder::describe(
+    { 0, 99, Trace::Kind::PinWrite, 1 } ));
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include "wifi_debug_ostream.h"
+#include "test_mock_debug.h"
+
+///
+/// @brief Net interface that keeps what's written and counts the writes
+///
+class NetMockRecord: public NetInterface
+{
+  public:
+
+  NetMockRecord() : writes{ 0 }
+  {
+  }
+  void setup( DebugInterface& debugLog ) override
+  {
+    (void) debugLog;
+  }
+  bool getString( WifiDebugOstream& log, std::string& string ) override
+  {
+    (void) log;
+    (void) string;
+    return false;
+  }
+  std::streamsize write( const char_type* s, std::streamsize n ) override
+  {
+    text.append( s, n );
+    ++writes;
+    return n;
+  }
+  void flush() override
+  {
+  }
+
+  std::string text;
+  unsigned int writes;
+};
+
+/// @brief Every line that goes to the net is a comment
+TEST( WIFI_DEBUG_OSTREAM, linesAreComments )
+{
+  DebugInterfaceRecordMock debug;
+  NetMockRecord net;
+  WifiDebugOstream log( &debug, &net );
+
+  log << "Moving " << 100 << "\n";
+  log << "Hit home\nResetting position to 0\n";
+
+  ASSERT_EQ( "Moving 100\nHit home\nResetting position to 0\n", debug.text );
+  ASSERT_EQ( "# Moving 100\n# Hit home\n# Resetting position to 0\n", net.text );
+}
+
+/// @brief Empty lines aren't prefixed and a line can arrive in pieces
+TEST( WIFI_DEBUG_OSTREAM, piecesAndEmptyLines )
+{
+  DebugInterfaceRecordMock debug;
+  NetMockRecord net;
+  WifiDebugOstream log( &debug, &net );
+
+  log << "\n";
+  log << "a";
+  log << "b";
+  log << "\n\nc\n";
+
+  ASSERT_EQ( "\nab\n\nc\n", debug.text );
+  ASSERT_EQ( "\n# ab\n\n# c\n", net.text );
+}
+
+/// @brief A line goes to the net in one write, not one per character
+TEST( WIFI_DEBUG_OSTREAM, aLineIsOneWrite )
+{
+  DebugInterfaceIgnoreMock debug;
+  NetMockRecord net;
+  WifiDebugOstream log( &debug, &net );
+
+  log << "Processing a request with a long name\n";
+
+  // The "# " prefix and the line.
+  ASSERT_EQ( 2u, net.writes );
+}